@@ -0,0 +1,40 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <type_traits>
+
+// Numeric command line values are parsed strictly. Only digits are accepted,
+// so a sign, whitespace or trailing characters fail, and so does anything
+// the field's type cannot hold. std::stoul would wrap "-1" around and the
+// assignment to a narrower field would silently truncate.
+
+// values below minValue are raised to it, like the clamps they replace
+template <typename T>
+inline bool parseUnsignedArgument(const std::string &valueString, T *valuePtr,
+                                  std::type_identity_t<T> minValue = 0) {
+  if (valueString.empty()) {
+    return false;
+  }
+
+  uint64_t maxValue = (uint64_t)std::numeric_limits<T>::max();
+  uint64_t value = 0;
+
+  for (char character : valueString) {
+    if (character < '0' || character > '9') {
+      return false;
+    }
+
+    uint64_t digit = character - '0';
+    if (value > (maxValue - digit) / 10) {
+      return false;
+    }
+
+    value = value * 10 + digit;
+  }
+
+  *valuePtr = std::max((T)value, minValue);
+  return true;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Where each example keeps its VkPipelineCache between runs, and reading and
+// writing that file. A cache is only handed back to the driver when its
+// header matches the device, and it is replaced atomically on write.
+
+// the user's cache directory, or the install's share directory without one
+inline std::string getCacheDirectoryPath() {
+  const char *cacheHomePtr = std::getenv("XDG_CACHE_HOME");
+  const char *homePtr = std::getenv("HOME");
+#if defined(_WIN32)
+  const char *localAppDataPtr = std::getenv("LOCALAPPDATA");
+#endif
+
+  if (cacheHomePtr != NULL && cacheHomePtr[0] != '\0') {
+    return cacheHomePtr;
+  } else if (homePtr != NULL && homePtr[0] != '\0') {
+    return std::string(homePtr) + "/.cache";
+#if defined(_WIN32)
+  } else if (localAppDataPtr != NULL && localAppDataPtr[0] != '\0') {
+    return localAppDataPtr;
+#endif
+  }
+
+  // install local directory
+  return std::string(SHARE_PATH) + "/cache";
+}
+
+inline std::string getPipelineCachePath(const std::string &cacheDirectoryPath,
+                                        const std::string &exampleName) {
+  return cacheDirectoryPath + "/vulkan_development/" + exampleName +
+         "/pipeline_cache.bin";
+}
+
+inline std::vector<char> readPipelineCacheFile(
+    const std::string &pipelineCachePath,
+    const VkPhysicalDeviceProperties &physicalDeviceProperties) {
+  std::ifstream pipelineCacheFile(pipelineCachePath,
+                                  std::ios::binary | std::ios::ate);
+
+  if (!pipelineCacheFile) {
+    return {};
+  }
+
+  std::streamsize pipelineCacheFileSize = pipelineCacheFile.tellg();
+  pipelineCacheFile.seekg(0, std::ios::beg);
+
+  std::vector<char> pipelineCacheData(pipelineCacheFileSize);
+  pipelineCacheFile.read(pipelineCacheData.data(), pipelineCacheFileSize);
+
+  if (!pipelineCacheFile) {
+    return {};
+  }
+
+  // VkPipelineCacheHeaderVersionOne: headerSize, headerVersion, vendorID,
+  // deviceID, pipelineCacheUUID
+  uint32_t headerList[4];
+  if (pipelineCacheData.size() < sizeof(headerList) + VK_UUID_SIZE) {
+    return {};
+  }
+
+  memcpy(headerList, pipelineCacheData.data(), sizeof(headerList));
+
+  if (headerList[0] < sizeof(headerList) + VK_UUID_SIZE ||
+      headerList[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+      headerList[2] != physicalDeviceProperties.vendorID ||
+      headerList[3] != physicalDeviceProperties.deviceID ||
+      memcmp(pipelineCacheData.data() + sizeof(headerList),
+             physicalDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+    return {};
+  }
+
+  return pipelineCacheData;
+}
+
+inline void writePipelineCacheFile(const std::string &pipelineCachePath,
+                                   const std::vector<char> &pipelineCacheData) {
+  std::error_code errorCode;
+  std::filesystem::create_directories(
+      std::filesystem::path(pipelineCachePath).parent_path(), errorCode);
+
+  // written next to the destination and renamed over it, so readers never
+  // see a partially written cache
+  std::string temporaryPath =
+      pipelineCachePath + ".tmp" +
+      std::to_string(
+          std::chrono::steady_clock::now().time_since_epoch().count());
+
+  std::ofstream pipelineCacheFile(temporaryPath,
+                                  std::ios::binary | std::ios::trunc);
+  pipelineCacheFile.write(pipelineCacheData.data(), pipelineCacheData.size());
+  pipelineCacheFile.close();
+
+  if (!pipelineCacheFile) {
+    std::filesystem::remove(temporaryPath, errorCode);
+    return;
+  }
+
+  std::filesystem::rename(temporaryPath, pipelineCachePath, errorCode);
+
+  if (errorCode) {
+    std::filesystem::remove(temporaryPath, errorCode);
+  }
+}
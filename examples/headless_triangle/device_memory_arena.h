@@ -0,0 +1,541 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <iostream>
+#include <set>
+#include <vector>
+
+// Sub-allocates buffers and images out of large VkDeviceMemory blocks, one
+// block list per memory type. Each block is managed by a buddy allocator whose
+// smallest node is at least bufferImageGranularity, so every allocation is
+// aligned to its own (power of two) size and linear and optimal resources can
+// never share a granularity page. Host visible blocks are mapped once for
+// their whole lifetime.
+
+struct DeviceMemoryAllocation {
+  VkDeviceMemory deviceMemoryHandle = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  void *hostMemoryPtr = NULL;
+
+  uint32_t memoryTypeIndex = -1;
+
+  // -1 for a dedicated allocation, which owns its VkDeviceMemory
+  uint32_t blockIndex = -1;
+  uint32_t order = 0;
+};
+
+struct DeviceMemoryBlock {
+  VkDeviceMemory deviceMemoryHandle = VK_NULL_HANDLE;
+  VkDeviceSize size = 0;
+  void *hostMemoryPtr = NULL;
+
+  uint32_t maxOrder = 0;
+  std::vector<std::set<VkDeviceSize>> freeOffsetSetList;
+
+  VkDeviceSize usedSize = 0;
+  uint32_t allocationCount = 0;
+};
+
+// what an allocation is for, ranks the memory types that could hold it
+enum DeviceMemoryUsage {
+  // only the device reads and writes it
+  DEVICE_MEMORY_USAGE_DEVICE,
+  // written by the host through a mapping, read by the device
+  DEVICE_MEMORY_USAGE_UPLOAD,
+  // written by the device, read by the host through a mapping
+  DEVICE_MEMORY_USAGE_READBACK,
+  // an attachment that only lives inside a render pass, e.g. depth or
+  // multisample color that is never stored. Lazily allocated memory may
+  // never be backed at all on tilers, device local memory stands in for it
+  DEVICE_MEMORY_USAGE_TRANSIENT
+};
+
+struct DeviceMemoryArena {
+  VkDevice deviceHandle = VK_NULL_HANDLE;
+  VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties = {};
+
+  // host reads and writes of memory that is not HOST_COHERENT are made
+  // visible in multiples of this
+  VkDeviceSize nonCoherentAtomSize = 1;
+
+  VkDeviceSize minNodeSize = 256;
+  VkDeviceSize blockSize = 64 * 1024 * 1024;
+
+  std::vector<DeviceMemoryBlock> blockList[VK_MAX_MEMORY_TYPES];
+
+  uint32_t deviceMemoryAllocationCount = 0;
+  uint32_t allocationCount = 0;
+};
+
+inline uint32_t findMemoryTypeIndex(
+    const VkPhysicalDeviceMemoryProperties &physicalDeviceMemoryProperties,
+    uint32_t memoryTypeBits, VkMemoryPropertyFlags memoryPropertyFlags) {
+
+  for (uint32_t x = 0; x < physicalDeviceMemoryProperties.memoryTypeCount;
+       x++) {
+    if ((memoryTypeBits & (1 << x)) &&
+        (physicalDeviceMemoryProperties.memoryTypes[x].propertyFlags &
+         memoryPropertyFlags) == memoryPropertyFlags) {
+
+      return x;
+    }
+  }
+
+  return -1;
+}
+
+// higher is better, negative when the type can not serve the usage at all
+inline int32_t getMemoryTypeScore(VkMemoryPropertyFlags propertyFlags,
+                                  DeviceMemoryUsage usage) {
+  bool isDeviceLocal = propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  bool isHostVisible = propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+  bool isHostCoherent = propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  bool isHostCached = propertyFlags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+  bool isLazilyAllocated =
+      propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+
+  // lazily allocated memory can only back transient attachments
+  if ((propertyFlags & VK_MEMORY_PROPERTY_PROTECTED_BIT) ||
+      (isLazilyAllocated && usage != DEVICE_MEMORY_USAGE_TRANSIENT)) {
+    return -1;
+  }
+
+  switch (usage) {
+  case DEVICE_MEMORY_USAGE_DEVICE:
+    // host visible device memory is a small BAR window on discrete GPUs,
+    // keep it for the allocations that are mapped
+    if (!isDeviceLocal) {
+      return -1;
+    }
+    return isHostVisible ? 1 : 2;
+  case DEVICE_MEMORY_USAGE_UPLOAD:
+    // the host only writes sequentially, write combined memory is as fast
+    // as cached memory for that and the device reads it without snooping
+    if (!isHostVisible || !isHostCoherent) {
+      return -1;
+    }
+    return (isDeviceLocal ? 2 : 0) + (isHostCached ? 0 : 1);
+  case DEVICE_MEMORY_USAGE_READBACK:
+    // uncached reads are an order of magnitude slower, a cached type that
+    // needs vkInvalidateMappedMemoryRanges is still far ahead
+    if (!isHostVisible) {
+      return -1;
+    }
+    return (isHostCached ? 4 : 0) + (isHostCoherent ? 2 : 0) +
+           (isDeviceLocal ? 0 : 1);
+  case DEVICE_MEMORY_USAGE_TRANSIENT:
+    if (!isDeviceLocal) {
+      return -1;
+    }
+    return isLazilyAllocated ? 3 : isHostVisible ? 1 : 2;
+  }
+
+  return -1;
+}
+
+inline uint32_t findMemoryTypeIndexForUsage(
+    const VkPhysicalDeviceMemoryProperties &physicalDeviceMemoryProperties,
+    uint32_t memoryTypeBits, DeviceMemoryUsage usage) {
+
+  uint32_t memoryTypeIndex = -1;
+  int32_t bestScore = -1;
+
+  for (uint32_t x = 0; x < physicalDeviceMemoryProperties.memoryTypeCount;
+       x++) {
+    if (!(memoryTypeBits & (1 << x))) {
+      continue;
+    }
+
+    int32_t score = getMemoryTypeScore(
+        physicalDeviceMemoryProperties.memoryTypes[x].propertyFlags, usage);
+
+    if (score > bestScore) {
+      memoryTypeIndex = x;
+      bestScore = score;
+    }
+  }
+
+  return memoryTypeIndex;
+}
+
+inline VkDeviceSize getPowerOfTwoCeiling(VkDeviceSize value) {
+  VkDeviceSize powerOfTwo = 1;
+  while (powerOfTwo < value) {
+    powerOfTwo <<= 1;
+  }
+
+  return powerOfTwo;
+}
+
+inline void createDeviceMemoryArena(
+    DeviceMemoryArena &arena, VkDevice deviceHandle,
+    const VkPhysicalDeviceMemoryProperties &physicalDeviceMemoryProperties,
+    VkDeviceSize bufferImageGranularity, VkDeviceSize nonCoherentAtomSize) {
+
+  arena.deviceHandle = deviceHandle;
+  arena.physicalDeviceMemoryProperties = physicalDeviceMemoryProperties;
+  arena.nonCoherentAtomSize = nonCoherentAtomSize;
+  arena.minNodeSize = getPowerOfTwoCeiling(
+      std::max(arena.minNodeSize, bufferImageGranularity));
+  arena.blockSize = std::max(arena.blockSize, arena.minNodeSize);
+}
+
+inline VkResult createDeviceMemoryBlock(DeviceMemoryArena &arena,
+                                        uint32_t memoryTypeIndex,
+                                        VkDeviceSize blockSize) {
+  DeviceMemoryBlock block;
+  block.size = blockSize;
+
+  while ((arena.minNodeSize << block.maxOrder) < blockSize) {
+    block.maxOrder += 1;
+  }
+
+  block.freeOffsetSetList.resize(block.maxOrder + 1);
+  block.freeOffsetSetList[block.maxOrder].insert(0);
+
+  VkMemoryAllocateInfo memoryAllocateInfo = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+      .pNext = NULL,
+      .allocationSize = blockSize,
+      .memoryTypeIndex = memoryTypeIndex};
+
+  VkResult result = vkAllocateMemory(arena.deviceHandle, &memoryAllocateInfo,
+                                     NULL, &block.deviceMemoryHandle);
+
+  if (result != VK_SUCCESS) {
+    return result;
+  }
+
+  if (arena.physicalDeviceMemoryProperties.memoryTypes[memoryTypeIndex]
+          .propertyFlags &
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+
+    result = vkMapMemory(arena.deviceHandle, block.deviceMemoryHandle, 0,
+                         VK_WHOLE_SIZE, 0, &block.hostMemoryPtr);
+
+    if (result != VK_SUCCESS) {
+      vkFreeMemory(arena.deviceHandle, block.deviceMemoryHandle, NULL);
+      return result;
+    }
+  }
+
+  arena.blockList[memoryTypeIndex].push_back(block);
+  arena.deviceMemoryAllocationCount += 1;
+
+  return VK_SUCCESS;
+}
+
+inline bool allocateDeviceMemoryBlockNode(DeviceMemoryBlock &block,
+                                          uint32_t order,
+                                          VkDeviceSize minNodeSize,
+                                          VkDeviceSize *offsetPtr) {
+  if (order > block.maxOrder) {
+    return false;
+  }
+
+  uint32_t freeOrder = order;
+  while (freeOrder <= block.maxOrder &&
+         block.freeOffsetSetList[freeOrder].empty()) {
+    freeOrder += 1;
+  }
+
+  if (freeOrder > block.maxOrder) {
+    return false;
+  }
+
+  VkDeviceSize offset = *block.freeOffsetSetList[freeOrder].begin();
+  block.freeOffsetSetList[freeOrder].erase(
+      block.freeOffsetSetList[freeOrder].begin());
+
+  // split down to the requested order, keeping the upper halves free
+  while (freeOrder > order) {
+    freeOrder -= 1;
+    block.freeOffsetSetList[freeOrder].insert(offset +
+                                              (minNodeSize << freeOrder));
+  }
+
+  *offsetPtr = offset;
+  return true;
+}
+
+inline VkResult allocateDeviceMemoryFromType(
+    DeviceMemoryArena &arena, const VkMemoryRequirements &memoryRequirements,
+    uint32_t memoryTypeIndex, DeviceMemoryAllocation *allocationPtr) {
+
+  VkDeviceSize nodeSize = getPowerOfTwoCeiling(
+      std::max({memoryRequirements.size, memoryRequirements.alignment,
+                arena.minNodeSize}));
+
+  uint32_t order = 0;
+  while ((arena.minNodeSize << order) < nodeSize) {
+    order += 1;
+  }
+
+  std::vector<DeviceMemoryBlock> &blockList = arena.blockList[memoryTypeIndex];
+
+  VkDeviceSize offset = 0;
+  uint32_t blockIndex = 0;
+  for (; blockIndex < blockList.size(); blockIndex++) {
+    if (allocateDeviceMemoryBlockNode(blockList[blockIndex], order,
+                                      arena.minNodeSize, &offset)) {
+      break;
+    }
+  }
+
+  if (blockIndex == blockList.size()) {
+    VkResult result = createDeviceMemoryBlock(
+        arena, memoryTypeIndex, std::max(arena.blockSize, nodeSize));
+
+    // small heaps (e.g. a 256 MiB BAR) may not fit a full block
+    if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY && nodeSize < arena.blockSize) {
+      result = createDeviceMemoryBlock(arena, memoryTypeIndex, nodeSize);
+    }
+
+    if (result != VK_SUCCESS) {
+      return result;
+    }
+
+    allocateDeviceMemoryBlockNode(blockList[blockIndex], order,
+                                  arena.minNodeSize, &offset);
+  }
+
+  DeviceMemoryBlock &block = blockList[blockIndex];
+  block.usedSize += nodeSize;
+  block.allocationCount += 1;
+  arena.allocationCount += 1;
+
+  allocationPtr->deviceMemoryHandle = block.deviceMemoryHandle;
+  allocationPtr->offset = offset;
+  allocationPtr->size = memoryRequirements.size;
+  allocationPtr->hostMemoryPtr =
+      block.hostMemoryPtr != NULL ? (char *)block.hostMemoryPtr + offset
+                                  : NULL;
+  allocationPtr->memoryTypeIndex = memoryTypeIndex;
+  allocationPtr->blockIndex = blockIndex;
+  allocationPtr->order = order;
+
+  return VK_SUCCESS;
+}
+
+inline VkResult allocateDeviceMemory(
+    DeviceMemoryArena &arena, const VkMemoryRequirements &memoryRequirements,
+    DeviceMemoryUsage usage, DeviceMemoryAllocation *allocationPtr) {
+
+  uint32_t memoryTypeIndex = findMemoryTypeIndexForUsage(
+      arena.physicalDeviceMemoryProperties, memoryRequirements.memoryTypeBits,
+      usage);
+
+  if (memoryTypeIndex == (uint32_t)-1) {
+    return VK_ERROR_FEATURE_NOT_PRESENT;
+  }
+
+  return allocateDeviceMemoryFromType(arena, memoryRequirements,
+                                      memoryTypeIndex, allocationPtr);
+}
+
+// a VkDeviceMemory of its own bound to a single image, outside the blocks.
+// For images whose memory is shared with another process, which exports the
+// whole allocation. nextPtr is chained after the dedicated allocation info,
+// e.g. a VkExportMemoryAllocateInfo
+inline VkResult allocateDedicatedDeviceMemory(
+    DeviceMemoryArena &arena, const VkMemoryRequirements &memoryRequirements,
+    DeviceMemoryUsage usage, VkImage imageHandle, const void *nextPtr,
+    DeviceMemoryAllocation *allocationPtr) {
+
+  uint32_t memoryTypeIndex = findMemoryTypeIndexForUsage(
+      arena.physicalDeviceMemoryProperties, memoryRequirements.memoryTypeBits,
+      usage);
+
+  if (memoryTypeIndex == (uint32_t)-1) {
+    return VK_ERROR_FEATURE_NOT_PRESENT;
+  }
+
+  VkMemoryDedicatedAllocateInfo memoryDedicatedAllocateInfo = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+      .pNext = nextPtr,
+      .image = imageHandle,
+      .buffer = VK_NULL_HANDLE};
+
+  VkMemoryAllocateInfo memoryAllocateInfo = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+      .pNext = &memoryDedicatedAllocateInfo,
+      .allocationSize = memoryRequirements.size,
+      .memoryTypeIndex = memoryTypeIndex};
+
+  VkResult result =
+      vkAllocateMemory(arena.deviceHandle, &memoryAllocateInfo, NULL,
+                       &allocationPtr->deviceMemoryHandle);
+
+  if (result != VK_SUCCESS) {
+    return result;
+  }
+
+  arena.deviceMemoryAllocationCount += 1;
+  arena.allocationCount += 1;
+
+  allocationPtr->offset = 0;
+  allocationPtr->size = memoryRequirements.size;
+  allocationPtr->hostMemoryPtr = NULL;
+  allocationPtr->memoryTypeIndex = memoryTypeIndex;
+  allocationPtr->blockIndex = -1;
+  allocationPtr->order = 0;
+
+  return VK_SUCCESS;
+}
+
+inline bool
+isDeviceMemoryHostCoherent(const DeviceMemoryArena &arena,
+                           const DeviceMemoryAllocation &allocation) {
+  return arena.physicalDeviceMemoryProperties
+             .memoryTypes[allocation.memoryTypeIndex]
+             .propertyFlags &
+         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+inline bool
+isDeviceMemoryLazilyAllocated(const DeviceMemoryArena &arena,
+                              const DeviceMemoryAllocation &allocation) {
+  return arena.physicalDeviceMemoryProperties
+             .memoryTypes[allocation.memoryTypeIndex]
+             .propertyFlags &
+         VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+}
+
+// makes device writes to [offset, offset + size) of a mapped allocation
+// visible to the host, a no-op for coherent memory. The range is widened to
+// whole atoms, which stays inside the buddy node the allocation owns, or
+// inside the VkDeviceMemory of a dedicated allocation
+inline VkResult invalidateDeviceMemory(DeviceMemoryArena &arena,
+                                       const DeviceMemoryAllocation &allocation,
+                                       VkDeviceSize offset,
+                                       VkDeviceSize size) {
+  if (isDeviceMemoryHostCoherent(arena, allocation)) {
+    return VK_SUCCESS;
+  }
+
+  // a dedicated allocation is its whole VkDeviceMemory, with no block
+  VkDeviceSize memorySize =
+      allocation.blockIndex == (uint32_t)-1
+          ? allocation.size
+          : arena.blockList[allocation.memoryTypeIndex][allocation.blockIndex]
+                .size;
+
+  VkDeviceSize startOffset = (allocation.offset + offset) /
+                             arena.nonCoherentAtomSize *
+                             arena.nonCoherentAtomSize;
+  VkDeviceSize endOffset =
+      std::min((allocation.offset + offset + size + arena.nonCoherentAtomSize -
+                1) / arena.nonCoherentAtomSize * arena.nonCoherentAtomSize,
+               memorySize);
+
+  VkMappedMemoryRange mappedMemoryRange = {
+      .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+      .pNext = NULL,
+      .memory = allocation.deviceMemoryHandle,
+      .offset = startOffset,
+      .size = endOffset - startOffset};
+
+  return vkInvalidateMappedMemoryRanges(arena.deviceHandle, 1,
+                                        &mappedMemoryRange);
+}
+
+inline void freeDeviceMemory(DeviceMemoryArena &arena,
+                             const DeviceMemoryAllocation &allocation) {
+  if (allocation.blockIndex == (uint32_t)-1) {
+    vkFreeMemory(arena.deviceHandle, allocation.deviceMemoryHandle, NULL);
+
+    arena.deviceMemoryAllocationCount -= 1;
+    arena.allocationCount -= 1;
+    return;
+  }
+
+  DeviceMemoryBlock &block =
+      arena.blockList[allocation.memoryTypeIndex][allocation.blockIndex];
+
+  VkDeviceSize offset = allocation.offset;
+  uint32_t order = allocation.order;
+
+  block.usedSize -= arena.minNodeSize << order;
+  block.allocationCount -= 1;
+  arena.allocationCount -= 1;
+
+  // merge with the buddy for as long as it is free
+  while (order < block.maxOrder) {
+    VkDeviceSize buddyOffset = offset ^ (arena.minNodeSize << order);
+
+    auto buddyIterator = block.freeOffsetSetList[order].find(buddyOffset);
+    if (buddyIterator == block.freeOffsetSetList[order].end()) {
+      break;
+    }
+
+    block.freeOffsetSetList[order].erase(buddyIterator);
+    offset = std::min(offset, buddyOffset);
+    order += 1;
+  }
+
+  block.freeOffsetSetList[order].insert(offset);
+}
+
+// bytes the implementation has actually backed for the blocks of a memory
+// type, only lazily allocated memory can report less than the block sizes
+inline VkDeviceSize getDeviceMemoryCommitment(const DeviceMemoryArena &arena,
+                                              uint32_t memoryTypeIndex) {
+  VkDeviceSize committedSize = 0;
+
+  for (const DeviceMemoryBlock &block : arena.blockList[memoryTypeIndex]) {
+    VkDeviceSize blockCommittedSize = 0;
+    vkGetDeviceMemoryCommitment(arena.deviceHandle, block.deviceMemoryHandle,
+                                &blockCommittedSize);
+
+    committedSize += blockCommittedSize;
+  }
+
+  return committedSize;
+}
+
+inline void destroyDeviceMemoryArena(DeviceMemoryArena &arena) {
+  for (uint32_t x = 0; x < VK_MAX_MEMORY_TYPES; x++) {
+    for (DeviceMemoryBlock &block : arena.blockList[x]) {
+      if (block.hostMemoryPtr != NULL) {
+        vkUnmapMemory(arena.deviceHandle, block.deviceMemoryHandle);
+      }
+
+      vkFreeMemory(arena.deviceHandle, block.deviceMemoryHandle, NULL);
+    }
+
+    arena.blockList[x].clear();
+  }
+
+  arena.deviceMemoryAllocationCount = 0;
+  arena.allocationCount = 0;
+}
+
+inline void printDeviceMemoryArenaStatistics(std::ostream &stream,
+                                             const DeviceMemoryArena &arena) {
+  stream << "device memory arena: " << arena.allocationCount
+         << " allocations in " << arena.deviceMemoryAllocationCount
+         << " vkAllocateMemory blocks" << std::endl;
+
+  for (uint32_t x = 0; x < VK_MAX_MEMORY_TYPES; x++) {
+    if (arena.blockList[x].empty()) {
+      continue;
+    }
+
+    VkDeviceSize blockSize = 0, usedSize = 0;
+    uint32_t allocationCount = 0;
+    for (const DeviceMemoryBlock &block : arena.blockList[x]) {
+      blockSize += block.size;
+      usedSize += block.usedSize;
+      allocationCount += block.allocationCount;
+    }
+
+    stream << "  memory type " << x << " (flags 0x" << std::hex
+           << arena.physicalDeviceMemoryProperties.memoryTypes[x].propertyFlags
+           << std::dec << "): " << arena.blockList[x].size() << " blocks, "
+           << allocationCount << " allocations, " << usedSize << " / "
+           << blockSize << " bytes used" << std::endl;
+  }
+}
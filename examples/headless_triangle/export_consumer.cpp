@@ -0,0 +1,703 @@
+#include <vulkan/vulkan.h>
+
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <string>
+#include <chrono>
+#include <thread>
+
+#include "device_memory_arena.h"
+#include "frame_export.h"
+
+// Reads the frames headless_triangle --export=SOCKET_PATH renders, straight
+// out of its render targets. It imports every slot's memory and semaphore,
+// copies each announced frame into a host visible buffer on its own queue,
+// checks the pixels and hands the slot back. Start it once the producer is
+// waiting for a consumer, or before, it retries the connection for a while.
+
+void throwExceptionVulkanAPI(VkResult result, const std::string &functionName) {
+  std::string message = "Vulkan API exception: return code " +
+                        std::to_string(result) + " (" + functionName + ")";
+
+  std::cerr << message.c_str() << std::endl;
+
+  throw std::runtime_error(message);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    std::cerr << "usage: export_consumer SOCKET_PATH" << std::endl;
+    return 1;
+  }
+
+  std::string socketPath = argv[1];
+
+  VkResult result;
+
+  // =========================================================================
+  // Producer Connection
+
+  sockaddr_un address;
+  if (!getFrameExportAddress(socketPath, &address)) {
+    throw std::runtime_error("Socket path too long: " + socketPath);
+  }
+
+  int socketDescriptor = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (socketDescriptor < 0) {
+    throw std::runtime_error("Could not create socket");
+  }
+
+  // the producer only listens once its device and render targets exist
+  bool isConnected = false;
+  for (uint32_t x = 0; x < 300 && !isConnected; x++) {
+    isConnected = connect(socketDescriptor, (sockaddr *)&address,
+                          sizeof(address)) == 0;
+
+    if (!isConnected) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+  }
+
+  if (!isConnected) {
+    throw std::runtime_error("Could not connect to producer: " + socketPath);
+  }
+
+  FrameExportMessage deviceMessage;
+  if (!receiveFrameExportMessage(socketDescriptor, &deviceMessage, NULL) ||
+      deviceMessage.type != FRAME_EXPORT_MESSAGE_TYPE_DEVICE) {
+    throw std::runtime_error("Producer sent no device message");
+  }
+
+  uint32_t slotCount = deviceMessage.slotCount;
+  VkExtent2D imageExtent = deviceMessage.imageExtent;
+
+  std::cout << "producer: " << slotCount << " slots, " << imageExtent.width
+            << "x" << imageExtent.height << std::endl;
+
+  // =========================================================================
+  // Instance
+
+  VkApplicationInfo applicationInfo = {
+      .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+      .pNext = NULL,
+      .pApplicationName = "Headless Triangle Export Consumer",
+      .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
+      .pEngineName = "",
+      .engineVersion = VK_MAKE_VERSION(1, 0, 0),
+      .apiVersion = VK_API_VERSION_1_3};
+
+  VkInstanceCreateInfo instanceCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+      .pNext = NULL,
+      .flags = 0,
+      .pApplicationInfo = &applicationInfo,
+      .enabledLayerCount = 0,
+      .ppEnabledLayerNames = NULL,
+      .enabledExtensionCount = 0,
+      .ppEnabledExtensionNames = NULL,
+  };
+
+  VkInstance instanceHandle = VK_NULL_HANDLE;
+  result = vkCreateInstance(&instanceCreateInfo, NULL, &instanceHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateInstance");
+  }
+
+  // =========================================================================
+  // Physical Device
+
+  uint32_t physicalDeviceCount = 0;
+  result =
+      vkEnumeratePhysicalDevices(instanceHandle, &physicalDeviceCount, NULL);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkEnumeratePhysicalDevices");
+  }
+
+  std::vector<VkPhysicalDevice> physicalDeviceHandleList(physicalDeviceCount);
+  result = vkEnumeratePhysicalDevices(instanceHandle, &physicalDeviceCount,
+                                      physicalDeviceHandleList.data());
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkEnumeratePhysicalDevices");
+  }
+
+  // opaque descriptors only import into the device and driver that exported
+  // them
+  VkPhysicalDevice activePhysicalDeviceHandle = VK_NULL_HANDLE;
+
+  for (VkPhysicalDevice physicalDeviceHandle : physicalDeviceHandleList) {
+    VkPhysicalDeviceIDProperties physicalDeviceIDProperties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES,
+        .pNext = NULL};
+
+    VkPhysicalDeviceProperties2 physicalDeviceProperties2 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &physicalDeviceIDProperties};
+
+    vkGetPhysicalDeviceProperties2(physicalDeviceHandle,
+                                   &physicalDeviceProperties2);
+
+    if (memcmp(physicalDeviceIDProperties.deviceUUID,
+               deviceMessage.deviceUUID, VK_UUID_SIZE) == 0 &&
+        memcmp(physicalDeviceIDProperties.driverUUID,
+               deviceMessage.driverUUID, VK_UUID_SIZE) == 0) {
+      activePhysicalDeviceHandle = physicalDeviceHandle;
+      break;
+    }
+  }
+
+  if (activePhysicalDeviceHandle == VK_NULL_HANDLE) {
+    throw std::runtime_error("Producer's device and driver not found");
+  }
+
+  VkPhysicalDeviceProperties physicalDeviceProperties;
+  vkGetPhysicalDeviceProperties(activePhysicalDeviceHandle,
+                                &physicalDeviceProperties);
+
+  VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties;
+  vkGetPhysicalDeviceMemoryProperties(activePhysicalDeviceHandle,
+                                      &physicalDeviceMemoryProperties);
+
+  std::cout << physicalDeviceProperties.deviceName << std::endl;
+
+  // =========================================================================
+  // Physical Device Submission Queue Families
+
+  uint32_t queueFamilyPropertyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(activePhysicalDeviceHandle,
+                                           &queueFamilyPropertyCount, NULL);
+
+  std::vector<VkQueueFamilyProperties> queueFamilyPropertiesList(
+      queueFamilyPropertyCount);
+
+  vkGetPhysicalDeviceQueueFamilyProperties(activePhysicalDeviceHandle,
+                                           &queueFamilyPropertyCount,
+                                           queueFamilyPropertiesList.data());
+
+  // every graphics or compute family supports transfers
+  uint32_t queueFamilyIndex = -1;
+  for (uint32_t x = 0; x < queueFamilyPropertiesList.size(); x++) {
+    if (queueFamilyPropertiesList[x].queueFlags &
+        (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT |
+         VK_QUEUE_TRANSFER_BIT)) {
+      queueFamilyIndex = x;
+      break;
+    }
+  }
+
+  std::vector<float> queuePrioritiesList = {1.0f};
+  VkDeviceQueueCreateInfo deviceQueueCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+      .pNext = NULL,
+      .flags = 0,
+      .queueFamilyIndex = queueFamilyIndex,
+      .queueCount = 1,
+      .pQueuePriorities = queuePrioritiesList.data()};
+
+  // =========================================================================
+  // Logical Device
+
+  std::vector<const char *> deviceExtensionList = {
+      VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME,
+      VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME};
+
+  VkDeviceCreateInfo deviceCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+      .pNext = NULL,
+      .flags = 0,
+      .queueCreateInfoCount = 1,
+      .pQueueCreateInfos = &deviceQueueCreateInfo,
+      .enabledLayerCount = 0,
+      .ppEnabledLayerNames = NULL,
+      .enabledExtensionCount = (uint32_t)deviceExtensionList.size(),
+      .ppEnabledExtensionNames = deviceExtensionList.data(),
+      .pEnabledFeatures = NULL};
+
+  VkDevice deviceHandle = VK_NULL_HANDLE;
+  result = vkCreateDevice(activePhysicalDeviceHandle, &deviceCreateInfo, NULL,
+                          &deviceHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateDevice");
+  }
+
+  PFN_vkImportSemaphoreFdKHR pvkImportSemaphoreFdKHR =
+      (PFN_vkImportSemaphoreFdKHR)vkGetDeviceProcAddr(
+          deviceHandle, "vkImportSemaphoreFdKHR");
+
+  // =========================================================================
+  // Submission Queue
+
+  VkQueue queueHandle = VK_NULL_HANDLE;
+  vkGetDeviceQueue(deviceHandle, queueFamilyIndex, 0, &queueHandle);
+
+  // =========================================================================
+  // Device Memory Arena
+
+  DeviceMemoryArena deviceMemoryArena;
+  createDeviceMemoryArena(
+      deviceMemoryArena, deviceHandle, physicalDeviceMemoryProperties,
+      physicalDeviceProperties.limits.bufferImageGranularity,
+      physicalDeviceProperties.limits.nonCoherentAtomSize);
+
+  // =========================================================================
+  // Imported Slots
+
+  // the images are created exactly like the producer's, then bound to the
+  // imported memory, which they alias
+  std::vector<VkImage> slotImageHandleList(slotCount, VK_NULL_HANDLE);
+  std::vector<VkDeviceMemory> slotDeviceMemoryHandleList(slotCount,
+                                                         VK_NULL_HANDLE);
+  std::vector<VkSemaphore> slotSemaphoreHandleList(slotCount, VK_NULL_HANDLE);
+
+  VkExternalMemoryImageCreateInfo externalMemoryImageCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO,
+      .pNext = NULL,
+      .handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT};
+
+  VkImageCreateInfo slotImageCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+      .pNext = &externalMemoryImageCreateInfo,
+      .flags = 0,
+      .imageType = VK_IMAGE_TYPE_2D,
+      .format = deviceMessage.format,
+      .extent = {.width = imageExtent.width,
+                 .height = imageExtent.height,
+                 .depth = 1},
+      .mipLevels = 1,
+      .arrayLayers = 1,
+      .samples = VK_SAMPLE_COUNT_1_BIT,
+      .tiling = VK_IMAGE_TILING_OPTIMAL,
+      .usage = deviceMessage.imageUsageFlags,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount = 1,
+      .pQueueFamilyIndices = &queueFamilyIndex,
+      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED};
+
+  VkSemaphoreCreateInfo semaphoreCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+      .pNext = NULL,
+      .flags = 0};
+
+  for (uint32_t x = 0; x < slotCount; x++) {
+    FrameExportMessage slotMessage;
+    std::vector<int> descriptorList;
+
+    if (!receiveFrameExportMessage(socketDescriptor, &slotMessage,
+                                   &descriptorList) ||
+        slotMessage.type != FRAME_EXPORT_MESSAGE_TYPE_SLOT ||
+        slotMessage.slotIndex >= slotCount || descriptorList.size() != 2) {
+      throw std::runtime_error("Producer sent no slot message");
+    }
+
+    uint32_t slotIndex = slotMessage.slotIndex;
+
+    result = vkCreateImage(deviceHandle, &slotImageCreateInfo, NULL,
+                           &slotImageHandleList[slotIndex]);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateImage");
+    }
+
+    VkMemoryRequirements slotImageMemoryRequirements;
+    vkGetImageMemoryRequirements(deviceHandle, slotImageHandleList[slotIndex],
+                                 &slotImageMemoryRequirements);
+
+    if (!(slotImageMemoryRequirements.memoryTypeBits &
+          (1 << slotMessage.memoryTypeIndex))) {
+      throwExceptionVulkanAPI(VK_ERROR_INVALID_EXTERNAL_HANDLE,
+                              "vkGetImageMemoryRequirements");
+    }
+
+    // a successful import takes ownership of the descriptor
+    VkImportMemoryFdInfoKHR importMemoryFdInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_FD_INFO_KHR,
+        .pNext = NULL,
+        .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT,
+        .fd = descriptorList[0]};
+
+    VkMemoryDedicatedAllocateInfo memoryDedicatedAllocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+        .pNext = &importMemoryFdInfo,
+        .image = slotImageHandleList[slotIndex],
+        .buffer = VK_NULL_HANDLE};
+
+    VkMemoryAllocateInfo memoryAllocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = &memoryDedicatedAllocateInfo,
+        .allocationSize = slotMessage.allocationSize,
+        .memoryTypeIndex = slotMessage.memoryTypeIndex};
+
+    result = vkAllocateMemory(deviceHandle, &memoryAllocateInfo, NULL,
+                              &slotDeviceMemoryHandleList[slotIndex]);
+
+    if (result != VK_SUCCESS) {
+      close(descriptorList[0]);
+      close(descriptorList[1]);
+      throwExceptionVulkanAPI(result, "vkAllocateMemory");
+    }
+
+    result = vkBindImageMemory(deviceHandle, slotImageHandleList[slotIndex],
+                               slotDeviceMemoryHandleList[slotIndex], 0);
+
+    if (result != VK_SUCCESS) {
+      close(descriptorList[1]);
+      throwExceptionVulkanAPI(result, "vkBindImageMemory");
+    }
+
+    result = vkCreateSemaphore(deviceHandle, &semaphoreCreateInfo, NULL,
+                               &slotSemaphoreHandleList[slotIndex]);
+
+    if (result != VK_SUCCESS) {
+      close(descriptorList[1]);
+      throwExceptionVulkanAPI(result, "vkCreateSemaphore");
+    }
+
+    // a permanent import, the semaphore shares its payload with the
+    // producer's for as long as it exists
+    VkImportSemaphoreFdInfoKHR importSemaphoreFdInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMPORT_SEMAPHORE_FD_INFO_KHR,
+        .pNext = NULL,
+        .semaphore = slotSemaphoreHandleList[slotIndex],
+        .flags = 0,
+        .handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT,
+        .fd = descriptorList[1]};
+
+    result = pvkImportSemaphoreFdKHR(deviceHandle, &importSemaphoreFdInfo);
+
+    if (result != VK_SUCCESS) {
+      close(descriptorList[1]);
+      throwExceptionVulkanAPI(result, "vkImportSemaphoreFdKHR");
+    }
+  }
+
+  // =========================================================================
+  // Readback Buffer
+
+  // every render format is four bytes a pixel
+  VkDeviceSize readbackBufferSize =
+      (VkDeviceSize)imageExtent.width * imageExtent.height * 4;
+
+  VkBufferCreateInfo readbackBufferCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .pNext = NULL,
+      .flags = 0,
+      .size = readbackBufferSize,
+      .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount = 1,
+      .pQueueFamilyIndices = &queueFamilyIndex};
+
+  VkBuffer readbackBufferHandle = VK_NULL_HANDLE;
+  result = vkCreateBuffer(deviceHandle, &readbackBufferCreateInfo, NULL,
+                          &readbackBufferHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateBuffer");
+  }
+
+  VkMemoryRequirements readbackBufferMemoryRequirements;
+  vkGetBufferMemoryRequirements(deviceHandle, readbackBufferHandle,
+                                &readbackBufferMemoryRequirements);
+
+  DeviceMemoryAllocation readbackBufferAllocation;
+  result = allocateDeviceMemory(deviceMemoryArena,
+                                readbackBufferMemoryRequirements,
+                                DEVICE_MEMORY_USAGE_READBACK,
+                                &readbackBufferAllocation);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkAllocateMemory");
+  }
+
+  result = vkBindBufferMemory(deviceHandle, readbackBufferHandle,
+                              readbackBufferAllocation.deviceMemoryHandle,
+                              readbackBufferAllocation.offset);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkBindBufferMemory");
+  }
+
+  // =========================================================================
+  // Command Pool, Command Buffer, Fence
+
+  VkCommandPoolCreateInfo commandPoolCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      .pNext = NULL,
+      .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+      .queueFamilyIndex = queueFamilyIndex};
+
+  VkCommandPool commandPoolHandle = VK_NULL_HANDLE;
+  result = vkCreateCommandPool(deviceHandle, &commandPoolCreateInfo, NULL,
+                               &commandPoolHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateCommandPool");
+  }
+
+  VkCommandBufferAllocateInfo commandBufferAllocateInfo = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .pNext = NULL,
+      .commandPool = commandPoolHandle,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 1};
+
+  VkCommandBuffer commandBufferHandle = VK_NULL_HANDLE;
+  result = vkAllocateCommandBuffers(deviceHandle, &commandBufferAllocateInfo,
+                                    &commandBufferHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkAllocateCommandBuffers");
+  }
+
+  VkFenceCreateInfo fenceCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+      .pNext = NULL,
+      .flags = 0};
+
+  VkFence copyFenceHandle = VK_NULL_HANDLE;
+  result = vkCreateFence(deviceHandle, &fenceCreateInfo, NULL,
+                         &copyFenceHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreateFence");
+  }
+
+  // =========================================================================
+  // Frame Loop
+
+  uint64_t receivedFrameCount = 0;
+  uint64_t mismatchFrameCount = 0;
+  uint64_t previousFrameNumber = 0;
+  double copySeconds = 0;
+
+  std::chrono::steady_clock::time_point startTimePoint =
+      std::chrono::steady_clock::now();
+
+  while (true) {
+    FrameExportMessage frameMessage;
+    if (!receiveFrameExportMessage(socketDescriptor, &frameMessage, NULL)) {
+      break;
+    }
+
+    if (frameMessage.type != FRAME_EXPORT_MESSAGE_TYPE_FRAME ||
+        frameMessage.slotIndex >= slotCount) {
+      throw std::runtime_error("Producer sent an unexpected message");
+    }
+
+    uint32_t slotIndex = frameMessage.slotIndex;
+    VkExtent2D frameExtent = frameMessage.frameExtent;
+
+    std::chrono::steady_clock::time_point copyStartTimePoint =
+        std::chrono::steady_clock::now();
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = NULL,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = NULL};
+
+    result = vkBeginCommandBuffer(commandBufferHandle, &commandBufferBeginInfo);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkBeginCommandBuffer");
+    }
+
+    // the acquire half of the producer's ownership release, the layout is
+    // kept. Nothing is released back, the producer discards the contents
+    // when it renders into the slot again
+    VkImageMemoryBarrier acquireImageMemoryBarrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL,
+        .dstQueueFamilyIndex = queueFamilyIndex,
+        .image = slotImageHandleList[slotIndex],
+        .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                             .baseMipLevel = 0,
+                             .levelCount = 1,
+                             .baseArrayLayer = 0,
+                             .layerCount = 1}};
+
+    vkCmdPipelineBarrier(commandBufferHandle, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL,
+                         1, &acquireImageMemoryBarrier);
+
+    VkBufferImageCopy bufferImageCopy = {
+        .bufferOffset = 0,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                             .mipLevel = 0,
+                             .baseArrayLayer = 0,
+                             .layerCount = 1},
+        .imageOffset = {.x = 0, .y = 0, .z = 0},
+        .imageExtent = {.width = frameExtent.width,
+                        .height = frameExtent.height,
+                        .depth = 1}};
+
+    vkCmdCopyImageToBuffer(commandBufferHandle,
+                           slotImageHandleList[slotIndex],
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           readbackBufferHandle, 1, &bufferImageCopy);
+
+    VkBufferMemoryBarrier hostBufferMemoryBarrier = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = readbackBufferHandle,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE};
+
+    vkCmdPipelineBarrier(commandBufferHandle, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 1,
+                         &hostBufferMemoryBarrier, 0, NULL);
+
+    result = vkEndCommandBuffer(commandBufferHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkEndCommandBuffer");
+    }
+
+    // the producer submitted the frame before announcing it, so the signal
+    // this waits on is already pending
+    VkPipelineStageFlags waitPipelineStageFlags =
+        VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+    VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = NULL,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &slotSemaphoreHandleList[slotIndex],
+        .pWaitDstStageMask = &waitPipelineStageFlags,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &commandBufferHandle,
+        .signalSemaphoreCount = 0,
+        .pSignalSemaphores = NULL};
+
+    result = vkQueueSubmit(queueHandle, 1, &submitInfo, copyFenceHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkQueueSubmit");
+    }
+
+    result = vkWaitForFences(deviceHandle, 1, &copyFenceHandle, VK_TRUE,
+                             UINT64_MAX);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkWaitForFences");
+    }
+
+    result = vkResetFences(deviceHandle, 1, &copyFenceHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkResetFences");
+    }
+
+    result = invalidateDeviceMemory(deviceMemoryArena, readbackBufferAllocation,
+                                    0, readbackBufferSize);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkInvalidateMappedMemoryRanges");
+    }
+
+    copySeconds += std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - copyStartTimePoint)
+                       .count();
+
+    // the slot can be rendered into again as soon as the copy is done, the
+    // pixels are checked out of the readback buffer
+    FrameExportMessage releaseMessage;
+    releaseMessage.type = FRAME_EXPORT_MESSAGE_TYPE_RELEASE;
+    releaseMessage.slotIndex = slotIndex;
+    releaseMessage.frameNumber = frameMessage.frameNumber;
+
+    bool isReleased =
+        sendFrameExportMessage(socketDescriptor, releaseMessage);
+
+    // every pixel is opaque, the clear color and the triangles both are, and
+    // a frame with draws must have something on it besides the clear color
+    const uint8_t *pixelPtr =
+        (const uint8_t *)readbackBufferAllocation.hostMemoryPtr;
+    size_t pixelCount = (size_t)frameExtent.width * frameExtent.height;
+
+    bool isOpaque = true;
+    bool isDrawn = false;
+    for (size_t x = 0; x < pixelCount; x++) {
+      isOpaque = isOpaque && pixelPtr[x * 4 + 3] == 255;
+      isDrawn = isDrawn || pixelPtr[x * 4] != 0 || pixelPtr[x * 4 + 1] != 0 ||
+                pixelPtr[x * 4 + 2] != 0;
+    }
+
+    bool isInOrder = receivedFrameCount == 0 ||
+                     frameMessage.frameNumber > previousFrameNumber;
+
+    if (!isOpaque || isDrawn != (deviceMessage.drawCount > 0) || !isInOrder) {
+      mismatchFrameCount += 1;
+
+      std::cerr << "frame " << frameMessage.frameNumber << " (slot "
+                << slotIndex << ") does not match" << std::endl;
+    }
+
+    receivedFrameCount += 1;
+    previousFrameNumber = frameMessage.frameNumber;
+
+    if (!isReleased) {
+      break;
+    }
+  }
+
+  double elapsedSeconds = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() -
+                              startTimePoint)
+                              .count();
+
+  std::cout << "frames received: " << receivedFrameCount << std::endl;
+  std::cout << "frames mismatched: " << mismatchFrameCount << std::endl;
+
+  if (receivedFrameCount > 0) {
+    std::cout << "copy per frame (ms): "
+              << copySeconds * 1000.0 / receivedFrameCount << std::endl;
+    std::cout << "frames per second: " << receivedFrameCount / elapsedSeconds
+              << std::endl;
+  }
+
+  // =========================================================================
+  // Cleanup
+
+  close(socketDescriptor);
+
+  result = vkDeviceWaitIdle(deviceHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkDeviceWaitIdle");
+  }
+
+  vkDestroyFence(deviceHandle, copyFenceHandle, NULL);
+  vkDestroyCommandPool(deviceHandle, commandPoolHandle, NULL);
+
+  vkDestroyBuffer(deviceHandle, readbackBufferHandle, NULL);
+  freeDeviceMemory(deviceMemoryArena, readbackBufferAllocation);
+
+  for (uint32_t x = 0; x < slotCount; x++) {
+    vkDestroySemaphore(deviceHandle, slotSemaphoreHandleList[x], NULL);
+    vkDestroyImage(deviceHandle, slotImageHandleList[x], NULL);
+    vkFreeMemory(deviceHandle, slotDeviceMemoryHandleList[x], NULL);
+  }
+
+  destroyDeviceMemoryArena(deviceMemoryArena);
+
+  vkDestroyDevice(deviceHandle, NULL);
+  vkDestroyInstance(instanceHandle, NULL);
+
+  return mismatchFrameCount == 0 ? 0 : 1;
+}
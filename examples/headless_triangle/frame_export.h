@@ -0,0 +1,290 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Hands the render targets to a consumer process on the same machine without
+// copying them to the host. Every render target lives in its own exportable
+// allocation, and each one has an exportable semaphore that its frame's
+// submission signals. Both are exported as opaque file descriptors once and
+// passed over a unix domain socket (SCM_RIGHTS). After that the socket only
+// carries small messages. The producer announces each frame after
+// submitting it. The consumer waits on the slot's semaphore on its own queue
+// and reads the image. Then it releases the slot, and the producer only
+// renders into it again after that. Opaque descriptors only import on the
+// same device and driver, so the consumer checks the UUIDs first.
+
+const uint32_t frameExportVersion = 1;
+
+enum FrameExportMessageType : uint32_t {
+  // producer to consumer, once: the device and how the images were created
+  FRAME_EXPORT_MESSAGE_TYPE_DEVICE,
+  // producer to consumer, once per slot: carries the memory and semaphore
+  // file descriptors
+  FRAME_EXPORT_MESSAGE_TYPE_SLOT,
+  // producer to consumer: a frame was submitted into a slot
+  FRAME_EXPORT_MESSAGE_TYPE_FRAME,
+  // consumer to producer: the consumer is done reading a slot
+  FRAME_EXPORT_MESSAGE_TYPE_RELEASE
+};
+
+// one fixed size message for every type, the socket keeps their boundaries
+struct FrameExportMessage {
+  FrameExportMessageType type = FRAME_EXPORT_MESSAGE_TYPE_DEVICE;
+  uint32_t version = frameExportVersion;
+
+  // device
+  uint8_t deviceUUID[VK_UUID_SIZE] = {};
+  uint8_t driverUUID[VK_UUID_SIZE] = {};
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  VkExtent2D imageExtent = {.width = 0, .height = 0};
+  VkImageUsageFlags imageUsageFlags = 0;
+  uint32_t slotCount = 0;
+
+  // whether the frames have anything drawn in them, for the consumer's check
+  uint32_t drawCount = 0;
+
+  // slot
+  VkDeviceSize allocationSize = 0;
+  uint32_t memoryTypeIndex = 0;
+
+  // slot, frame and release
+  uint32_t slotIndex = 0;
+
+  // frame and release
+  uint64_t frameNumber = 0;
+  VkExtent2D frameExtent = {.width = 0, .height = 0};
+};
+
+// a closed peer fails the send instead of raising SIGPIPE
+inline bool
+sendFrameExportMessage(int socketDescriptor, const FrameExportMessage &message,
+                       const std::vector<int> &descriptorList = {}) {
+  iovec messageVector = {.iov_base = (void *)&message,
+                         .iov_len = sizeof(FrameExportMessage)};
+
+  std::vector<char> controlBuffer(
+      descriptorList.empty() ? 0
+                             : CMSG_SPACE(sizeof(int) * descriptorList.size()));
+
+  msghdr messageHeader = {};
+  messageHeader.msg_iov = &messageVector;
+  messageHeader.msg_iovlen = 1;
+
+  if (!descriptorList.empty()) {
+    messageHeader.msg_control = controlBuffer.data();
+    messageHeader.msg_controllen = controlBuffer.size();
+
+    cmsghdr *controlMessagePtr = CMSG_FIRSTHDR(&messageHeader);
+    controlMessagePtr->cmsg_level = SOL_SOCKET;
+    controlMessagePtr->cmsg_type = SCM_RIGHTS;
+    controlMessagePtr->cmsg_len =
+        CMSG_LEN(sizeof(int) * descriptorList.size());
+
+    memcpy(CMSG_DATA(controlMessagePtr), descriptorList.data(),
+           sizeof(int) * descriptorList.size());
+  }
+
+  while (true) {
+    ssize_t sentSize = sendmsg(socketDescriptor, &messageHeader, MSG_NOSIGNAL);
+
+    if (sentSize < 0 && errno == EINTR) {
+      continue;
+    }
+
+    return sentSize == (ssize_t)sizeof(FrameExportMessage);
+  }
+}
+
+// false once the peer has gone away. Received descriptors belong to the
+// caller
+inline bool receiveFrameExportMessage(int socketDescriptor,
+                                      FrameExportMessage *messagePtr,
+                                      std::vector<int> *descriptorListPtr) {
+  iovec messageVector = {.iov_base = messagePtr,
+                         .iov_len = sizeof(FrameExportMessage)};
+
+  // room for the two descriptors of a slot message
+  char controlBuffer[CMSG_SPACE(sizeof(int) * 2)] = {};
+
+  msghdr messageHeader = {};
+  messageHeader.msg_iov = &messageVector;
+  messageHeader.msg_iovlen = 1;
+  messageHeader.msg_control = controlBuffer;
+  messageHeader.msg_controllen = sizeof(controlBuffer);
+
+  ssize_t receivedSize;
+  do {
+    receivedSize = recvmsg(socketDescriptor, &messageHeader, MSG_CMSG_CLOEXEC);
+  } while (receivedSize < 0 && errno == EINTR);
+
+  if (descriptorListPtr != NULL) {
+    descriptorListPtr->clear();
+  }
+
+  // a failed receive leaves the control fields as they were, there is
+  // nothing to parse
+  if (receivedSize <= 0) {
+    return false;
+  }
+
+  for (cmsghdr *controlMessagePtr = CMSG_FIRSTHDR(&messageHeader);
+       controlMessagePtr != NULL;
+       controlMessagePtr = CMSG_NXTHDR(&messageHeader, controlMessagePtr)) {
+    if (controlMessagePtr->cmsg_level != SOL_SOCKET ||
+        controlMessagePtr->cmsg_type != SCM_RIGHTS) {
+      continue;
+    }
+
+    uint32_t descriptorCount =
+        (controlMessagePtr->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+
+    for (uint32_t x = 0; x < descriptorCount; x++) {
+      int descriptor;
+      memcpy(&descriptor, CMSG_DATA(controlMessagePtr) + x * sizeof(int),
+             sizeof(int));
+
+      if (descriptorListPtr != NULL) {
+        descriptorListPtr->push_back(descriptor);
+      } else {
+        close(descriptor);
+      }
+    }
+  }
+
+  // descriptors that did not fit were closed by the kernel, the slot
+  // message is unusable without them
+  if (messageHeader.msg_flags & MSG_CTRUNC) {
+    if (descriptorListPtr != NULL) {
+      for (int descriptor : *descriptorListPtr) {
+        close(descriptor);
+      }
+      descriptorListPtr->clear();
+    }
+
+    return false;
+  }
+
+  return receivedSize == (ssize_t)sizeof(FrameExportMessage) &&
+         messagePtr->version == frameExportVersion;
+}
+
+inline bool getFrameExportAddress(const std::string &path,
+                                  sockaddr_un *addressPtr) {
+  if (path.size() >= sizeof(addressPtr->sun_path)) {
+    return false;
+  }
+
+  memset(addressPtr, 0, sizeof(sockaddr_un));
+  addressPtr->sun_family = AF_UNIX;
+  memcpy(addressPtr->sun_path, path.c_str(), path.size());
+
+  return true;
+}
+
+// the producer's end of the socket and which slots the consumer still holds
+struct FrameExport {
+  int socketDescriptor = -1;
+
+  std::vector<bool> slotBusyList;
+
+  uint64_t exportedFrameCount = 0;
+  uint64_t releasedFrameCount = 0;
+  double releaseWaitSeconds = 0;
+};
+
+// blocks until a consumer connects, the socket file is removed again once
+// it has
+inline bool createFrameExport(FrameExport &frameExport,
+                              const std::string &path, uint32_t slotCount) {
+  sockaddr_un address;
+  if (!getFrameExportAddress(path, &address)) {
+    return false;
+  }
+
+  int listenDescriptor = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (listenDescriptor < 0) {
+    return false;
+  }
+
+  unlink(path.c_str());
+
+  if (bind(listenDescriptor, (sockaddr *)&address, sizeof(address)) < 0 ||
+      listen(listenDescriptor, 1) < 0) {
+    close(listenDescriptor);
+    return false;
+  }
+
+  do {
+    frameExport.socketDescriptor =
+        accept4(listenDescriptor, NULL, NULL, SOCK_CLOEXEC);
+  } while (frameExport.socketDescriptor < 0 && errno == EINTR);
+
+  close(listenDescriptor);
+  unlink(path.c_str());
+
+  frameExport.slotBusyList.assign(slotCount, false);
+
+  return frameExport.socketDescriptor >= 0;
+}
+
+// called after the frame's submission, which signals the slot's semaphore
+inline bool submitFrameExport(FrameExport &frameExport, uint32_t slotIndex,
+                              uint64_t frameNumber, VkExtent2D frameExtent) {
+  FrameExportMessage message;
+  message.type = FRAME_EXPORT_MESSAGE_TYPE_FRAME;
+  message.slotIndex = slotIndex;
+  message.frameNumber = frameNumber;
+  message.frameExtent = frameExtent;
+
+  frameExport.slotBusyList[slotIndex] = true;
+  frameExport.exportedFrameCount += 1;
+
+  return sendFrameExportMessage(frameExport.socketDescriptor, message);
+}
+
+// blocks until the consumer has released the slot, false once it has gone
+// away
+inline bool waitFrameExportSlot(FrameExport &frameExport, uint32_t slotIndex) {
+  std::chrono::steady_clock::time_point waitStartTimePoint =
+      std::chrono::steady_clock::now();
+
+  bool isConnected = true;
+
+  while (isConnected && frameExport.slotBusyList[slotIndex]) {
+    FrameExportMessage message;
+    isConnected = receiveFrameExportMessage(frameExport.socketDescriptor,
+                                            &message, NULL) &&
+                  message.type == FRAME_EXPORT_MESSAGE_TYPE_RELEASE &&
+                  message.slotIndex < frameExport.slotBusyList.size();
+
+    if (isConnected) {
+      frameExport.slotBusyList[message.slotIndex] = false;
+      frameExport.releasedFrameCount += 1;
+    }
+  }
+
+  frameExport.releaseWaitSeconds +=
+      std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                    waitStartTimePoint)
+          .count();
+
+  return isConnected;
+}
+
+inline void destroyFrameExport(FrameExport &frameExport) {
+  if (frameExport.socketDescriptor >= 0) {
+    close(frameExport.socketDescriptor);
+    frameExport.socketDescriptor = -1;
+  }
+}
@@ -0,0 +1,465 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <string>
+
+// Publishes completed frames into a POSIX shared memory ring that any number
+// of reader processes map. The writer never waits for a reader. Every slot
+// carries a sequence number (a seqlock): odd while a frame is written into
+// the slot, even once it is complete. A reader checks the sequence before
+// and after it reads a frame and throws the frame away if it changed. A
+// reader that falls a whole ring behind finds its next frame overwritten and
+// skips ahead to the newest one. The writer also sees it lag in its reader
+// entry, but only counts it. Readers block on a futex in the header, so an
+// idle reader costs nothing, and the writer only makes the wake call while
+// somebody waits.
+
+const uint32_t frameRingMagic = 0x474e4952;
+const uint32_t frameRingVersion = 1;
+const uint32_t frameRingReaderCapacity = 16;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free &&
+                  std::atomic<uint32_t>::is_always_lock_free &&
+                  std::atomic<int32_t>::is_always_lock_free,
+              "the ring's atomics have to work across processes");
+
+// each on its own cache line, the writer's stores to one slot do not bounce
+// the line readers of another slot poll
+struct alignas(64) FrameRingSlotHeader {
+  // 0 before the first frame, 2 * frameNumber + 1 while frameNumber is
+  // written and 2 * frameNumber + 2 once it is complete
+  std::atomic<uint64_t> sequence;
+
+  std::atomic<uint32_t> width;
+  std::atomic<uint32_t> height;
+  std::atomic<uint64_t> size;
+};
+
+struct alignas(64) FrameRingReaderEntry {
+  // 0 for a free entry
+  std::atomic<int32_t> processID;
+
+  std::atomic<uint64_t> nextFrameNumber;
+  std::atomic<uint64_t> readFrameCount;
+  std::atomic<uint64_t> skippedFrameCount;
+};
+
+// at the start of the mapping, followed by the slot headers and, from
+// slotDataOffset on, the frames
+struct FrameRingHeader {
+  // set last, once everything else is
+  std::atomic<uint32_t> magic;
+  uint32_t version;
+
+  uint32_t slotCount;
+  VkFormat format;
+  VkExtent2D maxExtent;
+
+  uint64_t slotDataOffset;
+  uint64_t slotStride;
+
+  alignas(64) std::atomic<uint64_t> publishedFrameCount;
+  std::atomic<uint32_t> isClosed;
+
+  // bumped by every publish, the word readers sleep on
+  alignas(64) std::atomic<uint32_t> publishSignal;
+  std::atomic<uint32_t> waiterCount;
+
+  FrameRingReaderEntry readerList[frameRingReaderCapacity];
+};
+
+struct FrameRing {
+  std::string name;
+  bool isWriter = false;
+
+  int fileDescriptor = -1;
+  void *mappingPtr = NULL;
+  size_t mappingSize = 0;
+
+  FrameRingHeader *headerPtr = NULL;
+  FrameRingSlotHeader *slotHeaderList = NULL;
+  uint8_t *slotDataPtr = NULL;
+
+  uint32_t slotCount = 0;
+  uint64_t slotStride = 0;
+
+  // writer
+  uint64_t publishedFrameCount = 0;
+  uint64_t publishedByteCount = 0;
+
+  // frames a reader was a whole ring behind when they were published
+  uint64_t lappedReaderFrameCount = 0;
+};
+
+// what a reader got out of the ring
+struct FrameRingFrame {
+  uint64_t frameNumber = 0;
+  VkExtent2D extent = {.width = 0, .height = 0};
+  uint64_t size = 0;
+};
+
+enum FrameRingReadResult {
+  FRAME_RING_READ_RESULT_FRAME,
+  FRAME_RING_READ_RESULT_NOT_READY,
+  FRAME_RING_READ_RESULT_CLOSED
+};
+
+inline uint64_t getFrameRingAlignedSize(uint64_t size, uint64_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+inline void mapFrameRingLayout(FrameRing &ring) {
+  ring.headerPtr = (FrameRingHeader *)ring.mappingPtr;
+  ring.slotHeaderList =
+      (FrameRingSlotHeader *)((uint8_t *)ring.mappingPtr +
+                              sizeof(FrameRingHeader));
+  ring.slotDataPtr =
+      (uint8_t *)ring.mappingPtr + ring.headerPtr->slotDataOffset;
+
+  ring.slotCount = ring.headerPtr->slotCount;
+  ring.slotStride = ring.headerPtr->slotStride;
+}
+
+// name is a shm_open name such as "/headless_triangle". Slots start on a
+// multiple of alignment, which has to be a multiple of the page size, and
+// each one holds maxFrameSize bytes. A stale ring of the same name is
+// replaced, readers still attached to it keep the old one
+inline bool createFrameRing(FrameRing &ring, const std::string &name,
+                            uint32_t slotCount, VkFormat format,
+                            VkExtent2D maxExtent, uint64_t maxFrameSize,
+                            uint64_t alignment) {
+  ring.name = name;
+  ring.isWriter = true;
+
+  uint64_t slotDataOffset = getFrameRingAlignedSize(
+      sizeof(FrameRingHeader) + sizeof(FrameRingSlotHeader) * slotCount,
+      alignment);
+  uint64_t slotStride = getFrameRingAlignedSize(maxFrameSize, alignment);
+
+  ring.mappingSize = slotDataOffset + slotStride * slotCount;
+
+  shm_unlink(name.c_str());
+
+  ring.fileDescriptor =
+      shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+  if (ring.fileDescriptor < 0) {
+    return false;
+  }
+
+  if (ftruncate(ring.fileDescriptor, ring.mappingSize) < 0) {
+    return false;
+  }
+
+  ring.mappingPtr = mmap(NULL, ring.mappingSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, ring.fileDescriptor, 0);
+  if (ring.mappingPtr == MAP_FAILED) {
+    ring.mappingPtr = NULL;
+    return false;
+  }
+
+  // ftruncate zeroed the pages, which is every atomic's initial value
+  FrameRingHeader *headerPtr = new (ring.mappingPtr) FrameRingHeader;
+  headerPtr->version = frameRingVersion;
+  headerPtr->slotCount = slotCount;
+  headerPtr->format = format;
+  headerPtr->maxExtent = maxExtent;
+  headerPtr->slotDataOffset = slotDataOffset;
+  headerPtr->slotStride = slotStride;
+
+  new ((uint8_t *)ring.mappingPtr + sizeof(FrameRingHeader))
+      FrameRingSlotHeader[slotCount];
+
+  headerPtr->magic.store(frameRingMagic, std::memory_order_release);
+
+  mapFrameRingLayout(ring);
+
+  return true;
+}
+
+inline uint8_t *getFrameRingSlotPtr(const FrameRing &ring,
+                                    uint32_t slotIndex) {
+  return ring.slotDataPtr + ring.slotStride * slotIndex;
+}
+
+inline uint32_t getFrameRingSlotIndex(const FrameRing &ring,
+                                      uint64_t frameNumber) {
+  return (uint32_t)(frameNumber % ring.slotCount);
+}
+
+// readers that see the slot from here on discard what they read out of it.
+// Called before anything writes the frame, which with direct readback is
+// before the submission whose copy writes it
+inline uint8_t *beginFrameRingFrame(FrameRing &ring, uint64_t frameNumber) {
+  uint32_t slotIndex = getFrameRingSlotIndex(ring, frameNumber);
+
+  ring.slotHeaderList[slotIndex].sequence.store(frameNumber * 2 + 1,
+                                                std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  return getFrameRingSlotPtr(ring, slotIndex);
+}
+
+// frames are published in order, the frame's bytes have to be in the slot
+inline void publishFrameRingFrame(FrameRing &ring, uint64_t frameNumber,
+                                  VkExtent2D extent, uint64_t size) {
+  FrameRingHeader *headerPtr = ring.headerPtr;
+  FrameRingSlotHeader &slotHeader =
+      ring.slotHeaderList[getFrameRingSlotIndex(ring, frameNumber)];
+
+  slotHeader.width.store(extent.width, std::memory_order_relaxed);
+  slotHeader.height.store(extent.height, std::memory_order_relaxed);
+  slotHeader.size.store(size, std::memory_order_relaxed);
+  slotHeader.sequence.store(frameNumber * 2 + 2, std::memory_order_release);
+
+  headerPtr->publishedFrameCount.store(frameNumber + 1,
+                                       std::memory_order_release);
+  headerPtr->publishSignal.fetch_add(1, std::memory_order_seq_cst);
+
+  if (headerPtr->waiterCount.load(std::memory_order_seq_cst) > 0) {
+    syscall(SYS_futex, &headerPtr->publishSignal, FUTEX_WAKE, INT32_MAX,
+            NULL, NULL, 0);
+  }
+
+  ring.publishedFrameCount += 1;
+  ring.publishedByteCount += size;
+
+  // the frame about to be overwritten next is the oldest one still in the
+  // ring, a reader still waiting for an older one has been lapped. The
+  // entries of readers that died are handed back
+  uint64_t oldestFrameNumber =
+      frameNumber + 1 > ring.slotCount ? frameNumber + 1 - ring.slotCount : 0;
+
+  for (FrameRingReaderEntry &readerEntry : headerPtr->readerList) {
+    int32_t processID = readerEntry.processID.load(std::memory_order_relaxed);
+
+    if (processID == 0 ||
+        readerEntry.nextFrameNumber.load(std::memory_order_relaxed) >=
+            oldestFrameNumber) {
+      continue;
+    }
+
+    if (kill(processID, 0) < 0 && errno == ESRCH) {
+      readerEntry.processID.compare_exchange_strong(processID, 0);
+      continue;
+    }
+
+    ring.lappedReaderFrameCount += 1;
+  }
+}
+
+// wakes every reader, which read what is left and then see the ring closed
+inline void closeFrameRing(FrameRing &ring) {
+  ring.headerPtr->isClosed.store(1, std::memory_order_release);
+  ring.headerPtr->publishSignal.fetch_add(1, std::memory_order_release);
+
+  syscall(SYS_futex, &ring.headerPtr->publishSignal, FUTEX_WAKE, INT32_MAX,
+          NULL, NULL, 0);
+}
+
+// the writer unlinks the ring, mappings of it stay valid
+inline void destroyFrameRing(FrameRing &ring) {
+  if (ring.mappingPtr != NULL) {
+    if (ring.isWriter) {
+      closeFrameRing(ring);
+    }
+
+    munmap(ring.mappingPtr, ring.mappingSize);
+    ring.mappingPtr = NULL;
+  }
+
+  if (ring.fileDescriptor >= 0) {
+    close(ring.fileDescriptor);
+    ring.fileDescriptor = -1;
+
+    if (ring.isWriter) {
+      shm_unlink(ring.name.c_str());
+    }
+  }
+}
+
+// ===========================================================================
+// Reader
+
+// false while the ring does not exist yet or is still being set up
+inline bool openFrameRing(FrameRing &ring, const std::string &name) {
+  ring.name = name;
+  ring.isWriter = false;
+
+  ring.fileDescriptor = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+  if (ring.fileDescriptor < 0) {
+    return false;
+  }
+
+  struct stat fileStatus;
+  if (fstat(ring.fileDescriptor, &fileStatus) < 0 ||
+      (size_t)fileStatus.st_size < sizeof(FrameRingHeader)) {
+    destroyFrameRing(ring);
+    return false;
+  }
+
+  ring.mappingSize = fileStatus.st_size;
+  ring.mappingPtr = mmap(NULL, ring.mappingSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, ring.fileDescriptor, 0);
+  if (ring.mappingPtr == MAP_FAILED) {
+    ring.mappingPtr = NULL;
+    destroyFrameRing(ring);
+    return false;
+  }
+
+  FrameRingHeader *headerPtr = (FrameRingHeader *)ring.mappingPtr;
+  if (headerPtr->magic.load(std::memory_order_acquire) != frameRingMagic ||
+      headerPtr->version != frameRingVersion ||
+      headerPtr->slotDataOffset +
+              headerPtr->slotStride * headerPtr->slotCount >
+          ring.mappingSize) {
+    destroyFrameRing(ring);
+    return false;
+  }
+
+  mapFrameRingLayout(ring);
+
+  return true;
+}
+
+// claims a reader entry, the reader starts at the newest published frame.
+// Returns -1 when every entry is taken
+inline int32_t attachFrameRingReader(FrameRing &ring) {
+  int32_t processID = getpid();
+
+  for (uint32_t x = 0; x < frameRingReaderCapacity; x++) {
+    FrameRingReaderEntry &readerEntry = ring.headerPtr->readerList[x];
+
+    int32_t freeProcessID = 0;
+    if (!readerEntry.processID.compare_exchange_strong(freeProcessID,
+                                                       processID)) {
+      continue;
+    }
+
+    uint64_t publishedFrameCount =
+        ring.headerPtr->publishedFrameCount.load(std::memory_order_acquire);
+
+    readerEntry.nextFrameNumber.store(
+        publishedFrameCount > 0 ? publishedFrameCount - 1 : 0,
+        std::memory_order_relaxed);
+    readerEntry.readFrameCount.store(0, std::memory_order_relaxed);
+    readerEntry.skippedFrameCount.store(0, std::memory_order_relaxed);
+
+    return (int32_t)x;
+  }
+
+  return -1;
+}
+
+inline void detachFrameRingReader(FrameRing &ring, int32_t readerIndex) {
+  ring.headerPtr->readerList[readerIndex].processID.store(
+      0, std::memory_order_release);
+}
+
+// copies the reader's next frame into destinationPtr, which holds a slot.
+// A reader that was lapped skips to the newest frame, the frames it missed
+// are counted in its entry
+inline FrameRingReadResult readFrameRing(FrameRing &ring, int32_t readerIndex,
+                                         uint8_t *destinationPtr,
+                                         FrameRingFrame *framePtr) {
+  FrameRingHeader *headerPtr = ring.headerPtr;
+  FrameRingReaderEntry &readerEntry = headerPtr->readerList[readerIndex];
+
+  uint64_t nextFrameNumber =
+      readerEntry.nextFrameNumber.load(std::memory_order_relaxed);
+
+  while (true) {
+    // the closed flag is read first, every frame published before it was
+    // set is still read
+    bool isClosed = headerPtr->isClosed.load(std::memory_order_acquire);
+    uint64_t publishedFrameCount =
+        headerPtr->publishedFrameCount.load(std::memory_order_acquire);
+
+    if (nextFrameNumber >= publishedFrameCount) {
+      return isClosed ? FRAME_RING_READ_RESULT_CLOSED
+                      : FRAME_RING_READ_RESULT_NOT_READY;
+    }
+
+    FrameRingSlotHeader &slotHeader =
+        ring.slotHeaderList[getFrameRingSlotIndex(ring, nextFrameNumber)];
+
+    uint64_t sequence = slotHeader.sequence.load(std::memory_order_acquire);
+
+    if (sequence == nextFrameNumber * 2 + 2) {
+      framePtr->frameNumber = nextFrameNumber;
+      framePtr->extent.width =
+          slotHeader.width.load(std::memory_order_relaxed);
+      framePtr->extent.height =
+          slotHeader.height.load(std::memory_order_relaxed);
+      framePtr->size = std::min(slotHeader.size.load(std::memory_order_relaxed),
+                                ring.slotStride);
+
+      memcpy(destinationPtr,
+             getFrameRingSlotPtr(ring,
+                                 getFrameRingSlotIndex(ring, nextFrameNumber)),
+             framePtr->size);
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      if (slotHeader.sequence.load(std::memory_order_relaxed) == sequence) {
+        readerEntry.nextFrameNumber.store(nextFrameNumber + 1,
+                                          std::memory_order_relaxed);
+        readerEntry.readFrameCount.fetch_add(1, std::memory_order_relaxed);
+        return FRAME_RING_READ_RESULT_FRAME;
+      }
+    }
+
+    // the slot moved on to a later frame, before or while it was read
+    uint64_t newestFrameNumber = publishedFrameCount - 1;
+    if (newestFrameNumber <= nextFrameNumber) {
+      newestFrameNumber = nextFrameNumber + 1;
+    }
+
+    readerEntry.skippedFrameCount.fetch_add(
+        newestFrameNumber - nextFrameNumber, std::memory_order_relaxed);
+    nextFrameNumber = newestFrameNumber;
+    readerEntry.nextFrameNumber.store(nextFrameNumber,
+                                      std::memory_order_relaxed);
+  }
+}
+
+// sleeps until a frame after the reader's last one is published, the ring is
+// closed or timeoutNanoseconds pass
+inline void waitFrameRing(FrameRing &ring, int32_t readerIndex,
+                          uint64_t timeoutNanoseconds) {
+  FrameRingHeader *headerPtr = ring.headerPtr;
+
+  uint32_t publishSignal =
+      headerPtr->publishSignal.load(std::memory_order_acquire);
+  headerPtr->waiterCount.fetch_add(1, std::memory_order_seq_cst);
+
+  // a publish between the caller's read and the registration above has
+  // bumped the signal, the futex then returns right away
+  if (headerPtr->isClosed.load(std::memory_order_acquire) == 0 &&
+      headerPtr->readerList[readerIndex].nextFrameNumber.load(
+          std::memory_order_relaxed) >=
+          headerPtr->publishedFrameCount.load(std::memory_order_seq_cst)) {
+    timespec timeout = {.tv_sec = (time_t)(timeoutNanoseconds / 1000000000),
+                        .tv_nsec = (long)(timeoutNanoseconds % 1000000000)};
+
+    syscall(SYS_futex, &headerPtr->publishSignal, FUTEX_WAIT, publishSignal,
+            &timeout, NULL, 0);
+  }
+
+  headerPtr->waiterCount.fetch_sub(1, std::memory_order_seq_cst);
+}
@@ -0,0 +1,167 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <csignal>
+
+#include "argument_parsing.h"
+#include "frame_ring.h"
+
+// Reads the frames headless_triangle --ring=NAME publishes, a reference for
+// other readers of the ring. It copies every frame it gets out of its slot,
+// checks the pixels and reports how many frames it read and skipped.
+// --delay-ms makes it a slow reader, which the ring skips ahead instead of
+// waiting for.
+
+volatile std::sig_atomic_t isExitRequested = 0;
+
+void handleExitSignal(int) { isExitRequested = 1; }
+
+int main(int argc, char *argv[]) {
+  std::string frameRingName;
+  uint64_t maxFrameCount = 0;
+  uint32_t delayMilliseconds = 0;
+
+  for (int x = 1; x < argc; x++) {
+    std::string argument = argv[x];
+
+    bool isArgumentValid = true;
+    if (argument.rfind("--frames=", 0) == 0) {
+      isArgumentValid =
+          parseUnsignedArgument(argument.substr(9), &maxFrameCount);
+    } else if (argument.rfind("--delay-ms=", 0) == 0) {
+      isArgumentValid =
+          parseUnsignedArgument(argument.substr(11), &delayMilliseconds);
+    } else if (argument.rfind("--", 0) != 0 && frameRingName.empty()) {
+      frameRingName = argument;
+    } else {
+      isArgumentValid = false;
+    }
+
+    if (!isArgumentValid) {
+      std::cout << "Usage: frame_ring_reader SHARED_MEMORY_NAME" << std::endl;
+      std::cout << "  --frames=FRAME_COUNT" << std::endl;
+      std::cout << "  --delay-ms=MILLISECONDS_PER_FRAME" << std::endl;
+      return 1;
+    }
+  }
+
+  if (frameRingName.empty()) {
+    std::cout << "Usage: frame_ring_reader SHARED_MEMORY_NAME" << std::endl;
+    return 1;
+  }
+
+  if (frameRingName.rfind("/", 0) != 0) {
+    frameRingName = "/" + frameRingName;
+  }
+
+  std::signal(SIGINT, handleExitSignal);
+  std::signal(SIGTERM, handleExitSignal);
+
+  // =========================================================================
+  // Attach
+
+  // the writer creates the ring once its device is set up
+  FrameRing frameRing;
+  while (!openFrameRing(frameRing, frameRingName)) {
+    if (isExitRequested) {
+      return 0;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+
+  int32_t readerIndex = attachFrameRingReader(frameRing);
+  if (readerIndex < 0) {
+    std::cerr << "Every reader entry of " << frameRingName << " is taken"
+              << std::endl;
+    destroyFrameRing(frameRing);
+    return 1;
+  }
+
+  std::cout << frameRingName << ": " << frameRing.slotCount << " slots, "
+            << frameRing.headerPtr->maxExtent.width << "x"
+            << frameRing.headerPtr->maxExtent.height << ", reader "
+            << readerIndex << std::endl;
+
+  // =========================================================================
+  // Frame Loop
+
+  std::vector<uint8_t> frameBuffer(frameRing.slotStride);
+
+  uint64_t readFrameCount = 0;
+  uint64_t mismatchFrameCount = 0;
+  uint64_t previousFrameNumber = 0;
+
+  std::chrono::steady_clock::time_point startTimePoint =
+      std::chrono::steady_clock::now();
+
+  while (!isExitRequested &&
+         (maxFrameCount == 0 || readFrameCount < maxFrameCount)) {
+    FrameRingFrame frame;
+    FrameRingReadResult readResult =
+        readFrameRing(frameRing, readerIndex, frameBuffer.data(), &frame);
+
+    if (readResult == FRAME_RING_READ_RESULT_CLOSED) {
+      break;
+    }
+
+    if (readResult == FRAME_RING_READ_RESULT_NOT_READY) {
+      waitFrameRing(frameRing, readerIndex, 100000000);
+      continue;
+    }
+
+    // every pixel is opaque, the clear color and the triangles both are,
+    // and frames only ever come in order
+    size_t pixelCount = (size_t)frame.extent.width * frame.extent.height;
+
+    bool isOpaque = frame.size == pixelCount * 4;
+    for (size_t x = 0; isOpaque && x < pixelCount; x++) {
+      isOpaque = frameBuffer[x * 4 + 3] == 255;
+    }
+
+    bool isInOrder =
+        readFrameCount == 0 || frame.frameNumber > previousFrameNumber;
+
+    if (!isOpaque || !isInOrder) {
+      mismatchFrameCount += 1;
+
+      std::cerr << "frame " << frame.frameNumber << " does not match"
+                << std::endl;
+    }
+
+    readFrameCount += 1;
+    previousFrameNumber = frame.frameNumber;
+
+    if (delayMilliseconds > 0) {
+      std::this_thread::sleep_for(
+          std::chrono::milliseconds(delayMilliseconds));
+    }
+  }
+
+  double elapsedSeconds = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() -
+                              startTimePoint)
+                              .count();
+
+  uint64_t skippedFrameCount =
+      frameRing.headerPtr->readerList[readerIndex].skippedFrameCount.load();
+
+  std::cout << "frames read: " << readFrameCount << std::endl;
+  std::cout << "frames skipped: " << skippedFrameCount << std::endl;
+  std::cout << "frames mismatched: " << mismatchFrameCount << std::endl;
+
+  if (readFrameCount > 0) {
+    std::cout << "frames per second: " << readFrameCount / elapsedSeconds
+              << std::endl;
+  }
+
+  // =========================================================================
+  // Cleanup
+
+  detachFrameRingReader(frameRing, readerIndex);
+  destroyFrameRing(frameRing);
+
+  return mismatchFrameCount == 0 ? 0 : 1;
+}
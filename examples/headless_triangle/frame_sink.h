@@ -0,0 +1,440 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <zlib.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "pixel_conversion.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Encodes retrieved frames to disk on a pool of encoder threads. A job points
+// straight at a persistently mapped readback buffer, the slot that buffer
+// belongs to stays busy until its frame is written and the renderer waits on
+// it with waitFrameSinkSlot before recording another copy into it. Frames are
+// never copied on the host, and when the encoders or the disk fall behind the
+// busy slots stall the render loop instead of queueing frames without bound.
+
+enum FrameSinkFormat {
+  FRAME_SINK_FORMAT_PPM,
+  FRAME_SINK_FORMAT_QOI,
+  FRAME_SINK_FORMAT_PNG
+};
+
+struct FrameSinkJob {
+  uint32_t slotIndex = 0;
+  uint64_t frameNumber = 0;
+  const uint8_t *pixelPtr = NULL;
+  VkExtent2D extent = {.width = 0, .height = 0};
+};
+
+struct FrameSink {
+  FrameSinkFormat format = FRAME_SINK_FORMAT_PPM;
+  std::string directory;
+  bool isBGRA = false;
+
+  std::vector<std::thread> threadList;
+
+  std::mutex mutex;
+  std::condition_variable jobCondition;
+  std::condition_variable slotCondition;
+
+  std::deque<FrameSinkJob> jobQueue;
+  std::vector<bool> slotBusyList;
+  bool isExitRequested = false;
+
+  uint64_t encodedFrameCount = 0;
+  uint64_t rawByteCount = 0;
+  uint64_t encodedByteCount = 0;
+  uint64_t failedFrameCount = 0;
+
+  // summed over every encoder thread
+  double encodeSeconds = 0;
+
+  // time the renderer spent waiting for a slot to be released
+  double backpressureSeconds = 0;
+};
+
+inline const char *getFrameSinkExtension(FrameSinkFormat format) {
+  switch (format) {
+  case FRAME_SINK_FORMAT_QOI:
+    return "qoi";
+  case FRAME_SINK_FORMAT_PNG:
+    return "png";
+  default:
+    return "ppm";
+  }
+}
+
+inline bool parseFrameSinkFormat(const std::string &formatName,
+                                 FrameSinkFormat *formatPtr) {
+  for (FrameSinkFormat format :
+       {FRAME_SINK_FORMAT_PPM, FRAME_SINK_FORMAT_QOI, FRAME_SINK_FORMAT_PNG}) {
+    if (formatName == getFrameSinkExtension(format)) {
+      *formatPtr = format;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+inline void writeBigEndian32(uint8_t *destinationPtr, uint32_t value) {
+  destinationPtr[0] = (uint8_t)(value >> 24);
+  destinationPtr[1] = (uint8_t)(value >> 16);
+  destinationPtr[2] = (uint8_t)(value >> 8);
+  destinationPtr[3] = (uint8_t)value;
+}
+
+inline void appendBigEndian32(std::vector<uint8_t> &buffer, uint32_t value) {
+  buffer.resize(buffer.size() + 4);
+  writeBigEndian32(buffer.data() + buffer.size() - 4, value);
+}
+
+inline void encodePPM(std::vector<uint8_t> &encodedBuffer,
+                      const uint8_t *pixelPtr, VkExtent2D extent,
+                      bool isBGRA) {
+  std::string header = "P6\n" + std::to_string(extent.width) + " " +
+                       std::to_string(extent.height) + "\n255\n";
+
+  encodedBuffer.assign(header.begin(), header.end());
+  encodedBuffer.resize(header.size() +
+                       (size_t)extent.width * extent.height * 3);
+
+  convertPixels(encodedBuffer.data() + header.size(), pixelPtr, extent, isBGRA,
+                PIXEL_CONVERSION_FORMAT_RGB);
+}
+
+// https://qoiformat.org/qoi-specification.pdf
+inline void encodeQOI(std::vector<uint8_t> &encodedBuffer,
+                      const uint8_t *pixelPtr, VkExtent2D extent,
+                      bool isBGRA) {
+  encodedBuffer.clear();
+  encodedBuffer.reserve(14 + (size_t)extent.width * extent.height * 5 + 8);
+
+  encodedBuffer.insert(encodedBuffer.end(), {'q', 'o', 'i', 'f'});
+  appendBigEndian32(encodedBuffer, extent.width);
+  appendBigEndian32(encodedBuffer, extent.height);
+  encodedBuffer.push_back(4);
+  encodedBuffer.push_back(0);
+
+  uint8_t indexList[64][4] = {};
+  uint8_t previous[4] = {0, 0, 0, 255};
+  uint32_t run = 0;
+
+  uint32_t redIndex = isBGRA ? 2 : 0;
+  uint32_t blueIndex = isBGRA ? 0 : 2;
+
+  size_t pixelCount = (size_t)extent.width * extent.height;
+
+  for (size_t x = 0; x < pixelCount; x++) {
+    uint8_t pixel[4] = {pixelPtr[x * 4 + redIndex], pixelPtr[x * 4 + 1],
+                        pixelPtr[x * 4 + blueIndex], pixelPtr[x * 4 + 3]};
+
+    if (memcmp(pixel, previous, 4) == 0) {
+      run += 1;
+
+      if (run == 62 || x == pixelCount - 1) {
+        encodedBuffer.push_back(0xc0 | (run - 1));
+        run = 0;
+      }
+
+      continue;
+    }
+
+    if (run > 0) {
+      encodedBuffer.push_back(0xc0 | (run - 1));
+      run = 0;
+    }
+
+    uint32_t hash =
+        (pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64;
+
+    if (memcmp(indexList[hash], pixel, 4) == 0) {
+      encodedBuffer.push_back(hash);
+    } else {
+      memcpy(indexList[hash], pixel, 4);
+
+      if (pixel[3] == previous[3]) {
+        int8_t redDifference = (int8_t)(pixel[0] - previous[0]);
+        int8_t greenDifference = (int8_t)(pixel[1] - previous[1]);
+        int8_t blueDifference = (int8_t)(pixel[2] - previous[2]);
+
+        int8_t redGreenDifference = redDifference - greenDifference;
+        int8_t blueGreenDifference = blueDifference - greenDifference;
+
+        if (redDifference >= -2 && redDifference <= 1 &&
+            greenDifference >= -2 && greenDifference <= 1 &&
+            blueDifference >= -2 && blueDifference <= 1) {
+          encodedBuffer.push_back(0x40 | (redDifference + 2) << 4 |
+                                  (greenDifference + 2) << 2 |
+                                  (blueDifference + 2));
+        } else if (redGreenDifference >= -8 && redGreenDifference <= 7 &&
+                   greenDifference >= -32 && greenDifference <= 31 &&
+                   blueGreenDifference >= -8 && blueGreenDifference <= 7) {
+          encodedBuffer.push_back(0x80 | (greenDifference + 32));
+          encodedBuffer.push_back((redGreenDifference + 8) << 4 |
+                                  (blueGreenDifference + 8));
+        } else {
+          encodedBuffer.insert(encodedBuffer.end(),
+                               {0xfe, pixel[0], pixel[1], pixel[2]});
+        }
+      } else {
+        encodedBuffer.insert(encodedBuffer.end(),
+                             {0xff, pixel[0], pixel[1], pixel[2], pixel[3]});
+      }
+    }
+
+    memcpy(previous, pixel, 4);
+  }
+
+  encodedBuffer.insert(encodedBuffer.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+}
+
+// the Up filter, every byte minus the byte above it, which turns the large
+// flat areas of a render into runs of zeros for deflate
+inline void filterPNGRowUp(uint8_t *destinationPtr, const uint8_t *rowPtr,
+                           const uint8_t *previousRowPtr, size_t size) {
+  size_t x = 0;
+
+#if defined(__SSE2__)
+  for (; x + 16 <= size; x += 16) {
+    __m128i row = _mm_loadu_si128((const __m128i *)(rowPtr + x));
+    __m128i previousRow =
+        _mm_loadu_si128((const __m128i *)(previousRowPtr + x));
+
+    _mm_storeu_si128((__m128i *)(destinationPtr + x),
+                     _mm_sub_epi8(row, previousRow));
+  }
+#endif
+
+  for (; x < size; x++) {
+    destinationPtr[x] = rowPtr[x] - previousRowPtr[x];
+  }
+}
+
+inline void appendPNGChunk(std::vector<uint8_t> &encodedBuffer,
+                           const char *type, const uint8_t *dataPtr,
+                           size_t size) {
+  appendBigEndian32(encodedBuffer, (uint32_t)size);
+
+  size_t typeOffset = encodedBuffer.size();
+  encodedBuffer.insert(encodedBuffer.end(), type, type + 4);
+  encodedBuffer.insert(encodedBuffer.end(), dataPtr, dataPtr + size);
+
+  appendBigEndian32(encodedBuffer,
+                    (uint32_t)crc32(0, encodedBuffer.data() + typeOffset,
+                                    (uInt)(size + 4)));
+}
+
+// rgba, 8 bits per channel, every row Up filtered and deflated at the
+// fastest level since the encoders are the bottleneck, not the disk
+inline bool encodePNG(std::vector<uint8_t> &encodedBuffer,
+                      std::vector<uint8_t> &filteredBuffer,
+                      const uint8_t *pixelPtr, VkExtent2D extent,
+                      bool isBGRA) {
+  size_t rowSize = (size_t)extent.width * 4;
+
+  // two rgba rows to filter against each other, then the filtered rows with
+  // their filter type byte
+  filteredBuffer.resize(rowSize * 2 + (rowSize + 1) * extent.height);
+
+  uint8_t *rowPtr = filteredBuffer.data();
+  uint8_t *previousRowPtr = rowPtr + rowSize;
+  uint8_t *outputPtr = previousRowPtr + rowSize;
+
+  memset(previousRowPtr, 0, rowSize);
+
+  for (uint32_t y = 0; y < extent.height; y++) {
+    // rgba order, the render target may be bgra
+    convertPixels(rowPtr, pixelPtr + y * rowSize, {extent.width, 1}, isBGRA,
+                  PIXEL_CONVERSION_FORMAT_RGBA);
+
+    outputPtr[y * (rowSize + 1)] = 2;
+    filterPNGRowUp(outputPtr + y * (rowSize + 1) + 1, rowPtr, previousRowPtr,
+                   rowSize);
+
+    std::swap(rowPtr, previousRowPtr);
+  }
+
+  uLong filteredSize = (uLong)(rowSize + 1) * extent.height;
+  uLongf compressedSize = compressBound(filteredSize);
+
+  static const uint8_t signature[8] = {0x89, 'P',  'N',  'G',
+                                       '\r', '\n', 0x1a, '\n'};
+
+  encodedBuffer.assign(signature, signature + 8);
+
+  std::vector<uint8_t> headerData;
+  appendBigEndian32(headerData, extent.width);
+  appendBigEndian32(headerData, extent.height);
+  headerData.insert(headerData.end(), {8, 6, 0, 0, 0});
+  appendPNGChunk(encodedBuffer, "IHDR", headerData.data(), headerData.size());
+
+  // deflated straight into the IDAT chunk, its length, type and crc are
+  // filled in around the data afterwards
+  size_t chunkOffset = encodedBuffer.size();
+  encodedBuffer.resize(chunkOffset + 8 + compressedSize);
+
+  if (compress2(encodedBuffer.data() + chunkOffset + 8, &compressedSize,
+                outputPtr, filteredSize, Z_BEST_SPEED) != Z_OK) {
+    return false;
+  }
+
+  encodedBuffer.resize(chunkOffset + 8 + compressedSize);
+
+  uint8_t *chunkPtr = encodedBuffer.data() + chunkOffset;
+  writeBigEndian32(chunkPtr, (uint32_t)compressedSize);
+  memcpy(chunkPtr + 4, "IDAT", 4);
+
+  uint32_t chunkCRC =
+      (uint32_t)crc32(0, chunkPtr + 4, (uInt)(compressedSize + 4));
+  appendBigEndian32(encodedBuffer, chunkCRC);
+
+  appendPNGChunk(encodedBuffer, "IEND", NULL, 0);
+
+  return true;
+}
+
+inline void runFrameSinkThread(FrameSink &frameSink) {
+  std::vector<uint8_t> encodedBuffer;
+  std::vector<uint8_t> filteredBuffer;
+
+  while (true) {
+    FrameSinkJob job;
+    {
+      std::unique_lock<std::mutex> lock(frameSink.mutex);
+      frameSink.jobCondition.wait(lock, [&] {
+        return frameSink.isExitRequested || !frameSink.jobQueue.empty();
+      });
+
+      // queued frames are still written after an exit request
+      if (frameSink.jobQueue.empty()) {
+        return;
+      }
+
+      job = frameSink.jobQueue.front();
+      frameSink.jobQueue.pop_front();
+    }
+
+    std::chrono::steady_clock::time_point encodeStartTimePoint =
+        std::chrono::steady_clock::now();
+
+    bool isEncoded = true;
+    if (frameSink.format == FRAME_SINK_FORMAT_PNG) {
+      isEncoded = encodePNG(encodedBuffer, filteredBuffer, job.pixelPtr,
+                            job.extent, frameSink.isBGRA);
+    } else if (frameSink.format == FRAME_SINK_FORMAT_QOI) {
+      encodeQOI(encodedBuffer, job.pixelPtr, job.extent, frameSink.isBGRA);
+    } else {
+      encodePPM(encodedBuffer, job.pixelPtr, job.extent, frameSink.isBGRA);
+    }
+
+    // the readback buffer is no longer read, the renderer may reuse the slot
+    // while the file is written
+    {
+      std::lock_guard<std::mutex> lock(frameSink.mutex);
+      frameSink.slotBusyList[job.slotIndex] = false;
+    }
+    frameSink.slotCondition.notify_all();
+
+    double encodeSeconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() -
+                               encodeStartTimePoint)
+                               .count();
+
+    std::string frameNumberString = std::to_string(job.frameNumber);
+    std::string path =
+        frameSink.directory + "/frame_" +
+        std::string(8 - std::min<size_t>(frameNumberString.size(), 8), '0') +
+        frameNumberString + "." + getFrameSinkExtension(frameSink.format);
+
+    bool isWritten = false;
+    if (isEncoded) {
+      std::ofstream file(path, std::ios::binary | std::ios::trunc);
+      file.write((const char *)encodedBuffer.data(), encodedBuffer.size());
+      file.close();
+
+      isWritten = !file.fail();
+    }
+
+    std::lock_guard<std::mutex> lock(frameSink.mutex);
+    frameSink.encodeSeconds += encodeSeconds;
+
+    if (isWritten) {
+      frameSink.encodedFrameCount += 1;
+      frameSink.rawByteCount +=
+          (uint64_t)job.extent.width * job.extent.height * 4;
+      frameSink.encodedByteCount += encodedBuffer.size();
+    } else {
+      frameSink.failedFrameCount += 1;
+    }
+  }
+}
+
+inline void createFrameSink(FrameSink &frameSink, FrameSinkFormat format,
+                            const std::string &directory, bool isBGRA,
+                            uint32_t slotCount, uint32_t threadCount) {
+  frameSink.format = format;
+  frameSink.directory = directory;
+  frameSink.isBGRA = isBGRA;
+  frameSink.slotBusyList.assign(slotCount, false);
+
+  for (uint32_t x = 0; x < threadCount; x++) {
+    frameSink.threadList.emplace_back(runFrameSinkThread, std::ref(frameSink));
+  }
+}
+
+// the pixels must stay valid until the slot is released
+inline void submitFrameSink(FrameSink &frameSink, const FrameSinkJob &job) {
+  {
+    std::lock_guard<std::mutex> lock(frameSink.mutex);
+    frameSink.slotBusyList[job.slotIndex] = true;
+    frameSink.jobQueue.push_back(job);
+  }
+
+  frameSink.jobCondition.notify_one();
+}
+
+// blocks until the encoders are done reading the slot's pixels
+inline void waitFrameSinkSlot(FrameSink &frameSink, uint32_t slotIndex) {
+  std::chrono::steady_clock::time_point waitStartTimePoint =
+      std::chrono::steady_clock::now();
+
+  std::unique_lock<std::mutex> lock(frameSink.mutex);
+  frameSink.slotCondition.wait(
+      lock, [&] { return !frameSink.slotBusyList[slotIndex]; });
+
+  frameSink.backpressureSeconds +=
+      std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                    waitStartTimePoint)
+          .count();
+}
+
+// writes every queued frame before returning
+inline void destroyFrameSink(FrameSink &frameSink) {
+  {
+    std::lock_guard<std::mutex> lock(frameSink.mutex);
+    frameSink.isExitRequested = true;
+  }
+
+  frameSink.jobCondition.notify_all();
+
+  for (std::thread &thread : frameSink.threadList) {
+    thread.join();
+  }
+
+  frameSink.threadList.clear();
+}
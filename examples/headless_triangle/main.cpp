@@ -5,6 +5,27 @@
 #include <vector>
 #include <cstring>
 #include <string>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+#include <csignal>
+#include <stdexcept>
+
+#include <sys/wait.h>
+
+#include "argument_parsing.h"
+#include "device_memory_arena.h"
+#include "frame_export.h"
+#include "frame_ring.h"
+#include "frame_sink.h"
+#include "pipeline_barrier_tracker.h"
+#include "pipeline_cache.h"
+#include "pixel_conversion.h"
+#include "render_graph.h"
+#include "streaming_copy.h"
+#include "tiled_output.h"
+#include "worker_pool.h"
+#include "y4m_stream.h"
 
 #if defined(VALIDATION_ENABLED)
 #define STRING_RESET "\033[0m"
@@ -73,9 +94,783 @@ std::ifstream getShaderFile(std::string shaderFileName) {
   return shaderFile;
 }
 
-int main() {
+std::string getImageFormatName(VkFormat format) {
+  switch (format) {
+  case VK_FORMAT_R8G8B8A8_UNORM:
+    return "rgba8";
+  case VK_FORMAT_R8G8B8A8_SRGB:
+    return "rgba8_srgb";
+  case VK_FORMAT_B8G8R8A8_UNORM:
+    return "bgra8";
+  case VK_FORMAT_B8G8R8A8_SRGB:
+    return "bgra8_srgb";
+  case VK_FORMAT_D32_SFLOAT:
+    return "d32";
+  case VK_FORMAT_D32_SFLOAT_S8_UINT:
+    return "d32_s8";
+  case VK_FORMAT_D24_UNORM_S8_UINT:
+    return "d24_s8";
+  case VK_FORMAT_D16_UNORM:
+    return "d16";
+  default:
+    return "unknown";
+  }
+}
+
+// device_local|host_visible|host_coherent|host_cached
+std::string getMemoryPropertyFlagsName(VkMemoryPropertyFlags propertyFlags) {
+  std::string name;
+
+  for (auto [flag, flagName] :
+       {std::pair{VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "device_local"},
+        std::pair{VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, "host_visible"},
+        std::pair{VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "host_coherent"},
+        std::pair{VK_MEMORY_PROPERTY_HOST_CACHED_BIT, "host_cached"}}) {
+    if (propertyFlags & flag) {
+      name += (name.empty() ? "" : "|") + std::string(flagName);
+    }
+  }
+
+  return name.empty() ? "none" : name;
+}
+
+bool parseImageFormat(const std::string &formatName, VkFormat *formatPtr) {
+  for (VkFormat format : {VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8A8_SRGB,
+                          VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_B8G8R8A8_SRGB}) {
+    if (getImageFormatName(format) == formatName) {
+      *formatPtr = format;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// WIDTHxHEIGHT
+bool parseExtent(const std::string &extentString, VkExtent2D *extentPtr) {
+  size_t separatorPosition = extentString.find('x');
+  if (separatorPosition == std::string::npos) {
+    return false;
+  }
+
+  return parseUnsignedArgument(extentString.substr(0, separatorPosition),
+                               &extentPtr->width) &&
+         parseUnsignedArgument(extentString.substr(separatorPosition + 1),
+                               &extentPtr->height) &&
+         extentPtr->width > 0 && extentPtr->height > 0;
+}
+
+// WIDTHxHEIGHT[,WIDTHxHEIGHT...]
+bool parseExtentList(const std::string &extentListString,
+                     std::vector<VkExtent2D> *extentListPtr) {
+  extentListPtr->clear();
+
+  size_t position = 0;
+  while (position <= extentListString.size()) {
+    size_t endPosition = extentListString.find(',', position);
+    if (endPosition == std::string::npos) {
+      endPosition = extentListString.size();
+    }
+
+    VkExtent2D extent;
+    if (!parseExtent(
+            extentListString.substr(position, endPosition - position),
+            &extent)) {
+      return false;
+    }
+
+    extentListPtr->push_back(extent);
+    position = endPosition + 1;
+  }
+
+  return !extentListPtr->empty();
+}
+
+volatile std::sig_atomic_t isExitRequested = 0;
+
+void handleExitSignal(int) { isExitRequested = 1; }
+
+struct SampleStatistics {
+  double min = 0;
+  double mean = 0;
+  double p50 = 0;
+  double p95 = 0;
+  double p99 = 0;
+  double max = 0;
+};
+
+SampleStatistics getSampleStatistics(std::vector<double> sampleList) {
+  SampleStatistics sampleStatistics;
+
+  if (sampleList.empty()) {
+    return sampleStatistics;
+  }
+
+  std::sort(sampleList.begin(), sampleList.end());
+
+  // nearest-rank percentile
+  auto getPercentile = [&sampleList](double percentile) {
+    size_t rank = (size_t)(percentile / 100.0 * sampleList.size() + 0.5);
+    rank = std::clamp(rank, (size_t)1, sampleList.size());
+
+    return sampleList[rank - 1];
+  };
+
+  double sum = 0;
+  for (double sample : sampleList) {
+    sum += sample;
+  }
+
+  sampleStatistics.min = sampleList.front();
+  sampleStatistics.mean = sum / sampleList.size();
+  sampleStatistics.p50 = getPercentile(50);
+  sampleStatistics.p95 = getPercentile(95);
+  sampleStatistics.p99 = getPercentile(99);
+  sampleStatistics.max = sampleList.back();
+
+  return sampleStatistics;
+}
+
+void printSampleStatistics(std::ostream &stream, const std::string &name,
+                           const SampleStatistics &sampleStatistics,
+                           bool isJSON) {
+  if (isJSON) {
+    stream << "\"" << name << "\": {"
+           << "\"min\": " << sampleStatistics.min << ", "
+           << "\"mean\": " << sampleStatistics.mean << ", "
+           << "\"p50\": " << sampleStatistics.p50 << ", "
+           << "\"p95\": " << sampleStatistics.p95 << ", "
+           << "\"p99\": " << sampleStatistics.p99 << ", "
+           << "\"max\": " << sampleStatistics.max << "}";
+  } else {
+    stream << name << ": "
+           << "min " << sampleStatistics.min << ", "
+           << "mean " << sampleStatistics.mean << ", "
+           << "p50 " << sampleStatistics.p50 << ", "
+           << "p95 " << sampleStatistics.p95 << ", "
+           << "p99 " << sampleStatistics.p99 << ", "
+           << "max " << sampleStatistics.max << std::endl;
+  }
+}
+
+// a forked reader of the ring benchmark. Copies every frame it gets out of
+// the ring and checks the frame number the writer put at its start, exits
+// with 1 on a mismatch
+int runFrameRingBenchmarkReader(const std::string &name) {
+  FrameRing frameRing;
+  if (!openFrameRing(frameRing, name)) {
+    return 1;
+  }
+
+  int32_t readerIndex = attachFrameRingReader(frameRing);
+  if (readerIndex < 0) {
+    destroyFrameRing(frameRing);
+    return 1;
+  }
+
+  std::vector<uint8_t> frameBuffer(frameRing.slotStride);
+  bool isMismatched = false;
+
+  while (true) {
+    FrameRingFrame frame;
+    FrameRingReadResult readResult =
+        readFrameRing(frameRing, readerIndex, frameBuffer.data(), &frame);
+
+    if (readResult == FRAME_RING_READ_RESULT_CLOSED) {
+      break;
+    }
+
+    if (readResult == FRAME_RING_READ_RESULT_NOT_READY) {
+      waitFrameRing(frameRing, readerIndex, 100000000);
+      continue;
+    }
+
+    uint64_t frameNumber;
+    memcpy(&frameNumber, frameBuffer.data(), sizeof(uint64_t));
+    isMismatched = isMismatched || frameNumber != frame.frameNumber;
+  }
+
+  // the counters stay in the entry for the writer to collect
+  detachFrameRingReader(frameRing, readerIndex);
+  destroyFrameRing(frameRing);
+
+  return isMismatched ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
   VkResult result;
 
+  // =========================================================================
+  // Arguments
+
+  uint64_t maxFrameCount = 0;
+  double maxSeconds = 0;
+  bool isJSON = false;
+
+  uint32_t threadCount = 1;
+  uint32_t drawCount = 1;
+  bool isRecordScalingEnabled = false;
+
+  uint32_t frameInFlightCount = 3;
+  bool isTimelinePacingEnabled = false;
+
+  // frames cycle through the extents, every one of them renders with the same
+  // pipeline into render targets sized for the largest
+  std::vector<VkExtent2D> renderExtentList = {{.width = 800, .height = 600}};
+  VkFormat renderFormat = VK_FORMAT_R8G8B8A8_UNORM;
+
+  bool isDynamicRenderingEnabled = false;
+  bool isRenderGraphEnabled = false;
+
+  // the graph's post process copies the scene once, which keeps the frame
+  // as rendered. Resampling blits it down to a quarter and back up instead,
+  // the output is blurred but the intermediate images alias
+  bool isRenderGraphResampleEnabled = false;
+
+  // every draw covers the same quad a little closer than the one before, the
+  // prepass lays down depth first so the shading pass runs once per pixel
+  bool isDepthPrepassEnabled = false;
+  int32_t shadingIterationCount = 0;
+
+  // rasterization samples per pixel, above one the scene renders into
+  // transient multisample images that are resolved inside the pass
+  uint32_t sampleCount = 1;
+
+  // outputs larger than a render target are rendered as a grid of tiles, one
+  // tile per frame, and streamed into a PPM file
+  VkExtent2D tiledOutputExtent = {.width = 0, .height = 0};
+  VkExtent2D tileExtent = {.width = 4096, .height = 4096};
+  std::string tiledOutputPath = "tiled_output.ppm";
+
+  // retrieved frames are encoded to numbered files on their own threads
+  bool isFrameSinkEnabled = false;
+  FrameSinkFormat frameSinkFormat = FRAME_SINK_FORMAT_PNG;
+  std::string frameSinkDirectory = "frames";
+  uint32_t frameSinkThreadCount =
+      std::max(std::thread::hardware_concurrency(), 1u);
+
+  // times copies out of a result buffer placed in each host visible memory
+  // type instead of rendering
+  bool isReadbackBenchmarkEnabled = false;
+
+  // checks the pixel conversion kernels against the scalar ones and times
+  // them, without creating a device
+  bool isConversionBenchmarkEnabled = false;
+
+  // frames are converted to yuv 4:2:0 on the gpu and streamed as YUV4MPEG2
+  // to stdout ("-"), a fifo or a file for an external encoder
+  bool isY4MStreamEnabled = false;
+  std::string y4mStreamPath = "-";
+  uint32_t y4mStreamFrameRate = 30;
+
+  // render targets are exported to a consumer process over a unix socket
+  // instead of being copied to the host
+  bool isFrameExportEnabled = false;
+  std::string frameExportPath;
+
+  // retrieved frames are published into a shared memory ring that any number
+  // of reader processes map, readers that fall behind skip frames
+  bool isFrameRingEnabled = false;
+  std::string frameRingName;
+  uint32_t frameRingSlotCount = 8;
+
+  // times the ring with 1 to 16 forked readers instead of rendering
+  bool isFrameRingBenchmarkEnabled = false;
+
+  for (int x = 1; x < argc; x++) {
+    std::string argument = argv[x];
+
+    // std::stod throws on malformed numbers, which are bad arguments like any
+    // other
+    bool isArgumentValid = true;
+    try {
+      if (argument.rfind("--frames=", 0) == 0) {
+        isArgumentValid =
+            parseUnsignedArgument(argument.substr(9), &maxFrameCount);
+      } else if (argument.rfind("--seconds=", 0) == 0) {
+        maxSeconds = std::stod(argument.substr(10));
+      } else if (argument == "--format=json") {
+        isJSON = true;
+      } else if (argument == "--format=text") {
+        isJSON = false;
+      } else if (argument.rfind("--threads=", 0) == 0) {
+        isArgumentValid =
+            parseUnsignedArgument(argument.substr(10), &threadCount, 1);
+      } else if (argument.rfind("--draws=", 0) == 0) {
+        isArgumentValid = parseUnsignedArgument(argument.substr(8), &drawCount);
+      } else if (argument == "--record-scaling") {
+        isRecordScalingEnabled = true;
+      } else if (argument.rfind("--frames-in-flight=", 0) == 0) {
+        isArgumentValid = parseUnsignedArgument(argument.substr(19),
+                                                &frameInFlightCount, 1);
+      } else if (argument == "--pacing=timeline") {
+        isTimelinePacingEnabled = true;
+      } else if (argument == "--pacing=fence") {
+        isTimelinePacingEnabled = false;
+      } else if (argument.rfind("--extent=", 0) == 0) {
+        if (!parseExtentList(argument.substr(9), &renderExtentList)) {
+          std::cout << "Invalid extent: " << argument.substr(9) << std::endl;
+          return 1;
+        }
+      } else if (argument.rfind("--image-format=", 0) == 0) {
+        if (!parseImageFormat(argument.substr(15), &renderFormat)) {
+          std::cout << "Unknown image format: " << argument.substr(15)
+                    << std::endl;
+          return 1;
+        }
+      } else if (argument == "--dynamic-rendering") {
+        isDynamicRenderingEnabled = true;
+      } else if (argument == "--render-graph") {
+        isRenderGraphEnabled = true;
+      } else if (argument == "--render-graph-resample") {
+        isRenderGraphEnabled = true;
+        isRenderGraphResampleEnabled = true;
+      } else if (argument == "--depth-prepass") {
+        isDepthPrepassEnabled = true;
+      } else if (argument.rfind("--shading-iterations=", 0) == 0) {
+        isArgumentValid = parseUnsignedArgument(argument.substr(21),
+                                                &shadingIterationCount);
+      } else if (argument.rfind("--samples=", 0) == 0) {
+        isArgumentValid =
+            parseUnsignedArgument(argument.substr(10), &sampleCount, 1);
+      } else if (argument.rfind("--tiled-output=", 0) == 0) {
+        if (!parseExtent(argument.substr(15), &tiledOutputExtent)) {
+          std::cout << "Invalid extent: " << argument.substr(15) << std::endl;
+          return 1;
+        }
+      } else if (argument.rfind("--tile=", 0) == 0) {
+        if (!parseExtent(argument.substr(7), &tileExtent)) {
+          std::cout << "Invalid extent: " << argument.substr(7) << std::endl;
+          return 1;
+        }
+      } else if (argument.rfind("--output=", 0) == 0) {
+        tiledOutputPath = argument.substr(9);
+      } else if (argument.rfind("--sink=", 0) == 0) {
+        if (!parseFrameSinkFormat(argument.substr(7), &frameSinkFormat)) {
+          std::cout << "Unknown sink format: " << argument.substr(7)
+                    << std::endl;
+          return 1;
+        }
+        isFrameSinkEnabled = true;
+      } else if (argument.rfind("--sink-directory=", 0) == 0) {
+        frameSinkDirectory = argument.substr(17);
+      } else if (argument.rfind("--sink-threads=", 0) == 0) {
+        isArgumentValid = parseUnsignedArgument(argument.substr(15),
+                                                &frameSinkThreadCount, 1);
+      } else if (argument == "--readback-benchmark") {
+        isReadbackBenchmarkEnabled = true;
+      } else if (argument == "--conversion-benchmark") {
+        isConversionBenchmarkEnabled = true;
+      } else if (argument.rfind("--y4m=", 0) == 0) {
+        y4mStreamPath = argument.substr(6);
+        isY4MStreamEnabled = true;
+      } else if (argument.rfind("--y4m-rate=", 0) == 0) {
+        isArgumentValid = parseUnsignedArgument(argument.substr(11),
+                                                &y4mStreamFrameRate, 1);
+      } else if (argument.rfind("--export=", 0) == 0) {
+        frameExportPath = argument.substr(9);
+        isFrameExportEnabled = true;
+      } else if (argument.rfind("--ring=", 0) == 0) {
+        frameRingName = argument.substr(7);
+        isFrameRingEnabled = true;
+      } else if (argument.rfind("--ring-slots=", 0) == 0) {
+        isArgumentValid = parseUnsignedArgument(argument.substr(13),
+                                                &frameRingSlotCount, 2);
+      } else if (argument == "--ring-benchmark") {
+        isFrameRingBenchmarkEnabled = true;
+      } else {
+        isArgumentValid = false;
+      }
+    } catch (const std::logic_error &) {
+      isArgumentValid = false;
+    }
+
+    if (!isArgumentValid) {
+      std::cout << "Usage: headless_triangle" << std::endl;
+      std::cout << "  --frames=FRAME_COUNT" << std::endl;
+      std::cout << "  --seconds=DURATION" << std::endl;
+      std::cout << "  --format=text|json" << std::endl;
+      std::cout << "  --threads=RECORD_THREAD_COUNT" << std::endl;
+      std::cout << "  --draws=DRAW_COUNT" << std::endl;
+      std::cout << "  --record-scaling" << std::endl;
+      std::cout << "  --frames-in-flight=FRAME_IN_FLIGHT_COUNT" << std::endl;
+      std::cout << "  --pacing=fence|timeline" << std::endl;
+      std::cout << "  --extent=WIDTHxHEIGHT[,WIDTHxHEIGHT...]" << std::endl;
+      std::cout << "  --image-format=rgba8|rgba8_srgb|bgra8|bgra8_srgb"
+                << std::endl;
+      std::cout << "  --dynamic-rendering" << std::endl;
+      std::cout << "  --render-graph" << std::endl;
+      std::cout << "  --render-graph-resample (blurs the output)" << std::endl;
+      std::cout << "  --depth-prepass" << std::endl;
+      std::cout << "  --shading-iterations=FRAGMENT_LOOP_COUNT" << std::endl;
+      std::cout << "  --samples=1|2|4|8|16|32|64" << std::endl;
+      std::cout << "  --tiled-output=WIDTHxHEIGHT" << std::endl;
+      std::cout << "  --tile=WIDTHxHEIGHT" << std::endl;
+      std::cout << "  --output=PPM_PATH" << std::endl;
+      std::cout << "  --sink=png|qoi|ppm" << std::endl;
+      std::cout << "  --sink-directory=PATH" << std::endl;
+      std::cout << "  --sink-threads=ENCODER_THREAD_COUNT" << std::endl;
+      std::cout << "  --readback-benchmark" << std::endl;
+      std::cout << "  --conversion-benchmark" << std::endl;
+      std::cout << "  --y4m=PATH|-" << std::endl;
+      std::cout << "  --y4m-rate=FRAMES_PER_SECOND" << std::endl;
+      std::cout << "  --export=SOCKET_PATH" << std::endl;
+      std::cout << "  --ring=SHARED_MEMORY_NAME" << std::endl;
+      std::cout << "  --ring-slots=SLOT_COUNT" << std::endl;
+      std::cout << "  --ring-benchmark" << std::endl;
+      return 1;
+    }
+  }
+
+  bool isBenchmarkEnabled = maxFrameCount > 0 || maxSeconds > 0;
+
+  // a y4m stream has one frame size, and the tiles and the sink want the
+  // rgba frames the conversion replaces
+  if (isY4MStreamEnabled &&
+      (renderExtentList.size() > 1 || tiledOutputExtent.width > 0 ||
+       isFrameSinkEnabled || isReadbackBenchmarkEnabled)) {
+    std::cout << "--y4m takes a single extent and no --tiled-output, --sink "
+                 "or --readback-benchmark"
+              << std::endl;
+    return 1;
+  }
+
+  // the consumer reads the render targets themselves, which nothing else may
+  // replace or read back
+  if (isFrameExportEnabled &&
+      (isRenderGraphEnabled || isY4MStreamEnabled ||
+       tiledOutputExtent.width > 0 || isFrameSinkEnabled ||
+       isReadbackBenchmarkEnabled)) {
+    std::cout << "--export takes no --render-graph, --y4m, --tiled-output, "
+                 "--sink or --readback-benchmark"
+              << std::endl;
+    return 1;
+  }
+
+  // the ring takes the rgba frames out of the result buffers, or with direct
+  // readback takes their place
+  if (isFrameRingEnabled &&
+      (isRenderGraphEnabled || isY4MStreamEnabled ||
+       tiledOutputExtent.width > 0 || isFrameSinkEnabled ||
+       isFrameExportEnabled || isReadbackBenchmarkEnabled)) {
+    std::cout << "--ring takes no --render-graph, --y4m, --tiled-output, "
+                 "--sink, --export or --readback-benchmark"
+              << std::endl;
+    return 1;
+  }
+
+  // shm_open names start with a slash
+  if (isFrameRingEnabled && frameRingName.rfind("/", 0) != 0) {
+    frameRingName = "/" + frameRingName;
+  }
+
+  // the frames in flight hold a slot each while the device writes them with
+  // direct readback, one more keeps the newest frame readable
+  frameRingSlotCount = std::max(frameRingSlotCount, frameInFlightCount + 1);
+
+  // the graph owns every layout transition, which a render pass object would
+  // do behind its back
+  if (isRenderGraphEnabled) {
+    isDynamicRenderingEnabled = true;
+  }
+
+  VkExtent2D maxRenderExtent = {.width = 0, .height = 0};
+  for (VkExtent2D renderExtent : renderExtentList) {
+    maxRenderExtent.width = std::max(maxRenderExtent.width, renderExtent.width);
+    maxRenderExtent.height =
+        std::max(maxRenderExtent.height, renderExtent.height);
+  }
+
+  // keep stdout clean for the json report
+  std::ostream &logStream = isJSON ? std::clog : std::cout;
+
+  std::signal(SIGINT, handleExitSignal);
+  std::signal(SIGTERM, handleExitSignal);
+
+  // =========================================================================
+  // Conversion Benchmark
+
+  // needs no device, every kernel converts the same synthetic frame of the
+  // largest extent and has to match the scalar kernel byte for byte before
+  // it is timed
+  if (isConversionBenchmarkEnabled) {
+    std::vector<uint8_t> sourceBuffer((size_t)maxRenderExtent.width *
+                                      maxRenderExtent.height * 4);
+
+    uint32_t seed = 1;
+    for (uint8_t &value : sourceBuffer) {
+      seed = seed * 1664525 + 1013904223;
+      value = (uint8_t)(seed >> 24);
+    }
+
+    bool isSourceBGRA = renderFormat == VK_FORMAT_B8G8R8A8_UNORM ||
+                        renderFormat == VK_FORMAT_B8G8R8A8_SRGB;
+
+    if (isJSON) {
+      std::cout << "{\"extent\": \"" << maxRenderExtent.width << "x"
+                << maxRenderExtent.height << "\", \"source\": \""
+                << (isSourceBGRA ? "bgra" : "rgba") << "\", \"conversion\": [";
+    } else {
+      std::cout << "extent: " << maxRenderExtent.width << "x"
+                << maxRenderExtent.height
+                << ", source: " << (isSourceBGRA ? "bgra" : "rgba")
+                << std::endl;
+    }
+
+    bool isMismatched = false;
+    bool isFirstKernel = true;
+
+    for (PixelConversionFormat format :
+         {PIXEL_CONVERSION_FORMAT_RGBA, PIXEL_CONVERSION_FORMAT_BGRA,
+          PIXEL_CONVERSION_FORMAT_RGB, PIXEL_CONVERSION_FORMAT_GRAY,
+          PIXEL_CONVERSION_FORMAT_I420}) {
+      size_t convertedSize = getPixelConversionSize(format, maxRenderExtent);
+
+      std::vector<uint8_t> referenceBuffer(convertedSize);
+      convertPixels(referenceBuffer.data(), sourceBuffer.data(),
+                    maxRenderExtent, isSourceBGRA, format,
+                    PIXEL_CONVERSION_PATH_SCALAR);
+
+      for (PixelConversionPath path : getPixelConversionPathList()) {
+        std::vector<uint8_t> convertedBuffer(convertedSize);
+        std::vector<double> bandwidthList;
+
+        for (uint32_t x = 0; x < 20 && !isExitRequested; x++) {
+          std::chrono::steady_clock::time_point convertStartTimePoint =
+              std::chrono::steady_clock::now();
+
+          convertPixels(convertedBuffer.data(), sourceBuffer.data(),
+                        maxRenderExtent, isSourceBGRA, format, path);
+
+          bandwidthList.push_back(
+              sourceBuffer.size() /
+              std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                            convertStartTimePoint)
+                  .count() /
+              1.0e9);
+        }
+
+        bool isMatching = convertedBuffer == referenceBuffer;
+        isMismatched = isMismatched || !isMatching;
+
+        SampleStatistics bandwidthStatistics =
+            getSampleStatistics(bandwidthList);
+
+        if (isJSON) {
+          std::cout << (isFirstKernel ? "" : ", ") << "{\"format\": \""
+                    << getPixelConversionFormatName(format)
+                    << "\", \"path\": \"" << getPixelConversionPathName(path)
+                    << "\", \"matches_scalar\": "
+                    << (isMatching ? "true" : "false") << ", ";
+          printSampleStatistics(std::cout, "gb_per_second",
+                                bandwidthStatistics, true);
+          std::cout << "}";
+        } else {
+          printSampleStatistics(
+              std::cout,
+              std::string(getPixelConversionFormatName(format)) + " " +
+                  getPixelConversionPathName(path) + " (GB/s)" +
+                  (isMatching ? "" : " MISMATCH"),
+              bandwidthStatistics, false);
+        }
+
+        isFirstKernel = false;
+      }
+    }
+
+    if (isJSON) {
+      std::cout << "]}" << std::endl;
+    }
+
+    return isMismatched ? 1 : 0;
+  }
+
+  // =========================================================================
+  // Ring Benchmark
+
+  // needs no device, a writer publishes frames of the largest extent into
+  // the ring as fast as it can copy them while 1 to 16 forked readers copy
+  // out every frame they get. Every frame starts with its number, which the
+  // readers check
+  if (isFrameRingBenchmarkEnabled) {
+    size_t frameSize =
+        (size_t)maxRenderExtent.width * maxRenderExtent.height * 4;
+    double benchmarkSeconds = maxSeconds > 0 ? maxSeconds : 2.0;
+
+    std::string benchmarkRingName =
+        "/headless_triangle_benchmark_" + std::to_string(getpid());
+
+    std::vector<uint8_t> sourceBuffer(frameSize);
+
+    uint32_t seed = 1;
+    for (uint8_t &value : sourceBuffer) {
+      seed = seed * 1664525 + 1013904223;
+      value = (uint8_t)(seed >> 24);
+    }
+
+    if (isJSON) {
+      std::cout << "{\"extent\": \"" << maxRenderExtent.width << "x"
+                << maxRenderExtent.height
+                << "\", \"slots\": " << frameRingSlotCount
+                << ", \"fan_out\": [";
+    } else {
+      std::cout << "extent: " << maxRenderExtent.width << "x"
+                << maxRenderExtent.height << ", slots: " << frameRingSlotCount
+                << std::endl;
+    }
+
+    bool isMismatched = false;
+
+    for (uint32_t readerCount : {1, 2, 4, 8, 16}) {
+      if (isExitRequested) {
+        break;
+      }
+
+      FrameRing frameRing;
+      if (!createFrameRing(frameRing, benchmarkRingName, frameRingSlotCount,
+                           renderFormat, maxRenderExtent, frameSize,
+                           sysconf(_SC_PAGESIZE))) {
+        std::cerr << "Failed to create the ring: " << benchmarkRingName
+                  << std::endl;
+        return 1;
+      }
+
+      std::vector<pid_t> readerProcessIDList;
+      for (uint32_t x = 0; x < readerCount; x++) {
+        pid_t processID = fork();
+
+        if (processID == 0) {
+          _exit(runFrameRingBenchmarkReader(benchmarkRingName));
+        }
+
+        if (processID > 0) {
+          readerProcessIDList.push_back(processID);
+        }
+      }
+
+      // frames published before a reader attached are not offered to it
+      std::chrono::steady_clock::time_point attachStartTimePoint =
+          std::chrono::steady_clock::now();
+
+      while (std::chrono::steady_clock::now() - attachStartTimePoint <
+             std::chrono::seconds(5)) {
+        uint32_t attachedReaderCount = 0;
+        for (FrameRingReaderEntry &readerEntry :
+             frameRing.headerPtr->readerList) {
+          attachedReaderCount += readerEntry.processID.load() != 0 ? 1 : 0;
+        }
+
+        if (attachedReaderCount == readerProcessIDList.size()) {
+          break;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+
+      std::chrono::steady_clock::time_point writeStartTimePoint =
+          std::chrono::steady_clock::now();
+      double writeSeconds = 0;
+
+      for (uint64_t frameNumber = 0;
+           writeSeconds < benchmarkSeconds && !isExitRequested;
+           frameNumber++) {
+        uint8_t *slotPtr = beginFrameRingFrame(frameRing, frameNumber);
+
+        copyStreaming(slotPtr, sourceBuffer.data(), frameSize);
+        memcpy(slotPtr, &frameNumber, sizeof(uint64_t));
+
+        publishFrameRingFrame(frameRing, frameNumber, maxRenderExtent,
+                              frameSize);
+
+        writeSeconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() -
+                           writeStartTimePoint)
+                           .count();
+      }
+
+      closeFrameRing(frameRing);
+
+      for (pid_t processID : readerProcessIDList) {
+        int status = 0;
+        waitpid(processID, &status, 0);
+
+        isMismatched = isMismatched || !WIFEXITED(status) ||
+                       WEXITSTATUS(status) != 0;
+      }
+
+      // the readers took the first entries of the fresh ring
+      std::vector<double> readerFrameRateList;
+      uint64_t skippedFrameCount = 0;
+
+      for (uint32_t x = 0; x < readerProcessIDList.size(); x++) {
+        FrameRingReaderEntry &readerEntry = frameRing.headerPtr->readerList[x];
+
+        readerFrameRateList.push_back(readerEntry.readFrameCount.load() /
+                                      writeSeconds);
+        skippedFrameCount += readerEntry.skippedFrameCount.load();
+      }
+
+      double writeFrameRate = frameRing.publishedFrameCount / writeSeconds;
+      double writeBandwidth =
+          frameRing.publishedByteCount / writeSeconds / 1.0e9;
+
+      // frames each reader missed out of those published while it was
+      // attached
+      double skippedFraction =
+          skippedFrameCount /
+          std::max((double)frameRing.publishedFrameCount *
+                       readerProcessIDList.size(),
+                   1.0);
+
+      SampleStatistics readerFrameRateStatistics =
+          getSampleStatistics(readerFrameRateList);
+
+      if (isJSON) {
+        std::cout << (readerCount == 1 ? "" : ", ")
+                  << "{\"readers\": " << readerCount
+                  << ", \"write_frames_per_second\": " << writeFrameRate
+                  << ", \"write_gb_per_second\": " << writeBandwidth
+                  << ", \"skipped_fraction\": " << skippedFraction
+                  << ", \"lapped_reader_frames\": "
+                  << frameRing.lappedReaderFrameCount << ", ";
+        printSampleStatistics(std::cout, "reader_frames_per_second",
+                              readerFrameRateStatistics, true);
+        std::cout << "}";
+      } else {
+        std::cout << readerCount << " readers: write " << writeFrameRate
+                  << " frames/s (" << writeBandwidth << " GB/s), skipped "
+                  << skippedFraction * 100.0 << "%" << std::endl;
+        printSampleStatistics(std::cout, "  reader frames/s",
+                              readerFrameRateStatistics, false);
+      }
+
+      destroyFrameRing(frameRing);
+    }
+
+    if (isJSON) {
+      std::cout << "]}" << std::endl;
+    }
+
+    return isMismatched ? 1 : 0;
+  }
+
+  // =========================================================================
+  // Y4M Stream
+
+  // opened before anything else is logged, writing to stdout moves the log
+  // and the report to stderr. One slot per frame in flight, a slot is the
+  // frame's readback buffer
+  Y4MStream y4mStream;
+
+  if (isY4MStreamEnabled) {
+    if (!createY4MStream(y4mStream, y4mStreamPath, maxRenderExtent,
+                         y4mStreamFrameRate, frameInFlightCount)) {
+      std::cerr << "Failed to open the y4m stream: " << y4mStreamPath
+                << std::endl;
+      return 1;
+    }
+  }
+
   // =========================================================================
   // Vulkan Instance
 
@@ -187,13 +982,411 @@ int main() {
   vkGetPhysicalDeviceMemoryProperties(activePhysicalDeviceHandle,
                                       &physicalDeviceMemoryProperties);
 
-  std::cout << physicalDeviceProperties.deviceName << std::endl;
+  logStream << physicalDeviceProperties.deviceName << std::endl;
+
+  // render targets are created at every requested extent, tiles are clamped
+  // to the limit instead
+  if (tiledOutputExtent.width == 0) {
+    for (VkExtent2D renderExtent : renderExtentList) {
+      if (renderExtent.width >
+              physicalDeviceProperties.limits.maxImageDimension2D ||
+          renderExtent.height >
+              physicalDeviceProperties.limits.maxImageDimension2D) {
+        throw std::runtime_error(
+            "Extent " + std::to_string(renderExtent.width) + "x" +
+            std::to_string(renderExtent.height) +
+            " exceeds maxImageDimension2D of " +
+            std::to_string(
+                physicalDeviceProperties.limits.maxImageDimension2D));
+      }
+    }
+  }
 
   // =========================================================================
   // Physical Device Features
 
   VkPhysicalDeviceFeatures deviceFeatures = {};
 
+  // timeline semaphores are core since Vulkan 1.2 but still sit behind a
+  // feature bit, fall back to the fence ring when the device lacks them
+  if (isTimelinePacingEnabled) {
+    VkPhysicalDeviceVulkan12Features supportedVulkan12Features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        .pNext = NULL};
+
+    if (physicalDeviceProperties.apiVersion >= VK_API_VERSION_1_2) {
+      VkPhysicalDeviceFeatures2 supportedFeatures2 = {
+          .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+          .pNext = &supportedVulkan12Features};
+
+      vkGetPhysicalDeviceFeatures2(activePhysicalDeviceHandle,
+                                   &supportedFeatures2);
+    }
+
+    if (!supportedVulkan12Features.timelineSemaphore) {
+      logStream << "timeline semaphores not supported, using fence pacing"
+                << std::endl;
+      isTimelinePacingEnabled = false;
+    }
+  }
+
+  VkPhysicalDeviceVulkan12Features deviceVulkan12Features = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+      .pNext = NULL,
+      .timelineSemaphore = isTimelinePacingEnabled ? VK_TRUE : VK_FALSE};
+
+  VkPhysicalDeviceVulkan13Features supportedVulkan13Features = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+      .pNext = NULL};
+
+  if (physicalDeviceProperties.apiVersion >= VK_API_VERSION_1_3) {
+    VkPhysicalDeviceFeatures2 supportedFeatures2 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &supportedVulkan13Features};
+
+    vkGetPhysicalDeviceFeatures2(activePhysicalDeviceHandle,
+                                 &supportedFeatures2);
+  }
+
+  // every barrier goes through the pipeline barrier tracker, which emits
+  // vkCmdPipelineBarrier2 when it can and vkCmdPipelineBarrier otherwise
+  bool isSynchronization2Enabled =
+      supportedVulkan13Features.synchronization2 == VK_TRUE;
+
+  // dynamic rendering replaces the render pass and framebuffers, the layout
+  // transitions the render pass did implicitly become tracked barriers
+  if (isDynamicRenderingEnabled &&
+      !supportedVulkan13Features.dynamicRendering) {
+    logStream << "dynamic rendering not supported, using render pass"
+              << (isRenderGraphEnabled ? " without the render graph" : "")
+              << std::endl;
+    isDynamicRenderingEnabled = false;
+    isRenderGraphEnabled = false;
+  }
+
+  VkPhysicalDeviceVulkan13Features deviceVulkan13Features = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+      .pNext = NULL,
+      .synchronization2 = isSynchronization2Enabled ? VK_TRUE : VK_FALSE,
+      .dynamicRendering = isDynamicRenderingEnabled ? VK_TRUE : VK_FALSE};
+
+  uint32_t deviceExtensionPropertyCount = 0;
+  result = vkEnumerateDeviceExtensionProperties(
+      activePhysicalDeviceHandle, NULL, &deviceExtensionPropertyCount, NULL);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkEnumerateDeviceExtensionProperties");
+  }
+
+  std::vector<VkExtensionProperties> deviceExtensionPropertiesList(
+      deviceExtensionPropertyCount);
+  result = vkEnumerateDeviceExtensionProperties(
+      activePhysicalDeviceHandle, NULL, &deviceExtensionPropertyCount,
+      deviceExtensionPropertiesList.data());
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkEnumerateDeviceExtensionProperties");
+  }
+
+  auto isDeviceExtensionSupported = [&](const std::string &extensionName) {
+    for (const VkExtensionProperties &extensionProperties :
+         deviceExtensionPropertiesList) {
+      if (extensionName == extensionProperties.extensionName) {
+        return true;
+      }
+    }
+
+    return false;
+  };
+
+  // cull mode, front face, topology and depth state are set while recording
+  // instead of being baked into the pipeline, the commands are core since
+  // Vulkan 1.3 and an extension before that
+  bool isExtendedDynamicStateCore =
+      physicalDeviceProperties.apiVersion >= VK_API_VERSION_1_3;
+
+  VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures =
+      {.sType =
+           VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT,
+       .pNext = NULL,
+       .extendedDynamicState = VK_FALSE};
+
+  if (!isExtendedDynamicStateCore &&
+      isDeviceExtensionSupported("VK_EXT_extended_dynamic_state")) {
+    VkPhysicalDeviceFeatures2 supportedFeatures2 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &extendedDynamicStateFeatures};
+
+    vkGetPhysicalDeviceFeatures2(activePhysicalDeviceHandle,
+                                 &supportedFeatures2);
+  }
+
+  bool isExtendedDynamicStateEnabled =
+      isExtendedDynamicStateCore ||
+      extendedDynamicStateFeatures.extendedDynamicState;
+
+  // =========================================================================
+  // Tiled Output
+
+  // the tile is the only render target size, every frame renders the next
+  // tile and the job ends after the last one
+  bool isTiledOutputEnabled = tiledOutputExtent.width > 0;
+  TiledOutput tiledOutput;
+
+  if (isTiledOutputEnabled) {
+    uint32_t maxImageDimension2D =
+        physicalDeviceProperties.limits.maxImageDimension2D;
+
+    tileExtent.width =
+        std::min({tileExtent.width, maxImageDimension2D,
+                  tiledOutputExtent.width});
+    tileExtent.height =
+        std::min({tileExtent.height, maxImageDimension2D,
+                  tiledOutputExtent.height});
+
+    renderExtentList = {tileExtent};
+    maxRenderExtent = tileExtent;
+
+    if (!createTiledOutput(tiledOutput, tiledOutputPath, tiledOutputExtent,
+                           tileExtent,
+                           renderFormat == VK_FORMAT_B8G8R8A8_UNORM ||
+                               renderFormat == VK_FORMAT_B8G8R8A8_SRGB)) {
+      throw std::runtime_error("Could not open tiled output: " +
+                               tiledOutputPath);
+    }
+
+    maxFrameCount = tiledOutput.tileCount;
+    maxSeconds = 0;
+
+    logStream << "tiled output: " << tiledOutputExtent.width << "x"
+              << tiledOutputExtent.height << " in " << tiledOutput.tileCount
+              << " tiles of " << tileExtent.width << "x" << tileExtent.height
+              << " (" << tiledOutput.columnCount << "x"
+              << tiledOutput.rowCount << ") to " << tiledOutputPath
+              << std::endl;
+  }
+
+  // =========================================================================
+  // Render Target Format
+
+  VkFormatProperties renderFormatProperties;
+  vkGetPhysicalDeviceFormatProperties(activePhysicalDeviceHandle, renderFormat,
+                                      &renderFormatProperties);
+
+  VkFormatFeatureFlags requiredFormatFeatureFlags =
+      VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT |
+      VK_FORMAT_FEATURE_TRANSFER_SRC_BIT;
+
+  // the render graph's post process is a chain of linear filtered blits
+  if (isRenderGraphEnabled) {
+    requiredFormatFeatureFlags |=
+        VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+  }
+
+  // the yuv conversion shader fetches from the frame
+  if (isY4MStreamEnabled) {
+    requiredFormatFeatureFlags |= VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+  }
+
+  if ((renderFormatProperties.optimalTilingFeatures &
+       requiredFormatFeatureFlags) != requiredFormatFeatureFlags) {
+    throwExceptionVulkanAPI(VK_ERROR_FORMAT_NOT_SUPPORTED,
+                            "vkGetPhysicalDeviceFormatProperties");
+  }
+
+  // =========================================================================
+  // Frame Export Support
+
+  // opaque file descriptors only import on the same device and driver, the
+  // consumer compares these UUIDs before importing anything
+  VkPhysicalDeviceIDProperties physicalDeviceIDProperties = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES,
+      .pNext = NULL};
+
+  VkImageUsageFlags exportImageUsageFlags =
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+  if (isFrameExportEnabled) {
+    if (!isDeviceExtensionSupported(VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME) ||
+        !isDeviceExtensionSupported(
+            VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME)) {
+      throwExceptionVulkanAPI(VK_ERROR_EXTENSION_NOT_PRESENT,
+                              "vkEnumerateDeviceExtensionProperties");
+    }
+
+    VkPhysicalDeviceProperties2 physicalDeviceProperties2 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &physicalDeviceIDProperties};
+
+    vkGetPhysicalDeviceProperties2(activePhysicalDeviceHandle,
+                                   &physicalDeviceProperties2);
+
+    // the render targets as they are created, with an exportable allocation
+    VkPhysicalDeviceExternalImageFormatInfo externalImageFormatInfo = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO,
+        .pNext = NULL,
+        .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT};
+
+    VkPhysicalDeviceImageFormatInfo2 imageFormatInfo2 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2,
+        .pNext = &externalImageFormatInfo,
+        .format = renderFormat,
+        .type = VK_IMAGE_TYPE_2D,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = exportImageUsageFlags,
+        .flags = 0};
+
+    VkExternalImageFormatProperties externalImageFormatProperties = {
+        .sType = VK_STRUCTURE_TYPE_EXTERNAL_IMAGE_FORMAT_PROPERTIES,
+        .pNext = NULL};
+
+    VkImageFormatProperties2 imageFormatProperties2 = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2,
+        .pNext = &externalImageFormatProperties};
+
+    result = vkGetPhysicalDeviceImageFormatProperties2(
+        activePhysicalDeviceHandle, &imageFormatInfo2,
+        &imageFormatProperties2);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result,
+                              "vkGetPhysicalDeviceImageFormatProperties2");
+    }
+
+    if (!(externalImageFormatProperties.externalMemoryProperties
+              .externalMemoryFeatures &
+          VK_EXTERNAL_MEMORY_FEATURE_EXPORTABLE_BIT)) {
+      throwExceptionVulkanAPI(VK_ERROR_FORMAT_NOT_SUPPORTED,
+                              "vkGetPhysicalDeviceImageFormatProperties2");
+    }
+
+    VkPhysicalDeviceExternalSemaphoreInfo externalSemaphoreInfo = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_SEMAPHORE_INFO,
+        .pNext = NULL,
+        .handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT};
+
+    VkExternalSemaphoreProperties externalSemaphoreProperties = {
+        .sType = VK_STRUCTURE_TYPE_EXTERNAL_SEMAPHORE_PROPERTIES,
+        .pNext = NULL};
+
+    vkGetPhysicalDeviceExternalSemaphoreProperties(
+        activePhysicalDeviceHandle, &externalSemaphoreInfo,
+        &externalSemaphoreProperties);
+
+    if (!(externalSemaphoreProperties.externalSemaphoreFeatures &
+          VK_EXTERNAL_SEMAPHORE_FEATURE_EXPORTABLE_BIT)) {
+      throwExceptionVulkanAPI(VK_ERROR_FEATURE_NOT_PRESENT,
+                              "vkGetPhysicalDeviceExternalSemaphoreProperties");
+    }
+  }
+
+  // =========================================================================
+  // Frame Ring Support
+
+  // with VK_EXT_external_memory_host the ring's pages are imported as device
+  // memory and the readback copy writes them itself, without it every frame
+  // is copied over from its result buffer
+  bool isFrameRingDirect = false;
+  VkDeviceSize frameRingAlignment = sysconf(_SC_PAGESIZE);
+
+  if (isFrameRingEnabled &&
+      isDeviceExtensionSupported(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME)) {
+    VkPhysicalDeviceExternalMemoryHostPropertiesEXT
+        externalMemoryHostProperties = {
+            .sType =
+                VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT,
+            .pNext = NULL,
+            .minImportedHostPointerAlignment = 0};
+
+    VkPhysicalDeviceProperties2 physicalDeviceProperties2 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &externalMemoryHostProperties};
+
+    vkGetPhysicalDeviceProperties2(activePhysicalDeviceHandle,
+                                   &physicalDeviceProperties2);
+
+    frameRingAlignment =
+        std::max(frameRingAlignment,
+                 externalMemoryHostProperties.minImportedHostPointerAlignment);
+    isFrameRingDirect = true;
+  }
+
+  // =========================================================================
+  // Depth Format
+
+  // the most precise format that can be a depth attachment, nothing is ever
+  // read back so a stencil aspect is only tolerated
+  VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+
+  for (VkFormat format :
+       {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT,
+        VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D16_UNORM}) {
+    VkFormatProperties depthFormatProperties;
+    vkGetPhysicalDeviceFormatProperties(activePhysicalDeviceHandle, format,
+                                        &depthFormatProperties);
+
+    if (depthFormatProperties.optimalTilingFeatures &
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+      depthFormat = format;
+      break;
+    }
+  }
+
+  if (depthFormat == VK_FORMAT_UNDEFINED) {
+    throwExceptionVulkanAPI(VK_ERROR_FORMAT_NOT_SUPPORTED,
+                            "vkGetPhysicalDeviceFormatProperties");
+  }
+
+  // barriers on a combined format have to cover both aspects
+  VkImageSubresourceRange depthSubresourceRange = {
+      .aspectMask = (VkImageAspectFlags)(
+          depthFormat == VK_FORMAT_D32_SFLOAT ||
+                  depthFormat == VK_FORMAT_D16_UNORM
+              ? VK_IMAGE_ASPECT_DEPTH_BIT
+              : VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT),
+      .baseMipLevel = 0,
+      .levelCount = 1,
+      .baseArrayLayer = 0,
+      .layerCount = 1};
+
+  logStream << "depth format: " << getImageFormatName(depthFormat)
+            << std::endl;
+
+  // =========================================================================
+  // Sample Count
+
+  // every attachment of the pass shares one sample count, the highest one
+  // the color and depth attachments both support that is not above the
+  // requested count
+  VkSampleCountFlags supportedSampleCountFlags =
+      physicalDeviceProperties.limits.framebufferColorSampleCounts &
+      physicalDeviceProperties.limits.framebufferDepthSampleCounts;
+
+  if (depthSubresourceRange.aspectMask & VK_IMAGE_ASPECT_STENCIL_BIT) {
+    supportedSampleCountFlags &=
+        physicalDeviceProperties.limits.framebufferStencilSampleCounts;
+  }
+
+  VkSampleCountFlagBits sampleCountFlagBits = VK_SAMPLE_COUNT_1_BIT;
+
+  for (uint32_t count = VK_SAMPLE_COUNT_64_BIT; count > 1; count /= 2) {
+    if (count <= sampleCount && (supportedSampleCountFlags & count)) {
+      sampleCountFlagBits = (VkSampleCountFlagBits)count;
+      break;
+    }
+  }
+
+  if (sampleCountFlagBits != sampleCount) {
+    logStream << sampleCount << " samples not supported, using "
+              << sampleCountFlagBits << std::endl;
+    sampleCount = sampleCountFlagBits;
+  }
+
+  bool isMultisampleEnabled = sampleCountFlagBits != VK_SAMPLE_COUNT_1_BIT;
+
+  logStream << "samples: " << sampleCount << std::endl;
+
   // =========================================================================
   // Physical Device Submission Queue Families
 
@@ -230,9 +1423,35 @@ int main() {
 
   std::vector<const char *> deviceExtensionList = {};
 
+  void *deviceFeaturesNextPtr =
+      isTimelinePacingEnabled ? &deviceVulkan12Features : NULL;
+
+  if (isExtendedDynamicStateEnabled && !isExtendedDynamicStateCore) {
+    deviceExtensionList.push_back("VK_EXT_extended_dynamic_state");
+
+    extendedDynamicStateFeatures.pNext = deviceFeaturesNextPtr;
+    deviceFeaturesNextPtr = &extendedDynamicStateFeatures;
+  }
+
+  // the 1.3 feature struct is only valid on a 1.3 device, which is the only
+  // kind that can have either feature
+  if (isSynchronization2Enabled || isDynamicRenderingEnabled) {
+    deviceVulkan13Features.pNext = deviceFeaturesNextPtr;
+    deviceFeaturesNextPtr = &deviceVulkan13Features;
+  }
+
+  if (isFrameExportEnabled) {
+    deviceExtensionList.push_back(VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME);
+    deviceExtensionList.push_back(VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME);
+  }
+
+  if (isFrameRingDirect) {
+    deviceExtensionList.push_back(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+  }
+
   VkDeviceCreateInfo deviceCreateInfo = {
       .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-      .pNext = NULL,
+      .pNext = deviceFeaturesNextPtr,
       .flags = 0,
       .queueCreateInfoCount = 1,
       .pQueueCreateInfos = &deviceQueueCreateInfo,
@@ -250,12 +1469,66 @@ int main() {
     throwExceptionVulkanAPI(result, "vkCreateDevice");
   }
 
+  PFN_vkCmdSetCullMode pvkCmdSetCullMode = NULL;
+  PFN_vkCmdSetFrontFace pvkCmdSetFrontFace = NULL;
+  PFN_vkCmdSetPrimitiveTopology pvkCmdSetPrimitiveTopology = NULL;
+  PFN_vkCmdSetDepthTestEnable pvkCmdSetDepthTestEnable = NULL;
+  PFN_vkCmdSetDepthWriteEnable pvkCmdSetDepthWriteEnable = NULL;
+  PFN_vkCmdSetDepthCompareOp pvkCmdSetDepthCompareOp = NULL;
+
+  if (isExtendedDynamicStateEnabled) {
+    std::string suffix = isExtendedDynamicStateCore ? "" : "EXT";
+
+    pvkCmdSetCullMode = (PFN_vkCmdSetCullMode)vkGetDeviceProcAddr(
+        deviceHandle, ("vkCmdSetCullMode" + suffix).c_str());
+    pvkCmdSetFrontFace = (PFN_vkCmdSetFrontFace)vkGetDeviceProcAddr(
+        deviceHandle, ("vkCmdSetFrontFace" + suffix).c_str());
+    pvkCmdSetPrimitiveTopology =
+        (PFN_vkCmdSetPrimitiveTopology)vkGetDeviceProcAddr(
+            deviceHandle, ("vkCmdSetPrimitiveTopology" + suffix).c_str());
+    pvkCmdSetDepthTestEnable = (PFN_vkCmdSetDepthTestEnable)vkGetDeviceProcAddr(
+        deviceHandle, ("vkCmdSetDepthTestEnable" + suffix).c_str());
+    pvkCmdSetDepthWriteEnable =
+        (PFN_vkCmdSetDepthWriteEnable)vkGetDeviceProcAddr(
+            deviceHandle, ("vkCmdSetDepthWriteEnable" + suffix).c_str());
+    pvkCmdSetDepthCompareOp = (PFN_vkCmdSetDepthCompareOp)vkGetDeviceProcAddr(
+        deviceHandle, ("vkCmdSetDepthCompareOp" + suffix).c_str());
+  }
+
+  PFN_vkGetMemoryFdKHR pvkGetMemoryFdKHR = NULL;
+  PFN_vkGetSemaphoreFdKHR pvkGetSemaphoreFdKHR = NULL;
+
+  if (isFrameExportEnabled) {
+    pvkGetMemoryFdKHR = (PFN_vkGetMemoryFdKHR)vkGetDeviceProcAddr(
+        deviceHandle, "vkGetMemoryFdKHR");
+    pvkGetSemaphoreFdKHR = (PFN_vkGetSemaphoreFdKHR)vkGetDeviceProcAddr(
+        deviceHandle, "vkGetSemaphoreFdKHR");
+  }
+
+  PFN_vkGetMemoryHostPointerPropertiesEXT
+      pvkGetMemoryHostPointerPropertiesEXT = NULL;
+
+  if (isFrameRingDirect) {
+    pvkGetMemoryHostPointerPropertiesEXT =
+        (PFN_vkGetMemoryHostPointerPropertiesEXT)vkGetDeviceProcAddr(
+            deviceHandle, "vkGetMemoryHostPointerPropertiesEXT");
+  }
+
   // =========================================================================
   // Submission Queue
 
   VkQueue queueHandle = VK_NULL_HANDLE;
   vkGetDeviceQueue(deviceHandle, queueFamilyIndex, 0, &queueHandle);
 
+  // =========================================================================
+  // Device Memory Arena
+
+  DeviceMemoryArena deviceMemoryArena;
+  createDeviceMemoryArena(
+      deviceMemoryArena, deviceHandle, physicalDeviceMemoryProperties,
+      physicalDeviceProperties.limits.bufferImageGranularity,
+      physicalDeviceProperties.limits.nonCoherentAtomSize);
+
   // =========================================================================
   // Command Pool
 
@@ -281,10 +1554,10 @@ int main() {
       .pNext = NULL,
       .commandPool = commandPoolHandle,
       .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-      .commandBufferCount = 16};
+      .commandBufferCount = frameInFlightCount};
 
   std::vector<VkCommandBuffer> commandBufferHandleList =
-      std::vector<VkCommandBuffer>(16, VK_NULL_HANDLE);
+      std::vector<VkCommandBuffer>(frameInFlightCount, VK_NULL_HANDLE);
 
   result = vkAllocateCommandBuffers(deviceHandle, &commandBufferAllocateInfo,
                                     commandBufferHandleList.data());
@@ -296,19 +1569,72 @@ int main() {
   // =========================================================================
   // Render Pass
 
+  // startup cost of the objects dynamic rendering does without
+  double renderPassObjectCreationTime = 0;
+
+  std::chrono::steady_clock::time_point renderPassStartTimePoint =
+      std::chrono::steady_clock::now();
+
+  // how the finished frame is read into the result buffer, a copy or, for
+  // the y4m stream, the yuv conversion shader
+  VkImageLayout readbackImageLayout =
+      isY4MStreamEnabled ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                         : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  VkPipelineStageFlags2 readbackStageMask =
+      isY4MStreamEnabled ? VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT
+                         : VK_PIPELINE_STAGE_2_COPY_BIT;
+  VkAccessFlags2 readbackImageAccessMask =
+      isY4MStreamEnabled ? VK_ACCESS_2_SHADER_SAMPLED_READ_BIT
+                         : VK_ACCESS_2_TRANSFER_READ_BIT;
+  VkAccessFlags2 readbackBufferAccessMask =
+      isY4MStreamEnabled ? VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT
+                         : VK_ACCESS_2_TRANSFER_WRITE_BIT;
+  VkImageUsageFlags readbackImageUsageFlags =
+      isY4MStreamEnabled ? VK_IMAGE_USAGE_SAMPLED_BIT : 0;
+
+  // with multisampling the render target is only the resolve attachment,
+  // every sample it is resolved from is written in the pass
   std::vector<VkAttachmentDescription> attachmentDescriptionList = {
       {.flags = 0,
-       .format = VK_FORMAT_R8G8B8A8_UNORM,
+       .format = renderFormat,
        .samples = VK_SAMPLE_COUNT_1_BIT,
-       .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+       .loadOp = isMultisampleEnabled ? VK_ATTACHMENT_LOAD_OP_DONT_CARE
+                                      : VK_ATTACHMENT_LOAD_OP_CLEAR,
        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-       .finalLayout = VK_IMAGE_LAYOUT_GENERAL}};
+       .finalLayout = readbackImageLayout},
+      {.flags = 0,
+       .format = depthFormat,
+       .samples = sampleCountFlagBits,
+       .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+       .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+       .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+       .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+       .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+       .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL}};
 
   std::vector<VkAttachmentReference> attachmentReferenceList = {
-      {.attachment = 0, .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}};
+      {.attachment = 0, .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+      {.attachment = 1,
+       .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL},
+      {.attachment = 2, .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}};
+
+  // the samples are resolved at the end of the subpass and then discarded,
+  // they never have to leave tile memory
+  if (isMultisampleEnabled) {
+    attachmentDescriptionList.push_back(
+        {.flags = 0,
+         .format = renderFormat,
+         .samples = sampleCountFlagBits,
+         .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+         .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+         .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+         .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+  }
 
   VkSubpassDescription subpassDescription = {
       .flags = 0,
@@ -316,12 +1642,41 @@ int main() {
       .inputAttachmentCount = 0,
       .pInputAttachments = NULL,
       .colorAttachmentCount = 1,
-      .pColorAttachments = &attachmentReferenceList[0],
-      .pResolveAttachments = NULL,
-      .pDepthStencilAttachment = NULL,
+      .pColorAttachments = isMultisampleEnabled ? &attachmentReferenceList[2]
+                                                : &attachmentReferenceList[0],
+      .pResolveAttachments =
+          isMultisampleEnabled ? &attachmentReferenceList[0] : NULL,
+      .pDepthStencilAttachment = &attachmentReferenceList[1],
       .preserveAttachmentCount = 0,
       .pPreserveAttachments = NULL};
 
+  // the render target is read out after the pass, so the color writes (and
+  // the transition to the readback layout) must complete before those reads.
+  // The depth image is only ever an attachment, its clear has to wait for the
+  // depth tests of the frame that used it before
+  std::vector<VkSubpassDependency> subpassDependencyList = {
+      {.srcSubpass = VK_SUBPASS_EXTERNAL,
+       .dstSubpass = 0,
+       .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                       VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+       .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                       VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+       .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+       .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+       .dependencyFlags = 0},
+      {.srcSubpass = 0,
+       .dstSubpass = VK_SUBPASS_EXTERNAL,
+       .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+       .dstStageMask = isY4MStreamEnabled
+                           ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+                           : VK_PIPELINE_STAGE_TRANSFER_BIT,
+       .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+       .dstAccessMask = isY4MStreamEnabled ? VK_ACCESS_SHADER_READ_BIT
+                                           : VK_ACCESS_TRANSFER_READ_BIT,
+       .dependencyFlags = 0}};
+
   VkRenderPassCreateInfo renderPassCreateInfo = {
       .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
       .pNext = NULL,
@@ -330,39 +1685,62 @@ int main() {
       .pAttachments = attachmentDescriptionList.data(),
       .subpassCount = 1,
       .pSubpasses = &subpassDescription,
-      .dependencyCount = 0,
-      .pDependencies = NULL};
+      .dependencyCount = (uint32_t)subpassDependencyList.size(),
+      .pDependencies = subpassDependencyList.data()};
 
   VkRenderPass renderPassHandle = VK_NULL_HANDLE;
-  result = vkCreateRenderPass(deviceHandle, &renderPassCreateInfo, NULL,
-                              &renderPassHandle);
+  if (!isDynamicRenderingEnabled) {
+    result = vkCreateRenderPass(deviceHandle, &renderPassCreateInfo, NULL,
+                                &renderPassHandle);
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkCreateRenderPass");
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateRenderPass");
+    }
   }
 
+  renderPassObjectCreationTime +=
+      std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - renderPassStartTimePoint)
+          .count();
+
   // =========================================================================
   // Render Pass Images, Render Pass Image Views
 
-  std::vector<VkImage> renderPassImageHandleList(3, VK_NULL_HANDLE);
-  std::vector<VkImageView> renderPassImageViewHandleList(3, VK_NULL_HANDLE);
+  std::vector<VkImage> renderPassImageHandleList(frameInFlightCount,
+                                                 VK_NULL_HANDLE);
+  std::vector<VkImageView> renderPassImageViewHandleList(frameInFlightCount,
+                                                         VK_NULL_HANDLE);
+  std::vector<DeviceMemoryAllocation> renderPassImageAllocationList(
+      frameInFlightCount);
+
+  // exported render targets own their allocation, the consumer imports it
+  // whole
+  VkExternalMemoryImageCreateInfo externalMemoryImageCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO,
+      .pNext = NULL,
+      .handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT};
+
+  VkExportMemoryAllocateInfo exportMemoryAllocateInfo = {
+      .sType = VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO,
+      .pNext = NULL,
+      .handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT};
 
   for (uint32_t x = 0; x < renderPassImageHandleList.size(); x++) {
     VkImageCreateInfo renderPassImageCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-        .pNext = NULL,
+        .pNext = isFrameExportEnabled ? &externalMemoryImageCreateInfo : NULL,
         .flags = 0,
         .imageType = VK_IMAGE_TYPE_2D,
-        .format = VK_FORMAT_R8G8B8A8_UNORM,
-        .extent = {.width = 800,
-                   .height = 600,
+        .format = renderFormat,
+        .extent = {.width = maxRenderExtent.width,
+                   .height = maxRenderExtent.height,
                    .depth = 1},
         .mipLevels = 1,
         .arrayLayers = 1,
         .samples = VK_SAMPLE_COUNT_1_BIT,
         .tiling = VK_IMAGE_TILING_OPTIMAL,
         .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
-                 VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                 VK_IMAGE_USAGE_TRANSFER_SRC_BIT | readbackImageUsageFlags,
         .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
         .queueFamilyIndexCount = 1,
         .pQueueFamilyIndices = &queueFamilyIndex,
@@ -379,34 +1757,25 @@ int main() {
     vkGetImageMemoryRequirements(deviceHandle, renderPassImageHandleList[x],
                                  &renderPassImageMemoryRequirements);
 
-    uint32_t renderPassImageMemoryTypeIndex = -1;
-    for (uint32_t x = 0; x < physicalDeviceMemoryProperties.memoryTypeCount;
-         x++) {
-      if ((renderPassImageMemoryRequirements.memoryTypeBits & (1 << x)) &&
-          (physicalDeviceMemoryProperties.memoryTypes[x].propertyFlags &
-           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) ==
-              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) {
-
-        renderPassImageMemoryTypeIndex = x;
-        break;
-      }
+    if (isFrameExportEnabled) {
+      result = allocateDedicatedDeviceMemory(
+          deviceMemoryArena, renderPassImageMemoryRequirements,
+          DEVICE_MEMORY_USAGE_DEVICE, renderPassImageHandleList[x],
+          &exportMemoryAllocateInfo, &renderPassImageAllocationList[x]);
+    } else {
+      result = allocateDeviceMemory(deviceMemoryArena,
+                                    renderPassImageMemoryRequirements,
+                                    DEVICE_MEMORY_USAGE_DEVICE,
+                                    &renderPassImageAllocationList[x]);
     }
-
-    VkMemoryAllocateInfo renderPassImageMemoryAllocateInfo = {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .pNext = NULL,
-        .allocationSize = renderPassImageMemoryRequirements.size,
-        .memoryTypeIndex = renderPassImageMemoryTypeIndex};
-
-    VkDeviceMemory renderPassImageDeviceMemoryHandle = VK_NULL_HANDLE;
-    result = vkAllocateMemory(deviceHandle, &renderPassImageMemoryAllocateInfo,
-                              NULL, &renderPassImageDeviceMemoryHandle);
     if (result != VK_SUCCESS) {
       throwExceptionVulkanAPI(result, "vkAllocateMemory");
     }
 
-    result = vkBindImageMemory(deviceHandle, renderPassImageHandleList[x],
-                               renderPassImageDeviceMemoryHandle, 0);
+    result = vkBindImageMemory(
+        deviceHandle, renderPassImageHandleList[x],
+        renderPassImageAllocationList[x].deviceMemoryHandle,
+        renderPassImageAllocationList[x].offset);
     if (result != VK_SUCCESS) {
       throwExceptionVulkanAPI(result, "vkBindImageMemory");
     }
@@ -417,7 +1786,7 @@ int main() {
         .flags = 0,
         .image = renderPassImageHandleList[x],
         .viewType = VK_IMAGE_VIEW_TYPE_2D,
-        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .format = renderFormat,
         .components = {.r = VK_COMPONENT_SWIZZLE_IDENTITY,
                        .g = VK_COMPONENT_SWIZZLE_IDENTITY,
                        .b = VK_COMPONENT_SWIZZLE_IDENTITY,
@@ -436,24 +1805,228 @@ int main() {
     }
   }
 
+  // =========================================================================
+  // Depth Images, Depth Image Views
+
+  // depth is cleared on load and never stored, so on tiled GPUs it can live
+  // in lazily allocated memory that is never actually backed
+  std::vector<VkImage> depthImageHandleList(frameInFlightCount,
+                                            VK_NULL_HANDLE);
+  std::vector<VkImageView> depthImageViewHandleList(frameInFlightCount,
+                                                    VK_NULL_HANDLE);
+  std::vector<DeviceMemoryAllocation> depthImageAllocationList(
+      frameInFlightCount);
+
+  bool isDepthLazilyAllocated = false;
+
+  for (uint32_t x = 0; x < depthImageHandleList.size(); x++) {
+    VkImageCreateInfo depthImageCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = depthFormat,
+        .extent = {.width = maxRenderExtent.width,
+                   .height = maxRenderExtent.height,
+                   .depth = 1},
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = sampleCountFlagBits,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                 VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 1,
+        .pQueueFamilyIndices = &queueFamilyIndex,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED};
+
+    result = vkCreateImage(deviceHandle, &depthImageCreateInfo, NULL,
+                           &depthImageHandleList[x]);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateImage");
+    }
+
+    VkMemoryRequirements depthImageMemoryRequirements;
+    vkGetImageMemoryRequirements(deviceHandle, depthImageHandleList[x],
+                                 &depthImageMemoryRequirements);
+
+    result = allocateDeviceMemory(deviceMemoryArena,
+                                  depthImageMemoryRequirements,
+                                  DEVICE_MEMORY_USAGE_TRANSIENT,
+                                  &depthImageAllocationList[x]);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkAllocateMemory");
+    }
+
+    isDepthLazilyAllocated = isDeviceMemoryLazilyAllocated(
+        deviceMemoryArena, depthImageAllocationList[x]);
+
+    result = vkBindImageMemory(deviceHandle, depthImageHandleList[x],
+                               depthImageAllocationList[x].deviceMemoryHandle,
+                               depthImageAllocationList[x].offset);
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkBindImageMemory");
+    }
+
+    VkImageViewCreateInfo depthImageViewCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .image = depthImageHandleList[x],
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = depthFormat,
+        .components = {.r = VK_COMPONENT_SWIZZLE_IDENTITY,
+                       .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+                       .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+                       .a = VK_COMPONENT_SWIZZLE_IDENTITY},
+        .subresourceRange = depthSubresourceRange};
+
+    result = vkCreateImageView(deviceHandle, &depthImageViewCreateInfo, NULL,
+                               &depthImageViewHandleList[x]);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateImageView");
+    }
+  }
+
+  logStream << "depth memory: "
+            << (isDepthLazilyAllocated ? "lazily allocated" : "device local")
+            << std::endl;
+
+  // =========================================================================
+  // Multisample Images, Multisample Image Views
+
+  // like depth the samples are cleared on load and discarded once resolved,
+  // only created when multisampling
+  std::vector<VkImage> multisampleImageHandleList(
+      isMultisampleEnabled ? frameInFlightCount : 0, VK_NULL_HANDLE);
+  std::vector<VkImageView> multisampleImageViewHandleList(
+      multisampleImageHandleList.size(), VK_NULL_HANDLE);
+  std::vector<DeviceMemoryAllocation> multisampleImageAllocationList(
+      multisampleImageHandleList.size());
+
+  bool isMultisampleLazilyAllocated = false;
+
+  // what the images would keep resident if their samples were stored for a
+  // separate resolve
+  VkDeviceSize multisampleImageMemorySize = 0;
+
+  for (uint32_t x = 0; x < multisampleImageHandleList.size(); x++) {
+    VkImageCreateInfo multisampleImageCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = renderFormat,
+        .extent = {.width = maxRenderExtent.width,
+                   .height = maxRenderExtent.height,
+                   .depth = 1},
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = sampleCountFlagBits,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                 VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 1,
+        .pQueueFamilyIndices = &queueFamilyIndex,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED};
+
+    result = vkCreateImage(deviceHandle, &multisampleImageCreateInfo, NULL,
+                           &multisampleImageHandleList[x]);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateImage");
+    }
+
+    VkMemoryRequirements multisampleImageMemoryRequirements;
+    vkGetImageMemoryRequirements(deviceHandle, multisampleImageHandleList[x],
+                                 &multisampleImageMemoryRequirements);
+
+    multisampleImageMemorySize += multisampleImageMemoryRequirements.size;
+
+    result = allocateDeviceMemory(deviceMemoryArena,
+                                  multisampleImageMemoryRequirements,
+                                  DEVICE_MEMORY_USAGE_TRANSIENT,
+                                  &multisampleImageAllocationList[x]);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkAllocateMemory");
+    }
+
+    isMultisampleLazilyAllocated = isDeviceMemoryLazilyAllocated(
+        deviceMemoryArena, multisampleImageAllocationList[x]);
+
+    result = vkBindImageMemory(
+        deviceHandle, multisampleImageHandleList[x],
+        multisampleImageAllocationList[x].deviceMemoryHandle,
+        multisampleImageAllocationList[x].offset);
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkBindImageMemory");
+    }
+
+    VkImageViewCreateInfo multisampleImageViewCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .image = multisampleImageHandleList[x],
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = renderFormat,
+        .components = {.r = VK_COMPONENT_SWIZZLE_IDENTITY,
+                       .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+                       .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+                       .a = VK_COMPONENT_SWIZZLE_IDENTITY},
+        .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                             .baseMipLevel = 0,
+                             .levelCount = 1,
+                             .baseArrayLayer = 0,
+                             .layerCount = 1}};
+
+    result = vkCreateImageView(deviceHandle, &multisampleImageViewCreateInfo,
+                               NULL, &multisampleImageViewHandleList[x]);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateImageView");
+    }
+  }
+
+  if (isMultisampleEnabled) {
+    logStream << "multisample memory: "
+              << (isMultisampleLazilyAllocated ? "lazily allocated"
+                                               : "device local")
+              << ", " << multisampleImageMemorySize << " bytes" << std::endl;
+  }
+
   // =========================================================================
   // Framebuffers
 
-  std::vector<VkFramebuffer> framebufferHandleList(3, VK_NULL_HANDLE);
+  std::chrono::steady_clock::time_point framebufferStartTimePoint =
+      std::chrono::steady_clock::now();
+
+  // left empty with dynamic rendering, the destroy calls ignore null handles
+  std::vector<VkFramebuffer> framebufferHandleList(frameInFlightCount,
+                                                   VK_NULL_HANDLE);
 
-  for (uint32_t x = 0; x < framebufferHandleList.size(); x++) {
+  for (uint32_t x = 0;
+       x < framebufferHandleList.size() && !isDynamicRenderingEnabled; x++) {
     std::vector<VkImageView> imageViewHandleList = {
-        renderPassImageViewHandleList[x]};
+        renderPassImageViewHandleList[x], depthImageViewHandleList[x]};
+
+    if (isMultisampleEnabled) {
+      imageViewHandleList.push_back(multisampleImageViewHandleList[x]);
+    }
 
     VkFramebufferCreateInfo framebufferCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
         .pNext = NULL,
         .flags = 0,
         .renderPass = renderPassHandle,
-        .attachmentCount = 1,
+        .attachmentCount = (uint32_t)imageViewHandleList.size(),
         .pAttachments = imageViewHandleList.data(),
-        .width = 800,
-        .height = 600,
+        .width = maxRenderExtent.width,
+        .height = maxRenderExtent.height,
         .layers = 1};
 
     result = vkCreateFramebuffer(deviceHandle, &framebufferCreateInfo, NULL,
@@ -464,11 +2037,21 @@ int main() {
     }
   }
 
+  renderPassObjectCreationTime +=
+      std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - framebufferStartTimePoint)
+          .count();
+
+  logStream << "rendering: "
+            << (isDynamicRenderingEnabled ? "dynamic" : "render pass")
+            << ", render pass and framebuffer creation (ms): "
+            << renderPassObjectCreationTime << std::endl;
+
   // =========================================================================
   // Descriptor Pool
 
   std::vector<VkDescriptorPoolSize> descriptorPoolSizeList = {
-      {.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .descriptorCount = 1},
+      {.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, .descriptorCount = 1},
       {.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1}};
 
   VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {
@@ -492,7 +2075,7 @@ int main() {
 
   std::vector<VkDescriptorSetLayoutBinding> descriptorSetLayoutBindingList = {
       {.binding = 0,
-       .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+       .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
        .descriptorCount = 1,
        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
        .pImmutableSamplers = NULL}};
@@ -614,9 +2197,44 @@ int main() {
     throwExceptionVulkanAPI(result, "vkCreateShaderModule");
   }
 
+  // =========================================================================
+  // Pipeline Cache
+
+  std::string pipelineCachePath =
+      getPipelineCachePath(getCacheDirectoryPath(), "headless_triangle");
+
+  std::vector<char> initialPipelineCacheData =
+      readPipelineCacheFile(pipelineCachePath, physicalDeviceProperties);
+
+  VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+      .pNext = NULL,
+      .flags = 0,
+      .initialDataSize = initialPipelineCacheData.size(),
+      .pInitialData = initialPipelineCacheData.data()};
+
+  VkPipelineCache pipelineCacheHandle = VK_NULL_HANDLE;
+  result = vkCreatePipelineCache(deviceHandle, &pipelineCacheCreateInfo, NULL,
+                                 &pipelineCacheHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreatePipelineCache");
+  }
+
   // =========================================================================
   // Graphics Pipeline
 
+  // the fragment shader's loop count is a specialization constant so the
+  // compiler can unroll it
+  VkSpecializationMapEntry shadingSpecializationMapEntry = {
+      .constantID = 0, .offset = 0, .size = sizeof(int32_t)};
+
+  VkSpecializationInfo shadingSpecializationInfo = {
+      .mapEntryCount = 1,
+      .pMapEntries = &shadingSpecializationMapEntry,
+      .dataSize = sizeof(int32_t),
+      .pData = &shadingIterationCount};
+
   std::vector<VkPipelineShaderStageCreateInfo>
       pipelineShaderStageCreateInfoList = {
           {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
@@ -632,7 +2250,7 @@ int main() {
            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
            .module = fragmentShaderModuleHandle,
            .pName = "main",
-           .pSpecializationInfo = NULL}};
+           .pSpecializationInfo = &shadingSpecializationInfo}};
 
   VkVertexInputBindingDescription vertexInputBindingDescription = {
       .binding = 0,
@@ -661,25 +2279,16 @@ int main() {
        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
        .primitiveRestartEnable = VK_FALSE};
 
-  VkViewport viewport = {
-      .x = 0,
-      .y = 0,
-      .width = 800,
-      .height = 600,
-      .minDepth = 0,
-      .maxDepth = 1};
-
-  VkRect2D screenRect2D = {.offset = {.x = 0, .y = 0},
-                           .extent = {.width = 800, .height = 600}};
-
+  // viewport and scissor are set per frame from the frame's extent, so the
+  // pipeline does not depend on the render target size
   VkPipelineViewportStateCreateInfo pipelineViewportStateCreateInfo = {
       .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
       .pNext = NULL,
       .flags = 0,
       .viewportCount = 1,
-      .pViewports = &viewport,
+      .pViewports = NULL,
       .scissorCount = 1,
-      .pScissors = &screenRect2D};
+      .pScissors = NULL};
 
   VkPipelineRasterizationStateCreateInfo pipelineRasterizationStateCreateInfo =
       {.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
@@ -700,7 +2309,7 @@ int main() {
       .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
       .pNext = NULL,
       .flags = 0,
-      .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+      .rasterizationSamples = sampleCountFlagBits,
       .sampleShadingEnable = VK_FALSE,
       .minSampleShading = 0.0,
       .pSampleMask = NULL,
@@ -718,13 +2327,15 @@ int main() {
       .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
                         VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT};
 
+  // after a depth prepass only the fragments that won it are shaded
   VkPipelineDepthStencilStateCreateInfo pipelineDepthStencilStateCreateInfo = {
       .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
       .pNext = NULL,
       .flags = 0,
       .depthTestEnable = VK_TRUE,
-      .depthWriteEnable = VK_TRUE,
-      .depthCompareOp = VK_COMPARE_OP_LESS,
+      .depthWriteEnable = isDepthPrepassEnabled ? VK_FALSE : VK_TRUE,
+      .depthCompareOp =
+          isDepthPrepassEnabled ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS,
       .depthBoundsTestEnable = VK_FALSE,
       .stencilTestEnable = VK_FALSE,
       .front = {},
@@ -732,6 +2343,12 @@ int main() {
       .minDepthBounds = 0.0,
       .maxDepthBounds = 1.0};
 
+  VkPipelineDepthStencilStateCreateInfo
+      depthPrepassDepthStencilStateCreateInfo =
+          pipelineDepthStencilStateCreateInfo;
+  depthPrepassDepthStencilStateCreateInfo.depthWriteEnable = VK_TRUE;
+  depthPrepassDepthStencilStateCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+
   VkPipelineColorBlendStateCreateInfo pipelineColorBlendStateCreateInfo = {
       .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
       .pNext = NULL,
@@ -742,9 +2359,40 @@ int main() {
       .pAttachments = &pipelineColorBlendAttachmentState,
       .blendConstants = {0, 0, 0, 0}};
 
+  std::vector<VkDynamicState> dynamicStateList = {VK_DYNAMIC_STATE_VIEWPORT,
+                                                  VK_DYNAMIC_STATE_SCISSOR};
+
+  if (isExtendedDynamicStateEnabled) {
+    dynamicStateList.insert(dynamicStateList.end(),
+                            {VK_DYNAMIC_STATE_CULL_MODE,
+                             VK_DYNAMIC_STATE_FRONT_FACE,
+                             VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY,
+                             VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE,
+                             VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE,
+                             VK_DYNAMIC_STATE_DEPTH_COMPARE_OP});
+  }
+
+  VkPipelineDynamicStateCreateInfo pipelineDynamicStateCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+      .pNext = NULL,
+      .flags = 0,
+      .dynamicStateCount = (uint32_t)dynamicStateList.size(),
+      .pDynamicStates = dynamicStateList.data()};
+
+  // only the attachment formats are needed, the pipeline is compatible with
+  // any dynamic rendering instance that uses them
+  VkPipelineRenderingCreateInfo pipelineRenderingCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+      .pNext = NULL,
+      .viewMask = 0,
+      .colorAttachmentCount = 1,
+      .pColorAttachmentFormats = &renderFormat,
+      .depthAttachmentFormat = depthFormat,
+      .stencilAttachmentFormat = VK_FORMAT_UNDEFINED};
+
   VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo = {
       .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-      .pNext = NULL,
+      .pNext = isDynamicRenderingEnabled ? &pipelineRenderingCreateInfo : NULL,
       .flags = 0,
       .stageCount = (uint32_t)pipelineShaderStageCreateInfoList.size(),
       .pStages = pipelineShaderStageCreateInfoList.data(),
@@ -756,22 +2404,272 @@ int main() {
       .pMultisampleState = &pipelineMultisampleStateCreateInfo,
       .pDepthStencilState = &pipelineDepthStencilStateCreateInfo,
       .pColorBlendState = &pipelineColorBlendStateCreateInfo,
-      .pDynamicState = NULL,
+      .pDynamicState = &pipelineDynamicStateCreateInfo,
       .layout = pipelineLayoutHandle,
       .renderPass = renderPassHandle,
       .subpass = 0,
       .basePipelineHandle = VK_NULL_HANDLE,
       .basePipelineIndex = 0};
 
-  VkPipeline graphicsPipelineHandle = VK_NULL_HANDLE;
-  result = vkCreateGraphicsPipelines(deviceHandle, VK_NULL_HANDLE, 1,
-                                     &graphicsPipelineCreateInfo, NULL,
-                                     &graphicsPipelineHandle);
+  std::vector<VkGraphicsPipelineCreateInfo> graphicsPipelineCreateInfoList = {
+      graphicsPipelineCreateInfo};
+
+  // vertex shader only and no color writes, it fills the depth buffer with
+  // the nearest surface
+  VkPipelineColorBlendAttachmentState depthPrepassColorBlendAttachmentState =
+      pipelineColorBlendAttachmentState;
+  depthPrepassColorBlendAttachmentState.colorWriteMask = 0;
+
+  VkPipelineColorBlendStateCreateInfo depthPrepassColorBlendStateCreateInfo =
+      pipelineColorBlendStateCreateInfo;
+  depthPrepassColorBlendStateCreateInfo.pAttachments =
+      &depthPrepassColorBlendAttachmentState;
+
+  if (isDepthPrepassEnabled) {
+    VkGraphicsPipelineCreateInfo depthPrepassPipelineCreateInfo =
+        graphicsPipelineCreateInfo;
+    depthPrepassPipelineCreateInfo.stageCount = 1;
+    depthPrepassPipelineCreateInfo.pDepthStencilState =
+        &depthPrepassDepthStencilStateCreateInfo;
+    depthPrepassPipelineCreateInfo.pColorBlendState =
+        &depthPrepassColorBlendStateCreateInfo;
+
+    graphicsPipelineCreateInfoList.push_back(depthPrepassPipelineCreateInfo);
+  }
+
+  std::chrono::steady_clock::time_point pipelineStartTimePoint =
+      std::chrono::steady_clock::now();
+
+  std::vector<VkPipeline> graphicsPipelineHandleList(
+      graphicsPipelineCreateInfoList.size(), VK_NULL_HANDLE);
+  result = vkCreateGraphicsPipelines(
+      deviceHandle, pipelineCacheHandle,
+      (uint32_t)graphicsPipelineCreateInfoList.size(),
+      graphicsPipelineCreateInfoList.data(), NULL,
+      graphicsPipelineHandleList.data());
 
   if (result != VK_SUCCESS) {
     throwExceptionVulkanAPI(result, "vkCreateGraphicsPipelines");
   }
 
+  VkPipeline graphicsPipelineHandle = graphicsPipelineHandleList[0];
+  VkPipeline depthPrepassPipelineHandle =
+      isDepthPrepassEnabled ? graphicsPipelineHandleList[1] : VK_NULL_HANDLE;
+
+  logStream << "graphics pipeline creation (ms): "
+            << std::chrono::duration<double, std::milli>(
+                   std::chrono::steady_clock::now() - pipelineStartTimePoint)
+                   .count()
+            << (initialPipelineCacheData.empty() ? " (cold cache)"
+                                                 : " (warm cache)")
+            << std::endl;
+
+  // =========================================================================
+  // YUV Conversion Pipeline
+
+  // only for the y4m stream, a compute pass after the frame that writes its
+  // yuv 4:2:0 planes into the result buffer in place of the rgba copy. The
+  // shader fetches whole texels, the sampler is only there because a
+  // sampled image needs one
+  VkSampler yuvSamplerHandle = VK_NULL_HANDLE;
+  VkDescriptorSetLayout yuvDescriptorSetLayoutHandle = VK_NULL_HANDLE;
+  VkDescriptorPool yuvDescriptorPoolHandle = VK_NULL_HANDLE;
+  std::vector<VkDescriptorSet> yuvDescriptorSetHandleList;
+  VkPipelineLayout yuvPipelineLayoutHandle = VK_NULL_HANDLE;
+  VkShaderModule yuvShaderModuleHandle = VK_NULL_HANDLE;
+  VkPipeline yuvPipelineHandle = VK_NULL_HANDLE;
+
+  // pitches and offsets in words, as the shader stores them
+  struct YUVPushConstants {
+    uint32_t extent[2];
+    uint32_t lumaRowPitch;
+    uint32_t chromaRowPitch;
+    uint32_t uPlaneOffset;
+    uint32_t vPlaneOffset;
+  };
+
+  if (isY4MStreamEnabled) {
+    VkSamplerCreateInfo yuvSamplerCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .magFilter = VK_FILTER_NEAREST,
+        .minFilter = VK_FILTER_NEAREST,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .mipLodBias = 0.0f,
+        .anisotropyEnable = VK_FALSE,
+        .maxAnisotropy = 1.0f,
+        .compareEnable = VK_FALSE,
+        .compareOp = VK_COMPARE_OP_ALWAYS,
+        .minLod = 0.0f,
+        .maxLod = 0.0f,
+        .borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+        .unnormalizedCoordinates = VK_FALSE};
+
+    result = vkCreateSampler(deviceHandle, &yuvSamplerCreateInfo, NULL,
+                             &yuvSamplerHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateSampler");
+    }
+
+    std::vector<VkDescriptorSetLayoutBinding>
+        yuvDescriptorSetLayoutBindingList = {
+            {.binding = 0,
+             .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+             .descriptorCount = 1,
+             .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+             .pImmutableSamplers = &yuvSamplerHandle},
+            {.binding = 1,
+             .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+             .descriptorCount = 1,
+             .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+             .pImmutableSamplers = NULL}};
+
+    VkDescriptorSetLayoutCreateInfo yuvDescriptorSetLayoutCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .bindingCount = (uint32_t)yuvDescriptorSetLayoutBindingList.size(),
+        .pBindings = yuvDescriptorSetLayoutBindingList.data()};
+
+    result = vkCreateDescriptorSetLayout(deviceHandle,
+                                         &yuvDescriptorSetLayoutCreateInfo,
+                                         NULL, &yuvDescriptorSetLayoutHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateDescriptorSetLayout");
+    }
+
+    // one set per frame in flight, each points at its frame's image and
+    // result buffer
+    std::vector<VkDescriptorPoolSize> yuvDescriptorPoolSizeList = {
+        {.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+         .descriptorCount = frameInFlightCount},
+        {.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .descriptorCount = frameInFlightCount}};
+
+    VkDescriptorPoolCreateInfo yuvDescriptorPoolCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .maxSets = frameInFlightCount,
+        .poolSizeCount = (uint32_t)yuvDescriptorPoolSizeList.size(),
+        .pPoolSizes = yuvDescriptorPoolSizeList.data()};
+
+    result = vkCreateDescriptorPool(deviceHandle, &yuvDescriptorPoolCreateInfo,
+                                    NULL, &yuvDescriptorPoolHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateDescriptorPool");
+    }
+
+    std::vector<VkDescriptorSetLayout> yuvDescriptorSetLayoutHandleList(
+        frameInFlightCount, yuvDescriptorSetLayoutHandle);
+
+    VkDescriptorSetAllocateInfo yuvDescriptorSetAllocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = NULL,
+        .descriptorPool = yuvDescriptorPoolHandle,
+        .descriptorSetCount = frameInFlightCount,
+        .pSetLayouts = yuvDescriptorSetLayoutHandleList.data()};
+
+    yuvDescriptorSetHandleList.resize(frameInFlightCount, VK_NULL_HANDLE);
+
+    result = vkAllocateDescriptorSets(deviceHandle,
+                                      &yuvDescriptorSetAllocateInfo,
+                                      yuvDescriptorSetHandleList.data());
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkAllocateDescriptorSets");
+    }
+
+    VkPushConstantRange yuvPushConstantRange = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(YUVPushConstants)};
+
+    VkPipelineLayoutCreateInfo yuvPipelineLayoutCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .setLayoutCount = 1,
+        .pSetLayouts = &yuvDescriptorSetLayoutHandle,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &yuvPushConstantRange};
+
+    result = vkCreatePipelineLayout(deviceHandle, &yuvPipelineLayoutCreateInfo,
+                                    NULL, &yuvPipelineLayoutHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreatePipelineLayout");
+    }
+
+    std::ifstream yuvFile = getShaderFile("yuv.comp.spv");
+    std::streamsize yuvFileSize = yuvFile.tellg();
+    yuvFile.seekg(0, std::ios::beg);
+    std::vector<uint32_t> yuvShaderSource(yuvFileSize / sizeof(uint32_t));
+
+    yuvFile.read(reinterpret_cast<char *>(yuvShaderSource.data()),
+                 yuvFileSize);
+
+    yuvFile.close();
+
+    VkShaderModuleCreateInfo yuvShaderModuleCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .codeSize = (uint32_t)yuvShaderSource.size() * sizeof(uint32_t),
+        .pCode = yuvShaderSource.data()};
+
+    result = vkCreateShaderModule(deviceHandle, &yuvShaderModuleCreateInfo,
+                                  NULL, &yuvShaderModuleHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateShaderModule");
+    }
+
+    // the fetch decodes srgb formats, the shader encodes again to match the
+    // bytes a copy would read
+    VkBool32 isSRGB = renderFormat == VK_FORMAT_R8G8B8A8_SRGB ||
+                      renderFormat == VK_FORMAT_B8G8R8A8_SRGB;
+
+    VkSpecializationMapEntry yuvSpecializationMapEntry = {
+        .constantID = 0, .offset = 0, .size = sizeof(VkBool32)};
+
+    VkSpecializationInfo yuvSpecializationInfo = {
+        .mapEntryCount = 1,
+        .pMapEntries = &yuvSpecializationMapEntry,
+        .dataSize = sizeof(VkBool32),
+        .pData = &isSRGB};
+
+    VkComputePipelineCreateInfo yuvPipelineCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .stage = {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                  .pNext = NULL,
+                  .flags = 0,
+                  .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                  .module = yuvShaderModuleHandle,
+                  .pName = "main",
+                  .pSpecializationInfo = &yuvSpecializationInfo},
+        .layout = yuvPipelineLayoutHandle,
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex = 0};
+
+    result = vkCreateComputePipelines(deviceHandle, pipelineCacheHandle, 1,
+                                      &yuvPipelineCreateInfo, NULL,
+                                      &yuvPipelineHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateComputePipelines");
+    }
+  }
+
   // =========================================================================
   // Vertex Buffer
 
@@ -788,7 +2686,7 @@ int main() {
       .flags = 0,
       .size = sizeof(vertexBuffer),
       .usage =
-          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
       .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
       .queueFamilyIndexCount = 1,
       .pQueueFamilyIndices = &queueFamilyIndex};
@@ -805,50 +2703,35 @@ int main() {
   vkGetBufferMemoryRequirements(deviceHandle, vertexBufferHandle,
                                 &vertexMemoryRequirements);
 
-  uint32_t vertexMemoryTypeIndex = -1;
-  for (uint32_t x = 0; x < physicalDeviceMemoryProperties.memoryTypeCount;
-       x++) {
-    if ((vertexMemoryRequirements.memoryTypeBits & (1 << x)) &&
-        (physicalDeviceMemoryProperties.memoryTypes[x].propertyFlags &
-         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ==
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
-
-      vertexMemoryTypeIndex = x;
-      break;
-    }
-  }
-
-  VkMemoryAllocateInfo vertexMemoryAllocateInfo = {
-      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-      .pNext = NULL,
-      .allocationSize = vertexMemoryRequirements.size,
-      .memoryTypeIndex = vertexMemoryTypeIndex};
-
-  VkDeviceMemory vertexDeviceMemoryHandle = VK_NULL_HANDLE;
-  result = vkAllocateMemory(deviceHandle, &vertexMemoryAllocateInfo, NULL,
-                            &vertexDeviceMemoryHandle);
+  // static geometry lives in device local memory, it is only written
+  // directly when that memory is also host visible (resizable BAR, UMA).
+  // The upload usage ranks such a type above any host memory
+  bool isGeometryStaged =
+      findMemoryTypeIndex(physicalDeviceMemoryProperties,
+                          vertexMemoryRequirements.memoryTypeBits,
+                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) ==
+      (uint32_t)-1;
+
+  DeviceMemoryUsage geometryMemoryUsage =
+      isGeometryStaged ? DEVICE_MEMORY_USAGE_DEVICE
+                       : DEVICE_MEMORY_USAGE_UPLOAD;
+
+  DeviceMemoryAllocation vertexAllocation;
+  result = allocateDeviceMemory(deviceMemoryArena, vertexMemoryRequirements,
+                                geometryMemoryUsage, &vertexAllocation);
   if (result != VK_SUCCESS) {
     throwExceptionVulkanAPI(result, "vkAllocateMemory");
   }
 
   result = vkBindBufferMemory(deviceHandle, vertexBufferHandle,
-                              vertexDeviceMemoryHandle, 0);
+                              vertexAllocation.deviceMemoryHandle,
+                              vertexAllocation.offset);
   if (result != VK_SUCCESS) {
     throwExceptionVulkanAPI(result, "vkBindBufferMemory");
   }
 
-  void *hostVertexMemoryBuffer;
-  result = vkMapMemory(deviceHandle, vertexDeviceMemoryHandle, 0,
-                       sizeof(vertexBuffer), 0, &hostVertexMemoryBuffer);
-
-  memcpy(hostVertexMemoryBuffer, vertexBuffer, sizeof(vertexBuffer));
-
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkMapMemory");
-  }
-
-  vkUnmapMemory(deviceHandle, vertexDeviceMemoryHandle);
-
   // =========================================================================
   // Index Buffer
 
@@ -863,7 +2746,7 @@ int main() {
       .flags = 0,
       .size = sizeof(indexBuffer),
       .usage =
-          VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+          VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
       .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
       .queueFamilyIndexCount = 1,
       .pQueueFamilyIndices = &queueFamilyIndex};
@@ -880,49 +2763,207 @@ int main() {
   vkGetBufferMemoryRequirements(deviceHandle, indexBufferHandle,
                                 &indexMemoryRequirements);
 
-  uint32_t indexMemoryTypeIndex = -1;
-  for (uint32_t x = 0; x < physicalDeviceMemoryProperties.memoryTypeCount;
-       x++) {
-    if ((indexMemoryRequirements.memoryTypeBits & (1 << x)) &&
-        (physicalDeviceMemoryProperties.memoryTypes[x].propertyFlags &
-         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ==
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
-
-      indexMemoryTypeIndex = x;
-      break;
-    }
-  }
-
-  VkMemoryAllocateInfo indexMemoryAllocateInfo = {
-      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-      .pNext = NULL,
-      .allocationSize = indexMemoryRequirements.size,
-      .memoryTypeIndex = indexMemoryTypeIndex};
-
-  VkDeviceMemory indexDeviceMemoryHandle = VK_NULL_HANDLE;
-  result = vkAllocateMemory(deviceHandle, &indexMemoryAllocateInfo, NULL,
-                            &indexDeviceMemoryHandle);
+  DeviceMemoryAllocation indexAllocation;
+  result = allocateDeviceMemory(deviceMemoryArena, indexMemoryRequirements,
+                                geometryMemoryUsage, &indexAllocation);
   if (result != VK_SUCCESS) {
     throwExceptionVulkanAPI(result, "vkAllocateMemory");
   }
 
   result = vkBindBufferMemory(deviceHandle, indexBufferHandle,
-                              indexDeviceMemoryHandle, 0);
+                              indexAllocation.deviceMemoryHandle,
+                              indexAllocation.offset);
   if (result != VK_SUCCESS) {
     throwExceptionVulkanAPI(result, "vkBindBufferMemory");
   }
 
-  void *hostIndexMemoryBuffer;
-  result = vkMapMemory(deviceHandle, indexDeviceMemoryHandle, 0,
-                       sizeof(indexBuffer), 0, &hostIndexMemoryBuffer);
+  // =========================================================================
+  // Pipeline Barrier Tracker
 
-  memcpy(hostIndexMemoryBuffer, indexBuffer, sizeof(indexBuffer));
+  // shared by the upload and the frame command buffers, each recording starts
+  // from a reset tracker and declares the state its resources are in
+  PipelineBarrierTracker pipelineBarrierTracker;
+  pipelineBarrierTracker.isSynchronization2Enabled = isSynchronization2Enabled;
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkMapMemory");
+  // =========================================================================
+  // Geometry Upload
+
+  std::chrono::steady_clock::time_point uploadStartTimePoint =
+      std::chrono::steady_clock::now();
+
+  if (isGeometryStaged) {
+    VkBufferCreateInfo stagingBufferCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .size = sizeof(vertexBuffer) + sizeof(indexBuffer),
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 1,
+        .pQueueFamilyIndices = &queueFamilyIndex};
+
+    VkBuffer stagingBufferHandle = VK_NULL_HANDLE;
+    result = vkCreateBuffer(deviceHandle, &stagingBufferCreateInfo, NULL,
+                            &stagingBufferHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateBuffer");
+    }
+
+    VkMemoryRequirements stagingMemoryRequirements;
+    vkGetBufferMemoryRequirements(deviceHandle, stagingBufferHandle,
+                                  &stagingMemoryRequirements);
+
+    DeviceMemoryAllocation stagingAllocation;
+    result = allocateDeviceMemory(deviceMemoryArena, stagingMemoryRequirements,
+                                  DEVICE_MEMORY_USAGE_UPLOAD,
+                                  &stagingAllocation);
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkAllocateMemory");
+    }
+
+    result = vkBindBufferMemory(deviceHandle, stagingBufferHandle,
+                                stagingAllocation.deviceMemoryHandle,
+                                stagingAllocation.offset);
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkBindBufferMemory");
+    }
+
+    memcpy(stagingAllocation.hostMemoryPtr, vertexBuffer,
+           sizeof(vertexBuffer));
+    memcpy((char *)stagingAllocation.hostMemoryPtr + sizeof(vertexBuffer),
+           indexBuffer, sizeof(indexBuffer));
+
+    VkCommandBufferAllocateInfo uploadCommandBufferAllocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .pNext = NULL,
+        .commandPool = commandPoolHandle,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1};
+
+    VkCommandBuffer uploadCommandBufferHandle = VK_NULL_HANDLE;
+    result = vkAllocateCommandBuffers(deviceHandle,
+                                      &uploadCommandBufferAllocateInfo,
+                                      &uploadCommandBufferHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkAllocateCommandBuffers");
+    }
+
+    VkCommandBufferBeginInfo uploadCommandBufferBeginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = NULL,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = NULL};
+
+    result = vkBeginCommandBuffer(uploadCommandBufferHandle,
+                                  &uploadCommandBufferBeginInfo);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkBeginCommandBuffer");
+    }
+
+    // both buffers are new, the copies need no barrier in front of them
+    resetPipelineBarrierTracker(pipelineBarrierTracker);
+    trackBuffer(pipelineBarrierTracker, vertexBufferHandle);
+    trackBuffer(pipelineBarrierTracker, indexBufferHandle);
+
+    requireBufferAccess(pipelineBarrierTracker, vertexBufferHandle,
+                        VK_PIPELINE_STAGE_2_COPY_BIT,
+                        VK_ACCESS_2_TRANSFER_WRITE_BIT);
+    requireBufferAccess(pipelineBarrierTracker, indexBufferHandle,
+                        VK_PIPELINE_STAGE_2_COPY_BIT,
+                        VK_ACCESS_2_TRANSFER_WRITE_BIT);
+    flushPipelineBarriers(pipelineBarrierTracker, uploadCommandBufferHandle);
+
+    VkBufferCopy vertexBufferCopy = {
+        .srcOffset = 0, .dstOffset = 0, .size = sizeof(vertexBuffer)};
+
+    vkCmdCopyBuffer(uploadCommandBufferHandle, stagingBufferHandle,
+                    vertexBufferHandle, 1, &vertexBufferCopy);
+
+    VkBufferCopy indexBufferCopy = {.srcOffset = sizeof(vertexBuffer),
+                                    .dstOffset = 0,
+                                    .size = sizeof(indexBuffer)};
+
+    vkCmdCopyBuffer(uploadCommandBufferHandle, stagingBufferHandle,
+                    indexBufferHandle, 1, &indexBufferCopy);
+
+    // the two buffer barriers go out in one dependency info, each waited on
+    // only by the input stage that reads it
+    requireBufferAccess(pipelineBarrierTracker, vertexBufferHandle,
+                        VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT,
+                        VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT);
+    requireBufferAccess(pipelineBarrierTracker, indexBufferHandle,
+                        VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT,
+                        VK_ACCESS_2_INDEX_READ_BIT);
+    flushPipelineBarriers(pipelineBarrierTracker, uploadCommandBufferHandle);
+
+    result = vkEndCommandBuffer(uploadCommandBufferHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkEndCommandBuffer");
+    }
+
+    VkFenceCreateInfo uploadFenceCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0};
+
+    VkFence uploadFenceHandle = VK_NULL_HANDLE;
+    result = vkCreateFence(deviceHandle, &uploadFenceCreateInfo, NULL,
+                           &uploadFenceHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateFence");
+    }
+
+    VkSubmitInfo uploadSubmitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = NULL,
+        .waitSemaphoreCount = 0,
+        .pWaitSemaphores = NULL,
+        .pWaitDstStageMask = NULL,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &uploadCommandBufferHandle,
+        .signalSemaphoreCount = 0,
+        .pSignalSemaphores = NULL};
+
+    result = vkQueueSubmit(queueHandle, 1, &uploadSubmitInfo,
+                           uploadFenceHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkQueueSubmit");
+    }
+
+    result = vkWaitForFences(deviceHandle, 1, &uploadFenceHandle, true,
+                             UINT64_MAX);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkWaitForFences");
+    }
+
+    vkDestroyFence(deviceHandle, uploadFenceHandle, NULL);
+    vkFreeCommandBuffers(deviceHandle, commandPoolHandle, 1,
+                         &uploadCommandBufferHandle);
+    vkDestroyBuffer(deviceHandle, stagingBufferHandle, NULL);
+    freeDeviceMemory(deviceMemoryArena, stagingAllocation);
+  } else {
+    memcpy(vertexAllocation.hostMemoryPtr, vertexBuffer, sizeof(vertexBuffer));
+    memcpy(indexAllocation.hostMemoryPtr, indexBuffer, sizeof(indexBuffer));
   }
 
-  vkUnmapMemory(deviceHandle, indexDeviceMemoryHandle);
+  double uploadSeconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() -
+                             uploadStartTimePoint)
+                             .count();
+
+  // the geometry is a few dozen bytes, the time is the latency of a
+  // submission and says nothing about transfer bandwidth
+  logStream << "geometry upload: "
+            << (isGeometryStaged ? "staged" : "direct") << ", "
+            << sizeof(vertexBuffer) + sizeof(indexBuffer) << " bytes in "
+            << uploadSeconds * 1000.0 << " ms" << std::endl;
 
   // =========================================================================
   // Uniform Buffer
@@ -933,14 +2974,27 @@ int main() {
     float cameraUp[4] = {0, 1, 0, 1};
     float cameraForward[4] = {0, 0, 1, 1};
 
+    // scale (xy) and offset (zw) from the whole output to the tile that is
+    // being rendered, identity outside of tiled output
+    float tileTransform[4] = {1, 1, 0, 0};
+
     uint32_t frameCount = 0;
   } uniformStructure;
 
+  // one slot per in-flight frame, selected with a dynamic offset so a frame
+  // update is a single memcpy into memory the GPU is no longer reading
+  VkDeviceSize minUniformBufferOffsetAlignment =
+      physicalDeviceProperties.limits.minUniformBufferOffsetAlignment;
+
+  VkDeviceSize uniformSlotSize =
+      (sizeof(UniformStructure) + minUniformBufferOffsetAlignment - 1) /
+      minUniformBufferOffsetAlignment * minUniformBufferOffsetAlignment;
+
   VkBufferCreateInfo uniformBufferCreateInfo = {
       .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
       .pNext = NULL,
       .flags = 0,
-      .size = sizeof(UniformStructure),
+      .size = uniformSlotSize * renderPassImageHandleList.size(),
       .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
       .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
       .queueFamilyIndexCount = 1,
@@ -958,117 +3012,247 @@ int main() {
   vkGetBufferMemoryRequirements(deviceHandle, uniformBufferHandle,
                                 &uniformMemoryRequirements);
 
-  uint32_t uniformMemoryTypeIndex = -1;
-  for (uint32_t x = 0; x < physicalDeviceMemoryProperties.memoryTypeCount;
-       x++) {
-    if ((uniformMemoryRequirements.memoryTypeBits & (1 << x)) &&
-        (physicalDeviceMemoryProperties.memoryTypes[x].propertyFlags &
-         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ==
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
-
-      uniformMemoryTypeIndex = x;
-      break;
-    }
-  }
-
-  VkMemoryAllocateInfo uniformMemoryAllocateInfo = {
-      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-      .pNext = NULL,
-      .allocationSize = uniformMemoryRequirements.size,
-      .memoryTypeIndex = uniformMemoryTypeIndex};
-
-  VkDeviceMemory uniformDeviceMemoryHandle = VK_NULL_HANDLE;
-  result = vkAllocateMemory(deviceHandle, &uniformMemoryAllocateInfo, NULL,
-                            &uniformDeviceMemoryHandle);
+  DeviceMemoryAllocation uniformAllocation;
+  result = allocateDeviceMemory(deviceMemoryArena, uniformMemoryRequirements,
+                                DEVICE_MEMORY_USAGE_UPLOAD,
+                                &uniformAllocation);
   if (result != VK_SUCCESS) {
     throwExceptionVulkanAPI(result, "vkAllocateMemory");
   }
 
   result = vkBindBufferMemory(deviceHandle, uniformBufferHandle,
-                              uniformDeviceMemoryHandle, 0);
+                              uniformAllocation.deviceMemoryHandle,
+                              uniformAllocation.offset);
   if (result != VK_SUCCESS) {
     throwExceptionVulkanAPI(result, "vkBindBufferMemory");
   }
 
-  void *hostUniformMemoryBuffer;
-  result = vkMapMemory(deviceHandle, uniformDeviceMemoryHandle, 0,
-                       sizeof(UniformStructure), 0, &hostUniformMemoryBuffer);
+  for (uint32_t x = 0; x < renderPassImageHandleList.size(); x++) {
+    memcpy((char *)uniformAllocation.hostMemoryPtr + x * uniformSlotSize,
+           &uniformStructure, sizeof(UniformStructure));
+  }
 
-  memcpy(hostUniformMemoryBuffer, &uniformStructure, sizeof(UniformStructure));
+  // =========================================================================
+  // Result Buffers
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkMapMemory");
+  // one tightly packed readback buffer per render pass image, persistently
+  // mapped so the host can drain a retired frame while later ones render
+  VkDeviceSize resultBufferSize =
+      (VkDeviceSize)maxRenderExtent.width * maxRenderExtent.height * 4;
+
+  // the yuv planes are smaller apart from the padding of tiny frames
+  if (isY4MStreamEnabled) {
+    resultBufferSize = std::max(resultBufferSize, y4mStream.layout.size);
   }
 
-  vkUnmapMemory(deviceHandle, uniformDeviceMemoryHandle);
+  std::vector<VkBuffer> resultBufferHandleList(
+      renderPassImageHandleList.size(), VK_NULL_HANDLE);
+  std::vector<DeviceMemoryAllocation> resultAllocationList(
+      renderPassImageHandleList.size());
+  std::vector<void *> hostResultMemoryBufferList(
+      renderPassImageHandleList.size(), NULL);
+
+  for (uint32_t x = 0; x < resultBufferHandleList.size(); x++) {
+    VkBufferCreateInfo resultBufferCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .size = resultBufferSize,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                 VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 1,
+        .pQueueFamilyIndices = &queueFamilyIndex};
+
+    result = vkCreateBuffer(deviceHandle, &resultBufferCreateInfo, NULL,
+                            &resultBufferHandleList[x]);
 
-  // =========================================================================
-  // Result Buffer
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateBuffer");
+    }
 
-  VkMemoryRequirements renderPassImageMemoryRequirements;
-  vkGetImageMemoryRequirements(deviceHandle, renderPassImageHandleList[0],
-                               &renderPassImageMemoryRequirements);
+    VkMemoryRequirements resultMemoryRequirements;
+    vkGetBufferMemoryRequirements(deviceHandle, resultBufferHandleList[x],
+                                  &resultMemoryRequirements);
 
-  VkBufferCreateInfo resultBufferCreateInfo = {
-      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-      .pNext = NULL,
-      .flags = 0,
-      .size = renderPassImageMemoryRequirements.size,
-      .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-               VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-      .queueFamilyIndexCount = 1,
-      .pQueueFamilyIndices = &queueFamilyIndex};
+    // the host reads every pixel of it, cached memory is preferred even when
+    // it has to be invalidated before each read
+    result = allocateDeviceMemory(deviceMemoryArena, resultMemoryRequirements,
+                                  DEVICE_MEMORY_USAGE_READBACK,
+                                  &resultAllocationList[x]);
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkAllocateMemory");
+    }
 
-  VkBuffer resultBufferHandle = VK_NULL_HANDLE;
-  result = vkCreateBuffer(deviceHandle, &resultBufferCreateInfo, NULL,
-                          &resultBufferHandle);
+    result = vkBindBufferMemory(deviceHandle, resultBufferHandleList[x],
+                                resultAllocationList[x].deviceMemoryHandle,
+                                resultAllocationList[x].offset);
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkBindBufferMemory");
+    }
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkCreateBuffer");
+    hostResultMemoryBufferList[x] = resultAllocationList[x].hostMemoryPtr;
   }
 
-  VkMemoryRequirements resultMemoryRequirements;
-  vkGetBufferMemoryRequirements(deviceHandle, resultBufferHandle,
-                                &resultMemoryRequirements);
+  uint32_t resultMemoryTypeIndex = resultAllocationList[0].memoryTypeIndex;
+  VkMemoryPropertyFlags resultMemoryPropertyFlags =
+      physicalDeviceMemoryProperties.memoryTypes[resultMemoryTypeIndex]
+          .propertyFlags;
 
-  uint32_t resultMemoryTypeIndex = -1;
-  for (uint32_t x = 0; x < physicalDeviceMemoryProperties.memoryTypeCount;
-       x++) {
-    if ((resultMemoryRequirements.memoryTypeBits & (1 << x)) &&
-        (physicalDeviceMemoryProperties.memoryTypes[x].propertyFlags &
-         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ==
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+  logStream << "result buffer memory type " << resultMemoryTypeIndex << ": "
+            << getMemoryPropertyFlagsName(resultMemoryPropertyFlags)
+            << ", copy out with "
+            << getStreamingCopyPathName(getStreamingCopyPath()) << std::endl;
 
-      resultMemoryTypeIndex = x;
-      break;
+  printDeviceMemoryArenaStatistics(logStream, deviceMemoryArena);
+
+  // =========================================================================
+  // Frame Ring
+
+  // frame N is published in slot N % slotCount. With direct readback every
+  // slot's pages are imported at once and each slot gets a buffer over its
+  // part of the import, which the frame's copy writes
+  FrameRing frameRing;
+  std::vector<VkBuffer> frameRingBufferHandleList;
+  VkDeviceMemory frameRingDeviceMemoryHandle = VK_NULL_HANDLE;
+
+  // the slot each frame in flight is read back into
+  std::vector<uint32_t> frameRingSlotIndexList(frameInFlightCount, 0);
+
+  if (isFrameRingEnabled) {
+    if (!createFrameRing(frameRing, frameRingName, frameRingSlotCount,
+                         renderFormat, maxRenderExtent, resultBufferSize,
+                         frameRingAlignment)) {
+      throw std::runtime_error("Could not create frame ring: " +
+                               frameRingName);
     }
-  }
 
-  VkMemoryAllocateInfo resultMemoryAllocateInfo = {
-      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-      .pNext = NULL,
-      .allocationSize = resultMemoryRequirements.size,
-      .memoryTypeIndex = resultMemoryTypeIndex};
+    // mmap only promises page alignment
+    isFrameRingDirect =
+        isFrameRingDirect &&
+        (uintptr_t)frameRing.slotDataPtr % frameRingAlignment == 0;
 
-  VkDeviceMemory resultDeviceMemoryHandle = VK_NULL_HANDLE;
-  result = vkAllocateMemory(deviceHandle, &resultMemoryAllocateInfo, NULL,
-                            &resultDeviceMemoryHandle);
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkAllocateMemory");
-  }
+    VkMemoryHostPointerPropertiesEXT memoryHostPointerProperties = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT,
+        .pNext = NULL,
+        .memoryTypeBits = 0};
 
-  result = vkBindBufferMemory(deviceHandle, resultBufferHandle,
-                              resultDeviceMemoryHandle, 0);
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkBindBufferMemory");
+    if (isFrameRingDirect) {
+      result = pvkGetMemoryHostPointerPropertiesEXT(
+          deviceHandle, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+          frameRing.slotDataPtr, &memoryHostPointerProperties);
+
+      isFrameRingDirect = result == VK_SUCCESS;
+    }
+
+    VkExternalMemoryBufferCreateInfo externalMemoryBufferCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO,
+        .pNext = NULL,
+        .handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT};
+
+    VkBufferCreateInfo frameRingBufferCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = &externalMemoryBufferCreateInfo,
+        .flags = 0,
+        .size = frameRing.slotStride,
+        .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 1,
+        .pQueueFamilyIndices = &queueFamilyIndex};
+
+    for (uint32_t x = 0; isFrameRingDirect && x < frameRing.slotCount; x++) {
+      VkBuffer frameRingBufferHandle = VK_NULL_HANDLE;
+      result = vkCreateBuffer(deviceHandle, &frameRingBufferCreateInfo, NULL,
+                              &frameRingBufferHandle);
+
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkCreateBuffer");
+      }
+
+      frameRingBufferHandleList.push_back(frameRingBufferHandle);
+    }
+
+    // the host reads the pages without mapping the import, which only
+    // coherent memory allows
+    uint32_t frameRingMemoryTypeIndex = -1;
+
+    if (isFrameRingDirect) {
+      VkMemoryRequirements frameRingMemoryRequirements;
+      vkGetBufferMemoryRequirements(deviceHandle, frameRingBufferHandleList[0],
+                                    &frameRingMemoryRequirements);
+
+      frameRingMemoryTypeIndex = findMemoryTypeIndex(
+          physicalDeviceMemoryProperties,
+          frameRingMemoryRequirements.memoryTypeBits &
+              memoryHostPointerProperties.memoryTypeBits,
+          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+      isFrameRingDirect =
+          frameRingMemoryTypeIndex != (uint32_t)-1 &&
+          frameRing.slotStride % frameRingMemoryRequirements.alignment == 0;
+    }
+
+    // some drivers refuse pages that belong to a shared memory object
+    if (isFrameRingDirect) {
+      VkImportMemoryHostPointerInfoEXT importMemoryHostPointerInfo = {
+          .sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT,
+          .pNext = NULL,
+          .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+          .pHostPointer = frameRing.slotDataPtr};
+
+      VkMemoryAllocateInfo frameRingMemoryAllocateInfo = {
+          .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+          .pNext = &importMemoryHostPointerInfo,
+          .allocationSize = frameRing.slotStride * frameRing.slotCount,
+          .memoryTypeIndex = frameRingMemoryTypeIndex};
+
+      result = vkAllocateMemory(deviceHandle, &frameRingMemoryAllocateInfo,
+                                NULL, &frameRingDeviceMemoryHandle);
+
+      isFrameRingDirect = result == VK_SUCCESS;
+    }
+
+    for (uint32_t x = 0; isFrameRingDirect && x < frameRing.slotCount; x++) {
+      result = vkBindBufferMemory(deviceHandle, frameRingBufferHandleList[x],
+                                  frameRingDeviceMemoryHandle,
+                                  frameRing.slotStride * x);
+
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkBindBufferMemory");
+      }
+    }
+
+    if (!isFrameRingDirect) {
+      for (VkBuffer frameRingBufferHandle : frameRingBufferHandleList) {
+        vkDestroyBuffer(deviceHandle, frameRingBufferHandle, NULL);
+      }
+
+      frameRingBufferHandleList.clear();
+    }
+
+    logStream << "frame ring: " << frameRingName << ", "
+              << frameRing.slotCount << " slots of " << frameRing.slotStride
+              << " bytes, "
+              << (isFrameRingDirect ? "direct readback"
+                                    : "copied from the result buffers")
+              << std::endl;
   }
 
+  // the buffer a frame is read back into
+  auto getResultBufferHandle = [&](uint32_t frameIndex) {
+    return isFrameRingDirect
+               ? frameRingBufferHandleList[frameRingSlotIndexList[frameIndex]]
+               : resultBufferHandleList[frameIndex];
+  };
+
   // =========================================================================
   // Update Descriptor Set
 
   VkDescriptorBufferInfo uniformDescriptorInfo = {
-      .buffer = uniformBufferHandle, .offset = 0, .range = VK_WHOLE_SIZE};
+      .buffer = uniformBufferHandle,
+      .offset = 0,
+      .range = sizeof(UniformStructure)};
 
   std::vector<VkWriteDescriptorSet> writeDescriptorSetList = {
       {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
@@ -1077,7 +3261,7 @@ int main() {
        .dstBinding = 0,
        .dstArrayElement = 0,
        .descriptorCount = 1,
-       .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+       .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
        .pImageInfo = NULL,
        .pBufferInfo = &uniformDescriptorInfo,
        .pTexelBufferView = NULL}};
@@ -1086,207 +3270,2185 @@ int main() {
                          writeDescriptorSetList.data(), 0, NULL);
 
   // =========================================================================
-  // Record Render Pass Command Buffers
+  // Timestamp Query Pool
 
-  for (uint32_t x = 0; x < renderPassImageHandleList.size(); x++) {
-    VkCommandBufferBeginInfo renderCommandBufferBeginInfo = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .pNext = NULL,
-        .flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
-        .pInheritanceInfo = NULL};
+  // per frame: render pass begin, render pass end / copy begin, copy end
+  uint32_t timestampQueryCount = 3;
 
-    result = vkBeginCommandBuffer(commandBufferHandleList[x],
-                                  &renderCommandBufferBeginInfo);
+  uint32_t timestampValidBits =
+      queueFamilyPropertiesList[queueFamilyIndex].timestampValidBits;
 
-    if (result != VK_SUCCESS) {
-      throwExceptionVulkanAPI(result, "vkBeginCommandBuffer");
-    }
+  uint64_t timestampMask = timestampValidBits >= 64
+                               ? UINT64_MAX
+                               : ((uint64_t)1 << timestampValidBits) - 1;
 
-    std::vector<VkClearValue> clearValueList = {
-        {.color = {0.0f, 0.0f, 0.0f, 1.0f}}, {.depthStencil = {1.0f, 0}}};
+  VkQueryPool timestampQueryPoolHandle = VK_NULL_HANDLE;
 
-    VkRenderPassBeginInfo renderPassBeginInfo = {
-        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+  if (timestampValidBits > 0) {
+    VkQueryPoolCreateInfo timestampQueryPoolCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
         .pNext = NULL,
-        .renderPass = renderPassHandle,
-        .framebuffer = framebufferHandleList[x],
-        .renderArea = screenRect2D,
-        .clearValueCount = (uint32_t)clearValueList.size(),
-        .pClearValues = clearValueList.data()};
-
-    vkCmdBeginRenderPass(commandBufferHandleList[x], &renderPassBeginInfo,
-                         VK_SUBPASS_CONTENTS_INLINE);
-
-    vkCmdBindPipeline(commandBufferHandleList[x],
-                      VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelineHandle);
-
-    VkDeviceSize offset = 0;
-    vkCmdBindVertexBuffers(commandBufferHandleList[x], 0, 1,
-                           &vertexBufferHandle, &offset);
-
-    vkCmdBindIndexBuffer(commandBufferHandleList[x], indexBufferHandle, 0,
-                         VK_INDEX_TYPE_UINT32);
-
-    vkCmdBindDescriptorSets(
-        commandBufferHandleList[x], VK_PIPELINE_BIND_POINT_GRAPHICS,
-        pipelineLayoutHandle, 0, (uint32_t)descriptorSetHandleList.size(),
-        descriptorSetHandleList.data(), 0, NULL);
-
-    vkCmdDrawIndexed(commandBufferHandleList[x],
-                     sizeof(indexBuffer) / sizeof(uint32_t), 1, 0, 0, 0);
-
-    vkCmdEndRenderPass(commandBufferHandleList[x]);
+        .flags = 0,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = timestampQueryCount *
+                      (uint32_t)renderPassImageHandleList.size(),
+        .pipelineStatistics = 0};
 
-    result = vkEndCommandBuffer(commandBufferHandleList[x]);
+    result = vkCreateQueryPool(deviceHandle, &timestampQueryPoolCreateInfo,
+                               NULL, &timestampQueryPoolHandle);
 
     if (result != VK_SUCCESS) {
-      throwExceptionVulkanAPI(result, "vkEndCommandBuffer");
+      throwExceptionVulkanAPI(result, "vkCreateQueryPool");
     }
   }
 
   // =========================================================================
-  // Fences, Semaphores
+  // Worker Command Pools, Secondary Command Buffers
 
-  std::vector<VkFence> imageAvailableFenceHandleList(
-      renderPassImageHandleList.size(), VK_NULL_HANDLE);
+  // every worker owns one pool per frame in flight, so a pool is only reset
+  // after the frame that last used it has retired and no two threads ever
+  // touch the same pool
+  std::vector<VkCommandPool> workerCommandPoolHandleList(
+      frameInFlightCount * threadCount, VK_NULL_HANDLE);
 
-  std::vector<VkSemaphore> writeImageSemaphoreHandleList(
-      renderPassImageHandleList.size(), VK_NULL_HANDLE);
+  std::vector<VkCommandBuffer> secondaryCommandBufferHandleList(
+      frameInFlightCount * threadCount, VK_NULL_HANDLE);
 
-  for (uint32_t x = 0; x < renderPassImageHandleList.size(); x++) {
-    VkFenceCreateInfo imageAvailableFenceCreateInfo = {
-        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+  // with a depth prepass every worker records its draws twice, the prepass
+  // secondaries all run before the first color secondary
+  std::vector<VkCommandBuffer> depthPrepassCommandBufferHandleList(
+      frameInFlightCount * threadCount, VK_NULL_HANDLE);
+
+  for (uint32_t x = 0; x < workerCommandPoolHandleList.size(); x++) {
+    VkCommandPoolCreateInfo workerCommandPoolCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
         .pNext = NULL,
-        .flags = VK_FENCE_CREATE_SIGNALED_BIT};
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = queueFamilyIndex};
 
-    result = vkCreateFence(deviceHandle, &imageAvailableFenceCreateInfo, NULL,
-                           &imageAvailableFenceHandleList[x]);
+    result = vkCreateCommandPool(deviceHandle, &workerCommandPoolCreateInfo,
+                                 NULL, &workerCommandPoolHandleList[x]);
 
     if (result != VK_SUCCESS) {
-      throwExceptionVulkanAPI(result, "vkCreateFence");
+      throwExceptionVulkanAPI(result, "vkCreateCommandPool");
     }
 
-    VkSemaphoreCreateInfo writeImageSemaphoreCreateInfo = {
-        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+    VkCommandBufferAllocateInfo secondaryCommandBufferAllocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
         .pNext = NULL,
-        .flags = 0};
+        .commandPool = workerCommandPoolHandleList[x],
+        .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+        .commandBufferCount = 1};
 
-    result = vkCreateSemaphore(deviceHandle, &writeImageSemaphoreCreateInfo,
-                               NULL, &writeImageSemaphoreHandleList[x]);
+    result = vkAllocateCommandBuffers(deviceHandle,
+                                      &secondaryCommandBufferAllocateInfo,
+                                      &secondaryCommandBufferHandleList[x]);
 
     if (result != VK_SUCCESS) {
-      throwExceptionVulkanAPI(result, "vkCreateSemaphore");
+      throwExceptionVulkanAPI(result, "vkAllocateCommandBuffers");
     }
-  }
 
-  VkSubmitInfo signalFirstSemaphoreSubmitInfo = {
-      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-      .pNext = NULL,
-      .waitSemaphoreCount = 0,
-      .pWaitSemaphores = NULL,
-      .pWaitDstStageMask = NULL,
-      .commandBufferCount = 0,
-      .pCommandBuffers = NULL,
-      .signalSemaphoreCount = 1,
-      .pSignalSemaphores = &writeImageSemaphoreHandleList[0]};
+    if (isDepthPrepassEnabled) {
+      result = vkAllocateCommandBuffers(
+          deviceHandle, &secondaryCommandBufferAllocateInfo,
+          &depthPrepassCommandBufferHandleList[x]);
 
-  VkFenceCreateInfo signalFirstSemaphoreFenceCreateInfo = {
-      .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, .pNext = NULL, .flags = 0};
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkAllocateCommandBuffers");
+      }
+    }
+  }
 
-  VkFence signalFirstSemaphoreFenceHandle = VK_NULL_HANDLE;
-  result = vkCreateFence(deviceHandle, &signalFirstSemaphoreFenceCreateInfo,
-      NULL, &signalFirstSemaphoreFenceHandle);
+  WorkerPool workerPool;
+  createWorkerPool(workerPool, threadCount);
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkCreateFence");
-  }
+  // =========================================================================
+  // Record Render Pass Command Buffers
 
-  result = vkQueueSubmit(queueHandle, 1, &signalFirstSemaphoreSubmitInfo,
-                         signalFirstSemaphoreFenceHandle);
+  // extent each frame in flight was recorded with, the readback only covers
+  // that corner of the render target
+  std::vector<VkExtent2D> frameExtentList(frameInFlightCount,
+                                          renderExtentList[0]);
+
+  // dynamic state is not inherited by secondary command buffers, every worker
+  // sets it before its first draw, from the values the pipeline was created
+  // with
+  auto setDynamicState = [&](VkCommandBuffer commandBufferHandle,
+                             VkExtent2D extent,
+                             const VkPipelineDepthStencilStateCreateInfo
+                                 &depthStencilStateCreateInfo) {
+    VkViewport viewport = {.x = 0,
+                           .y = 0,
+                           .width = (float)extent.width,
+                           .height = (float)extent.height,
+                           .minDepth = 0,
+                           .maxDepth = 1};
+
+    VkRect2D scissorRect2D = {.offset = {.x = 0, .y = 0}, .extent = extent};
+
+    vkCmdSetViewport(commandBufferHandle, 0, 1, &viewport);
+    vkCmdSetScissor(commandBufferHandle, 0, 1, &scissorRect2D);
+
+    if (isExtendedDynamicStateEnabled) {
+      pvkCmdSetCullMode(commandBufferHandle,
+                        pipelineRasterizationStateCreateInfo.cullMode);
+      pvkCmdSetFrontFace(commandBufferHandle,
+                         pipelineRasterizationStateCreateInfo.frontFace);
+      pvkCmdSetPrimitiveTopology(
+          commandBufferHandle,
+          pipelineInputAssemblyStateCreateInfo.topology);
+      pvkCmdSetDepthTestEnable(commandBufferHandle,
+                               depthStencilStateCreateInfo.depthTestEnable);
+      pvkCmdSetDepthWriteEnable(commandBufferHandle,
+                                depthStencilStateCreateInfo.depthWriteEnable);
+      pvkCmdSetDepthCompareOp(commandBufferHandle,
+                              depthStencilStateCreateInfo.depthCompareOp);
+    }
+  };
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkQueueSubmit");
-  }
+  // every draw is one quad, firstInstance tells the vertex shader how far
+  // along the stack it is so each quad lands in front of the previous one
+  auto recordDraws =
+      [&](VkCommandBuffer commandBufferHandle, uint32_t frameIndex,
+          VkPipeline pipelineHandle,
+          const VkPipelineDepthStencilStateCreateInfo
+              &depthStencilStateCreateInfo,
+          uint32_t firstDraw, uint32_t lastDraw) {
+        vkCmdBindPipeline(commandBufferHandle, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          pipelineHandle);
+
+        setDynamicState(commandBufferHandle, frameExtentList[frameIndex],
+                        depthStencilStateCreateInfo);
+
+        VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(commandBufferHandle, 0, 1, &vertexBufferHandle,
+                               &offset);
+
+        vkCmdBindIndexBuffer(commandBufferHandle, indexBufferHandle, 0,
+                             VK_INDEX_TYPE_UINT32);
+
+        uint32_t uniformDynamicOffset = frameIndex * uniformSlotSize;
+        vkCmdBindDescriptorSets(
+            commandBufferHandle, VK_PIPELINE_BIND_POINT_GRAPHICS,
+            pipelineLayoutHandle, 0, (uint32_t)descriptorSetHandleList.size(),
+            descriptorSetHandleList.data(), 1, &uniformDynamicOffset);
+
+        for (uint32_t y = firstDraw; y < lastDraw; y++) {
+          vkCmdDrawIndexed(commandBufferHandle,
+                           sizeof(indexBuffer) / sizeof(uint32_t), 1, 0, 0, y);
+        }
+      };
+
+  // records the draws [firstDraw, lastDraw) of a frame into the secondary
+  // command buffers owned by the calling worker
+  auto recordSecondaryCommandBuffer = [&](uint32_t frameIndex,
+                                          uint32_t threadIndex,
+                                          uint32_t firstDraw,
+                                          uint32_t lastDraw) {
+    uint32_t workerIndex = frameIndex * threadCount + threadIndex;
+
+    VkResult workerResult = vkResetCommandPool(
+        deviceHandle, workerCommandPoolHandleList[workerIndex], 0);
+
+    if (workerResult != VK_SUCCESS) {
+      throwExceptionVulkanAPI(workerResult, "vkResetCommandPool");
+    }
 
-  result = vkWaitForFences(deviceHandle, 1, &signalFirstSemaphoreFenceHandle,
-                           true, UINT32_MAX);
+    VkCommandBufferInheritanceRenderingInfo
+        commandBufferInheritanceRenderingInfo = {
+            .sType =
+                VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+            .pNext = NULL,
+            .flags = 0,
+            .viewMask = 0,
+            .colorAttachmentCount = 1,
+            .pColorAttachmentFormats = &renderFormat,
+            .depthAttachmentFormat = depthFormat,
+            .stencilAttachmentFormat = VK_FORMAT_UNDEFINED,
+            .rasterizationSamples = sampleCountFlagBits};
+
+    VkCommandBufferInheritanceInfo commandBufferInheritanceInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .pNext = isDynamicRenderingEnabled
+                     ? &commandBufferInheritanceRenderingInfo
+                     : NULL,
+        .renderPass = renderPassHandle,
+        .subpass = 0,
+        .framebuffer = framebufferHandleList[frameIndex],
+        .occlusionQueryEnable = VK_FALSE,
+        .queryFlags = 0,
+        .pipelineStatistics = 0};
 
-  if (result != VK_SUCCESS && result != VK_TIMEOUT) {
-    throwExceptionVulkanAPI(result, "vkWaitForFences");
-  }
+    VkCommandBufferBeginInfo secondaryCommandBufferBeginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = NULL,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                 VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        .pInheritanceInfo = &commandBufferInheritanceInfo};
 
-  // =========================================================================
-  // Main Loop
+    if (isDepthPrepassEnabled) {
+      VkCommandBuffer depthPrepassCommandBufferHandle =
+          depthPrepassCommandBufferHandleList[workerIndex];
 
-  uint32_t currentFrame = 0, previousFrame = 0;
-  while (true) {
-    result = vkWaitForFences(deviceHandle, 1,
-                             &imageAvailableFenceHandleList[currentFrame], true,
-                             UINT32_MAX);
+      workerResult = vkBeginCommandBuffer(depthPrepassCommandBufferHandle,
+                                          &secondaryCommandBufferBeginInfo);
 
-    if (result != VK_SUCCESS && result != VK_TIMEOUT) {
-      throwExceptionVulkanAPI(result, "vkWaitForFences");
-    }
+      if (workerResult != VK_SUCCESS) {
+        throwExceptionVulkanAPI(workerResult, "vkBeginCommandBuffer");
+      }
 
-    result = vkResetFences(deviceHandle, 1,
-                           &imageAvailableFenceHandleList[currentFrame]);
+      if (firstDraw < lastDraw) {
+        recordDraws(depthPrepassCommandBufferHandle, frameIndex,
+                    depthPrepassPipelineHandle,
+                    depthPrepassDepthStencilStateCreateInfo, firstDraw,
+                    lastDraw);
+      }
 
-    if (result != VK_SUCCESS) {
-      throwExceptionVulkanAPI(result, "vkResetFences");
+      workerResult = vkEndCommandBuffer(depthPrepassCommandBufferHandle);
+
+      if (workerResult != VK_SUCCESS) {
+        throwExceptionVulkanAPI(workerResult, "vkEndCommandBuffer");
+      }
     }
 
-    VkPipelineStageFlags pipelineStageFlags =
-        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    VkCommandBuffer secondaryCommandBufferHandle =
+        secondaryCommandBufferHandleList[workerIndex];
 
-    VkSubmitInfo submitInfo = {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .pNext = NULL,
-        .waitSemaphoreCount = 1,
-        .pWaitSemaphores = &writeImageSemaphoreHandleList[previousFrame],
-        .pWaitDstStageMask = &pipelineStageFlags,
-        .commandBufferCount = 1,
-        .pCommandBuffers = &commandBufferHandleList[currentFrame],
-        .signalSemaphoreCount = 1,
-        .pSignalSemaphores = &writeImageSemaphoreHandleList[currentFrame]};
+    workerResult = vkBeginCommandBuffer(secondaryCommandBufferHandle,
+                                        &secondaryCommandBufferBeginInfo);
 
-    result = vkQueueSubmit(queueHandle, 1, &submitInfo,
-                           imageAvailableFenceHandleList[currentFrame]);
+    if (workerResult != VK_SUCCESS) {
+      throwExceptionVulkanAPI(workerResult, "vkBeginCommandBuffer");
+    }
 
-    if (result != VK_SUCCESS) {
-      throwExceptionVulkanAPI(result, "vkQueueSubmit");
+    if (firstDraw < lastDraw) {
+      recordDraws(secondaryCommandBufferHandle, frameIndex,
+                  graphicsPipelineHandle, pipelineDepthStencilStateCreateInfo,
+                  firstDraw, lastDraw);
     }
 
-    previousFrame = currentFrame;
-    currentFrame = (currentFrame + 1) % renderPassImageHandleList.size();
-  }
+    workerResult = vkEndCommandBuffer(secondaryCommandBufferHandle);
 
-  // =========================================================================
-  // Cleanup
+    if (workerResult != VK_SUCCESS) {
+      throwExceptionVulkanAPI(workerResult, "vkEndCommandBuffer");
+    }
+  };
 
-  result = vkDeviceWaitIdle(deviceHandle);
+  VkImageSubresourceRange colorSubresourceRange = {
+      .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+      .baseMipLevel = 0,
+      .levelCount = 1,
+      .baseArrayLayer = 0,
+      .layerCount = 1};
+
+  // begins the render pass (or dynamic rendering) on the frame's render
+  // target and executes the workers' secondaries, the layout the target is in
+  // is up to the caller with dynamic rendering
+  auto recordScene = [&](uint32_t frameIndex, uint32_t activeThreadCount) {
+    std::vector<VkClearValue> clearValueList = {
+        {.color = {0.0f, 0.0f, 0.0f, 1.0f}},
+        {.depthStencil = {1.0f, 0}},
+        {.color = {0.0f, 0.0f, 0.0f, 1.0f}}};
+
+    VkRect2D renderArea = {.offset = {.x = 0, .y = 0},
+                           .extent = frameExtentList[frameIndex]};
+
+    if (isDynamicRenderingEnabled) {
+      VkRenderingAttachmentInfo colorAttachmentInfo = {
+          .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+          .pNext = NULL,
+          .imageView = renderPassImageViewHandleList[frameIndex],
+          .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+          .resolveMode = VK_RESOLVE_MODE_NONE,
+          .resolveImageView = VK_NULL_HANDLE,
+          .resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+          .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+          .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+          .clearValue = clearValueList[0]};
+
+      // the samples are averaged into the render target as the rendering
+      // ends and never stored
+      if (isMultisampleEnabled) {
+        colorAttachmentInfo.imageView =
+            multisampleImageViewHandleList[frameIndex];
+        colorAttachmentInfo.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+        colorAttachmentInfo.resolveImageView =
+            renderPassImageViewHandleList[frameIndex];
+        colorAttachmentInfo.resolveImageLayout =
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachmentInfo.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        colorAttachmentInfo.clearValue = clearValueList[2];
+      }
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkDeviceWaitIdle");
-  }
+      // the depth buffer never leaves the pass, it is cleared on load and
+      // discarded on store
+      VkRenderingAttachmentInfo depthAttachmentInfo = {
+          .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+          .pNext = NULL,
+          .imageView = depthImageViewHandleList[frameIndex],
+          .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+          .resolveMode = VK_RESOLVE_MODE_NONE,
+          .resolveImageView = VK_NULL_HANDLE,
+          .resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+          .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+          .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+          .clearValue = clearValueList[1]};
+
+      VkRenderingInfo renderingInfo = {
+          .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+          .pNext = NULL,
+          .flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT,
+          .renderArea = renderArea,
+          .layerCount = 1,
+          .viewMask = 0,
+          .colorAttachmentCount = 1,
+          .pColorAttachments = &colorAttachmentInfo,
+          .pDepthAttachment = &depthAttachmentInfo,
+          .pStencilAttachment = NULL};
+
+      vkCmdBeginRendering(commandBufferHandleList[frameIndex], &renderingInfo);
+    } else {
+      VkRenderPassBeginInfo renderPassBeginInfo = {
+          .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+          .pNext = NULL,
+          .renderPass = renderPassHandle,
+          .framebuffer = framebufferHandleList[frameIndex],
+          .renderArea = renderArea,
+          .clearValueCount = (uint32_t)clearValueList.size(),
+          .pClearValues = clearValueList.data()};
+
+      vkCmdBeginRenderPass(commandBufferHandleList[frameIndex],
+                           &renderPassBeginInfo,
+                           VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    }
 
-  vkDestroyFence(deviceHandle, signalFirstSemaphoreFenceHandle, NULL);
+    if (isDepthPrepassEnabled) {
+      vkCmdExecuteCommands(
+          commandBufferHandleList[frameIndex], activeThreadCount,
+          &depthPrepassCommandBufferHandleList[frameIndex * threadCount]);
+    }
 
-  for (uint32_t x = 0; x < renderPassImageHandleList.size(); x++) {
-    vkDestroySemaphore(deviceHandle, writeImageSemaphoreHandleList[x], NULL);
-    vkDestroyFence(deviceHandle, imageAvailableFenceHandleList[x], NULL);
-  }
+    vkCmdExecuteCommands(
+        commandBufferHandleList[frameIndex], activeThreadCount,
+        &secondaryCommandBufferHandleList[frameIndex * threadCount]);
 
-  vkDestroyBuffer(deviceHandle, resultBufferHandle, NULL);
-  vkFreeMemory(deviceHandle, resultDeviceMemoryHandle, NULL);
+    if (isDynamicRenderingEnabled) {
+      vkCmdEndRendering(commandBufferHandleList[frameIndex]);
+    } else {
+      vkCmdEndRenderPass(commandBufferHandleList[frameIndex]);
+    }
 
-  vkFreeMemory(deviceHandle, uniformDeviceMemoryHandle, NULL);
-  vkDestroyBuffer(deviceHandle, uniformBufferHandle, NULL);
+    if (timestampQueryPoolHandle != VK_NULL_HANDLE) {
+      vkCmdWriteTimestamp(commandBufferHandleList[frameIndex],
+                          VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                          timestampQueryPoolHandle,
+                          frameIndex * timestampQueryCount + 1);
+    }
+  };
 
-  vkFreeMemory(deviceHandle, indexDeviceMemoryHandle, NULL);
-  vkDestroyBuffer(deviceHandle, indexBufferHandle, NULL);
-  vkFreeMemory(deviceHandle, vertexDeviceMemoryHandle, NULL);
+  // copies the frame's extent out of an image in TRANSFER_SRC_OPTIMAL into
+  // the frame's result buffer. For the y4m stream the conversion shader reads
+  // the image in SHADER_READ_ONLY_OPTIMAL through the frame's descriptor set
+  // instead, and writes the yuv planes
+  auto recordReadback = [&](uint32_t frameIndex, VkImage imageHandle) {
+    if (isY4MStreamEnabled) {
+      const Y4MPlaneLayout &layout = y4mStream.layout;
+
+      YUVPushConstants yuvPushConstants = {
+          .extent = {frameExtentList[frameIndex].width,
+                     frameExtentList[frameIndex].height},
+          .lumaRowPitch = layout.lumaRowPitch / 4,
+          .chromaRowPitch = layout.chromaRowPitch / 4,
+          .uPlaneOffset = (uint32_t)(layout.uPlaneOffset / 4),
+          .vPlaneOffset = (uint32_t)(layout.vPlaneOffset / 4)};
+
+      vkCmdBindPipeline(commandBufferHandleList[frameIndex],
+                        VK_PIPELINE_BIND_POINT_COMPUTE, yuvPipelineHandle);
+      vkCmdBindDescriptorSets(
+          commandBufferHandleList[frameIndex], VK_PIPELINE_BIND_POINT_COMPUTE,
+          yuvPipelineLayoutHandle, 0, 1,
+          &yuvDescriptorSetHandleList[frameIndex], 0, NULL);
+      vkCmdPushConstants(commandBufferHandleList[frameIndex],
+                         yuvPipelineLayoutHandle, VK_SHADER_STAGE_COMPUTE_BIT,
+                         0, sizeof(YUVPushConstants), &yuvPushConstants);
+
+      // 8x8 invocations per group, 8x2 pixels per invocation
+      uint32_t blockColumnCount = (yuvPushConstants.extent[0] + 7) / 8;
+      uint32_t blockRowCount = (yuvPushConstants.extent[1] + 1) / 2;
+
+      vkCmdDispatch(commandBufferHandleList[frameIndex],
+                    (blockColumnCount + 7) / 8, (blockRowCount + 7) / 8, 1);
+      return;
+    }
+
+    VkBufferImageCopy bufferImageCopy = {
+        .bufferOffset = 0,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                             .mipLevel = 0,
+                             .baseArrayLayer = 0,
+                             .layerCount = 1},
+        .imageOffset = {.x = 0, .y = 0, .z = 0},
+        .imageExtent = {.width = frameExtentList[frameIndex].width,
+                        .height = frameExtentList[frameIndex].height,
+                        .depth = 1}};
+
+    vkCmdCopyImageToBuffer(commandBufferHandleList[frameIndex], imageHandle,
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           getResultBufferHandle(frameIndex), 1,
+                           &bufferImageCopy);
+  };
+
+  // =========================================================================
+  // Render Graph
+
+  // one graph per frame in flight, each with its own transient memory since
+  // the frames overlap on the device. The post process is a single copy of
+  // the scene, or when resampling a blit chain down to a quarter of the
+  // frame and back up, whose two intermediate images of each size never
+  // live at the same time and are aliased
+  std::vector<RenderGraph> renderGraphList(isRenderGraphEnabled
+                                               ? frameInFlightCount
+                                               : 0);
+
+  auto getScaledExtent = [](VkExtent2D extent, uint32_t divisor) {
+    return VkExtent2D{.width = std::max(extent.width / divisor, 1u),
+                      .height = std::max(extent.height / divisor, 1u)};
+  };
+
+  auto recordBlit = [](VkCommandBuffer commandBufferHandle,
+                       VkImage sourceImageHandle, VkExtent2D sourceExtent,
+                       VkImage destinationImageHandle,
+                       VkExtent2D destinationExtent) {
+    VkImageSubresourceLayers subresourceLayers = {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .mipLevel = 0,
+        .baseArrayLayer = 0,
+        .layerCount = 1};
+
+    VkImageBlit imageBlit = {
+        .srcSubresource = subresourceLayers,
+        .srcOffsets = {{0, 0, 0},
+                       {(int32_t)sourceExtent.width,
+                        (int32_t)sourceExtent.height, 1}},
+        .dstSubresource = subresourceLayers,
+        .dstOffsets = {{0, 0, 0},
+                       {(int32_t)destinationExtent.width,
+                        (int32_t)destinationExtent.height, 1}}};
+
+    vkCmdBlitImage(commandBufferHandle, sourceImageHandle,
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   destinationImageHandle,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit,
+                   VK_FILTER_LINEAR);
+  };
+
+  // scene and graph recording share the primary's active worker count
+  uint32_t sceneThreadCount = threadCount;
+
+  VkDeviceSize renderGraphAliasedMemorySize = 0;
+  VkDeviceSize renderGraphUnaliasedMemorySize = 0;
+
+  // the image each frame is read back from, the last post image with a graph
+  std::vector<VkImageView> readbackImageViewHandleList =
+      renderPassImageViewHandleList;
+
+  for (uint32_t x = 0; x < renderGraphList.size(); x++) {
+    RenderGraph &renderGraph = renderGraphList[x];
+
+    uint32_t sceneIndex = importRenderGraphImage(
+        renderGraph, "scene", renderPassImageHandleList[x],
+        renderPassImageViewHandleList[x], colorSubresourceRange);
+    uint32_t depthIndex = importRenderGraphImage(
+        renderGraph, "depth", depthImageHandleList[x],
+        depthImageViewHandleList[x], depthSubresourceRange);
+    uint32_t resultIndex = importRenderGraphBuffer(renderGraph, "result",
+                                                   resultBufferHandleList[x]);
+
+    // the intermediate images, by their size relative to the frame
+    std::vector<uint32_t> divisorList = isRenderGraphResampleEnabled
+                                            ? std::vector<uint32_t>{2, 4, 2, 1}
+                                            : std::vector<uint32_t>{1};
+    std::vector<uint32_t> postIndexList;
+
+    for (uint32_t divisor : divisorList) {
+      VkExtent2D extent = getScaledExtent(maxRenderExtent, divisor);
+
+      VkImageCreateInfo postImageCreateInfo = {
+          .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+          .pNext = NULL,
+          .flags = 0,
+          .imageType = VK_IMAGE_TYPE_2D,
+          .format = renderFormat,
+          .extent = {.width = extent.width,
+                     .height = extent.height,
+                     .depth = 1},
+          .mipLevels = 1,
+          .arrayLayers = 1,
+          .samples = VK_SAMPLE_COUNT_1_BIT,
+          .tiling = VK_IMAGE_TILING_OPTIMAL,
+          .usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                   VK_IMAGE_USAGE_TRANSFER_DST_BIT | readbackImageUsageFlags,
+          .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+          .queueFamilyIndexCount = 1,
+          .pQueueFamilyIndices = &queueFamilyIndex,
+          .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED};
+
+      postIndexList.push_back(addRenderGraphImage(
+          renderGraph, "post_" + std::to_string(postIndexList.size()),
+          postImageCreateInfo, VK_IMAGE_ASPECT_COLOR_BIT));
+    }
+
+    // the resolve writes the scene image in the color attachment stage too
+    std::vector<RenderGraphAccess> sceneAccessList = {
+        {.resourceIndex = sceneIndex,
+         .stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+         .accessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+         .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+        {.resourceIndex = depthIndex,
+         .stageMask = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+                      VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+         .accessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                       VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+         .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL}};
+
+    if (isMultisampleEnabled) {
+      sceneAccessList.push_back(
+          {.resourceIndex = importRenderGraphImage(
+               renderGraph, "scene_multisample", multisampleImageHandleList[x],
+               multisampleImageViewHandleList[x], colorSubresourceRange),
+           .stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+           .accessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+           .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+    }
+
+    addRenderGraphPass(
+        renderGraph, "scene", sceneAccessList,
+        [&, x](VkCommandBuffer) { recordScene(x, sceneThreadCount); });
+
+    for (uint32_t y = 0; y < postIndexList.size(); y++) {
+      uint32_t sourceIndex = y == 0 ? sceneIndex : postIndexList[y - 1];
+      uint32_t sourceDivisor = y == 0 ? 1 : divisorList[y - 1];
+      uint32_t destinationIndex = postIndexList[y];
+      uint32_t destinationDivisor = divisorList[y];
+
+      addRenderGraphPass(
+          renderGraph, "blit_" + std::to_string(y),
+          {{.resourceIndex = sourceIndex,
+            .stageMask = VK_PIPELINE_STAGE_2_BLIT_BIT,
+            .accessMask = VK_ACCESS_2_TRANSFER_READ_BIT,
+            .layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL},
+           {.resourceIndex = destinationIndex,
+            .stageMask = VK_PIPELINE_STAGE_2_BLIT_BIT,
+            .accessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            .layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL}},
+          [&, x, sourceIndex, sourceDivisor, destinationIndex,
+           destinationDivisor](VkCommandBuffer commandBufferHandle) {
+            recordBlit(
+                commandBufferHandle,
+                renderGraphList[x].resourceList[sourceIndex].imageHandle,
+                getScaledExtent(frameExtentList[x], sourceDivisor),
+                renderGraphList[x].resourceList[destinationIndex].imageHandle,
+                getScaledExtent(frameExtentList[x], destinationDivisor));
+          });
+    }
+
+    uint32_t postIndex = postIndexList.back();
+
+    addRenderGraphPass(
+        renderGraph, "readback",
+        {{.resourceIndex = postIndex,
+          .stageMask = readbackStageMask,
+          .accessMask = readbackImageAccessMask,
+          .layout = readbackImageLayout},
+         {.resourceIndex = resultIndex,
+          .stageMask = readbackStageMask,
+          .accessMask = readbackBufferAccessMask,
+          .layout = VK_IMAGE_LAYOUT_UNDEFINED}},
+        [&, x, postIndex](VkCommandBuffer) {
+          recordReadback(
+              x, renderGraphList[x].resourceList[postIndex].imageHandle);
+        });
+
+    result = compileRenderGraph(renderGraph, deviceHandle, deviceMemoryArena);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "compileRenderGraph");
+    }
+
+    readbackImageViewHandleList[x] =
+        renderGraph.resourceList[postIndex].imageViewHandle;
+
+    renderGraphAliasedMemorySize += renderGraph.aliasedMemorySize;
+    renderGraphUnaliasedMemorySize += renderGraph.unaliasedMemorySize;
+  }
+
+  if (isRenderGraphEnabled) {
+    printRenderGraphStatistics(logStream, renderGraphList[0]);
+    logStream << "render graph transient memory, all frames in flight: "
+              << renderGraphAliasedMemorySize << " bytes aliased, "
+              << renderGraphUnaliasedMemorySize << " bytes without aliasing"
+              << std::endl;
+  }
+
+  // =========================================================================
+  // Update YUV Conversion Descriptor Sets
+
+  for (uint32_t x = 0; x < yuvDescriptorSetHandleList.size(); x++) {
+    VkDescriptorImageInfo readbackDescriptorImageInfo = {
+        .sampler = VK_NULL_HANDLE,
+        .imageView = readbackImageViewHandleList[x],
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+
+    VkDescriptorBufferInfo resultDescriptorBufferInfo = {
+        .buffer = resultBufferHandleList[x],
+        .offset = 0,
+        .range = VK_WHOLE_SIZE};
+
+    std::vector<VkWriteDescriptorSet> yuvWriteDescriptorSetList = {
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .pNext = NULL,
+         .dstSet = yuvDescriptorSetHandleList[x],
+         .dstBinding = 0,
+         .dstArrayElement = 0,
+         .descriptorCount = 1,
+         .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+         .pImageInfo = &readbackDescriptorImageInfo,
+         .pBufferInfo = NULL,
+         .pTexelBufferView = NULL},
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .pNext = NULL,
+         .dstSet = yuvDescriptorSetHandleList[x],
+         .dstBinding = 1,
+         .dstArrayElement = 0,
+         .descriptorCount = 1,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .pImageInfo = NULL,
+         .pBufferInfo = &resultDescriptorBufferInfo,
+         .pTexelBufferView = NULL}};
+
+    vkUpdateDescriptorSets(deviceHandle, yuvWriteDescriptorSetList.size(),
+                           yuvWriteDescriptorSetList.data(), 0, NULL);
+  }
+
+  // =========================================================================
+  // Record Frame Command Buffers
+
+  // the draw list is split evenly across the first activeThreadCount workers,
+  // the primary only begins the render pass and executes their secondaries
+  auto recordFrame = [&](uint32_t frameIndex, uint32_t activeThreadCount) {
+    runWorkerPool(workerPool, [&](uint32_t threadIndex) {
+      if (threadIndex >= activeThreadCount) {
+        return;
+      }
+
+      recordSecondaryCommandBuffer(
+          frameIndex, threadIndex,
+          (uint64_t)drawCount * threadIndex / activeThreadCount,
+          (uint64_t)drawCount * (threadIndex + 1) / activeThreadCount);
+    });
+
+    VkCommandBufferBeginInfo renderCommandBufferBeginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = NULL,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = NULL};
+
+    result = vkBeginCommandBuffer(commandBufferHandleList[frameIndex],
+                                  &renderCommandBufferBeginInfo);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkBeginCommandBuffer");
+    }
+
+    if (timestampQueryPoolHandle != VK_NULL_HANDLE) {
+      vkCmdResetQueryPool(commandBufferHandleList[frameIndex],
+                          timestampQueryPoolHandle,
+                          frameIndex * timestampQueryCount,
+                          timestampQueryCount);
+
+      vkCmdWriteTimestamp(commandBufferHandleList[frameIndex],
+                          VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                          timestampQueryPoolHandle,
+                          frameIndex * timestampQueryCount);
+    }
+
+    // the fence wait before recording retired every earlier access to this
+    // frame's resources, the render target's previous contents are cleared
+    if (isRenderGraphEnabled) {
+      sceneThreadCount = activeThreadCount;
+      executeRenderGraph(renderGraphList[frameIndex], pipelineBarrierTracker,
+                         commandBufferHandleList[frameIndex]);
+    } else {
+      resetPipelineBarrierTracker(pipelineBarrierTracker);
+      trackImage(pipelineBarrierTracker, renderPassImageHandleList[frameIndex],
+                 colorSubresourceRange);
+      trackBuffer(pipelineBarrierTracker, getResultBufferHandle(frameIndex));
+
+      if (isDynamicRenderingEnabled) {
+        trackImage(pipelineBarrierTracker, depthImageHandleList[frameIndex],
+                   depthSubresourceRange);
+
+        requireImageAccess(pipelineBarrierTracker,
+                           renderPassImageHandleList[frameIndex],
+                           VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                           VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                           VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        requireImageAccess(pipelineBarrierTracker,
+                           depthImageHandleList[frameIndex],
+                           VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+                               VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                           VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                               VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                           VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+
+        if (isMultisampleEnabled) {
+          trackImage(pipelineBarrierTracker,
+                     multisampleImageHandleList[frameIndex],
+                     colorSubresourceRange);
+          requireImageAccess(pipelineBarrierTracker,
+                             multisampleImageHandleList[frameIndex],
+                             VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                             VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                             VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        }
+        flushPipelineBarriers(pipelineBarrierTracker,
+                              commandBufferHandleList[frameIndex]);
+      }
+
+      recordScene(frameIndex, activeThreadCount);
+
+      // the render pass's outgoing dependency already made the color writes
+      // visible to the readback in the final layout
+      if (!isDynamicRenderingEnabled) {
+        trackImage(pipelineBarrierTracker,
+                   renderPassImageHandleList[frameIndex],
+                   colorSubresourceRange,
+                   {.layout = readbackImageLayout,
+                    .writeStageMask =
+                        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    .writeAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                    .readStageMask = readbackStageMask,
+                    .readAccessMask = readbackImageAccessMask});
+      }
+
+      // with dynamic rendering this is what the render pass's final layout
+      // and outgoing dependency did
+      requireImageAccess(pipelineBarrierTracker,
+                         renderPassImageHandleList[frameIndex],
+                         readbackStageMask, readbackImageAccessMask,
+                         readbackImageLayout);
+
+      // an exported frame is handed to the consumer's queue in
+      // TRANSFER_SRC_OPTIMAL instead of being read back. The transition above
+      // is flushed first, barriers in one call are unordered and the release
+      // has to see the image in its final layout
+      if (isFrameExportEnabled) {
+        flushPipelineBarriers(pipelineBarrierTracker,
+                              commandBufferHandleList[frameIndex]);
+        releaseImageOwnership(pipelineBarrierTracker,
+                              renderPassImageHandleList[frameIndex],
+                              queueFamilyIndex, VK_QUEUE_FAMILY_EXTERNAL);
+        flushPipelineBarriers(pipelineBarrierTracker,
+                              commandBufferHandleList[frameIndex]);
+      } else {
+        requireBufferAccess(pipelineBarrierTracker,
+                            getResultBufferHandle(frameIndex),
+                            readbackStageMask, readbackBufferAccessMask);
+        flushPipelineBarriers(pipelineBarrierTracker,
+                              commandBufferHandleList[frameIndex]);
+
+        recordReadback(frameIndex, renderPassImageHandleList[frameIndex]);
+      }
+    }
+
+    requireBufferAccess(pipelineBarrierTracker,
+                        getResultBufferHandle(frameIndex),
+                        VK_PIPELINE_STAGE_2_HOST_BIT,
+                        VK_ACCESS_2_HOST_READ_BIT);
+    flushPipelineBarriers(pipelineBarrierTracker,
+                          commandBufferHandleList[frameIndex]);
+
+    if (timestampQueryPoolHandle != VK_NULL_HANDLE) {
+      vkCmdWriteTimestamp(commandBufferHandleList[frameIndex],
+                          VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                          timestampQueryPoolHandle,
+                          frameIndex * timestampQueryCount + 2);
+    }
+
+    result = vkEndCommandBuffer(commandBufferHandleList[frameIndex]);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkEndCommandBuffer");
+    }
+  };
+
+  // =========================================================================
+  // Record Scaling Benchmark
+
+  // nothing has been submitted yet, so the first frame's command buffers can
+  // be recorded over and over with a growing number of workers
+  if (isRecordScalingEnabled) {
+    if (isJSON) {
+      std::cout << "{\"device\": \"" << physicalDeviceProperties.deviceName
+                << "\", \"draws\": " << drawCount << ", \"record_scaling\": [";
+    } else {
+      std::cout << "draws: " << drawCount << std::endl;
+    }
+
+    std::vector<uint32_t> activeThreadCountList;
+    for (uint32_t x = 1; x < threadCount; x *= 2) {
+      activeThreadCountList.push_back(x);
+    }
+    activeThreadCountList.push_back(threadCount);
+
+    double singleThreadMean = 0;
+    for (uint32_t activeThreadCount : activeThreadCountList) {
+      std::vector<double> recordTimeList;
+
+      for (uint32_t x = 0; x < 100 && !isExitRequested; x++) {
+        std::chrono::steady_clock::time_point recordStartTimePoint =
+            std::chrono::steady_clock::now();
+
+        recordFrame(0, activeThreadCount);
+
+        recordTimeList.push_back(std::chrono::duration<double, std::milli>(
+                                     std::chrono::steady_clock::now() -
+                                     recordStartTimePoint)
+                                     .count());
+      }
+
+      SampleStatistics recordTimeStatistics =
+          getSampleStatistics(recordTimeList);
+
+      if (activeThreadCount == 1) {
+        singleThreadMean = recordTimeStatistics.mean;
+      }
+
+      double speedup = singleThreadMean / recordTimeStatistics.mean;
+
+      if (isJSON) {
+        std::cout << (activeThreadCount == 1 ? "" : ", ")
+                  << "{\"threads\": " << activeThreadCount
+                  << ", \"speedup\": " << speedup << ", ";
+        printSampleStatistics(std::cout, "record_time_ms",
+                              recordTimeStatistics, true);
+        std::cout << "}";
+      } else {
+        std::cout << "threads " << activeThreadCount << ", speedup "
+                  << speedup << ", ";
+        printSampleStatistics(std::cout, "record time (ms)",
+                              recordTimeStatistics, false);
+      }
+    }
+
+    if (isJSON) {
+      std::cout << "]}" << std::endl;
+    }
+  }
+
+  // =========================================================================
+  // Readback Benchmark
+
+  // a result buffer is placed in every host visible memory type it accepts,
+  // filled by the device and copied out by the host, once with memcpy and
+  // once with the streaming copy. The fill drops whatever the host cached of
+  // the buffer, the same as a rendered frame would
+  if (isReadbackBenchmarkEnabled) {
+    VkBufferCreateInfo readbackBufferCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .size = resultBufferSize,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                 VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 1,
+        .pQueueFamilyIndices = &queueFamilyIndex};
+
+    VkCommandBufferAllocateInfo readbackCommandBufferAllocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .pNext = NULL,
+        .commandPool = commandPoolHandle,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1};
+
+    VkCommandBuffer readbackCommandBufferHandle = VK_NULL_HANDLE;
+    result = vkAllocateCommandBuffers(deviceHandle,
+                                      &readbackCommandBufferAllocateInfo,
+                                      &readbackCommandBufferHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkAllocateCommandBuffers");
+    }
+
+    VkFenceCreateInfo readbackFenceCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0};
+
+    VkFence readbackFenceHandle = VK_NULL_HANDLE;
+    result = vkCreateFence(deviceHandle, &readbackFenceCreateInfo, NULL,
+                           &readbackFenceHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateFence");
+    }
+
+    std::vector<uint8_t> readbackHostBuffer(resultBufferSize);
+
+    if (isJSON) {
+      std::cout << "{\"device\": \"" << physicalDeviceProperties.deviceName
+                << "\", \"bytes\": " << resultBufferSize
+                << ", \"streaming_copy\": \""
+                << getStreamingCopyPathName(getStreamingCopyPath())
+                << "\", \"readback\": [";
+    } else {
+      std::cout << "readback bytes: " << resultBufferSize
+                << ", streaming copy: "
+                << getStreamingCopyPathName(getStreamingCopyPath())
+                << std::endl;
+    }
+
+    bool isFirstMemoryType = true;
+    for (uint32_t memoryTypeIndex = 0;
+         memoryTypeIndex < physicalDeviceMemoryProperties.memoryTypeCount &&
+         !isExitRequested;
+         memoryTypeIndex++) {
+      VkMemoryPropertyFlags propertyFlags =
+          physicalDeviceMemoryProperties.memoryTypes[memoryTypeIndex]
+              .propertyFlags;
+
+      VkBuffer readbackBufferHandle = VK_NULL_HANDLE;
+      result = vkCreateBuffer(deviceHandle, &readbackBufferCreateInfo, NULL,
+                              &readbackBufferHandle);
+
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkCreateBuffer");
+      }
+
+      VkMemoryRequirements readbackMemoryRequirements;
+      vkGetBufferMemoryRequirements(deviceHandle, readbackBufferHandle,
+                                    &readbackMemoryRequirements);
+
+      if (!(readbackMemoryRequirements.memoryTypeBits &
+            (1 << memoryTypeIndex)) ||
+          getMemoryTypeScore(propertyFlags, DEVICE_MEMORY_USAGE_READBACK) <
+              0) {
+        vkDestroyBuffer(deviceHandle, readbackBufferHandle, NULL);
+        continue;
+      }
+
+      DeviceMemoryAllocation readbackAllocation;
+      result = allocateDeviceMemoryFromType(
+          deviceMemoryArena, readbackMemoryRequirements, memoryTypeIndex,
+          &readbackAllocation);
+
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkAllocateMemory");
+      }
+
+      result = vkBindBufferMemory(deviceHandle, readbackBufferHandle,
+                                  readbackAllocation.deviceMemoryHandle,
+                                  readbackAllocation.offset);
+
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkBindBufferMemory");
+      }
+
+      VkCommandBufferBeginInfo readbackCommandBufferBeginInfo = {
+          .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+          .pNext = NULL,
+          .flags = 0,
+          .pInheritanceInfo = NULL};
+
+      result = vkBeginCommandBuffer(readbackCommandBufferHandle,
+                                    &readbackCommandBufferBeginInfo);
+
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkBeginCommandBuffer");
+      }
+
+      resetPipelineBarrierTracker(pipelineBarrierTracker);
+      trackBuffer(pipelineBarrierTracker, readbackBufferHandle);
+
+      requireBufferAccess(pipelineBarrierTracker, readbackBufferHandle,
+                          VK_PIPELINE_STAGE_2_CLEAR_BIT,
+                          VK_ACCESS_2_TRANSFER_WRITE_BIT);
+      flushPipelineBarriers(pipelineBarrierTracker,
+                            readbackCommandBufferHandle);
+
+      vkCmdFillBuffer(readbackCommandBufferHandle, readbackBufferHandle, 0,
+                      VK_WHOLE_SIZE, 0x80402010);
+
+      requireBufferAccess(pipelineBarrierTracker, readbackBufferHandle,
+                          VK_PIPELINE_STAGE_2_HOST_BIT,
+                          VK_ACCESS_2_HOST_READ_BIT);
+      flushPipelineBarriers(pipelineBarrierTracker,
+                            readbackCommandBufferHandle);
+
+      result = vkEndCommandBuffer(readbackCommandBufferHandle);
+
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkEndCommandBuffer");
+      }
+
+      VkSubmitInfo readbackSubmitInfo = {
+          .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+          .pNext = NULL,
+          .waitSemaphoreCount = 0,
+          .pWaitSemaphores = NULL,
+          .pWaitDstStageMask = NULL,
+          .commandBufferCount = 1,
+          .pCommandBuffers = &readbackCommandBufferHandle,
+          .signalSemaphoreCount = 0,
+          .pSignalSemaphores = NULL};
+
+      // gigabytes per second of each copy, fill and invalidate included in
+      // neither
+      auto getReadbackBandwidth = [&](bool isStreaming) {
+        std::vector<double> bandwidthList;
+
+        for (uint32_t x = 0; x < 20 && !isExitRequested; x++) {
+          result = vkQueueSubmit(queueHandle, 1, &readbackSubmitInfo,
+                                 readbackFenceHandle);
+
+          if (result != VK_SUCCESS) {
+            throwExceptionVulkanAPI(result, "vkQueueSubmit");
+          }
+
+          result = vkWaitForFences(deviceHandle, 1, &readbackFenceHandle,
+                                   true, UINT64_MAX);
+
+          if (result != VK_SUCCESS) {
+            throwExceptionVulkanAPI(result, "vkWaitForFences");
+          }
+
+          result = vkResetFences(deviceHandle, 1, &readbackFenceHandle);
+
+          if (result != VK_SUCCESS) {
+            throwExceptionVulkanAPI(result, "vkResetFences");
+          }
+
+          result = invalidateDeviceMemory(deviceMemoryArena,
+                                          readbackAllocation, 0,
+                                          resultBufferSize);
+
+          if (result != VK_SUCCESS) {
+            throwExceptionVulkanAPI(result, "vkInvalidateMappedMemoryRanges");
+          }
+
+          std::chrono::steady_clock::time_point copyStartTimePoint =
+              std::chrono::steady_clock::now();
+
+          if (isStreaming) {
+            copyStreaming(readbackHostBuffer.data(),
+                          readbackAllocation.hostMemoryPtr, resultBufferSize);
+          } else {
+            memcpy(readbackHostBuffer.data(),
+                   readbackAllocation.hostMemoryPtr, resultBufferSize);
+          }
+
+          bandwidthList.push_back(
+              resultBufferSize /
+              std::chrono::duration<double>(
+                  std::chrono::steady_clock::now() - copyStartTimePoint)
+                  .count() /
+              1.0e9);
+        }
+
+        return getSampleStatistics(bandwidthList);
+      };
+
+      SampleStatistics memcpyBandwidthStatistics = getReadbackBandwidth(false);
+      SampleStatistics streamingBandwidthStatistics =
+          getReadbackBandwidth(true);
+
+      bool isSelected = memoryTypeIndex == resultMemoryTypeIndex;
+
+      if (isJSON) {
+        std::cout << (isFirstMemoryType ? "" : ", ")
+                  << "{\"memory_type\": " << memoryTypeIndex
+                  << ", \"flags\": \""
+                  << getMemoryPropertyFlagsName(propertyFlags)
+                  << "\", \"selected\": " << (isSelected ? "true" : "false")
+                  << ", ";
+        printSampleStatistics(std::cout, "memcpy_gb_per_second",
+                              memcpyBandwidthStatistics, true);
+        std::cout << ", ";
+        printSampleStatistics(std::cout, "streaming_gb_per_second",
+                              streamingBandwidthStatistics, true);
+        std::cout << "}";
+      } else {
+        std::cout << "memory type " << memoryTypeIndex << " ("
+                  << getMemoryPropertyFlagsName(propertyFlags) << ")"
+                  << (isSelected ? ", selected" : "") << std::endl;
+        printSampleStatistics(std::cout, "  memcpy (GB/s)",
+                              memcpyBandwidthStatistics, false);
+        printSampleStatistics(std::cout, "  streaming copy (GB/s)",
+                              streamingBandwidthStatistics, false);
+      }
+
+      isFirstMemoryType = false;
+
+      vkDestroyBuffer(deviceHandle, readbackBufferHandle, NULL);
+      freeDeviceMemory(deviceMemoryArena, readbackAllocation);
+    }
+
+    if (isJSON) {
+      std::cout << "]}" << std::endl;
+    }
+
+    vkDestroyFence(deviceHandle, readbackFenceHandle, NULL);
+    vkFreeCommandBuffers(deviceHandle, commandPoolHandle, 1,
+                         &readbackCommandBufferHandle);
+  }
+
+  // =========================================================================
+  // Fences, Semaphores
+
+  // fence pacing: a fence per frame in flight plus a chain of binary
+  // semaphores, each submit waits on the previous one
+  std::vector<VkFence> imageAvailableFenceHandleList(frameInFlightCount,
+                                                     VK_NULL_HANDLE);
+
+  std::vector<VkSemaphore> writeImageSemaphoreHandleList(frameInFlightCount,
+                                                         VK_NULL_HANDLE);
+
+  // timeline pacing: a single semaphore whose value is the number of frames
+  // the queue has completed, frames are independent and may overlap
+  VkSemaphore frameTimelineSemaphoreHandle = VK_NULL_HANDLE;
+  std::vector<uint64_t> frameTimelineValueList(frameInFlightCount, 0);
+
+  VkFence signalFirstSemaphoreFenceHandle = VK_NULL_HANDLE;
+
+  if (isTimelinePacingEnabled) {
+    VkSemaphoreTypeCreateInfo frameTimelineSemaphoreTypeCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .pNext = NULL,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0};
+
+    VkSemaphoreCreateInfo frameTimelineSemaphoreCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &frameTimelineSemaphoreTypeCreateInfo,
+        .flags = 0};
+
+    result = vkCreateSemaphore(deviceHandle, &frameTimelineSemaphoreCreateInfo,
+                               NULL, &frameTimelineSemaphoreHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateSemaphore");
+    }
+  } else {
+    for (uint32_t x = 0; x < frameInFlightCount; x++) {
+      VkFenceCreateInfo imageAvailableFenceCreateInfo = {
+          .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+          .pNext = NULL,
+          .flags = VK_FENCE_CREATE_SIGNALED_BIT};
+
+      result = vkCreateFence(deviceHandle, &imageAvailableFenceCreateInfo,
+                             NULL, &imageAvailableFenceHandleList[x]);
+
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkCreateFence");
+      }
+
+      VkSemaphoreCreateInfo writeImageSemaphoreCreateInfo = {
+          .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+          .pNext = NULL,
+          .flags = 0};
+
+      result = vkCreateSemaphore(deviceHandle, &writeImageSemaphoreCreateInfo,
+                                 NULL, &writeImageSemaphoreHandleList[x]);
+
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkCreateSemaphore");
+      }
+    }
+
+    VkSubmitInfo signalFirstSemaphoreSubmitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = NULL,
+        .waitSemaphoreCount = 0,
+        .pWaitSemaphores = NULL,
+        .pWaitDstStageMask = NULL,
+        .commandBufferCount = 0,
+        .pCommandBuffers = NULL,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &writeImageSemaphoreHandleList[0]};
+
+    VkFenceCreateInfo signalFirstSemaphoreFenceCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0};
+
+    result = vkCreateFence(deviceHandle, &signalFirstSemaphoreFenceCreateInfo,
+                           NULL, &signalFirstSemaphoreFenceHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateFence");
+    }
+
+    result = vkQueueSubmit(queueHandle, 1, &signalFirstSemaphoreSubmitInfo,
+                           signalFirstSemaphoreFenceHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkQueueSubmit");
+    }
+
+    result = vkWaitForFences(deviceHandle, 1, &signalFirstSemaphoreFenceHandle,
+                             true, UINT64_MAX);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkWaitForFences");
+    }
+  }
+
+  // =========================================================================
+  // Frame Export
+
+  // a binary semaphore per render target, signaled by the frame's submission
+  // and waited on by the consumer's copy. The producer only signals it again
+  // after the consumer released the slot, so every signal has its wait
+  std::vector<VkSemaphore> exportSemaphoreHandleList;
+  FrameExport frameExport;
+
+  if (isFrameExportEnabled) {
+    VkExportSemaphoreCreateInfo exportSemaphoreCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO,
+        .pNext = NULL,
+        .handleTypes = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT};
+
+    VkSemaphoreCreateInfo exportableSemaphoreCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &exportSemaphoreCreateInfo,
+        .flags = 0};
+
+    exportSemaphoreHandleList.resize(frameInFlightCount, VK_NULL_HANDLE);
+
+    for (uint32_t x = 0; x < frameInFlightCount; x++) {
+      result = vkCreateSemaphore(deviceHandle, &exportableSemaphoreCreateInfo,
+                                 NULL, &exportSemaphoreHandleList[x]);
+
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkCreateSemaphore");
+      }
+    }
+
+    logStream << "frame export: waiting for a consumer on " << frameExportPath
+              << std::endl;
+
+    if (!createFrameExport(frameExport, frameExportPath, frameInFlightCount)) {
+      throw std::runtime_error("Could not open frame export socket: " +
+                               frameExportPath);
+    }
+
+    FrameExportMessage deviceMessage;
+    deviceMessage.type = FRAME_EXPORT_MESSAGE_TYPE_DEVICE;
+    memcpy(deviceMessage.deviceUUID, physicalDeviceIDProperties.deviceUUID,
+           VK_UUID_SIZE);
+    memcpy(deviceMessage.driverUUID, physicalDeviceIDProperties.driverUUID,
+           VK_UUID_SIZE);
+    deviceMessage.format = renderFormat;
+    deviceMessage.imageExtent = maxRenderExtent;
+    deviceMessage.imageUsageFlags = exportImageUsageFlags;
+    deviceMessage.slotCount = frameInFlightCount;
+    deviceMessage.drawCount = drawCount;
+
+    bool isSent =
+        sendFrameExportMessage(frameExport.socketDescriptor, deviceMessage);
+
+    // every export returns a new descriptor, the socket duplicates it into
+    // the consumer and the producer's copy is closed right away
+    for (uint32_t x = 0; isSent && x < frameInFlightCount; x++) {
+      VkMemoryGetFdInfoKHR memoryGetFdInfo = {
+          .sType = VK_STRUCTURE_TYPE_MEMORY_GET_FD_INFO_KHR,
+          .pNext = NULL,
+          .memory = renderPassImageAllocationList[x].deviceMemoryHandle,
+          .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT};
+
+      int memoryDescriptor = -1;
+      result = pvkGetMemoryFdKHR(deviceHandle, &memoryGetFdInfo,
+                                 &memoryDescriptor);
+
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkGetMemoryFdKHR");
+      }
+
+      VkSemaphoreGetFdInfoKHR semaphoreGetFdInfo = {
+          .sType = VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR,
+          .pNext = NULL,
+          .semaphore = exportSemaphoreHandleList[x],
+          .handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT};
+
+      int semaphoreDescriptor = -1;
+      result = pvkGetSemaphoreFdKHR(deviceHandle, &semaphoreGetFdInfo,
+                                    &semaphoreDescriptor);
+
+      if (result != VK_SUCCESS) {
+        close(memoryDescriptor);
+        throwExceptionVulkanAPI(result, "vkGetSemaphoreFdKHR");
+      }
+
+      FrameExportMessage slotMessage;
+      slotMessage.type = FRAME_EXPORT_MESSAGE_TYPE_SLOT;
+      slotMessage.slotIndex = x;
+      slotMessage.allocationSize = renderPassImageAllocationList[x].size;
+      slotMessage.memoryTypeIndex =
+          renderPassImageAllocationList[x].memoryTypeIndex;
+
+      isSent = sendFrameExportMessage(frameExport.socketDescriptor,
+                                      slotMessage,
+                                      {memoryDescriptor, semaphoreDescriptor});
+
+      close(memoryDescriptor);
+      close(semaphoreDescriptor);
+    }
+
+    if (!isSent) {
+      throw std::runtime_error("Frame export consumer disconnected: " +
+                               frameExportPath);
+    }
+
+    logStream << "frame export: " << frameInFlightCount
+              << " render targets exported" << std::endl;
+  }
+
+  // =========================================================================
+  // Frame Sink
+
+  // one slot per readback buffer, raising the frames in flight gives the
+  // encoders more frames to work on at once
+  FrameSink frameSink;
+
+  if (isFrameSinkEnabled) {
+    std::error_code errorCode;
+    std::filesystem::create_directories(frameSinkDirectory, errorCode);
+
+    createFrameSink(frameSink, frameSinkFormat, frameSinkDirectory,
+                    renderFormat == VK_FORMAT_B8G8R8A8_UNORM ||
+                        renderFormat == VK_FORMAT_B8G8R8A8_SRGB,
+                    frameInFlightCount, frameSinkThreadCount);
+
+    logStream << "frame sink: " << getFrameSinkExtension(frameSinkFormat)
+              << " to " << frameSinkDirectory << " on "
+              << frameSinkThreadCount << " threads" << std::endl;
+  }
+
+  // =========================================================================
+  // Main Loop
+
+  std::vector<bool> frameSubmittedList(renderPassImageHandleList.size(), false);
+  std::vector<uint8_t> hostFrameBuffer(resultBufferSize);
+
+  uint64_t submittedFrameCount = 0;
+  uint64_t retrievedFrameCount = 0, retrievedFrameCountReported = 0;
+
+  std::vector<double> frameTimeList;
+  std::vector<double> cpuTimeList;
+  std::vector<double> recordTimeList;
+  std::vector<double> gpuRenderPassTimeList;
+  std::vector<double> gpuCopyTimeList;
+
+  double gpuRenderPassTimeSum = 0;
+  uint64_t gpuRenderPassTimeCount = 0;
+
+  // memory traffic a separate resolve would have added, storing every sample
+  // at the end of the pass and reading them all back in vkCmdResolveImage
+  VkDeviceSize separateResolveTrafficSize = 0;
+
+  // tile each frame in flight was recorded for
+  std::vector<uint32_t> frameTileIndexList(renderPassImageHandleList.size(),
+                                           0);
+
+  // submission number of each frame in flight, names the sink's files
+  std::vector<uint64_t> frameNumberList(renderPassImageHandleList.size(), 0);
+
+  // only called for frames whose fence has signaled, so the copy is complete
+  // and the timestamps are available without waiting on the query pool
+  auto retrieveFrame = [&](uint32_t frameIndex) {
+    // the sink's encoders and the y4m writer read the mapped buffer in place
+    const uint8_t *framePtr =
+        (const uint8_t *)hostResultMemoryBufferList[frameIndex];
+
+    VkDeviceSize frameSize =
+        isY4MStreamEnabled ? y4mStream.layout.size
+                           : (VkDeviceSize)frameExtentList[frameIndex].width *
+                                 frameExtentList[frameIndex].height * 4;
+
+    // exported frames never reach the result buffer, and neither do frames
+    // read back into the ring directly
+    if (!isFrameExportEnabled && !isFrameRingDirect) {
+      result = invalidateDeviceMemory(deviceMemoryArena,
+                                      resultAllocationList[frameIndex], 0,
+                                      frameSize);
+
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkInvalidateMappedMemoryRanges");
+      }
+    }
+
+    // the frame goes into its slot instead of the host buffer, readers that
+    // are still reading the slot's previous frame discard it from here on
+    if (isFrameRingEnabled) {
+      if (!isFrameRingDirect) {
+        copyStreaming(
+            beginFrameRingFrame(frameRing, frameNumberList[frameIndex]),
+            framePtr, frameSize);
+      }
+
+      publishFrameRingFrame(frameRing, frameNumberList[frameIndex],
+                            frameExtentList[frameIndex], frameSize);
+    } else if (!isFrameSinkEnabled && !isY4MStreamEnabled &&
+               !isFrameExportEnabled) {
+      copyStreaming(hostFrameBuffer.data(), framePtr, frameSize);
+      framePtr = hostFrameBuffer.data();
+    }
+
+    if (isTiledOutputEnabled &&
+        !writeTiledOutputTile(tiledOutput, frameTileIndexList[frameIndex],
+                              framePtr)) {
+      throw std::runtime_error("Could not write tiled output: " +
+                               tiledOutputPath);
+    }
+
+    if (isFrameSinkEnabled) {
+      submitFrameSink(frameSink,
+                      {.slotIndex = frameIndex,
+                       .frameNumber = frameNumberList[frameIndex],
+                       .pixelPtr = framePtr,
+                       .extent = frameExtentList[frameIndex]});
+    }
+
+    if (isY4MStreamEnabled) {
+      submitY4MStream(y4mStream,
+                      {.slotIndex = frameIndex, .planePtr = framePtr});
+    }
+
+    if (timestampQueryPoolHandle != VK_NULL_HANDLE) {
+      uint64_t timestampList[3];
+      result = vkGetQueryPoolResults(
+          deviceHandle, timestampQueryPoolHandle,
+          frameIndex * timestampQueryCount, timestampQueryCount,
+          sizeof(timestampList), timestampList, sizeof(uint64_t),
+          VK_QUERY_RESULT_64_BIT);
+
+      if (result != VK_SUCCESS && result != VK_NOT_READY) {
+        throwExceptionVulkanAPI(result, "vkGetQueryPoolResults");
+      }
+
+      if (result == VK_SUCCESS) {
+        double timestampPeriodMilliseconds =
+            physicalDeviceProperties.limits.timestampPeriod / 1000000.0;
+
+        double gpuRenderPassTime =
+            ((timestampList[1] - timestampList[0]) & timestampMask) *
+            timestampPeriodMilliseconds;
+        double gpuCopyTime =
+            ((timestampList[2] - timestampList[1]) & timestampMask) *
+            timestampPeriodMilliseconds;
+
+        gpuRenderPassTimeSum += gpuRenderPassTime;
+        gpuRenderPassTimeCount += 1;
+
+        if (isBenchmarkEnabled) {
+          gpuRenderPassTimeList.push_back(gpuRenderPassTime);
+          gpuCopyTimeList.push_back(gpuCopyTime);
+        }
+      }
+    }
+
+    frameSubmittedList[frameIndex] = false;
+    retrievedFrameCount += 1;
+  };
+
+  std::chrono::steady_clock::time_point startTimePoint =
+      std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point reportTimePoint = startTimePoint;
+
+  uint32_t currentFrame = 0, previousFrame = 0;
+  while (!isExitRequested && !isRecordScalingEnabled &&
+         !isReadbackBenchmarkEnabled) {
+    std::chrono::steady_clock::time_point frameStartTimePoint =
+        std::chrono::steady_clock::now();
+
+    if (maxFrameCount > 0 && submittedFrameCount >= maxFrameCount) {
+      break;
+    }
+
+    if (maxSeconds > 0 &&
+        std::chrono::duration<double>(frameStartTimePoint - startTimePoint)
+                .count() >= maxSeconds) {
+      break;
+    }
+
+    // without a timeout, the frame's buffer is read, handed on and its
+    // command buffer recorded again right after, all of which needs the
+    // frame to have finished
+    if (isTimelinePacingEnabled) {
+      VkSemaphoreWaitInfo frameSemaphoreWaitInfo = {
+          .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+          .pNext = NULL,
+          .flags = 0,
+          .semaphoreCount = 1,
+          .pSemaphores = &frameTimelineSemaphoreHandle,
+          .pValues = &frameTimelineValueList[currentFrame]};
+
+      result = vkWaitSemaphores(deviceHandle, &frameSemaphoreWaitInfo,
+                                UINT64_MAX);
+
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkWaitSemaphores");
+      }
+    } else {
+      result = vkWaitForFences(deviceHandle, 1,
+                               &imageAvailableFenceHandleList[currentFrame],
+                               true, UINT64_MAX);
+
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkWaitForFences");
+      }
+    }
+
+    std::chrono::steady_clock::time_point fenceTimePoint =
+        std::chrono::steady_clock::now();
+
+    // the wait only guards the oldest frame in the ring, the remaining
+    // frames keep rendering while its result buffer is drained
+    if (frameSubmittedList[currentFrame]) {
+      retrieveFrame(currentFrame);
+    }
+
+    // the copy into this frame's readback buffer must wait for the encoders
+    // to let go of it, this is where a slow disk holds the renderer back
+    if (isFrameSinkEnabled) {
+      waitFrameSinkSlot(frameSink, currentFrame);
+    }
+
+    // the same for the y4m writer and whatever reads the stream, the
+    // renderer slows down to the consumer instead of dropping frames
+    if (isY4MStreamEnabled && !waitY4MStreamSlot(y4mStream, currentFrame)) {
+      logStream << "y4m stream closed by its reader" << std::endl;
+      break;
+    }
+
+    // the consumer may still be reading the render target
+    if (isFrameExportEnabled &&
+        !waitFrameExportSlot(frameExport, currentFrame)) {
+      logStream << "frame export consumer disconnected" << std::endl;
+      break;
+    }
+
+    std::chrono::duration<double> reportDuration =
+        fenceTimePoint - reportTimePoint;
+
+    if (!isBenchmarkEnabled && reportDuration.count() >= 1.0) {
+      logStream << "retrieved frames/s: "
+                << (retrievedFrameCount - retrievedFrameCountReported) /
+                       reportDuration.count();
+
+      if (gpuRenderPassTimeCount > 0) {
+        logStream << ", gpu render pass (ms): "
+                  << gpuRenderPassTimeSum / gpuRenderPassTimeCount;
+      }
+
+      logStream << std::endl;
+
+      retrievedFrameCountReported = retrievedFrameCount;
+      reportTimePoint = fenceTimePoint;
+      gpuRenderPassTimeSum = 0;
+      gpuRenderPassTimeCount = 0;
+    }
+
+    if (!isTimelinePacingEnabled) {
+      result = vkResetFences(deviceHandle, 1,
+                             &imageAvailableFenceHandleList[currentFrame]);
+
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkResetFences");
+      }
+    }
+
+    frameExtentList[currentFrame] =
+        renderExtentList[submittedFrameCount % renderExtentList.size()];
+    frameNumberList[currentFrame] = submittedFrameCount;
+
+    // the device writes the slot from the submission on
+    if (isFrameRingDirect) {
+      frameRingSlotIndexList[currentFrame] =
+          getFrameRingSlotIndex(frameRing, submittedFrameCount);
+      beginFrameRingFrame(frameRing, submittedFrameCount);
+    }
+
+    if (isTiledOutputEnabled) {
+      frameTileIndexList[currentFrame] = (uint32_t)submittedFrameCount;
+      frameExtentList[currentFrame] =
+          getTiledOutputRect(tiledOutput, frameTileIndexList[currentFrame])
+              .extent;
+
+      getTiledOutputTransform(tiledOutput, frameTileIndexList[currentFrame],
+                              uniformStructure.tileTransform);
+    }
+
+    // the wait above guarantees the previous use of this slot has retired
+    uniformStructure.frameCount = submittedFrameCount;
+    memcpy((char *)uniformAllocation.hostMemoryPtr +
+               currentFrame * uniformSlotSize,
+           &uniformStructure, sizeof(UniformStructure));
+
+    if (isMultisampleEnabled) {
+      separateResolveTrafficSize += (VkDeviceSize)2 *
+                                    frameExtentList[currentFrame].width *
+                                    frameExtentList[currentFrame].height * 4 *
+                                    sampleCount;
+    }
+
+    std::chrono::steady_clock::time_point recordStartTimePoint =
+        std::chrono::steady_clock::now();
+
+    recordFrame(currentFrame, threadCount);
+
+    std::chrono::steady_clock::time_point recordEndTimePoint =
+        std::chrono::steady_clock::now();
+
+    VkPipelineStageFlags pipelineStageFlags =
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+    VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = NULL,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &writeImageSemaphoreHandleList[previousFrame],
+        .pWaitDstStageMask = &pipelineStageFlags,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &commandBufferHandleList[currentFrame],
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &writeImageSemaphoreHandleList[currentFrame]};
+
+    // frame N signals value N + 1, nothing waits on an earlier frame
+    frameTimelineValueList[currentFrame] = submittedFrameCount + 1;
+
+    VkTimelineSemaphoreSubmitInfo timelineSemaphoreSubmitInfo = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = NULL,
+        .waitSemaphoreValueCount = 0,
+        .pWaitSemaphoreValues = NULL,
+        .signalSemaphoreValueCount = 1,
+        .pSignalSemaphoreValues = &frameTimelineValueList[currentFrame]};
+
+    if (isTimelinePacingEnabled) {
+      submitInfo.pNext = &timelineSemaphoreSubmitInfo;
+      submitInfo.waitSemaphoreCount = 0;
+      submitInfo.pWaitSemaphores = NULL;
+      submitInfo.pWaitDstStageMask = NULL;
+      submitInfo.pSignalSemaphores = &frameTimelineSemaphoreHandle;
+    }
+
+    // an exported frame also signals the semaphore the consumer waits on, a
+    // binary semaphore's value is ignored
+    VkSemaphore exportSignalSemaphoreHandleList[2] = {VK_NULL_HANDLE,
+                                                      VK_NULL_HANDLE};
+    uint64_t exportSignalSemaphoreValueList[2] = {
+        frameTimelineValueList[currentFrame], 0};
+
+    if (isFrameExportEnabled) {
+      exportSignalSemaphoreHandleList[0] = submitInfo.pSignalSemaphores[0];
+      exportSignalSemaphoreHandleList[1] =
+          exportSemaphoreHandleList[currentFrame];
+
+      submitInfo.signalSemaphoreCount = 2;
+      submitInfo.pSignalSemaphores = exportSignalSemaphoreHandleList;
+
+      timelineSemaphoreSubmitInfo.signalSemaphoreValueCount = 2;
+      timelineSemaphoreSubmitInfo.pSignalSemaphoreValues =
+          exportSignalSemaphoreValueList;
+    }
+
+    result = vkQueueSubmit(queueHandle, 1, &submitInfo,
+                           imageAvailableFenceHandleList[currentFrame]);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkQueueSubmit");
+    }
+
+    frameSubmittedList[currentFrame] = true;
+    submittedFrameCount += 1;
+
+    if (isFrameExportEnabled &&
+        !submitFrameExport(frameExport, currentFrame,
+                           frameNumberList[currentFrame],
+                           frameExtentList[currentFrame])) {
+      logStream << "frame export consumer disconnected" << std::endl;
+      break;
+    }
+
+    if (isBenchmarkEnabled) {
+      std::chrono::steady_clock::time_point frameEndTimePoint =
+          std::chrono::steady_clock::now();
+
+      frameTimeList.push_back(std::chrono::duration<double, std::milli>(
+                                  frameEndTimePoint - frameStartTimePoint)
+                                  .count());
+      cpuTimeList.push_back(std::chrono::duration<double, std::milli>(
+                                frameEndTimePoint - fenceTimePoint)
+                                .count());
+      recordTimeList.push_back(std::chrono::duration<double, std::milli>(
+                                   recordEndTimePoint - recordStartTimePoint)
+                                   .count());
+    }
+
+    // frames that already finished are handed to the sink or the y4m writer
+    // right away, in submission order, so encoding overlaps the rest of the
+    // ring instead of starting only when their slot comes around again
+    for (uint32_t x = 1;
+         (isFrameSinkEnabled || isY4MStreamEnabled) && x < frameInFlightCount;
+         x++) {
+      uint32_t frameIndex = (currentFrame + x) % frameInFlightCount;
+
+      if (!frameSubmittedList[frameIndex]) {
+        continue;
+      }
+
+      bool isFrameComplete = false;
+      if (isTimelinePacingEnabled) {
+        uint64_t frameTimelineValue = 0;
+        result = vkGetSemaphoreCounterValue(
+            deviceHandle, frameTimelineSemaphoreHandle, &frameTimelineValue);
+
+        if (result != VK_SUCCESS) {
+          throwExceptionVulkanAPI(result, "vkGetSemaphoreCounterValue");
+        }
+
+        isFrameComplete =
+            frameTimelineValue >= frameTimelineValueList[frameIndex];
+      } else {
+        result = vkGetFenceStatus(deviceHandle,
+                                  imageAvailableFenceHandleList[frameIndex]);
+
+        if (result != VK_SUCCESS && result != VK_NOT_READY) {
+          throwExceptionVulkanAPI(result, "vkGetFenceStatus");
+        }
+
+        isFrameComplete = result == VK_SUCCESS;
+      }
+
+      if (!isFrameComplete) {
+        break;
+      }
+
+      retrieveFrame(frameIndex);
+    }
+
+    previousFrame = currentFrame;
+    currentFrame = (currentFrame + 1) % renderPassImageHandleList.size();
+  }
+
+  // =========================================================================
+  // Drain
+
+  result = vkDeviceWaitIdle(deviceHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkDeviceWaitIdle");
+  }
+
+  // frames still in the ring are retrieved in submission order
+  for (uint32_t x = 0; x < renderPassImageHandleList.size(); x++) {
+    uint32_t frameIndex = (currentFrame + x) % renderPassImageHandleList.size();
+
+    if (frameSubmittedList[frameIndex]) {
+      retrieveFrame(frameIndex);
+    }
+  }
+
+  if (isFrameSinkEnabled) {
+    destroyFrameSink(frameSink);
+
+    logStream << "frame sink: " << frameSink.encodedFrameCount
+              << " frames written, " << frameSink.failedFrameCount
+              << " failed" << std::endl;
+  }
+
+  if (isFrameExportEnabled) {
+    destroyFrameExport(frameExport);
+
+    logStream << "frame export: " << frameExport.exportedFrameCount
+              << " frames exported, " << frameExport.releasedFrameCount
+              << " released" << std::endl;
+  }
+
+  if (isFrameRingEnabled) {
+    closeFrameRing(frameRing);
+
+    logStream << "frame ring: " << frameRing.publishedFrameCount
+              << " frames published, " << frameRing.lappedReaderFrameCount
+              << " times a reader was a whole ring behind" << std::endl;
+  }
+
+  if (isY4MStreamEnabled) {
+    destroyY4MStream(y4mStream);
+
+    logStream << "y4m stream: " << y4mStream.writtenFrameCount
+              << " frames, " << y4mStream.writtenByteCount << " bytes to "
+              << y4mStreamPath << std::endl;
+  }
+
+  if (isTiledOutputEnabled) {
+    if (!closeTiledOutput(tiledOutput)) {
+      throw std::runtime_error("Could not write tiled output: " +
+                               tiledOutputPath);
+    }
+
+    logStream << "tiled output: " << tiledOutput.writtenTileCount << " of "
+              << tiledOutput.tileCount << " tiles written" << std::endl;
+  }
+
+  // =========================================================================
+  // Statistics
+
+  if (isBenchmarkEnabled && !isRecordScalingEnabled &&
+      !isReadbackBenchmarkEnabled) {
+    double totalSeconds = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - startTimePoint)
+                              .count();
+
+    SampleStatistics frameTimeStatistics = getSampleStatistics(frameTimeList);
+    SampleStatistics cpuTimeStatistics = getSampleStatistics(cpuTimeList);
+    SampleStatistics recordTimeStatistics = getSampleStatistics(recordTimeList);
+    SampleStatistics gpuRenderPassTimeStatistics =
+        getSampleStatistics(gpuRenderPassTimeList);
+    SampleStatistics gpuCopyTimeStatistics =
+        getSampleStatistics(gpuCopyTimeList);
+
+    // what the lazily allocated blocks (depth and multisample images) ended
+    // up backing after every frame has rendered, a separate resolve would
+    // keep multisampleImageMemorySize resident
+    VkDeviceSize lazilyAllocatedCommittedSize = 0;
+    if (isMultisampleLazilyAllocated) {
+      lazilyAllocatedCommittedSize = getDeviceMemoryCommitment(
+          deviceMemoryArena, multisampleImageAllocationList[0].memoryTypeIndex);
+    } else if (isDepthLazilyAllocated) {
+      lazilyAllocatedCommittedSize = getDeviceMemoryCommitment(
+          deviceMemoryArena, depthImageAllocationList[0].memoryTypeIndex);
+    }
+
+    // what the host reads out of a result buffer each frame, the yuv planes
+    // are 12 bits per pixel against the copy's 32
+    VkDeviceSize readbackFrameSize =
+        isY4MStreamEnabled ? y4mStream.layout.size
+                           : (VkDeviceSize)maxRenderExtent.width *
+                                 maxRenderExtent.height * 4;
+
+    if (isJSON) {
+      std::cout << "{\"device\": \"" << physicalDeviceProperties.deviceName
+                << "\", "
+                << "\"pacing\": \""
+                << (isTimelinePacingEnabled ? "timeline" : "fence") << "\", "
+                << "\"rendering\": \""
+                << (isDynamicRenderingEnabled ? "dynamic" : "render_pass")
+                << "\", "
+                << "\"render_pass_object_creation_ms\": "
+                << renderPassObjectCreationTime << ", "
+                << "\"barrier_accesses\": "
+                << pipelineBarrierTracker.accessCount << ", "
+                << "\"barriers\": " << pipelineBarrierTracker.barrierCount
+                << ", "
+                << "\"barrier_batches\": "
+                << pipelineBarrierTracker.dependencyInfoCount << ", "
+                << "\"render_graph\": "
+                << (isRenderGraphEnabled ? "true" : "false") << ", "
+                << "\"render_graph_resample\": "
+                << (isRenderGraphResampleEnabled ? "true" : "false") << ", "
+                << "\"transient_bytes_aliased\": "
+                << renderGraphAliasedMemorySize << ", "
+                << "\"transient_bytes_unaliased\": "
+                << renderGraphUnaliasedMemorySize << ", "
+                << "\"frames_in_flight\": " << frameInFlightCount << ", "
+                << "\"image_format\": \"" << getImageFormatName(renderFormat)
+                << "\", "
+                << "\"depth_format\": \"" << getImageFormatName(depthFormat)
+                << "\", "
+                << "\"depth_memory\": \""
+                << (isDepthLazilyAllocated ? "lazy" : "device_local") << "\", "
+                << "\"depth_prepass\": "
+                << (isDepthPrepassEnabled ? "true" : "false") << ", "
+                << "\"shading_iterations\": " << shadingIterationCount << ", "
+                << "\"samples\": " << sampleCount << ", "
+                << "\"tiled_output\": \"" << tiledOutputExtent.width << "x"
+                << tiledOutputExtent.height << "\", "
+                << "\"tiles\": " << tiledOutput.writtenTileCount << ", "
+                << "\"sink\": \""
+                << (isFrameSinkEnabled ? getFrameSinkExtension(frameSinkFormat)
+                                       : "none")
+                << "\", "
+                << "\"sink_threads\": "
+                << (isFrameSinkEnabled ? frameSinkThreadCount : 0) << ", "
+                << "\"sink_frames\": " << frameSink.encodedFrameCount << ", "
+                << "\"sink_bytes\": " << frameSink.encodedByteCount << ", "
+                << "\"sink_compression_ratio\": "
+                << (frameSink.encodedByteCount > 0
+                        ? (double)frameSink.rawByteCount /
+                              frameSink.encodedByteCount
+                        : 0)
+                << ", "
+                << "\"sink_encode_ms_per_frame\": "
+                << (frameSink.encodedFrameCount > 0
+                        ? frameSink.encodeSeconds * 1000.0 /
+                              frameSink.encodedFrameCount
+                        : 0)
+                << ", "
+                << "\"sink_backpressure_seconds\": "
+                << frameSink.backpressureSeconds << ", "
+                << "\"y4m_frames\": " << y4mStream.writtenFrameCount << ", "
+                << "\"y4m_bytes\": " << y4mStream.writtenByteCount << ", "
+                << "\"y4m_backpressure_seconds\": "
+                << y4mStream.backpressureSeconds << ", "
+                << "\"readback_bytes_per_frame\": " << readbackFrameSize
+                << ", "
+                << "\"export_frames\": " << frameExport.exportedFrameCount
+                << ", "
+                << "\"export_release_wait_seconds\": "
+                << frameExport.releaseWaitSeconds << ", "
+                << "\"ring_frames\": " << frameRing.publishedFrameCount
+                << ", "
+                << "\"ring_direct\": "
+                << (isFrameRingDirect ? "true" : "false") << ", "
+                << "\"ring_lapped_reader_frames\": "
+                << frameRing.lappedReaderFrameCount << ", "
+                << "\"multisample_memory\": \""
+                << (!isMultisampleEnabled           ? "none"
+                    : isMultisampleLazilyAllocated ? "lazy"
+                                                   : "device_local")
+                << "\", "
+                << "\"multisample_image_bytes\": " << multisampleImageMemorySize
+                << ", "
+                << "\"lazily_allocated_bytes_committed\": "
+                << lazilyAllocatedCommittedSize << ", "
+                << "\"separate_resolve_bytes_avoided\": "
+                << separateResolveTrafficSize << ", "
+                << "\"separate_resolve_bytes_avoided_per_second\": "
+                << separateResolveTrafficSize / totalSeconds << ", "
+                << "\"extents\": " << renderExtentList.size() << ", "
+                << "\"max_extent\": \"" << maxRenderExtent.width << "x"
+                << maxRenderExtent.height << "\", "
+                << "\"threads\": " << threadCount << ", "
+                << "\"draws\": " << drawCount << ", "
+                << "\"frames\": " << retrievedFrameCount << ", "
+                << "\"seconds\": " << totalSeconds << ", "
+                << "\"frames_per_second\": "
+                << retrievedFrameCount / totalSeconds << ", ";
+      printSampleStatistics(std::cout, "frame_time_ms", frameTimeStatistics,
+                            true);
+      std::cout << ", ";
+      printSampleStatistics(std::cout, "cpu_time_ms", cpuTimeStatistics, true);
+      std::cout << ", ";
+      printSampleStatistics(std::cout, "record_time_ms", recordTimeStatistics,
+                            true);
+
+      if (timestampQueryPoolHandle != VK_NULL_HANDLE) {
+        std::cout << ", ";
+        printSampleStatistics(std::cout, "gpu_render_pass_time_ms",
+                              gpuRenderPassTimeStatistics, true);
+        std::cout << ", ";
+        printSampleStatistics(std::cout, "gpu_copy_time_ms",
+                              gpuCopyTimeStatistics, true);
+      }
+
+      std::cout << "}" << std::endl;
+    } else {
+      std::cout << "pacing: "
+                << (isTimelinePacingEnabled ? "timeline" : "fence")
+                << std::endl;
+      std::cout << "rendering: "
+                << (isDynamicRenderingEnabled ? "dynamic" : "render pass")
+                << std::endl;
+      std::cout << "render pass and framebuffer creation (ms): "
+                << renderPassObjectCreationTime << std::endl;
+      std::cout << "pipeline barriers: " << pipelineBarrierTracker.barrierCount
+                << " for " << pipelineBarrierTracker.accessCount
+                << " accesses in " << pipelineBarrierTracker.dependencyInfoCount
+                << " batches" << std::endl;
+      if (isRenderGraphEnabled) {
+        std::cout << "render graph transient memory (bytes): "
+                  << renderGraphAliasedMemorySize << " aliased, "
+                  << renderGraphUnaliasedMemorySize << " without aliasing"
+                  << std::endl;
+      }
+      std::cout << "frames in flight: " << frameInFlightCount << std::endl;
+      std::cout << "image format: " << getImageFormatName(renderFormat)
+                << std::endl;
+      std::cout << "depth format: " << getImageFormatName(depthFormat) << " ("
+                << (isDepthLazilyAllocated ? "lazily allocated"
+                                           : "device local")
+                << ")" << std::endl;
+      std::cout << "depth prepass: " << (isDepthPrepassEnabled ? "on" : "off")
+                << ", shading iterations: " << shadingIterationCount
+                << std::endl;
+      std::cout << "samples: " << sampleCount << std::endl;
+      if (isFrameSinkEnabled) {
+        std::cout << "frame sink: " << frameSink.encodedFrameCount << " "
+                  << getFrameSinkExtension(frameSinkFormat) << " frames, "
+                  << frameSink.encodedByteCount << " bytes ("
+                  << (frameSink.encodedByteCount > 0
+                          ? (double)frameSink.rawByteCount /
+                                frameSink.encodedByteCount
+                          : 0)
+                  << ":1) on " << frameSinkThreadCount << " threads"
+                  << std::endl;
+        std::cout << "frame sink encode per frame (ms): "
+                  << (frameSink.encodedFrameCount > 0
+                          ? frameSink.encodeSeconds * 1000.0 /
+                                frameSink.encodedFrameCount
+                          : 0)
+                  << ", backpressure (s): " << frameSink.backpressureSeconds
+                  << std::endl;
+      }
+      if (isY4MStreamEnabled) {
+        std::cout << "y4m stream: " << y4mStream.writtenFrameCount
+                  << " frames, " << y4mStream.writtenByteCount
+                  << " bytes, backpressure (s): "
+                  << y4mStream.backpressureSeconds << std::endl;
+      }
+      if (isFrameRingEnabled) {
+        std::cout << "frame ring: " << frameRing.publishedFrameCount
+                  << " frames" << (isFrameRingDirect ? ", direct" : "")
+                  << ", lapped readers: " << frameRing.lappedReaderFrameCount
+                  << std::endl;
+      }
+
+      if (isFrameExportEnabled) {
+        std::cout << "frame export: " << frameExport.exportedFrameCount
+                  << " frames, release wait (s): "
+                  << frameExport.releaseWaitSeconds << std::endl;
+      } else {
+        std::cout << "readback per frame (bytes): " << readbackFrameSize
+                  << std::endl;
+      }
+      if (isTiledOutputEnabled) {
+        std::cout << "tiled output: " << tiledOutputExtent.width << "x"
+                  << tiledOutputExtent.height << ", "
+                  << tiledOutput.writtenTileCount << " tiles" << std::endl;
+      }
+      if (isMultisampleEnabled) {
+        std::cout << "multisample images (bytes): "
+                  << multisampleImageMemorySize << " "
+                  << (isMultisampleLazilyAllocated ? "lazily allocated"
+                                                   : "device local")
+                  << ", " << lazilyAllocatedCommittedSize
+                  << " lazily allocated bytes committed" << std::endl;
+        std::cout << "on-tile resolve avoided (bytes): "
+                  << separateResolveTrafficSize << " ("
+                  << separateResolveTrafficSize / totalSeconds / 1.0e9
+                  << " GB/s) of separate resolve traffic" << std::endl;
+      }
+      std::cout << "extents: " << renderExtentList.size() << " (max "
+                << maxRenderExtent.width << "x" << maxRenderExtent.height
+                << ")" << std::endl;
+      std::cout << "threads: " << threadCount << std::endl;
+      std::cout << "draws: " << drawCount << std::endl;
+      std::cout << "frames: " << retrievedFrameCount << std::endl;
+      std::cout << "seconds: " << totalSeconds << std::endl;
+      std::cout << "frames/s: " << retrievedFrameCount / totalSeconds
+                << std::endl;
+      printSampleStatistics(std::cout, "frame time (ms)", frameTimeStatistics,
+                            false);
+      printSampleStatistics(std::cout, "cpu time (ms)", cpuTimeStatistics,
+                            false);
+      printSampleStatistics(std::cout, "record time (ms)",
+                            recordTimeStatistics, false);
+
+      if (timestampQueryPoolHandle != VK_NULL_HANDLE) {
+        printSampleStatistics(std::cout, "gpu render pass time (ms)",
+                              gpuRenderPassTimeStatistics, false);
+        printSampleStatistics(std::cout, "gpu copy time (ms)",
+                              gpuCopyTimeStatistics, false);
+      }
+    }
+  }
+
+  // =========================================================================
+  // Cleanup
+
+  result = vkDeviceWaitIdle(deviceHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkDeviceWaitIdle");
+  }
+
+  vkDestroyFence(deviceHandle, signalFirstSemaphoreFenceHandle, NULL);
+
+  if (timestampQueryPoolHandle != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(deviceHandle, timestampQueryPoolHandle, NULL);
+  }
+
+  destroyWorkerPool(workerPool);
+
+  for (uint32_t x = 0; x < workerCommandPoolHandleList.size(); x++) {
+    vkDestroyCommandPool(deviceHandle, workerCommandPoolHandleList[x], NULL);
+  }
+
+  vkDestroySemaphore(deviceHandle, frameTimelineSemaphoreHandle, NULL);
+
+  for (uint32_t x = 0; x < renderPassImageHandleList.size(); x++) {
+    vkDestroySemaphore(deviceHandle, writeImageSemaphoreHandleList[x], NULL);
+    vkDestroyFence(deviceHandle, imageAvailableFenceHandleList[x], NULL);
+  }
+
+  for (VkSemaphore exportSemaphoreHandle : exportSemaphoreHandleList) {
+    vkDestroySemaphore(deviceHandle, exportSemaphoreHandle, NULL);
+  }
+
+  for (RenderGraph &renderGraph : renderGraphList) {
+    destroyRenderGraph(renderGraph, deviceMemoryArena);
+  }
+
+  for (uint32_t x = 0; x < resultBufferHandleList.size(); x++) {
+    vkDestroyBuffer(deviceHandle, resultBufferHandleList[x], NULL);
+    freeDeviceMemory(deviceMemoryArena, resultAllocationList[x]);
+  }
+
+  // the import is freed before the pages it points at are unmapped
+  for (VkBuffer frameRingBufferHandle : frameRingBufferHandleList) {
+    vkDestroyBuffer(deviceHandle, frameRingBufferHandle, NULL);
+  }
+
+  vkFreeMemory(deviceHandle, frameRingDeviceMemoryHandle, NULL);
+  destroyFrameRing(frameRing);
+
+  vkDestroyBuffer(deviceHandle, uniformBufferHandle, NULL);
+  freeDeviceMemory(deviceMemoryArena, uniformAllocation);
+
+  vkDestroyBuffer(deviceHandle, indexBufferHandle, NULL);
+  freeDeviceMemory(deviceMemoryArena, indexAllocation);
   vkDestroyBuffer(deviceHandle, vertexBufferHandle, NULL);
+  freeDeviceMemory(deviceMemoryArena, vertexAllocation);
+  vkDestroyPipeline(deviceHandle, depthPrepassPipelineHandle, NULL);
   vkDestroyPipeline(deviceHandle, graphicsPipelineHandle, NULL);
+  vkDestroyPipeline(deviceHandle, yuvPipelineHandle, NULL);
+
+  size_t pipelineCacheDataSize = 0;
+  result = vkGetPipelineCacheData(deviceHandle, pipelineCacheHandle,
+                                  &pipelineCacheDataSize, NULL);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkGetPipelineCacheData");
+  }
+
+  std::vector<char> pipelineCacheData(pipelineCacheDataSize);
+  result = vkGetPipelineCacheData(deviceHandle, pipelineCacheHandle,
+                                  &pipelineCacheDataSize,
+                                  pipelineCacheData.data());
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkGetPipelineCacheData");
+  }
+
+  pipelineCacheData.resize(pipelineCacheDataSize);
+  writePipelineCacheFile(pipelineCachePath, pipelineCacheData);
+
+  vkDestroyPipelineCache(deviceHandle, pipelineCacheHandle, NULL);
   vkDestroyShaderModule(deviceHandle, fragmentShaderModuleHandle, NULL);
   vkDestroyShaderModule(deviceHandle, vertexShaderModuleHandle, NULL);
   vkDestroyPipelineLayout(deviceHandle, pipelineLayoutHandle, NULL);
@@ -1294,12 +5456,34 @@ int main() {
   vkDestroyDescriptorSetLayout(deviceHandle, descriptorSetLayoutHandle, NULL);
   vkDestroyDescriptorPool(deviceHandle, descriptorPoolHandle, NULL);
 
+  vkDestroyShaderModule(deviceHandle, yuvShaderModuleHandle, NULL);
+  vkDestroyPipelineLayout(deviceHandle, yuvPipelineLayoutHandle, NULL);
+  vkDestroyDescriptorSetLayout(deviceHandle, yuvDescriptorSetLayoutHandle,
+                               NULL);
+  vkDestroyDescriptorPool(deviceHandle, yuvDescriptorPoolHandle, NULL);
+  vkDestroySampler(deviceHandle, yuvSamplerHandle, NULL);
+
+  for (uint32_t x = 0; x < depthImageHandleList.size(); x++) {
+    vkDestroyImageView(deviceHandle, depthImageViewHandleList[x], NULL);
+    vkDestroyImage(deviceHandle, depthImageHandleList[x], NULL);
+    freeDeviceMemory(deviceMemoryArena, depthImageAllocationList[x]);
+  }
+
+  for (uint32_t x = 0; x < multisampleImageHandleList.size(); x++) {
+    vkDestroyImageView(deviceHandle, multisampleImageViewHandleList[x], NULL);
+    vkDestroyImage(deviceHandle, multisampleImageHandleList[x], NULL);
+    freeDeviceMemory(deviceMemoryArena, multisampleImageAllocationList[x]);
+  }
+
   for (uint32_t x = 0; x < renderPassImageHandleList.size(); x++) {
     vkDestroyFramebuffer(deviceHandle, framebufferHandleList[x], NULL);
-    vkDestroyImage(deviceHandle, renderPassImageHandleList[x], NULL);
     vkDestroyImageView(deviceHandle, renderPassImageViewHandleList[x], NULL);
+    vkDestroyImage(deviceHandle, renderPassImageHandleList[x], NULL);
+    freeDeviceMemory(deviceMemoryArena, renderPassImageAllocationList[x]);
   }
 
+  destroyDeviceMemoryArena(deviceMemoryArena);
+
   vkDestroyRenderPass(deviceHandle, renderPassHandle, NULL);
   vkDestroyCommandPool(deviceHandle, commandPoolHandle, NULL);
   vkDestroyDevice(deviceHandle, NULL);
@@ -0,0 +1,349 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <map>
+#include <vector>
+
+// Remembers the last access to every image and buffer a command buffer
+// touches and turns each new access into the narrowest synchronization2
+// barrier that orders it after the previous ones. A read after a write waits
+// on the writing stages and makes the written data visible. A write after a
+// read only needs an execution dependency on the reading stages. A read after
+// a read needs nothing unless the layout changes. Barriers are queued and
+// flushPipelineBarriers submits them all with a single vkCmdPipelineBarrier2,
+// so adjacent transitions share one dependency info. Devices without
+// synchronization2 get the same barriers through vkCmdPipelineBarrier, with
+// the stage masks of one flush merged.
+
+const VkAccessFlags2 writeAccessFlags =
+    VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+    VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT |
+    VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+struct ResourceAccessState {
+  VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  // the last write or layout transition
+  VkPipelineStageFlags2 writeStageMask = VK_PIPELINE_STAGE_2_NONE;
+  VkAccessFlags2 writeAccessMask = VK_ACCESS_2_NONE;
+
+  // stages that read since the last write, every access in readAccessMask is
+  // visible to every stage in readStageMask
+  VkPipelineStageFlags2 readStageMask = VK_PIPELINE_STAGE_2_NONE;
+  VkAccessFlags2 readAccessMask = VK_ACCESS_2_NONE;
+};
+
+struct TrackedImage {
+  VkImageSubresourceRange subresourceRange;
+  ResourceAccessState accessState;
+};
+
+struct PipelineBarrierTracker {
+  std::map<VkImage, TrackedImage> imageMap;
+  std::map<VkBuffer, ResourceAccessState> bufferMap;
+
+  std::vector<VkImageMemoryBarrier2> imageMemoryBarrierList;
+  std::vector<VkBufferMemoryBarrier2> bufferMemoryBarrierList;
+
+  bool isSynchronization2Enabled = true;
+
+  uint64_t accessCount = 0;
+  uint64_t barrierCount = 0;
+  uint64_t dependencyInfoCount = 0;
+};
+
+// updates the state for a new access and returns whether it needs a barrier,
+// along with the masks that barrier should use
+inline bool updateResourceAccessState(ResourceAccessState &accessState,
+                                      VkPipelineStageFlags2 stageMask,
+                                      VkAccessFlags2 accessMask,
+                                      VkImageLayout layout,
+                                      VkPipelineStageFlags2 *srcStageMaskPtr,
+                                      VkAccessFlags2 *srcAccessMaskPtr,
+                                      VkPipelineStageFlags2 *dstStageMaskPtr,
+                                      VkAccessFlags2 *dstAccessMaskPtr) {
+  bool isLayoutTransition = layout != accessState.layout;
+  bool isWrite = (accessMask & writeAccessFlags) || isLayoutTransition;
+
+  if (isWrite) {
+    bool isBarrierRequired = isLayoutTransition ||
+                             accessState.writeStageMask != 0 ||
+                             accessState.readStageMask != 0;
+
+    // once something has read the last write it is available, waiting for
+    // the readers is enough to order the new write after both
+    if (accessState.readStageMask != 0) {
+      *srcStageMaskPtr = accessState.readStageMask;
+      *srcAccessMaskPtr = VK_ACCESS_2_NONE;
+    } else {
+      *srcStageMaskPtr = accessState.writeStageMask;
+      *srcAccessMaskPtr = accessState.writeAccessMask;
+    }
+
+    *dstStageMaskPtr = stageMask;
+    *dstAccessMaskPtr = accessMask;
+
+    accessState.layout = layout;
+    accessState.writeStageMask = stageMask;
+    accessState.writeAccessMask = accessMask & writeAccessFlags;
+    accessState.readStageMask =
+        (accessMask & ~writeAccessFlags) ? stageMask : VK_PIPELINE_STAGE_2_NONE;
+    accessState.readAccessMask = accessMask & ~writeAccessFlags;
+
+    return isBarrierRequired;
+  }
+
+  if ((stageMask & ~accessState.readStageMask) == 0 &&
+      (accessMask & ~accessState.readAccessMask) == 0) {
+    return false;
+  }
+
+  // the destination masks include the earlier readers so the visibility
+  // recorded in the state stays true for every reading stage
+  *srcStageMaskPtr = accessState.writeStageMask;
+  *srcAccessMaskPtr = accessState.writeAccessMask;
+  *dstStageMaskPtr = stageMask | accessState.readStageMask;
+  *dstAccessMaskPtr = accessMask | accessState.readAccessMask;
+
+  accessState.readStageMask |= stageMask;
+  accessState.readAccessMask |= accessMask;
+
+  return accessState.writeStageMask != 0;
+}
+
+inline void trackImage(PipelineBarrierTracker &tracker, VkImage imageHandle,
+                       const VkImageSubresourceRange &subresourceRange,
+                       const ResourceAccessState &accessState = {}) {
+  tracker.imageMap[imageHandle] = {.subresourceRange = subresourceRange,
+                                   .accessState = accessState};
+}
+
+inline void trackBuffer(PipelineBarrierTracker &tracker,
+                        VkBuffer bufferHandle,
+                        const ResourceAccessState &accessState = {}) {
+  tracker.bufferMap[bufferHandle] = accessState;
+}
+
+inline void requireImageAccess(PipelineBarrierTracker &tracker,
+                               VkImage imageHandle,
+                               VkPipelineStageFlags2 stageMask,
+                               VkAccessFlags2 accessMask,
+                               VkImageLayout layout) {
+  TrackedImage &trackedImage = tracker.imageMap.at(imageHandle);
+  VkImageLayout oldLayout = trackedImage.accessState.layout;
+
+  VkImageMemoryBarrier2 imageMemoryBarrier = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+      .pNext = NULL,
+      .oldLayout = oldLayout,
+      .newLayout = layout,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = imageHandle,
+      .subresourceRange = trackedImage.subresourceRange};
+
+  tracker.accessCount += 1;
+
+  if (updateResourceAccessState(
+          trackedImage.accessState, stageMask, accessMask, layout,
+          &imageMemoryBarrier.srcStageMask, &imageMemoryBarrier.srcAccessMask,
+          &imageMemoryBarrier.dstStageMask,
+          &imageMemoryBarrier.dstAccessMask)) {
+
+    tracker.imageMemoryBarrierList.push_back(imageMemoryBarrier);
+  }
+}
+
+inline void requireBufferAccess(PipelineBarrierTracker &tracker,
+                                VkBuffer bufferHandle,
+                                VkPipelineStageFlags2 stageMask,
+                                VkAccessFlags2 accessMask) {
+  ResourceAccessState &accessState = tracker.bufferMap.at(bufferHandle);
+
+  VkBufferMemoryBarrier2 bufferMemoryBarrier = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+      .pNext = NULL,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .buffer = bufferHandle,
+      .offset = 0,
+      .size = VK_WHOLE_SIZE};
+
+  tracker.accessCount += 1;
+
+  if (updateResourceAccessState(
+          accessState, stageMask, accessMask, VK_IMAGE_LAYOUT_UNDEFINED,
+          &bufferMemoryBarrier.srcStageMask, &bufferMemoryBarrier.srcAccessMask,
+          &bufferMemoryBarrier.dstStageMask,
+          &bufferMemoryBarrier.dstAccessMask)) {
+
+    tracker.bufferMemoryBarrierList.push_back(bufferMemoryBarrier);
+  }
+}
+
+// the release half of a queue family ownership transfer, e.g. to
+// VK_QUEUE_FAMILY_EXTERNAL for another process. The image keeps its layout
+// and the barrier waits on every earlier access, the receiver records the
+// matching acquire. Barriers already queued for the image must be flushed
+// first. The image is untracked afterwards
+inline void releaseImageOwnership(PipelineBarrierTracker &tracker,
+                                  VkImage imageHandle,
+                                  uint32_t srcQueueFamilyIndex,
+                                  uint32_t dstQueueFamilyIndex) {
+  TrackedImage &trackedImage = tracker.imageMap.at(imageHandle);
+  const ResourceAccessState &accessState = trackedImage.accessState;
+
+  tracker.imageMemoryBarrierList.push_back(
+      {.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+       .pNext = NULL,
+       .srcStageMask = accessState.writeStageMask | accessState.readStageMask,
+       .srcAccessMask = accessState.writeAccessMask,
+       .dstStageMask = VK_PIPELINE_STAGE_2_NONE,
+       .dstAccessMask = VK_ACCESS_2_NONE,
+       .oldLayout = accessState.layout,
+       .newLayout = accessState.layout,
+       .srcQueueFamilyIndex = srcQueueFamilyIndex,
+       .dstQueueFamilyIndex = dstQueueFamilyIndex,
+       .image = imageHandle,
+       .subresourceRange = trackedImage.subresourceRange});
+
+  tracker.accessCount += 1;
+  tracker.imageMap.erase(imageHandle);
+}
+
+// the stages and accesses split up by synchronization2 map back onto the
+// original bit that covers them, the rest share their values
+inline VkPipelineStageFlags
+getPipelineStageFlags(VkPipelineStageFlags2 stageMask) {
+  VkPipelineStageFlags stageFlags = (VkPipelineStageFlags)stageMask;
+
+  if (stageMask &
+      (VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_RESOLVE_BIT |
+       VK_PIPELINE_STAGE_2_BLIT_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT)) {
+    stageFlags |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+  }
+
+  if (stageMask & (VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT |
+                   VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT)) {
+    stageFlags |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+  }
+
+  return stageFlags;
+}
+
+inline VkAccessFlags getAccessFlags(VkAccessFlags2 accessMask) {
+  VkAccessFlags accessFlags = (VkAccessFlags)accessMask;
+
+  if (accessMask & (VK_ACCESS_2_SHADER_SAMPLED_READ_BIT |
+                    VK_ACCESS_2_SHADER_STORAGE_READ_BIT)) {
+    accessFlags |= VK_ACCESS_SHADER_READ_BIT;
+  }
+
+  if (accessMask & VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT) {
+    accessFlags |= VK_ACCESS_SHADER_WRITE_BIT;
+  }
+
+  return accessFlags;
+}
+
+// vkCmdPipelineBarrier takes one pair of stage masks for every barrier, so
+// they are the union of the queued ones. No stages means nothing to wait on
+// or nothing waiting
+inline void flushPipelineBarriersWithoutSynchronization2(
+    PipelineBarrierTracker &tracker, VkCommandBuffer commandBufferHandle) {
+  VkPipelineStageFlags srcStageFlags = 0;
+  VkPipelineStageFlags dstStageFlags = 0;
+
+  std::vector<VkImageMemoryBarrier> imageMemoryBarrierList;
+  for (const VkImageMemoryBarrier2 &imageMemoryBarrier :
+       tracker.imageMemoryBarrierList) {
+    srcStageFlags |= getPipelineStageFlags(imageMemoryBarrier.srcStageMask);
+    dstStageFlags |= getPipelineStageFlags(imageMemoryBarrier.dstStageMask);
+
+    imageMemoryBarrierList.push_back(
+        {.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+         .pNext = NULL,
+         .srcAccessMask = getAccessFlags(imageMemoryBarrier.srcAccessMask),
+         .dstAccessMask = getAccessFlags(imageMemoryBarrier.dstAccessMask),
+         .oldLayout = imageMemoryBarrier.oldLayout,
+         .newLayout = imageMemoryBarrier.newLayout,
+         .srcQueueFamilyIndex = imageMemoryBarrier.srcQueueFamilyIndex,
+         .dstQueueFamilyIndex = imageMemoryBarrier.dstQueueFamilyIndex,
+         .image = imageMemoryBarrier.image,
+         .subresourceRange = imageMemoryBarrier.subresourceRange});
+  }
+
+  std::vector<VkBufferMemoryBarrier> bufferMemoryBarrierList;
+  for (const VkBufferMemoryBarrier2 &bufferMemoryBarrier :
+       tracker.bufferMemoryBarrierList) {
+    srcStageFlags |= getPipelineStageFlags(bufferMemoryBarrier.srcStageMask);
+    dstStageFlags |= getPipelineStageFlags(bufferMemoryBarrier.dstStageMask);
+
+    bufferMemoryBarrierList.push_back(
+        {.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+         .pNext = NULL,
+         .srcAccessMask = getAccessFlags(bufferMemoryBarrier.srcAccessMask),
+         .dstAccessMask = getAccessFlags(bufferMemoryBarrier.dstAccessMask),
+         .srcQueueFamilyIndex = bufferMemoryBarrier.srcQueueFamilyIndex,
+         .dstQueueFamilyIndex = bufferMemoryBarrier.dstQueueFamilyIndex,
+         .buffer = bufferMemoryBarrier.buffer,
+         .offset = bufferMemoryBarrier.offset,
+         .size = bufferMemoryBarrier.size});
+  }
+
+  vkCmdPipelineBarrier(
+      commandBufferHandle,
+      srcStageFlags != 0 ? srcStageFlags : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      dstStageFlags != 0 ? dstStageFlags : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+      0, 0, NULL, (uint32_t)bufferMemoryBarrierList.size(),
+      bufferMemoryBarrierList.data(), (uint32_t)imageMemoryBarrierList.size(),
+      imageMemoryBarrierList.data());
+}
+
+// must be called before the commands that perform the required accesses, a
+// resource should be required at most once between two flushes
+inline void flushPipelineBarriers(PipelineBarrierTracker &tracker,
+                                  VkCommandBuffer commandBufferHandle) {
+  if (tracker.imageMemoryBarrierList.empty() &&
+      tracker.bufferMemoryBarrierList.empty()) {
+    return;
+  }
+
+  if (tracker.isSynchronization2Enabled) {
+    VkDependencyInfo dependencyInfo = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = NULL,
+        .dependencyFlags = 0,
+        .memoryBarrierCount = 0,
+        .pMemoryBarriers = NULL,
+        .bufferMemoryBarrierCount =
+            (uint32_t)tracker.bufferMemoryBarrierList.size(),
+        .pBufferMemoryBarriers = tracker.bufferMemoryBarrierList.data(),
+        .imageMemoryBarrierCount =
+            (uint32_t)tracker.imageMemoryBarrierList.size(),
+        .pImageMemoryBarriers = tracker.imageMemoryBarrierList.data()};
+
+    vkCmdPipelineBarrier2(commandBufferHandle, &dependencyInfo);
+  } else {
+    flushPipelineBarriersWithoutSynchronization2(tracker,
+                                                 commandBufferHandle);
+  }
+
+  tracker.barrierCount += tracker.imageMemoryBarrierList.size() +
+                          tracker.bufferMemoryBarrierList.size();
+  tracker.dependencyInfoCount += 1;
+
+  tracker.imageMemoryBarrierList.clear();
+  tracker.bufferMemoryBarrierList.clear();
+}
+
+// forgets every resource, the counters are kept for the statistics
+inline void resetPipelineBarrierTracker(PipelineBarrierTracker &tracker) {
+  tracker.imageMap.clear();
+  tracker.bufferMap.clear();
+  tracker.imageMemoryBarrierList.clear();
+  tracker.bufferMemoryBarrierList.clear();
+}
@@ -0,0 +1,741 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PIXEL_CONVERSION_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#define PIXEL_CONVERSION_NEON
+#include <arm_neon.h>
+#endif
+
+// Converts tightly packed rgba8 or bgra8 frames, as they come out of the
+// result buffers, to the formats consumers ask for. Every kernel only reads
+// its source once and front to back, so it can run straight on mapped
+// readback memory. The kernels are integer only and every SIMD variant
+// produces exactly the bytes the scalar one does:
+//
+//   gray   BT.601 luma, full range, (77 R + 150 G + 29 B + 128) >> 8
+//   i420   BT.601, limited range, a Y plane and U and V planes at half the
+//          width and height, each chroma sample from the sum of a 2x2 block
+
+enum PixelConversionFormat {
+  PIXEL_CONVERSION_FORMAT_RGBA,
+  PIXEL_CONVERSION_FORMAT_BGRA,
+  PIXEL_CONVERSION_FORMAT_RGB,
+  PIXEL_CONVERSION_FORMAT_GRAY,
+  PIXEL_CONVERSION_FORMAT_I420
+};
+
+enum PixelConversionPath {
+  PIXEL_CONVERSION_PATH_SCALAR,
+  PIXEL_CONVERSION_PATH_SSE41,
+  PIXEL_CONVERSION_PATH_AVX2,
+  PIXEL_CONVERSION_PATH_NEON
+};
+
+inline const char *getPixelConversionFormatName(PixelConversionFormat format) {
+  switch (format) {
+  case PIXEL_CONVERSION_FORMAT_RGBA:
+    return "rgba";
+  case PIXEL_CONVERSION_FORMAT_BGRA:
+    return "bgra";
+  case PIXEL_CONVERSION_FORMAT_RGB:
+    return "rgb";
+  case PIXEL_CONVERSION_FORMAT_GRAY:
+    return "gray";
+  default:
+    return "i420";
+  }
+}
+
+inline const char *getPixelConversionPathName(PixelConversionPath path) {
+  switch (path) {
+  case PIXEL_CONVERSION_PATH_SSE41:
+    return "sse4.1";
+  case PIXEL_CONVERSION_PATH_AVX2:
+    return "avx2";
+  case PIXEL_CONVERSION_PATH_NEON:
+    return "neon";
+  default:
+    return "scalar";
+  }
+}
+
+// every path this CPU can run, scalar first
+inline std::vector<PixelConversionPath> getPixelConversionPathList() {
+  std::vector<PixelConversionPath> pathList = {PIXEL_CONVERSION_PATH_SCALAR};
+
+#if defined(PIXEL_CONVERSION_X86)
+  if (__builtin_cpu_supports("sse4.1")) {
+    pathList.push_back(PIXEL_CONVERSION_PATH_SSE41);
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    pathList.push_back(PIXEL_CONVERSION_PATH_AVX2);
+  }
+#elif defined(PIXEL_CONVERSION_NEON)
+  // advanced simd is part of the aarch64 baseline
+  pathList.push_back(PIXEL_CONVERSION_PATH_NEON);
+#endif
+
+  return pathList;
+}
+
+inline PixelConversionPath getPixelConversionPath() {
+  static const PixelConversionPath path = getPixelConversionPathList().back();
+  return path;
+}
+
+inline size_t getPixelConversionSize(PixelConversionFormat format,
+                                     VkExtent2D extent) {
+  size_t pixelCount = (size_t)extent.width * extent.height;
+
+  switch (format) {
+  case PIXEL_CONVERSION_FORMAT_RGB:
+    return pixelCount * 3;
+  case PIXEL_CONVERSION_FORMAT_GRAY:
+    return pixelCount;
+  case PIXEL_CONVERSION_FORMAT_I420:
+    return pixelCount + (size_t)((extent.width + 1) / 2) *
+                            ((extent.height + 1) / 2) * 2;
+  default:
+    return pixelCount * 4;
+  }
+}
+
+// weights in source byte order, the red and blue weights trade places for a
+// bgra source
+struct PixelConversionWeights {
+  int16_t luma[3];
+  int16_t lumaOffset;
+  int16_t u[3];
+  int16_t v[3];
+};
+
+inline PixelConversionWeights
+getPixelConversionWeights(PixelConversionFormat format, bool isSourceBGRA) {
+  PixelConversionWeights weights =
+      format == PIXEL_CONVERSION_FORMAT_GRAY
+          ? PixelConversionWeights{.luma = {77, 150, 29},
+                                   .lumaOffset = 0,
+                                   .u = {},
+                                   .v = {}}
+          : PixelConversionWeights{.luma = {66, 129, 25},
+                                   .lumaOffset = 16,
+                                   .u = {-38, -74, 112},
+                                   .v = {112, -94, -18}};
+
+  if (isSourceBGRA) {
+    std::swap(weights.luma[0], weights.luma[2]);
+    std::swap(weights.u[0], weights.u[2]);
+    std::swap(weights.v[0], weights.v[2]);
+  }
+
+  return weights;
+}
+
+// =========================================================================
+// Scalar
+
+inline void swapPixelRedBlueScalar(uint8_t *destinationPtr,
+                                   const uint8_t *sourcePtr, size_t count) {
+  for (size_t x = 0; x < count; x++) {
+    destinationPtr[x * 4 + 0] = sourcePtr[x * 4 + 2];
+    destinationPtr[x * 4 + 1] = sourcePtr[x * 4 + 1];
+    destinationPtr[x * 4 + 2] = sourcePtr[x * 4 + 0];
+    destinationPtr[x * 4 + 3] = sourcePtr[x * 4 + 3];
+  }
+}
+
+inline void packPixelRGBScalar(uint8_t *destinationPtr,
+                               const uint8_t *sourcePtr, size_t count,
+                               bool isSourceBGRA) {
+  uint32_t redIndex = isSourceBGRA ? 2 : 0;
+  uint32_t blueIndex = isSourceBGRA ? 0 : 2;
+
+  for (size_t x = 0; x < count; x++) {
+    destinationPtr[x * 3 + 0] = sourcePtr[x * 4 + redIndex];
+    destinationPtr[x * 3 + 1] = sourcePtr[x * 4 + 1];
+    destinationPtr[x * 3 + 2] = sourcePtr[x * 4 + blueIndex];
+  }
+}
+
+inline void convertPixelLumaScalar(uint8_t *destinationPtr,
+                                   const uint8_t *sourcePtr, size_t count,
+                                   const PixelConversionWeights &weights) {
+  for (size_t x = 0; x < count; x++) {
+    const uint8_t *pixelPtr = sourcePtr + x * 4;
+
+    destinationPtr[x] =
+        (uint8_t)(((weights.luma[0] * pixelPtr[0] +
+                    weights.luma[1] * pixelPtr[1] +
+                    weights.luma[2] * pixelPtr[2] + 128) >>
+                   8) +
+                  weights.lumaOffset);
+  }
+}
+
+// one chroma sample from the channel sums of a 2x2 block
+inline void convertPixelChromaSample(uint8_t *uPtr, uint8_t *vPtr,
+                                     const int32_t *sumList,
+                                     const PixelConversionWeights &weights) {
+  *uPtr = (uint8_t)(((weights.u[0] * sumList[0] + weights.u[1] * sumList[1] +
+                      weights.u[2] * sumList[2] + 512) >>
+                     10) +
+                    128);
+  *vPtr = (uint8_t)(((weights.v[0] * sumList[0] + weights.v[1] * sumList[1] +
+                      weights.v[2] * sumList[2] + 512) >>
+                     10) +
+                    128);
+}
+
+// count chroma samples from two full source rows, two pixels per sample
+inline void convertPixelChromaScalar(uint8_t *uPtr, uint8_t *vPtr,
+                                     const uint8_t *row0Ptr,
+                                     const uint8_t *row1Ptr, size_t count,
+                                     const PixelConversionWeights &weights) {
+  for (size_t x = 0; x < count; x++) {
+    int32_t sumList[3];
+    for (uint32_t y = 0; y < 3; y++) {
+      sumList[y] = row0Ptr[x * 8 + y] + row0Ptr[x * 8 + 4 + y] +
+                   row1Ptr[x * 8 + y] + row1Ptr[x * 8 + 4 + y];
+    }
+
+    convertPixelChromaSample(uPtr + x, vPtr + x, sumList, weights);
+  }
+}
+
+// =========================================================================
+// SSE4.1, AVX2
+
+#if defined(PIXEL_CONVERSION_X86)
+__attribute__((target("sse4.1"))) inline size_t
+swapPixelRedBlueSSE41(uint8_t *destinationPtr, const uint8_t *sourcePtr,
+                      size_t count) {
+  const __m128i shuffle =
+      _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+  size_t x = 0;
+  for (; x + 4 <= count; x += 4) {
+    __m128i pixels = _mm_loadu_si128((const __m128i *)(sourcePtr + x * 4));
+    _mm_storeu_si128((__m128i *)(destinationPtr + x * 4),
+                     _mm_shuffle_epi8(pixels, shuffle));
+  }
+
+  return x;
+}
+
+__attribute__((target("sse4.1"))) inline size_t
+packPixelRGBSSE41(uint8_t *destinationPtr, const uint8_t *sourcePtr,
+                  size_t count, bool isSourceBGRA) {
+  // 12 rgb bytes at the bottom of each register, zeros above
+  const __m128i shuffle =
+      isSourceBGRA ? _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1,
+                                   -1, -1, -1)
+                   : _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1,
+                                   -1, -1, -1);
+
+  size_t x = 0;
+  for (; x + 16 <= count; x += 16) {
+    const __m128i *pixelPtr = (const __m128i *)(sourcePtr + x * 4);
+
+    __m128i rgb0 = _mm_shuffle_epi8(_mm_loadu_si128(pixelPtr + 0), shuffle);
+    __m128i rgb1 = _mm_shuffle_epi8(_mm_loadu_si128(pixelPtr + 1), shuffle);
+    __m128i rgb2 = _mm_shuffle_epi8(_mm_loadu_si128(pixelPtr + 2), shuffle);
+    __m128i rgb3 = _mm_shuffle_epi8(_mm_loadu_si128(pixelPtr + 3), shuffle);
+
+    __m128i *outputPtr = (__m128i *)(destinationPtr + x * 3);
+
+    _mm_storeu_si128(outputPtr + 0,
+                     _mm_or_si128(rgb0, _mm_slli_si128(rgb1, 12)));
+    _mm_storeu_si128(outputPtr + 1, _mm_or_si128(_mm_srli_si128(rgb1, 4),
+                                                 _mm_slli_si128(rgb2, 8)));
+    _mm_storeu_si128(outputPtr + 2, _mm_or_si128(_mm_srli_si128(rgb2, 8),
+                                                 _mm_slli_si128(rgb3, 4)));
+  }
+
+  return x;
+}
+
+// weighted sums of four pixels as 32 bit integers
+__attribute__((target("sse4.1"))) inline __m128i
+getPixelWeightedSumSSE41(const uint8_t *sourcePtr, __m128i weights) {
+  __m128i pixels01 = _mm_cvtepu8_epi16(
+      _mm_loadl_epi64((const __m128i *)(sourcePtr + 0)));
+  __m128i pixels23 = _mm_cvtepu8_epi16(
+      _mm_loadl_epi64((const __m128i *)(sourcePtr + 8)));
+
+  return _mm_hadd_epi32(_mm_madd_epi16(pixels01, weights),
+                        _mm_madd_epi16(pixels23, weights));
+}
+
+__attribute__((target("sse4.1"))) inline __m128i
+getPixelLumaSSE41(const uint8_t *sourcePtr, __m128i weights, __m128i offset) {
+  __m128i sum = getPixelWeightedSumSSE41(sourcePtr, weights);
+  return _mm_add_epi32(
+      _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(128)), 8), offset);
+}
+
+__attribute__((target("sse4.1"))) inline size_t
+convertPixelLumaSSE41(uint8_t *destinationPtr, const uint8_t *sourcePtr,
+                      size_t count, const PixelConversionWeights &weights) {
+  const __m128i lumaWeights =
+      _mm_setr_epi16(weights.luma[0], weights.luma[1], weights.luma[2], 0,
+                     weights.luma[0], weights.luma[1], weights.luma[2], 0);
+  const __m128i offset = _mm_set1_epi32(weights.lumaOffset);
+
+  size_t x = 0;
+  for (; x + 16 <= count; x += 16) {
+    const uint8_t *pixelPtr = sourcePtr + x * 4;
+
+    __m128i luma0 =
+        _mm_packs_epi32(getPixelLumaSSE41(pixelPtr, lumaWeights, offset),
+                        getPixelLumaSSE41(pixelPtr + 16, lumaWeights, offset));
+    __m128i luma1 =
+        _mm_packs_epi32(getPixelLumaSSE41(pixelPtr + 32, lumaWeights, offset),
+                        getPixelLumaSSE41(pixelPtr + 48, lumaWeights, offset));
+
+    _mm_storeu_si128((__m128i *)(destinationPtr + x),
+                     _mm_packus_epi16(luma0, luma1));
+  }
+
+  return x;
+}
+
+// channel sums of the 2x2 blocks under the low eight bytes of two rows, in
+// the low four words
+__attribute__((target("sse4.1"))) inline __m128i
+getPixelBlockSumSSE41(__m128i row0, __m128i row1) {
+  __m128i sum =
+      _mm_add_epi16(_mm_cvtepu8_epi16(row0), _mm_cvtepu8_epi16(row1));
+  return _mm_add_epi16(sum, _mm_srli_si128(sum, 8));
+}
+
+// four chroma samples from the block sums of two registers
+__attribute__((target("sse4.1"))) inline __m128i
+getPixelChromaSSE41(__m128i sum01, __m128i sum23, __m128i weights) {
+  __m128i chroma = _mm_hadd_epi32(_mm_madd_epi16(sum01, weights),
+                                  _mm_madd_epi16(sum23, weights));
+  return _mm_add_epi32(
+      _mm_srai_epi32(_mm_add_epi32(chroma, _mm_set1_epi32(512)), 10),
+      _mm_set1_epi32(128));
+}
+
+__attribute__((target("sse4.1"))) inline size_t
+convertPixelChromaSSE41(uint8_t *uPtr, uint8_t *vPtr, const uint8_t *row0Ptr,
+                        const uint8_t *row1Ptr, size_t count,
+                        const PixelConversionWeights &weights) {
+  const __m128i uWeights =
+      _mm_setr_epi16(weights.u[0], weights.u[1], weights.u[2], 0,
+                     weights.u[0], weights.u[1], weights.u[2], 0);
+  const __m128i vWeights =
+      _mm_setr_epi16(weights.v[0], weights.v[1], weights.v[2], 0,
+                     weights.v[0], weights.v[1], weights.v[2], 0);
+
+  size_t x = 0;
+  for (; x + 4 <= count; x += 4) {
+    __m128i row0a = _mm_loadu_si128((const __m128i *)(row0Ptr + x * 8));
+    __m128i row0b = _mm_loadu_si128((const __m128i *)(row0Ptr + x * 8 + 16));
+    __m128i row1a = _mm_loadu_si128((const __m128i *)(row1Ptr + x * 8));
+    __m128i row1b = _mm_loadu_si128((const __m128i *)(row1Ptr + x * 8 + 16));
+
+    __m128i sum01 = _mm_unpacklo_epi64(
+        getPixelBlockSumSSE41(row0a, row1a),
+        getPixelBlockSumSSE41(_mm_srli_si128(row0a, 8),
+                              _mm_srli_si128(row1a, 8)));
+    __m128i sum23 = _mm_unpacklo_epi64(
+        getPixelBlockSumSSE41(row0b, row1b),
+        getPixelBlockSumSSE41(_mm_srli_si128(row0b, 8),
+                              _mm_srli_si128(row1b, 8)));
+
+    // four u bytes, then four v bytes
+    __m128i chroma = _mm_packus_epi16(
+        _mm_packs_epi32(getPixelChromaSSE41(sum01, sum23, uWeights),
+                        getPixelChromaSSE41(sum01, sum23, vWeights)),
+        _mm_setzero_si128());
+
+    uint32_t u = (uint32_t)_mm_cvtsi128_si32(chroma);
+    uint32_t v = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(chroma, 4));
+
+    memcpy(uPtr + x, &u, 4);
+    memcpy(vPtr + x, &v, 4);
+  }
+
+  return x;
+}
+
+__attribute__((target("avx2"))) inline size_t
+swapPixelRedBlueAVX2(uint8_t *destinationPtr, const uint8_t *sourcePtr,
+                     size_t count) {
+  const __m256i shuffle = _mm256_setr_epi8(
+      2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15, 2, 1, 0, 3, 6, 5,
+      4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+  size_t x = 0;
+  for (; x + 8 <= count; x += 8) {
+    __m256i pixels =
+        _mm256_loadu_si256((const __m256i *)(sourcePtr + x * 4));
+    _mm256_storeu_si256((__m256i *)(destinationPtr + x * 4),
+                        _mm256_shuffle_epi8(pixels, shuffle));
+  }
+
+  return x;
+}
+
+__attribute__((target("avx2"))) inline size_t
+packPixelRGBAVX2(uint8_t *destinationPtr, const uint8_t *sourcePtr,
+                 size_t count, bool isSourceBGRA) {
+  const __m256i shuffle =
+      isSourceBGRA
+          ? _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1,
+                             -1, -1, 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+                             -1, -1, -1, -1)
+          : _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1,
+                             -1, -1, 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14,
+                             -1, -1, -1, -1);
+
+  // the two lanes' 12 bytes next to each other
+  const __m256i permutation = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+
+  size_t x = 0;
+  for (; x + 8 <= count; x += 8) {
+    __m256i pixels =
+        _mm256_loadu_si256((const __m256i *)(sourcePtr + x * 4));
+    __m256i rgb = _mm256_permutevar8x32_epi32(
+        _mm256_shuffle_epi8(pixels, shuffle), permutation);
+
+    _mm_storeu_si128((__m128i *)(destinationPtr + x * 3),
+                     _mm256_castsi256_si128(rgb));
+    _mm_storel_epi64((__m128i *)(destinationPtr + x * 3 + 16),
+                     _mm256_extracti128_si256(rgb, 1));
+  }
+
+  return x;
+}
+
+__attribute__((target("avx2"))) inline __m256i
+getPixelWeightedSumAVX2(const uint8_t *sourcePtr, __m256i weights) {
+  return _mm256_madd_epi16(
+      _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)sourcePtr)),
+      weights);
+}
+
+// hadd works inside each lane, eight pixels come out as 0 1 4 5 in the low
+// lane and 2 3 6 7 in the high one
+__attribute__((target("avx2"))) inline __m256i
+getPixelLumaAVX2(const uint8_t *sourcePtr, __m256i weights, __m256i offset) {
+  __m256i sum = _mm256_hadd_epi32(getPixelWeightedSumAVX2(sourcePtr, weights),
+                                  getPixelWeightedSumAVX2(sourcePtr + 16,
+                                                          weights));
+  return _mm256_add_epi32(
+      _mm256_srai_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(128)), 8),
+      offset);
+}
+
+__attribute__((target("avx2"))) inline size_t
+convertPixelLumaAVX2(uint8_t *destinationPtr, const uint8_t *sourcePtr,
+                     size_t count, const PixelConversionWeights &weights) {
+  const __m256i lumaWeights = _mm256_setr_epi16(
+      weights.luma[0], weights.luma[1], weights.luma[2], 0, weights.luma[0],
+      weights.luma[1], weights.luma[2], 0, weights.luma[0], weights.luma[1],
+      weights.luma[2], 0, weights.luma[0], weights.luma[1], weights.luma[2],
+      0);
+  const __m256i offset = _mm256_set1_epi32(weights.lumaOffset);
+
+  // after packing, the bytes are pixels 0 1 4 5 8 9 12 13 followed by
+  // 2 3 6 7 10 11 14 15
+  const __m128i order =
+      _mm_setr_epi8(0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15);
+
+  size_t x = 0;
+  for (; x + 16 <= count; x += 16) {
+    const uint8_t *pixelPtr = sourcePtr + x * 4;
+
+    __m256i luma = _mm256_packs_epi32(
+        getPixelLumaAVX2(pixelPtr, lumaWeights, offset),
+        getPixelLumaAVX2(pixelPtr + 32, lumaWeights, offset));
+    luma = _mm256_permute4x64_epi64(_mm256_packus_epi16(luma, luma),
+                                    _MM_SHUFFLE(3, 1, 2, 0));
+
+    _mm_storeu_si128(
+        (__m128i *)(destinationPtr + x),
+        _mm_shuffle_epi8(_mm256_castsi256_si128(luma), order));
+  }
+
+  return x;
+}
+#endif
+
+// =========================================================================
+// NEON
+
+#if defined(PIXEL_CONVERSION_NEON)
+inline size_t swapPixelRedBlueNEON(uint8_t *destinationPtr,
+                                   const uint8_t *sourcePtr, size_t count) {
+  size_t x = 0;
+  for (; x + 16 <= count; x += 16) {
+    uint8x16x4_t pixels = vld4q_u8(sourcePtr + x * 4);
+
+    uint8x16_t red = pixels.val[0];
+    pixels.val[0] = pixels.val[2];
+    pixels.val[2] = red;
+
+    vst4q_u8(destinationPtr + x * 4, pixels);
+  }
+
+  return x;
+}
+
+inline size_t packPixelRGBNEON(uint8_t *destinationPtr,
+                               const uint8_t *sourcePtr, size_t count,
+                               bool isSourceBGRA) {
+  size_t x = 0;
+  for (; x + 16 <= count; x += 16) {
+    uint8x16x4_t pixels = vld4q_u8(sourcePtr + x * 4);
+
+    uint8x16x3_t rgb = {
+        {pixels.val[isSourceBGRA ? 2 : 0], pixels.val[1],
+         pixels.val[isSourceBGRA ? 0 : 2]}};
+
+    vst3q_u8(destinationPtr + x * 3, rgb);
+  }
+
+  return x;
+}
+
+inline size_t convertPixelLumaNEON(uint8_t *destinationPtr,
+                                   const uint8_t *sourcePtr, size_t count,
+                                   const PixelConversionWeights &weights) {
+  // luma weights are all positive and below 256
+  uint8x8_t weight0 = vdup_n_u8((uint8_t)weights.luma[0]);
+  uint8x8_t weight1 = vdup_n_u8((uint8_t)weights.luma[1]);
+  uint8x8_t weight2 = vdup_n_u8((uint8_t)weights.luma[2]);
+  uint8x16_t offset = vdupq_n_u8((uint8_t)weights.lumaOffset);
+
+  size_t x = 0;
+  for (; x + 16 <= count; x += 16) {
+    uint8x16x4_t pixels = vld4q_u8(sourcePtr + x * 4);
+
+    uint16x8_t low = vmull_u8(vget_low_u8(pixels.val[0]), weight0);
+    low = vmlal_u8(low, vget_low_u8(pixels.val[1]), weight1);
+    low = vmlal_u8(low, vget_low_u8(pixels.val[2]), weight2);
+
+    uint16x8_t high = vmull_u8(vget_high_u8(pixels.val[0]), weight0);
+    high = vmlal_u8(high, vget_high_u8(pixels.val[1]), weight1);
+    high = vmlal_u8(high, vget_high_u8(pixels.val[2]), weight2);
+
+    uint8x16_t luma =
+        vcombine_u8(vrshrn_n_u16(low, 8), vrshrn_n_u16(high, 8));
+
+    vst1q_u8(destinationPtr + x, vaddq_u8(luma, offset));
+  }
+
+  return x;
+}
+
+inline size_t convertPixelChromaNEON(uint8_t *uPtr, uint8_t *vPtr,
+                                     const uint8_t *row0Ptr,
+                                     const uint8_t *row1Ptr, size_t count,
+                                     const PixelConversionWeights &weights) {
+  auto getChroma = [](const int16x8_t *sumList, const int16_t *weightList) {
+    int32x4_t low = vmull_n_s16(vget_low_s16(sumList[0]), weightList[0]);
+    low = vmlal_n_s16(low, vget_low_s16(sumList[1]), weightList[1]);
+    low = vmlal_n_s16(low, vget_low_s16(sumList[2]), weightList[2]);
+
+    int32x4_t high = vmull_n_s16(vget_high_s16(sumList[0]), weightList[0]);
+    high = vmlal_n_s16(high, vget_high_s16(sumList[1]), weightList[1]);
+    high = vmlal_n_s16(high, vget_high_s16(sumList[2]), weightList[2]);
+
+    int16x8_t chroma = vcombine_s16(vmovn_s32(vrshrq_n_s32(low, 10)),
+                                    vmovn_s32(vrshrq_n_s32(high, 10)));
+
+    return vqmovun_s16(vaddq_s16(chroma, vdupq_n_s16(128)));
+  };
+
+  size_t x = 0;
+  for (; x + 8 <= count; x += 8) {
+    uint8x16x4_t row0 = vld4q_u8(row0Ptr + x * 8);
+    uint8x16x4_t row1 = vld4q_u8(row1Ptr + x * 8);
+
+    int16x8_t sumList[3];
+    for (uint32_t y = 0; y < 3; y++) {
+      sumList[y] = vreinterpretq_s16_u16(
+          vpadalq_u8(vpaddlq_u8(row0.val[y]), row1.val[y]));
+    }
+
+    vst1_u8(uPtr + x, getChroma(sumList, weights.u));
+    vst1_u8(vPtr + x, getChroma(sumList, weights.v));
+  }
+
+  return x;
+}
+#endif
+
+// =========================================================================
+// Dispatch
+
+// each returns how many pixels (chroma samples) it converted, the scalar
+// kernels finish the rest
+
+inline void swapPixelRedBlue(uint8_t *destinationPtr, const uint8_t *sourcePtr,
+                             size_t count, PixelConversionPath path) {
+  size_t x = 0;
+
+#if defined(PIXEL_CONVERSION_X86)
+  if (path == PIXEL_CONVERSION_PATH_AVX2) {
+    x = swapPixelRedBlueAVX2(destinationPtr, sourcePtr, count);
+  } else if (path == PIXEL_CONVERSION_PATH_SSE41) {
+    x = swapPixelRedBlueSSE41(destinationPtr, sourcePtr, count);
+  }
+#elif defined(PIXEL_CONVERSION_NEON)
+  if (path == PIXEL_CONVERSION_PATH_NEON) {
+    x = swapPixelRedBlueNEON(destinationPtr, sourcePtr, count);
+  }
+#endif
+
+  swapPixelRedBlueScalar(destinationPtr + x * 4, sourcePtr + x * 4,
+                         count - x);
+}
+
+inline void packPixelRGB(uint8_t *destinationPtr, const uint8_t *sourcePtr,
+                         size_t count, bool isSourceBGRA,
+                         PixelConversionPath path) {
+  size_t x = 0;
+
+#if defined(PIXEL_CONVERSION_X86)
+  if (path == PIXEL_CONVERSION_PATH_AVX2) {
+    x = packPixelRGBAVX2(destinationPtr, sourcePtr, count, isSourceBGRA);
+  } else if (path == PIXEL_CONVERSION_PATH_SSE41) {
+    x = packPixelRGBSSE41(destinationPtr, sourcePtr, count, isSourceBGRA);
+  }
+#elif defined(PIXEL_CONVERSION_NEON)
+  if (path == PIXEL_CONVERSION_PATH_NEON) {
+    x = packPixelRGBNEON(destinationPtr, sourcePtr, count, isSourceBGRA);
+  }
+#endif
+
+  packPixelRGBScalar(destinationPtr + x * 3, sourcePtr + x * 4, count - x,
+                     isSourceBGRA);
+}
+
+inline void convertPixelLuma(uint8_t *destinationPtr, const uint8_t *sourcePtr,
+                             size_t count,
+                             const PixelConversionWeights &weights,
+                             PixelConversionPath path) {
+  size_t x = 0;
+
+#if defined(PIXEL_CONVERSION_X86)
+  if (path == PIXEL_CONVERSION_PATH_AVX2) {
+    x = convertPixelLumaAVX2(destinationPtr, sourcePtr, count, weights);
+  } else if (path == PIXEL_CONVERSION_PATH_SSE41) {
+    x = convertPixelLumaSSE41(destinationPtr, sourcePtr, count, weights);
+  }
+#elif defined(PIXEL_CONVERSION_NEON)
+  if (path == PIXEL_CONVERSION_PATH_NEON) {
+    x = convertPixelLumaNEON(destinationPtr, sourcePtr, count, weights);
+  }
+#endif
+
+  convertPixelLumaScalar(destinationPtr + x, sourcePtr + x * 4, count - x,
+                         weights);
+}
+
+// the chroma kernel is 128 bits wide on x86, two rows feeding a handful of
+// samples per iteration leave nothing for a wider one to win
+inline void convertPixelChroma(uint8_t *uPtr, uint8_t *vPtr,
+                               const uint8_t *row0Ptr, const uint8_t *row1Ptr,
+                               size_t count,
+                               const PixelConversionWeights &weights,
+                               PixelConversionPath path) {
+  size_t x = 0;
+
+#if defined(PIXEL_CONVERSION_X86)
+  if (path == PIXEL_CONVERSION_PATH_AVX2 ||
+      path == PIXEL_CONVERSION_PATH_SSE41) {
+    x = convertPixelChromaSSE41(uPtr, vPtr, row0Ptr, row1Ptr, count, weights);
+  }
+#elif defined(PIXEL_CONVERSION_NEON)
+  if (path == PIXEL_CONVERSION_PATH_NEON) {
+    x = convertPixelChromaNEON(uPtr, vPtr, row0Ptr, row1Ptr, count, weights);
+  }
+#endif
+
+  convertPixelChromaScalar(uPtr + x, vPtr + x, row0Ptr + x * 8,
+                           row1Ptr + x * 8, count - x, weights);
+}
+
+// destination holds getPixelConversionSize bytes, i420 planes are tightly
+// packed one after another
+inline void convertPixels(uint8_t *destinationPtr, const uint8_t *sourcePtr,
+                          VkExtent2D extent, bool isSourceBGRA,
+                          PixelConversionFormat format,
+                          PixelConversionPath path = getPixelConversionPath()) {
+  size_t pixelCount = (size_t)extent.width * extent.height;
+
+  if ((format == PIXEL_CONVERSION_FORMAT_RGBA && !isSourceBGRA) ||
+      (format == PIXEL_CONVERSION_FORMAT_BGRA && isSourceBGRA)) {
+    memcpy(destinationPtr, sourcePtr, pixelCount * 4);
+    return;
+  }
+
+  if (format == PIXEL_CONVERSION_FORMAT_RGBA ||
+      format == PIXEL_CONVERSION_FORMAT_BGRA) {
+    swapPixelRedBlue(destinationPtr, sourcePtr, pixelCount, path);
+    return;
+  }
+
+  if (format == PIXEL_CONVERSION_FORMAT_RGB) {
+    packPixelRGB(destinationPtr, sourcePtr, pixelCount, isSourceBGRA, path);
+    return;
+  }
+
+  PixelConversionWeights weights =
+      getPixelConversionWeights(format, isSourceBGRA);
+
+  convertPixelLuma(destinationPtr, sourcePtr, pixelCount, weights, path);
+
+  if (format != PIXEL_CONVERSION_FORMAT_I420) {
+    return;
+  }
+
+  uint32_t chromaWidth = (extent.width + 1) / 2;
+  uint32_t chromaHeight = (extent.height + 1) / 2;
+
+  uint8_t *uPlanePtr = destinationPtr + pixelCount;
+  uint8_t *vPlanePtr = uPlanePtr + (size_t)chromaWidth * chromaHeight;
+
+  size_t rowSize = (size_t)extent.width * 4;
+
+  for (uint32_t y = 0; y < chromaHeight; y++) {
+    // an odd last row and column pair up with themselves
+    const uint8_t *row0Ptr = sourcePtr + (size_t)y * 2 * rowSize;
+    const uint8_t *row1Ptr =
+        y * 2 + 1 < extent.height ? row0Ptr + rowSize : row0Ptr;
+
+    uint8_t *uPtr = uPlanePtr + (size_t)y * chromaWidth;
+    uint8_t *vPtr = vPlanePtr + (size_t)y * chromaWidth;
+
+    convertPixelChroma(uPtr, vPtr, row0Ptr, row1Ptr, extent.width / 2,
+                       weights, path);
+
+    if (extent.width % 2 == 1) {
+      const uint8_t *pixel0Ptr = row0Ptr + rowSize - 4;
+      const uint8_t *pixel1Ptr = row1Ptr + rowSize - 4;
+
+      int32_t sumList[3];
+      for (uint32_t x = 0; x < 3; x++) {
+        sumList[x] = (pixel0Ptr[x] + pixel1Ptr[x]) * 2;
+      }
+
+      convertPixelChromaSample(uPtr + chromaWidth - 1, vPtr + chromaWidth - 1,
+                               sumList, weights);
+    }
+  }
+}
@@ -0,0 +1,135 @@
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <random>
+
+#include "pixel_conversion.h"
+
+// Checks every SIMD path this CPU can run against the scalar kernels, for
+// every format and both source orders. The widths cover frames narrower
+// than one vector, odd and even widths and tails after whole vectors. The
+// heights cover the odd last chroma row. The scalar kernels themselves are
+// checked against the formulas at the top of pixel_conversion.h for a few
+// known pixels.
+
+// bytes written past the end of the destination show up as changed guard
+// bytes
+const size_t guardSize = 64;
+const uint8_t guardValue = 0xa5;
+
+bool checkScalarReference() {
+  // rgba: white, black, pure red, pure green, pure blue and a gray
+  const uint8_t sourceList[] = {255, 255, 255, 255, 0,   0,   0,   255,
+                                255, 0,   0,   255, 0,   255, 0,   255,
+                                0,   0,   255, 255, 128, 128, 128, 255};
+  const uint8_t expectedGrayList[] = {255, 0, 77, 149, 29, 128};
+
+  uint8_t grayList[6];
+  convertPixels(grayList, sourceList, {.width = 6, .height = 1}, false,
+                PIXEL_CONVERSION_FORMAT_GRAY, PIXEL_CONVERSION_PATH_SCALAR);
+
+  bool isMatching = memcmp(grayList, expectedGrayList, 6) == 0;
+
+  // full range white lands on the limited range top of the y plane, and
+  // gray has no chroma
+  uint8_t i420List[4 + 1 + 1];
+  const uint8_t whiteList[16] = {255, 255, 255, 255, 255, 255, 255, 255,
+                                 255, 255, 255, 255, 255, 255, 255, 255};
+  convertPixels(i420List, whiteList, {.width = 2, .height = 2}, false,
+                PIXEL_CONVERSION_FORMAT_I420, PIXEL_CONVERSION_PATH_SCALAR);
+
+  isMatching = isMatching && i420List[0] == 235 && i420List[3] == 235 &&
+               i420List[4] == 128 && i420List[5] == 128;
+
+  std::cout << "scalar reference: " << (isMatching ? "ok" : "MISMATCH")
+            << std::endl;
+
+  return isMatching;
+}
+
+bool checkPath(PixelConversionPath path, std::mt19937 &generator) {
+  const PixelConversionFormat formatList[] = {
+      PIXEL_CONVERSION_FORMAT_RGBA, PIXEL_CONVERSION_FORMAT_BGRA,
+      PIXEL_CONVERSION_FORMAT_RGB, PIXEL_CONVERSION_FORMAT_GRAY,
+      PIXEL_CONVERSION_FORMAT_I420};
+
+  std::vector<uint32_t> widthList;
+  for (uint32_t width = 1; width <= 70; width++) {
+    widthList.push_back(width);
+  }
+  widthList.insert(widthList.end(), {127, 128, 129, 255, 256, 257, 1001});
+
+  const uint32_t heightList[] = {1, 2, 3, 4};
+
+  bool isPathMatching = true;
+
+  for (PixelConversionFormat format : formatList) {
+    for (bool isSourceBGRA : {false, true}) {
+      uint32_t mismatchCount = 0;
+      uint32_t caseCount = 0;
+
+      for (uint32_t width : widthList) {
+        for (uint32_t height : heightList) {
+          VkExtent2D extent = {.width = width, .height = height};
+
+          std::vector<uint8_t> sourceList((size_t)width * height * 4);
+          for (uint8_t &value : sourceList) {
+            value = (uint8_t)generator();
+          }
+
+          size_t size = getPixelConversionSize(format, extent);
+          std::vector<uint8_t> expectedList(size + guardSize, guardValue);
+          std::vector<uint8_t> resultList(size + guardSize, guardValue);
+
+          convertPixels(expectedList.data(), sourceList.data(), extent,
+                        isSourceBGRA, format, PIXEL_CONVERSION_PATH_SCALAR);
+          convertPixels(resultList.data(), sourceList.data(), extent,
+                        isSourceBGRA, format, path);
+
+          caseCount += 1;
+
+          if (resultList != expectedList) {
+            if (mismatchCount == 0) {
+              std::cout << "  first mismatch at " << width << "x" << height
+                        << std::endl;
+            }
+            mismatchCount += 1;
+          }
+        }
+      }
+
+      std::cout << getPixelConversionPathName(path) << " "
+                << getPixelConversionFormatName(format) << " from "
+                << (isSourceBGRA ? "bgra" : "rgba") << ": "
+                << (mismatchCount == 0 ? "ok" : "MISMATCH") << " ("
+                << caseCount - mismatchCount << "/" << caseCount << ")"
+                << std::endl;
+
+      isPathMatching = isPathMatching && mismatchCount == 0;
+    }
+  }
+
+  return isPathMatching;
+}
+
+int main() {
+  std::mt19937 generator(1);
+
+  bool isMatching = checkScalarReference();
+
+  std::vector<PixelConversionPath> pathList = getPixelConversionPathList();
+  for (PixelConversionPath path :
+       {PIXEL_CONVERSION_PATH_SSE41, PIXEL_CONVERSION_PATH_AVX2,
+        PIXEL_CONVERSION_PATH_NEON}) {
+    if (std::find(pathList.begin(), pathList.end(), path) == pathList.end()) {
+      std::cout << getPixelConversionPathName(path)
+                << ": not supported, skipped" << std::endl;
+      continue;
+    }
+
+    isMatching = checkPath(path, generator) && isMatching;
+  }
+
+  return isMatching ? 0 : 1;
+}
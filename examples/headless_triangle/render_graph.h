@@ -0,0 +1,560 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "device_memory_arena.h"
+#include "pipeline_barrier_tracker.h"
+
+// A frame described as passes that declare which images and buffers they read
+// and write. Compiling the graph orders the passes so every reader runs after
+// the write it reads and before the next write of the same resource. It culls
+// passes whose results never reach an imported resource, and creates the
+// transient images. Transient images whose
+// lifetimes (first to last executing pass) do not overlap share memory. At
+// execution every pass's accesses go through the pipeline barrier tracker
+// before it records, which also orders an aliased image after the previous
+// user of its memory.
+
+struct RenderGraphAccess {
+  uint32_t resourceIndex;
+  VkPipelineStageFlags2 stageMask;
+  VkAccessFlags2 accessMask;
+
+  // ignored for buffers
+  VkImageLayout layout;
+};
+
+struct RenderGraphPass {
+  std::string name;
+  std::vector<RenderGraphAccess> accessList;
+  std::function<void(VkCommandBuffer)> recordFunction;
+
+  // filled in by compileRenderGraph, the producers are the dependencies that
+  // wrote what the pass accesses, culling only follows those
+  std::vector<uint32_t> dependencyPassIndexList;
+  std::vector<uint32_t> producerPassIndexList;
+  bool isCulled = false;
+};
+
+struct RenderGraphResource {
+  std::string name;
+  bool isImage = true;
+  bool isTransient = false;
+
+  VkImage imageHandle = VK_NULL_HANDLE;
+  VkImageView imageViewHandle = VK_NULL_HANDLE;
+  VkBuffer bufferHandle = VK_NULL_HANDLE;
+  VkImageSubresourceRange subresourceRange = {};
+
+  // transient images only
+  VkImageCreateInfo imageCreateInfo = {};
+  VkMemoryRequirements memoryRequirements = {};
+  VkDeviceSize memoryOffset = 0;
+
+  // state before the first pass, imported resources only
+  ResourceAccessState initialAccessState = {};
+
+  // positions in the execution order, -1 when no executing pass uses it
+  uint32_t firstPassOrder = -1;
+  uint32_t lastPassOrder = -1;
+
+  // transient images that used the same memory earlier in the frame
+  std::vector<uint32_t> aliasedResourceIndexList;
+};
+
+struct RenderGraph {
+  VkDevice deviceHandle = VK_NULL_HANDLE;
+
+  std::vector<RenderGraphResource> resourceList;
+  std::vector<RenderGraphPass> passList;
+
+  // indices into passList in execution order, culled passes left out
+  std::vector<uint32_t> passOrderList;
+
+  DeviceMemoryAllocation transientAllocation;
+  VkDeviceSize aliasedMemorySize = 0;
+  VkDeviceSize unaliasedMemorySize = 0;
+};
+
+inline uint32_t addRenderGraphImage(RenderGraph &graph, const std::string &name,
+                                    const VkImageCreateInfo &imageCreateInfo,
+                                    VkImageAspectFlags aspectMask) {
+  RenderGraphResource resource;
+  resource.name = name;
+  resource.isTransient = true;
+  resource.imageCreateInfo = imageCreateInfo;
+  resource.subresourceRange = {.aspectMask = aspectMask,
+                               .baseMipLevel = 0,
+                               .levelCount = imageCreateInfo.mipLevels,
+                               .baseArrayLayer = 0,
+                               .layerCount = imageCreateInfo.arrayLayers};
+
+  graph.resourceList.push_back(resource);
+  return (uint32_t)graph.resourceList.size() - 1;
+}
+
+inline uint32_t
+importRenderGraphImage(RenderGraph &graph, const std::string &name,
+                       VkImage imageHandle, VkImageView imageViewHandle,
+                       const VkImageSubresourceRange &subresourceRange,
+                       const ResourceAccessState &initialAccessState = {}) {
+  RenderGraphResource resource;
+  resource.name = name;
+  resource.imageHandle = imageHandle;
+  resource.imageViewHandle = imageViewHandle;
+  resource.subresourceRange = subresourceRange;
+  resource.initialAccessState = initialAccessState;
+
+  graph.resourceList.push_back(resource);
+  return (uint32_t)graph.resourceList.size() - 1;
+}
+
+inline uint32_t
+importRenderGraphBuffer(RenderGraph &graph, const std::string &name,
+                        VkBuffer bufferHandle,
+                        const ResourceAccessState &initialAccessState = {}) {
+  RenderGraphResource resource;
+  resource.name = name;
+  resource.isImage = false;
+  resource.bufferHandle = bufferHandle;
+  resource.initialAccessState = initialAccessState;
+
+  graph.resourceList.push_back(resource);
+  return (uint32_t)graph.resourceList.size() - 1;
+}
+
+inline void
+addRenderGraphPass(RenderGraph &graph, const std::string &name,
+                   const std::vector<RenderGraphAccess> &accessList,
+                   const std::function<void(VkCommandBuffer)> &recordFunction) {
+  RenderGraphPass pass;
+  pass.name = name;
+  pass.accessList = accessList;
+  pass.recordFunction = recordFunction;
+
+  graph.passList.push_back(pass);
+}
+
+inline bool isRenderGraphWrite(const RenderGraphAccess &access) {
+  return (access.accessMask & writeAccessFlags) != 0;
+}
+
+// in declaration order: a reader depends on the nearest writer of the
+// resource declared before it, a writer on that writer and on every reader
+// declared since, so neither a later write nor the reuse of aliased memory
+// can overtake a pending read
+inline void createRenderGraphDependencies(RenderGraph &graph) {
+  std::vector<uint32_t> lastWriterPassIndexList(graph.resourceList.size(),
+                                                (uint32_t)-1);
+  std::vector<std::vector<uint32_t>> readerPassIndexListList(
+      graph.resourceList.size());
+
+  auto addDependency = [](std::vector<uint32_t> &passIndexList,
+                          uint32_t passIndex) {
+    if (std::find(passIndexList.begin(), passIndexList.end(), passIndex) ==
+        passIndexList.end()) {
+      passIndexList.push_back(passIndex);
+    }
+  };
+
+  for (uint32_t x = 0; x < graph.passList.size(); x++) {
+    RenderGraphPass &pass = graph.passList[x];
+    pass.dependencyPassIndexList.clear();
+    pass.producerPassIndexList.clear();
+
+    for (const RenderGraphAccess &access : pass.accessList) {
+      uint32_t lastWriterPassIndex =
+          lastWriterPassIndexList[access.resourceIndex];
+
+      if (lastWriterPassIndex != (uint32_t)-1 && lastWriterPassIndex != x) {
+        addDependency(pass.dependencyPassIndexList, lastWriterPassIndex);
+        addDependency(pass.producerPassIndexList, lastWriterPassIndex);
+      }
+
+      if (isRenderGraphWrite(access)) {
+        for (uint32_t readerPassIndex :
+             readerPassIndexListList[access.resourceIndex]) {
+          if (readerPassIndex != x) {
+            addDependency(pass.dependencyPassIndexList, readerPassIndex);
+          }
+        }
+      }
+    }
+
+    // only after every access of the pass, a pass that reads and writes a
+    // resource must not depend on itself
+    for (const RenderGraphAccess &access : pass.accessList) {
+      if (isRenderGraphWrite(access)) {
+        lastWriterPassIndexList[access.resourceIndex] = x;
+        readerPassIndexListList[access.resourceIndex].clear();
+      }
+    }
+
+    for (const RenderGraphAccess &access : pass.accessList) {
+      if (!isRenderGraphWrite(access) &&
+          lastWriterPassIndexList[access.resourceIndex] != x) {
+        readerPassIndexListList[access.resourceIndex].push_back(x);
+      }
+    }
+  }
+}
+
+// topological order that keeps declaration order wherever the dependencies
+// allow it, false on a cycle
+inline bool sortRenderGraphPasses(const RenderGraph &graph,
+                                  std::vector<uint32_t> *passOrderListPtr) {
+  std::vector<bool> isOrderedList(graph.passList.size(), false);
+  passOrderListPtr->clear();
+
+  while (passOrderListPtr->size() < graph.passList.size()) {
+    uint32_t readyPassIndex = -1;
+
+    for (uint32_t x = 0; x < graph.passList.size(); x++) {
+      if (isOrderedList[x]) {
+        continue;
+      }
+
+      bool isReady = true;
+      for (uint32_t dependencyPassIndex :
+           graph.passList[x].dependencyPassIndexList) {
+        isReady = isReady && isOrderedList[dependencyPassIndex];
+      }
+
+      if (isReady) {
+        readyPassIndex = x;
+        break;
+      }
+    }
+
+    if (readyPassIndex == (uint32_t)-1) {
+      return false;
+    }
+
+    isOrderedList[readyPassIndex] = true;
+    passOrderListPtr->push_back(readyPassIndex);
+  }
+
+  return true;
+}
+
+// only passes that write an imported resource have effects outside the
+// frame, everything they do not (transitively) consume is culled
+inline void cullRenderGraphPasses(RenderGraph &graph,
+                                  const std::vector<uint32_t> &passOrderList) {
+  for (RenderGraphPass &pass : graph.passList) {
+    pass.isCulled = true;
+
+    for (const RenderGraphAccess &access : pass.accessList) {
+      if (isRenderGraphWrite(access) &&
+          !graph.resourceList[access.resourceIndex].isTransient) {
+        pass.isCulled = false;
+      }
+    }
+  }
+
+  for (auto iterator = passOrderList.rbegin();
+       iterator != passOrderList.rend(); iterator++) {
+    if (graph.passList[*iterator].isCulled) {
+      continue;
+    }
+
+    for (uint32_t producerPassIndex :
+         graph.passList[*iterator].producerPassIndexList) {
+      graph.passList[producerPassIndex].isCulled = false;
+    }
+  }
+}
+
+// first fit, largest image first: every image gets the lowest offset that
+// does not overlap an image placed before it whose lifetime it shares
+inline void placeRenderGraphImages(RenderGraph &graph) {
+  std::vector<uint32_t> imageIndexList;
+  for (uint32_t x = 0; x < graph.resourceList.size(); x++) {
+    if (graph.resourceList[x].isTransient &&
+        graph.resourceList[x].firstPassOrder != (uint32_t)-1) {
+      imageIndexList.push_back(x);
+    }
+  }
+
+  std::stable_sort(imageIndexList.begin(), imageIndexList.end(),
+                   [&](uint32_t a, uint32_t b) {
+                     return graph.resourceList[a].memoryRequirements.size >
+                            graph.resourceList[b].memoryRequirements.size;
+                   });
+
+  graph.aliasedMemorySize = 0;
+  graph.unaliasedMemorySize = 0;
+
+  std::vector<uint32_t> placedIndexList;
+  for (uint32_t imageIndex : imageIndexList) {
+    RenderGraphResource &resource = graph.resourceList[imageIndex];
+    VkDeviceSize size = resource.memoryRequirements.size;
+    VkDeviceSize alignment = resource.memoryRequirements.alignment;
+
+    VkDeviceSize offset = 0;
+    bool isOverlapping = true;
+    while (isOverlapping) {
+      offset = (offset + alignment - 1) / alignment * alignment;
+      isOverlapping = false;
+
+      for (uint32_t placedIndex : placedIndexList) {
+        const RenderGraphResource &placed = graph.resourceList[placedIndex];
+
+        bool isLifetimeOverlapping =
+            resource.firstPassOrder <= placed.lastPassOrder &&
+            placed.firstPassOrder <= resource.lastPassOrder;
+        bool isMemoryOverlapping =
+            offset < placed.memoryOffset + placed.memoryRequirements.size &&
+            placed.memoryOffset < offset + size;
+
+        if (isLifetimeOverlapping && isMemoryOverlapping) {
+          offset = placed.memoryOffset + placed.memoryRequirements.size;
+          isOverlapping = true;
+          break;
+        }
+      }
+    }
+
+    resource.memoryOffset = offset;
+    placedIndexList.push_back(imageIndex);
+
+    graph.aliasedMemorySize = std::max(graph.aliasedMemorySize, offset + size);
+    graph.unaliasedMemorySize +=
+        (size + alignment - 1) / alignment * alignment;
+  }
+
+  for (uint32_t imageIndex : placedIndexList) {
+    RenderGraphResource &resource = graph.resourceList[imageIndex];
+    resource.aliasedResourceIndexList.clear();
+
+    for (uint32_t otherIndex : placedIndexList) {
+      const RenderGraphResource &other = graph.resourceList[otherIndex];
+
+      if (other.lastPassOrder < resource.firstPassOrder &&
+          resource.memoryOffset <
+              other.memoryOffset + other.memoryRequirements.size &&
+          other.memoryOffset <
+              resource.memoryOffset + resource.memoryRequirements.size) {
+        resource.aliasedResourceIndexList.push_back(otherIndex);
+      }
+    }
+  }
+}
+
+inline VkResult compileRenderGraph(RenderGraph &graph, VkDevice deviceHandle,
+                                   DeviceMemoryArena &arena) {
+  graph.deviceHandle = deviceHandle;
+
+  createRenderGraphDependencies(graph);
+
+  std::vector<uint32_t> passOrderList;
+  if (!sortRenderGraphPasses(graph, &passOrderList)) {
+    return VK_ERROR_INITIALIZATION_FAILED;
+  }
+
+  cullRenderGraphPasses(graph, passOrderList);
+
+  graph.passOrderList.clear();
+  for (uint32_t passIndex : passOrderList) {
+    if (!graph.passList[passIndex].isCulled) {
+      graph.passOrderList.push_back(passIndex);
+    }
+  }
+
+  for (uint32_t x = 0; x < graph.passOrderList.size(); x++) {
+    for (const RenderGraphAccess &access :
+         graph.passList[graph.passOrderList[x]].accessList) {
+      RenderGraphResource &resource = graph.resourceList[access.resourceIndex];
+
+      resource.firstPassOrder = std::min(resource.firstPassOrder, x);
+      resource.lastPassOrder = resource.lastPassOrder == (uint32_t)-1
+                                   ? x
+                                   : std::max(resource.lastPassOrder, x);
+    }
+  }
+
+  // images of culled passes are never created
+  uint32_t memoryTypeBits = -1;
+  VkDeviceSize alignment = 1;
+
+  for (RenderGraphResource &resource : graph.resourceList) {
+    if (!resource.isTransient || resource.firstPassOrder == (uint32_t)-1) {
+      continue;
+    }
+
+    VkResult result = vkCreateImage(deviceHandle, &resource.imageCreateInfo,
+                                    NULL, &resource.imageHandle);
+
+    if (result != VK_SUCCESS) {
+      return result;
+    }
+
+    vkGetImageMemoryRequirements(deviceHandle, resource.imageHandle,
+                                 &resource.memoryRequirements);
+
+    memoryTypeBits &= resource.memoryRequirements.memoryTypeBits;
+    alignment = std::max(alignment, resource.memoryRequirements.alignment);
+  }
+
+  placeRenderGraphImages(graph);
+
+  if (graph.aliasedMemorySize == 0) {
+    return VK_SUCCESS;
+  }
+
+  VkMemoryRequirements transientMemoryRequirements = {
+      .size = graph.aliasedMemorySize,
+      .alignment = alignment,
+      .memoryTypeBits = memoryTypeBits};
+
+  // these images outlive a single render pass and are copied between, which
+  // lazily allocated memory can not back
+  VkResult result = allocateDeviceMemory(arena, transientMemoryRequirements,
+                                         DEVICE_MEMORY_USAGE_DEVICE,
+                                         &graph.transientAllocation);
+
+  if (result != VK_SUCCESS) {
+    return result;
+  }
+
+  for (RenderGraphResource &resource : graph.resourceList) {
+    if (resource.imageHandle == VK_NULL_HANDLE || !resource.isTransient) {
+      continue;
+    }
+
+    result = vkBindImageMemory(
+        deviceHandle, resource.imageHandle,
+        graph.transientAllocation.deviceMemoryHandle,
+        graph.transientAllocation.offset + resource.memoryOffset);
+
+    if (result != VK_SUCCESS) {
+      return result;
+    }
+
+    if (!(resource.imageCreateInfo.usage &
+          (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+           VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+           VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT))) {
+      continue;
+    }
+
+    VkImageViewCreateInfo imageViewCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .image = resource.imageHandle,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = resource.imageCreateInfo.format,
+        .components = {.r = VK_COMPONENT_SWIZZLE_IDENTITY,
+                       .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+                       .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+                       .a = VK_COMPONENT_SWIZZLE_IDENTITY},
+        .subresourceRange = resource.subresourceRange};
+
+    result = vkCreateImageView(deviceHandle, &imageViewCreateInfo, NULL,
+                               &resource.imageViewHandle);
+
+    if (result != VK_SUCCESS) {
+      return result;
+    }
+  }
+
+  return VK_SUCCESS;
+}
+
+// records every pass that survived culling, the command buffer must be in
+// the recording state
+inline void executeRenderGraph(RenderGraph &graph,
+                               PipelineBarrierTracker &tracker,
+                               VkCommandBuffer commandBufferHandle) {
+  resetPipelineBarrierTracker(tracker);
+
+  for (const RenderGraphResource &resource : graph.resourceList) {
+    if (resource.isImage && !resource.isTransient) {
+      trackImage(tracker, resource.imageHandle, resource.subresourceRange,
+                 resource.initialAccessState);
+    } else if (!resource.isImage) {
+      trackBuffer(tracker, resource.bufferHandle,
+                  resource.initialAccessState);
+    }
+  }
+
+  for (uint32_t x = 0; x < graph.passOrderList.size(); x++) {
+    const RenderGraphPass &pass = graph.passList[graph.passOrderList[x]];
+
+    for (const RenderGraphAccess &access : pass.accessList) {
+      RenderGraphResource &resource = graph.resourceList[access.resourceIndex];
+
+      // an aliased image starts out undefined but has to wait for everything
+      // the previous users of its memory did, as if that had been a write
+      if (resource.isTransient && resource.firstPassOrder == x) {
+        ResourceAccessState accessState;
+
+        for (uint32_t aliasedIndex : resource.aliasedResourceIndexList) {
+          const ResourceAccessState &aliasedAccessState =
+              tracker.imageMap.at(graph.resourceList[aliasedIndex].imageHandle)
+                  .accessState;
+
+          accessState.writeStageMask |= aliasedAccessState.writeStageMask |
+                                        aliasedAccessState.readStageMask;
+          accessState.writeAccessMask |= aliasedAccessState.writeAccessMask;
+        }
+
+        trackImage(tracker, resource.imageHandle, resource.subresourceRange,
+                   accessState);
+      }
+
+      if (resource.isImage) {
+        requireImageAccess(tracker, resource.imageHandle, access.stageMask,
+                           access.accessMask, access.layout);
+      } else {
+        requireBufferAccess(tracker, resource.bufferHandle, access.stageMask,
+                            access.accessMask);
+      }
+    }
+
+    flushPipelineBarriers(tracker, commandBufferHandle);
+
+    pass.recordFunction(commandBufferHandle);
+  }
+}
+
+inline void destroyRenderGraph(RenderGraph &graph, DeviceMemoryArena &arena) {
+  for (RenderGraphResource &resource : graph.resourceList) {
+    if (!resource.isTransient) {
+      continue;
+    }
+
+    vkDestroyImageView(graph.deviceHandle, resource.imageViewHandle, NULL);
+    vkDestroyImage(graph.deviceHandle, resource.imageHandle, NULL);
+  }
+
+  if (graph.transientAllocation.deviceMemoryHandle != VK_NULL_HANDLE) {
+    freeDeviceMemory(arena, graph.transientAllocation);
+  }
+
+  graph.resourceList.clear();
+  graph.passList.clear();
+  graph.passOrderList.clear();
+}
+
+inline void printRenderGraphStatistics(std::ostream &stream,
+                                       const RenderGraph &graph) {
+  stream << "render graph: " << graph.passOrderList.size() << " passes, "
+         << graph.passList.size() - graph.passOrderList.size() << " culled"
+         << std::endl;
+
+  for (uint32_t passIndex : graph.passOrderList) {
+    stream << "  " << graph.passList[passIndex].name << std::endl;
+  }
+
+  stream << "  transient memory: " << graph.aliasedMemorySize
+         << " bytes aliased, " << graph.unaliasedMemorySize
+         << " bytes without aliasing" << std::endl;
+}
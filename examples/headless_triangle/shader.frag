@@ -1,7 +1,17 @@
 #version 460
 
+// fragment cost knob for the overdraw benchmark, zero keeps the plain white
+// output
+layout(constant_id = 0) const int SHADING_ITERATIONS = 0;
+
 layout(location = 0) out vec4 outColor;
 
 void main() {
-  outColor = vec4(1.0, 1.0, 1.0, 1.0);
+  vec3 color = vec3(1.0, 1.0, 1.0);
+
+  for (int x = 0; x < SHADING_ITERATIONS; x++) {
+    color = abs(sin(color * 1.618 + gl_FragCoord.xyx * 0.001));
+  }
+
+  outColor = vec4(color, 1.0);
 }
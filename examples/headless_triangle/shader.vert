@@ -1,5 +1,30 @@
 #version 460
 
+layout(location = 0) in vec3 inPosition;
+
+layout(set = 0, binding = 0) uniform UniformBuffer {
+  vec4 cameraPosition;
+  vec4 cameraRight;
+  vec4 cameraUp;
+  vec4 cameraForward;
+
+  // scale (xy) and offset (zw) into the tile being rendered
+  vec4 tileTransform;
+
+  uint frameCount;
+} uniformBuffer;
+
+// the depth prepass and the color pass must produce the same depth for the
+// EQUAL test to pass
+invariant gl_Position;
+
 void main() {
+  // every instance is drawn in front of the previous one, back to front
+  // is the worst case for overdraw without a prepass
+  float depth = 1.0 / float(gl_InstanceIndex + 2);
+
+  vec2 position = inPosition.xy * uniformBuffer.tileTransform.xy +
+                  uniformBuffer.tileTransform.zw;
 
+  gl_Position = vec4(position, depth, 1.0);
 }
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STREAMING_COPY_X86
+#include <immintrin.h>
+#endif
+
+// Copies pixels out of mapped device memory. Non-temporal loads (MOVNTDQA)
+// read write combined memory a whole line at a time instead of one uncached
+// access per load, and non-temporal stores keep a frame that is only passed
+// on from evicting everything else in the cache. The widest variant the CPU
+// supports is picked at run time, so the binary stays portable. Both
+// pointers have to share their alignment within a vector for the streaming
+// path, anything else falls back to memcpy.
+
+enum StreamingCopyPath {
+  STREAMING_COPY_PATH_MEMCPY,
+  STREAMING_COPY_PATH_SSE41,
+  STREAMING_COPY_PATH_AVX2
+};
+
+inline const char *getStreamingCopyPathName(StreamingCopyPath path) {
+  switch (path) {
+  case STREAMING_COPY_PATH_SSE41:
+    return "sse4.1";
+  case STREAMING_COPY_PATH_AVX2:
+    return "avx2";
+  default:
+    return "memcpy";
+  }
+}
+
+#if defined(STREAMING_COPY_X86)
+__attribute__((target("sse4.1"))) inline void
+copyStreamingSSE41(uint8_t *destinationPtr, const uint8_t *sourcePtr,
+                   size_t size) {
+  size_t x = 0;
+
+  for (; x + 64 <= size; x += 64) {
+    __m128i data0 = _mm_stream_load_si128((__m128i *)(sourcePtr + x));
+    __m128i data1 = _mm_stream_load_si128((__m128i *)(sourcePtr + x + 16));
+    __m128i data2 = _mm_stream_load_si128((__m128i *)(sourcePtr + x + 32));
+    __m128i data3 = _mm_stream_load_si128((__m128i *)(sourcePtr + x + 48));
+
+    _mm_stream_si128((__m128i *)(destinationPtr + x), data0);
+    _mm_stream_si128((__m128i *)(destinationPtr + x + 16), data1);
+    _mm_stream_si128((__m128i *)(destinationPtr + x + 32), data2);
+    _mm_stream_si128((__m128i *)(destinationPtr + x + 48), data3);
+  }
+
+  _mm_sfence();
+
+  memcpy(destinationPtr + x, sourcePtr + x, size - x);
+}
+
+__attribute__((target("avx2"))) inline void
+copyStreamingAVX2(uint8_t *destinationPtr, const uint8_t *sourcePtr,
+                  size_t size) {
+  size_t x = 0;
+
+  for (; x + 128 <= size; x += 128) {
+    __m256i data0 = _mm256_stream_load_si256((__m256i *)(sourcePtr + x));
+    __m256i data1 = _mm256_stream_load_si256((__m256i *)(sourcePtr + x + 32));
+    __m256i data2 = _mm256_stream_load_si256((__m256i *)(sourcePtr + x + 64));
+    __m256i data3 = _mm256_stream_load_si256((__m256i *)(sourcePtr + x + 96));
+
+    _mm256_stream_si256((__m256i *)(destinationPtr + x), data0);
+    _mm256_stream_si256((__m256i *)(destinationPtr + x + 32), data1);
+    _mm256_stream_si256((__m256i *)(destinationPtr + x + 64), data2);
+    _mm256_stream_si256((__m256i *)(destinationPtr + x + 96), data3);
+  }
+
+  _mm_sfence();
+
+  memcpy(destinationPtr + x, sourcePtr + x, size - x);
+}
+#endif
+
+inline StreamingCopyPath getStreamingCopyPath() {
+#if defined(STREAMING_COPY_X86)
+  static const StreamingCopyPath path =
+      __builtin_cpu_supports("avx2")     ? STREAMING_COPY_PATH_AVX2
+      : __builtin_cpu_supports("sse4.1") ? STREAMING_COPY_PATH_SSE41
+                                         : STREAMING_COPY_PATH_MEMCPY;
+  return path;
+#else
+  return STREAMING_COPY_PATH_MEMCPY;
+#endif
+}
+
+inline void copyStreaming(void *destinationPtr, const void *sourcePtr,
+                          size_t size,
+                          StreamingCopyPath path = getStreamingCopyPath()) {
+#if defined(STREAMING_COPY_X86)
+  size_t alignment = path == STREAMING_COPY_PATH_AVX2 ? 32 : 16;
+
+  uintptr_t destinationAddress = (uintptr_t)destinationPtr;
+  uintptr_t sourceAddress = (uintptr_t)sourcePtr;
+
+  if (path != STREAMING_COPY_PATH_MEMCPY &&
+      destinationAddress % alignment == sourceAddress % alignment) {
+    // bring both pointers up to the vector alignment
+    size_t headSize =
+        std::min(size, (alignment - destinationAddress % alignment) %
+                           alignment);
+
+    memcpy(destinationPtr, sourcePtr, headSize);
+
+    uint8_t *alignedDestinationPtr = (uint8_t *)destinationPtr + headSize;
+    const uint8_t *alignedSourcePtr = (const uint8_t *)sourcePtr + headSize;
+
+    if (path == STREAMING_COPY_PATH_AVX2) {
+      copyStreamingAVX2(alignedDestinationPtr, alignedSourcePtr,
+                        size - headSize);
+    } else {
+      copyStreamingSSE41(alignedDestinationPtr, alignedSourcePtr,
+                         size - headSize);
+    }
+    return;
+  }
+#endif
+
+  memcpy(destinationPtr, sourcePtr, size);
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "pixel_conversion.h"
+
+// Splits an output image that is too large for a single render target into
+// a grid of tiles rendered one after another, and streams every retrieved
+// tile straight into a binary PPM on disk. Each tile row is written at its
+// final offset in the file, so the host only ever holds one tile row no
+// matter how large the output is. Tiles are numbered row major.
+
+struct TiledOutput {
+  VkExtent2D extent = {.width = 0, .height = 0};
+  VkExtent2D tileExtent = {.width = 0, .height = 0};
+
+  uint32_t columnCount = 0;
+  uint32_t rowCount = 0;
+  uint32_t tileCount = 0;
+
+  // rgba and bgra render targets are written as rgb
+  bool isBGRA = false;
+
+  std::ofstream file;
+  std::streamoff headerSize = 0;
+  std::vector<char> rowBuffer;
+
+  uint64_t writtenTileCount = 0;
+};
+
+inline bool createTiledOutput(TiledOutput &tiledOutput,
+                              const std::string &path, VkExtent2D extent,
+                              VkExtent2D tileExtent, bool isBGRA) {
+  tiledOutput.extent = extent;
+  tiledOutput.tileExtent = tileExtent;
+  tiledOutput.columnCount =
+      (extent.width + tileExtent.width - 1) / tileExtent.width;
+  tiledOutput.rowCount =
+      (extent.height + tileExtent.height - 1) / tileExtent.height;
+  tiledOutput.tileCount = tiledOutput.columnCount * tiledOutput.rowCount;
+  tiledOutput.isBGRA = isBGRA;
+
+  tiledOutput.file.open(path, std::ios::binary | std::ios::trunc);
+  if (!tiledOutput.file) {
+    return false;
+  }
+
+  std::string header = "P6\n" + std::to_string(extent.width) + " " +
+                       std::to_string(extent.height) + "\n255\n";
+
+  tiledOutput.file.write(header.data(), header.size());
+  tiledOutput.headerSize = header.size();
+  tiledOutput.rowBuffer.resize((size_t)tileExtent.width * 3);
+
+  return (bool)tiledOutput.file;
+}
+
+// the part of the output a tile covers, edge tiles are cut to the output
+inline VkRect2D getTiledOutputRect(const TiledOutput &tiledOutput,
+                                   uint32_t tileIndex) {
+  VkOffset2D offset = {
+      .x = (int32_t)(tileIndex % tiledOutput.columnCount *
+                     tiledOutput.tileExtent.width),
+      .y = (int32_t)(tileIndex / tiledOutput.columnCount *
+                     tiledOutput.tileExtent.height)};
+
+  return {.offset = offset,
+          .extent = {.width = std::min(tiledOutput.tileExtent.width,
+                                       tiledOutput.extent.width - offset.x),
+                     .height = std::min(tiledOutput.tileExtent.height,
+                                        tiledOutput.extent.height -
+                                            offset.y)}};
+}
+
+// scale (xy) and offset (zw) that take a position in the whole output's
+// normalized device coordinates to the same position inside the tile's
+// viewport
+inline void getTiledOutputTransform(const TiledOutput &tiledOutput,
+                                    uint32_t tileIndex,
+                                    float *tileTransformPtr) {
+  VkRect2D rect = getTiledOutputRect(tiledOutput, tileIndex);
+
+  double width = tiledOutput.extent.width;
+  double height = tiledOutput.extent.height;
+
+  tileTransformPtr[0] = (float)(width / rect.extent.width);
+  tileTransformPtr[1] = (float)(height / rect.extent.height);
+  tileTransformPtr[2] =
+      (float)((width - 2.0 * rect.offset.x) / rect.extent.width - 1.0);
+  tileTransformPtr[3] =
+      (float)((height - 2.0 * rect.offset.y) / rect.extent.height - 1.0);
+}
+
+// pixels are the tightly packed readback of the tile's rect
+inline bool writeTiledOutputTile(TiledOutput &tiledOutput, uint32_t tileIndex,
+                                 const uint8_t *pixelPtr) {
+  VkRect2D rect = getTiledOutputRect(tiledOutput, tileIndex);
+
+  for (uint32_t y = 0; y < rect.extent.height; y++) {
+    const uint8_t *rowPtr = pixelPtr + (size_t)y * rect.extent.width * 4;
+
+    convertPixels((uint8_t *)tiledOutput.rowBuffer.data(), rowPtr,
+                  {rect.extent.width, 1}, tiledOutput.isBGRA,
+                  PIXEL_CONVERSION_FORMAT_RGB);
+
+    std::streamoff rowOffset =
+        tiledOutput.headerSize +
+        ((std::streamoff)(rect.offset.y + y) * tiledOutput.extent.width +
+         rect.offset.x) *
+            3;
+
+    tiledOutput.file.seekp(rowOffset);
+    tiledOutput.file.write(tiledOutput.rowBuffer.data(),
+                           (std::streamsize)rect.extent.width * 3);
+  }
+
+  tiledOutput.writtenTileCount += 1;
+
+  return (bool)tiledOutput.file;
+}
+
+inline bool closeTiledOutput(TiledOutput &tiledOutput) {
+  tiledOutput.file.close();
+  return !tiledOutput.file.fail();
+}
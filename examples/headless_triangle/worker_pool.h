@@ -0,0 +1,112 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads that all run the same job once per dispatch. The
+// job receives the index of the worker it runs on, so per-thread resources
+// (command pools, secondary command buffers) can be indexed without any
+// further synchronization. runWorkerPool blocks until every worker is done
+// and rethrows the first exception a job threw.
+
+struct WorkerPool {
+  std::vector<std::thread> threadList;
+
+  std::mutex mutex;
+  std::condition_variable startCondition;
+  std::condition_variable finishCondition;
+
+  std::function<void(uint32_t)> job;
+  uint64_t dispatchCount = 0;
+  uint32_t runningCount = 0;
+  bool isExitRequested = false;
+
+  // the first exception of the current dispatch
+  std::exception_ptr exceptionPtr;
+};
+
+inline void runWorkerPoolThread(WorkerPool &workerPool, uint32_t threadIndex) {
+  uint64_t dispatchCount = 0;
+
+  while (true) {
+    std::function<void(uint32_t)> job;
+    {
+      std::unique_lock<std::mutex> lock(workerPool.mutex);
+      workerPool.startCondition.wait(lock, [&] {
+        return workerPool.isExitRequested ||
+               workerPool.dispatchCount != dispatchCount;
+      });
+
+      if (workerPool.isExitRequested) {
+        return;
+      }
+
+      dispatchCount = workerPool.dispatchCount;
+      job = workerPool.job;
+    }
+
+    // an exception leaving the thread would terminate the process, it is
+    // handed to runWorkerPool instead
+    std::exception_ptr exceptionPtr;
+    try {
+      job(threadIndex);
+    } catch (...) {
+      exceptionPtr = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(workerPool.mutex);
+    if (exceptionPtr && !workerPool.exceptionPtr) {
+      workerPool.exceptionPtr = exceptionPtr;
+    }
+
+    workerPool.runningCount -= 1;
+    if (workerPool.runningCount == 0) {
+      workerPool.finishCondition.notify_one();
+    }
+  }
+}
+
+inline void createWorkerPool(WorkerPool &workerPool, uint32_t threadCount) {
+  for (uint32_t x = 0; x < threadCount; x++) {
+    workerPool.threadList.emplace_back(runWorkerPoolThread,
+                                       std::ref(workerPool), x);
+  }
+}
+
+inline void runWorkerPool(WorkerPool &workerPool,
+                          const std::function<void(uint32_t)> &job) {
+  std::unique_lock<std::mutex> lock(workerPool.mutex);
+  workerPool.job = job;
+  workerPool.runningCount = (uint32_t)workerPool.threadList.size();
+  workerPool.dispatchCount += 1;
+  workerPool.startCondition.notify_all();
+
+  workerPool.finishCondition.wait(
+      lock, [&] { return workerPool.runningCount == 0; });
+
+  if (workerPool.exceptionPtr) {
+    std::exception_ptr exceptionPtr = workerPool.exceptionPtr;
+    workerPool.exceptionPtr = NULL;
+    std::rethrow_exception(exceptionPtr);
+  }
+}
+
+inline void destroyWorkerPool(WorkerPool &workerPool) {
+  {
+    std::lock_guard<std::mutex> lock(workerPool.mutex);
+    workerPool.isExitRequested = true;
+  }
+
+  workerPool.startCondition.notify_all();
+
+  for (std::thread &thread : workerPool.threadList) {
+    thread.join();
+  }
+
+  workerPool.threadList.clear();
+}
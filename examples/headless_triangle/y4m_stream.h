@@ -0,0 +1,319 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Streams the planar yuv 4:2:0 frames the conversion shader leaves in the
+// readback buffers as YUV4MPEG2, to stdout, a fifo or a file, for an external
+// encoder. One thread writes the frames in submission order straight out of
+// the mapped buffers and hands each slot back once its bytes are with the
+// kernel. A consumer that falls behind stalls the writer and, through the
+// slots, the renderer, so no frame is ever dropped.
+
+// where the planes sit in a readback buffer. The shader converts 8x2 pixel
+// blocks and only stores whole words, so luma rows are padded to 8 pixels,
+// chroma rows to 4 samples and the frame to an even number of rows
+struct Y4MPlaneLayout {
+  uint32_t lumaRowPitch = 0;
+  uint32_t chromaRowPitch = 0;
+  uint32_t rowCount = 0;
+
+  VkDeviceSize uPlaneOffset = 0;
+  VkDeviceSize vPlaneOffset = 0;
+  VkDeviceSize size = 0;
+};
+
+inline Y4MPlaneLayout getY4MPlaneLayout(VkExtent2D extent) {
+  Y4MPlaneLayout layout;
+  layout.lumaRowPitch = (extent.width + 7) / 8 * 8;
+  layout.chromaRowPitch = layout.lumaRowPitch / 2;
+  layout.rowCount = (extent.height + 1) / 2 * 2;
+
+  VkDeviceSize chromaPlaneSize =
+      (VkDeviceSize)layout.chromaRowPitch * layout.rowCount / 2;
+
+  layout.uPlaneOffset = (VkDeviceSize)layout.lumaRowPitch * layout.rowCount;
+  layout.vPlaneOffset = layout.uPlaneOffset + chromaPlaneSize;
+  layout.size = layout.vPlaneOffset + chromaPlaneSize;
+
+  return layout;
+}
+
+struct Y4MStreamJob {
+  uint32_t slotIndex = 0;
+  const uint8_t *planePtr = NULL;
+};
+
+struct Y4MStream {
+  int fileDescriptor = -1;
+
+  VkExtent2D extent = {.width = 0, .height = 0};
+  Y4MPlaneLayout layout;
+
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable jobCondition;
+  std::condition_variable slotCondition;
+
+  std::deque<Y4MStreamJob> jobQueue;
+  std::vector<bool> slotBusyList;
+
+  bool isExitRequested = false;
+
+  // the consumer went away, frames queued after that are released unwritten
+  bool isFailed = false;
+
+  uint64_t writtenFrameCount = 0;
+  uint64_t writtenByteCount = 0;
+  double writeSeconds = 0;
+  double backpressureSeconds = 0;
+};
+
+// writes every byte of the list, in batches the kernel accepts and across
+// short writes
+inline bool writeY4MStreamVectors(int fileDescriptor,
+                                  std::vector<iovec> &vectorList) {
+  size_t vectorIndex = 0;
+
+  while (vectorIndex < vectorList.size()) {
+    int vectorCount =
+        (int)std::min<size_t>(vectorList.size() - vectorIndex, IOV_MAX);
+
+    ssize_t writtenSize =
+        writev(fileDescriptor, &vectorList[vectorIndex], vectorCount);
+
+    if (writtenSize < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+
+    while (writtenSize > 0) {
+      iovec &vector = vectorList[vectorIndex];
+
+      if ((size_t)writtenSize >= vector.iov_len) {
+        writtenSize -= vector.iov_len;
+        vectorIndex += 1;
+      } else {
+        vector.iov_base = (char *)vector.iov_base + writtenSize;
+        vector.iov_len -= writtenSize;
+        writtenSize = 0;
+      }
+    }
+
+    while (vectorIndex < vectorList.size() &&
+           vectorList[vectorIndex].iov_len == 0) {
+      vectorIndex += 1;
+    }
+  }
+
+  return true;
+}
+
+// a frame header and the three planes without their padding, whole planes
+// go out as one vector when the rows are not padded
+inline void getY4MFrameVectors(const Y4MStream &stream,
+                               const uint8_t *planePtr,
+                               std::vector<iovec> &vectorList) {
+  static char frameHeader[] = "FRAME\n";
+
+  vectorList.clear();
+  vectorList.push_back({.iov_base = frameHeader, .iov_len = 6});
+
+  uint32_t chromaWidth = (stream.extent.width + 1) / 2;
+  uint32_t chromaHeight = (stream.extent.height + 1) / 2;
+
+  auto addPlane = [&](const uint8_t *rowPtr, uint32_t width, uint32_t height,
+                      uint32_t rowPitch) {
+    if (width == rowPitch) {
+      vectorList.push_back({.iov_base = (void *)rowPtr,
+                            .iov_len = (size_t)width * height});
+      return;
+    }
+
+    for (uint32_t y = 0; y < height; y++) {
+      vectorList.push_back(
+          {.iov_base = (void *)(rowPtr + (size_t)y * rowPitch),
+           .iov_len = width});
+    }
+  };
+
+  addPlane(planePtr, stream.extent.width, stream.extent.height,
+           stream.layout.lumaRowPitch);
+  addPlane(planePtr + stream.layout.uPlaneOffset, chromaWidth, chromaHeight,
+           stream.layout.chromaRowPitch);
+  addPlane(planePtr + stream.layout.vPlaneOffset, chromaWidth, chromaHeight,
+           stream.layout.chromaRowPitch);
+}
+
+inline void runY4MStreamThread(Y4MStream &stream) {
+  std::vector<iovec> vectorList;
+
+  while (true) {
+    Y4MStreamJob job;
+    bool isFailed = false;
+    {
+      std::unique_lock<std::mutex> lock(stream.mutex);
+      stream.jobCondition.wait(lock, [&] {
+        return stream.isExitRequested || !stream.jobQueue.empty();
+      });
+
+      // queued frames are still written after an exit request
+      if (stream.jobQueue.empty()) {
+        return;
+      }
+
+      job = stream.jobQueue.front();
+      stream.jobQueue.pop_front();
+
+      isFailed = stream.isFailed;
+    }
+
+    std::chrono::steady_clock::time_point writeStartTimePoint =
+        std::chrono::steady_clock::now();
+
+    size_t frameSize = 0;
+    if (!isFailed) {
+      getY4MFrameVectors(stream, job.planePtr, vectorList);
+
+      for (const iovec &vector : vectorList) {
+        frameSize += vector.iov_len;
+      }
+
+      isFailed = !writeY4MStreamVectors(stream.fileDescriptor, vectorList);
+    }
+
+    double writeSeconds = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() -
+                              writeStartTimePoint)
+                              .count();
+
+    {
+      std::lock_guard<std::mutex> lock(stream.mutex);
+      stream.slotBusyList[job.slotIndex] = false;
+      stream.writeSeconds += writeSeconds;
+
+      if (isFailed) {
+        stream.isFailed = true;
+      } else {
+        stream.writtenFrameCount += 1;
+        stream.writtenByteCount += frameSize;
+      }
+    }
+    stream.slotCondition.notify_all();
+  }
+}
+
+// "-" is stdout. Everything else the process prints is moved to stderr
+// first, so call this before anything is written to stdout. A fifo blocks
+// here until its reader opens it
+inline bool createY4MStream(Y4MStream &stream, const std::string &path,
+                            VkExtent2D extent, uint32_t frameRate,
+                            uint32_t slotCount) {
+  if (path == "-") {
+    fflush(stdout);
+
+    stream.fileDescriptor = dup(STDOUT_FILENO);
+    if (stream.fileDescriptor < 0 ||
+        dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+      return false;
+    }
+  } else {
+    stream.fileDescriptor =
+        open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (stream.fileDescriptor < 0) {
+      return false;
+    }
+  }
+
+  // a consumer that exits fails the write instead of killing the process
+  std::signal(SIGPIPE, SIG_IGN);
+
+  stream.extent = extent;
+  stream.layout = getY4MPlaneLayout(extent);
+  stream.slotBusyList.assign(slotCount, false);
+
+  // C420jpeg siting matches the shader's 2x2 box average
+  std::string header = "YUV4MPEG2 W" + std::to_string(extent.width) + " H" +
+                       std::to_string(extent.height) + " F" +
+                       std::to_string(frameRate) +
+                       ":1 Ip A1:1 C420jpeg XYSCSS=420JPEG "
+                       "XCOLORRANGE=LIMITED\n";
+
+  std::vector<iovec> vectorList = {
+      {.iov_base = header.data(), .iov_len = header.size()}};
+
+  if (!writeY4MStreamVectors(stream.fileDescriptor, vectorList)) {
+    return false;
+  }
+
+  stream.writtenByteCount = header.size();
+  stream.thread = std::thread(runY4MStreamThread, std::ref(stream));
+
+  return true;
+}
+
+// the planes must stay valid until the slot is released
+inline void submitY4MStream(Y4MStream &stream, const Y4MStreamJob &job) {
+  {
+    std::lock_guard<std::mutex> lock(stream.mutex);
+    stream.slotBusyList[job.slotIndex] = true;
+    stream.jobQueue.push_back(job);
+  }
+
+  stream.jobCondition.notify_one();
+}
+
+// blocks until the writer is done with the slot's planes, false once the
+// consumer has gone away
+inline bool waitY4MStreamSlot(Y4MStream &stream, uint32_t slotIndex) {
+  std::chrono::steady_clock::time_point waitStartTimePoint =
+      std::chrono::steady_clock::now();
+
+  std::unique_lock<std::mutex> lock(stream.mutex);
+  stream.slotCondition.wait(lock,
+                            [&] { return !stream.slotBusyList[slotIndex]; });
+
+  stream.backpressureSeconds +=
+      std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                    waitStartTimePoint)
+          .count();
+
+  return !stream.isFailed;
+}
+
+// writes every queued frame, then closes the stream
+inline void destroyY4MStream(Y4MStream &stream) {
+  {
+    std::lock_guard<std::mutex> lock(stream.mutex);
+    stream.isExitRequested = true;
+  }
+
+  stream.jobCondition.notify_all();
+
+  if (stream.thread.joinable()) {
+    stream.thread.join();
+  }
+
+  if (stream.fileDescriptor >= 0) {
+    close(stream.fileDescriptor);
+    stream.fileDescriptor = -1;
+  }
+}
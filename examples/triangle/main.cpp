@@ -5,6 +5,14 @@
 #include <vector>
 #include <cstring>
 #include <string>
+#include <chrono>
+#include <filesystem>
+#include <csignal>
+#include <stdexcept>
+#include <algorithm>
+#include <deque>
+#include <cmath>
+#include <thread>
 
 #if defined(PLATFORM_LINUX)
 #include <X11/Xlib.h>
@@ -21,6 +29,9 @@
 #include <vulkan/vulkan_win32.h>
 #endif
 
+#include "argument_parsing.h"
+#include "pipeline_cache.h"
+
 #if defined(VALIDATION_ENABLED)
 #define STRING_RESET "\033[0m"
 #define STRING_INFO "\033[37m"
@@ -121,6 +132,107 @@ std::vector<uint32_t> loadShaderFile(
   return shaderSource;
 }
 
+uint32_t findMemoryTypeIndex(
+    const VkPhysicalDeviceMemoryProperties &physicalDeviceMemoryProperties,
+    uint32_t memoryTypeBits, VkMemoryPropertyFlags memoryPropertyFlags) {
+
+  for (uint32_t x = 0; x < physicalDeviceMemoryProperties.memoryTypeCount;
+       x++) {
+    if ((memoryTypeBits & (1 << x)) &&
+        (physicalDeviceMemoryProperties.memoryTypes[x].propertyFlags &
+         memoryPropertyFlags) == memoryPropertyFlags) {
+
+      return x;
+    }
+  }
+
+  return -1;
+}
+
+std::string getPresentModeName(VkPresentModeKHR presentMode) {
+  switch (presentMode) {
+  case VK_PRESENT_MODE_IMMEDIATE_KHR:
+    return "immediate";
+  case VK_PRESENT_MODE_MAILBOX_KHR:
+    return "mailbox";
+  case VK_PRESENT_MODE_FIFO_KHR:
+    return "fifo";
+  case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+    return "fifo_relaxed";
+  default:
+    return "unknown";
+  }
+}
+
+bool parsePresentMode(const std::string &presentModeName,
+                      VkPresentModeKHR *presentModePtr) {
+  for (VkPresentModeKHR presentMode :
+       {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR,
+        VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR}) {
+    if (getPresentModeName(presentMode) == presentModeName) {
+      *presentModePtr = presentMode;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+std::string getImageFormatName(VkFormat format) {
+  switch (format) {
+  case VK_FORMAT_R8G8B8A8_UNORM:
+    return "rgba8";
+  case VK_FORMAT_R8G8B8A8_SRGB:
+    return "rgba8_srgb";
+  case VK_FORMAT_B8G8R8A8_UNORM:
+    return "bgra8";
+  case VK_FORMAT_B8G8R8A8_SRGB:
+    return "bgra8_srgb";
+  default:
+    return "unknown";
+  }
+}
+
+bool parseImageFormat(const std::string &formatName, VkFormat *formatPtr) {
+  for (VkFormat format : {VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8A8_SRGB,
+                          VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_B8G8R8A8_SRGB}) {
+    if (getImageFormatName(format) == formatName) {
+      *formatPtr = format;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// WIDTHxHEIGHT
+// the window is created at this size, and X11 window dimensions are 16 bit
+bool parseExtent(const std::string &extentString, VkExtent2D *extentPtr) {
+  size_t separatorPosition = extentString.find('x');
+  if (separatorPosition == std::string::npos) {
+    return false;
+  }
+
+  uint16_t width;
+  uint16_t height;
+  if (!parseUnsignedArgument(extentString.substr(0, separatorPosition),
+                             &width) ||
+      !parseUnsignedArgument(extentString.substr(separatorPosition + 1),
+                             &height) ||
+      width == 0 || height == 0) {
+    return false;
+  }
+
+  extentPtr->width = width;
+  extentPtr->height = height;
+
+  return true;
+}
+
+volatile std::sig_atomic_t isExitRequested = 0;
+
+void handleExitSignal(int) { isExitRequested = 1; }
+
 #if defined(PLATFORM_ANDROID)
 bool isWindowReady = false;
 
@@ -150,22 +262,116 @@ _Use_decl_annotations_ int APIENTRY WinMain(HINSTANCE hInstance,
                                             LPSTR pCmdLine,
                                             int nCmdShow) {
 #else
-int main() {
+int main(int argc, char *argv[]) {
 #endif
   VkResult result;
 
+  // =========================================================================
+  // Arguments
+
+  uint64_t maxFrameCount = 0;
+  double maxSeconds = 0;
+
+  VkPresentModeKHR requestedPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+  bool isLowLatencyEnabled = false;
+
+  // initial window size, the swapchain follows the window afterwards
+  VkExtent2D requestedExtent = {.width = 800, .height = 600};
+  VkFormat requestedFormat = VK_FORMAT_R8G8B8A8_UNORM;
+  uint32_t requestedImageCount = 0;
+
+  bool isDynamicRenderingEnabled = false;
+
+#if defined(PLATFORM_LINUX)
+  for (int x = 1; x < argc; x++) {
+    std::string argument = argv[x];
+
+    // std::stod throws on malformed numbers, which are bad arguments like any
+    // other
+    bool isArgumentValid = true;
+    try {
+      if (argument.rfind("--frames=", 0) == 0) {
+        isArgumentValid =
+            parseUnsignedArgument(argument.substr(9), &maxFrameCount);
+      } else if (argument.rfind("--seconds=", 0) == 0) {
+        maxSeconds = std::stod(argument.substr(10));
+      } else if (argument.rfind("--present-mode=", 0) == 0) {
+        if (!parsePresentMode(argument.substr(15), &requestedPresentMode)) {
+          std::cout << "Unknown present mode: " << argument.substr(15)
+                    << std::endl;
+          return 1;
+        }
+      } else if (argument == "--low-latency") {
+        isLowLatencyEnabled = true;
+      } else if (argument.rfind("--extent=", 0) == 0) {
+        if (!parseExtent(argument.substr(9), &requestedExtent)) {
+          std::cout << "Invalid extent: " << argument.substr(9) << std::endl;
+          return 1;
+        }
+      } else if (argument.rfind("--image-format=", 0) == 0) {
+        if (!parseImageFormat(argument.substr(15), &requestedFormat)) {
+          std::cout << "Unknown image format: " << argument.substr(15)
+                    << std::endl;
+          return 1;
+        }
+      } else if (argument.rfind("--images=", 0) == 0) {
+        isArgumentValid =
+            parseUnsignedArgument(argument.substr(9), &requestedImageCount);
+      } else if (argument == "--dynamic-rendering") {
+        isDynamicRenderingEnabled = true;
+      } else {
+        isArgumentValid = false;
+      }
+    } catch (const std::logic_error &) {
+      isArgumentValid = false;
+    }
+
+    if (!isArgumentValid) {
+      std::cout << "Usage: triangle" << std::endl;
+      std::cout << "  --frames=FRAME_COUNT" << std::endl;
+      std::cout << "  --seconds=DURATION" << std::endl;
+      std::cout << "  --present-mode=mailbox|immediate|fifo_relaxed|fifo"
+                << std::endl;
+      std::cout << "  --low-latency" << std::endl;
+      std::cout << "  --extent=WIDTHxHEIGHT" << std::endl;
+      std::cout << "  --image-format=rgba8|rgba8_srgb|bgra8|bgra8_srgb"
+                << std::endl;
+      std::cout << "  --images=SWAPCHAIN_IMAGE_COUNT" << std::endl;
+      std::cout << "  --dynamic-rendering" << std::endl;
+      return 1;
+    }
+  }
+
+  std::signal(SIGINT, handleExitSignal);
+  std::signal(SIGTERM, handleExitSignal);
+#endif
+
   // =========================================================================
   // Window
 
 #if defined(PLATFORM_LINUX)
   Display *displayPtr = XOpenDisplay(NULL);
+
+  if (displayPtr == NULL) {
+    throw std::runtime_error("Could not open X display: " +
+                             std::string(XDisplayName(NULL)));
+  }
+
   int screen = DefaultScreen(displayPtr);
 
   Window windowLinux = XCreateSimpleWindow(
-      displayPtr, RootWindow(displayPtr, screen), 10, 10, 100, 100, 1,
+      displayPtr, RootWindow(displayPtr, screen), 10, 10,
+      requestedExtent.width, requestedExtent.height, 1,
       BlackPixel(displayPtr, screen), WhitePixel(displayPtr, screen));
 
-  XSelectInput(displayPtr, windowLinux, ExposureMask | KeyPressMask);
+  XSelectInput(displayPtr, windowLinux,
+               ExposureMask | KeyPressMask | StructureNotifyMask);
+
+  // closing the window arrives as a client message instead of killing the
+  // connection
+  Atom deleteWindowAtom = XInternAtom(displayPtr, "WM_DELETE_WINDOW", False);
+  XSetWMProtocols(displayPtr, windowLinux, &deleteWindowAtom, 1);
+
   XMapWindow(displayPtr, windowLinux);
 #elif defined(PLATFORM_ANDROID)
   appPtr->onAppCmd = handleAppCmd;
@@ -198,7 +404,7 @@ int main() {
       "WINDOW_CLASS",
       "Triangle",
       WS_OVERLAPPEDWINDOW | WS_CLIPSIBLINGS | WS_CLIPCHILDREN,
-      0, 0, 800, 600,
+      0, 0, requestedExtent.width, requestedExtent.height,
       NULL,
       NULL,
       hInstance,
@@ -437,9 +643,141 @@ int main() {
 
   std::vector<const char *> deviceExtensionList = {"VK_KHR_swapchain"};
 
+  uint32_t deviceExtensionCount = 0;
+  result = vkEnumerateDeviceExtensionProperties(
+      activePhysicalDeviceHandle, NULL, &deviceExtensionCount, NULL);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkEnumerateDeviceExtensionProperties");
+  }
+
+  std::vector<VkExtensionProperties> deviceExtensionPropertiesList(
+      deviceExtensionCount);
+  result = vkEnumerateDeviceExtensionProperties(
+      activePhysicalDeviceHandle, NULL, &deviceExtensionCount,
+      deviceExtensionPropertiesList.data());
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkEnumerateDeviceExtensionProperties");
+  }
+
+  auto isDeviceExtensionSupported = [&](const std::string &extensionName) {
+    for (const VkExtensionProperties &extensionProperties :
+         deviceExtensionPropertiesList) {
+      if (extensionName == extensionProperties.extensionName) {
+        return true;
+      }
+    }
+
+    return false;
+  };
+
+  // present ids let the loop wait for the moment a frame actually reaches
+  // the display, without them latency is measured up to render completion
+  VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+      .pNext = NULL,
+      .presentWait = VK_FALSE};
+
+  VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+      .pNext = &presentWaitFeatures,
+      .presentId = VK_FALSE};
+
+  if (isDeviceExtensionSupported("VK_KHR_present_id") &&
+      isDeviceExtensionSupported("VK_KHR_present_wait")) {
+    VkPhysicalDeviceFeatures2 supportedFeatures2 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &presentIdFeatures};
+
+    vkGetPhysicalDeviceFeatures2(activePhysicalDeviceHandle,
+                                 &supportedFeatures2);
+  }
+
+  bool isPresentWaitEnabled =
+      presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+
+  void *deviceFeaturesNextPtr = NULL;
+
+  if (isPresentWaitEnabled) {
+    deviceExtensionList.push_back("VK_KHR_present_id");
+    deviceExtensionList.push_back("VK_KHR_present_wait");
+
+    deviceFeaturesNextPtr = &presentIdFeatures;
+  }
+
+  // cull mode, front face and topology are set while recording instead of
+  // being baked into the pipeline, the commands are core since Vulkan 1.3 and
+  // an extension before that
+  bool isExtendedDynamicStateCore =
+      physicalDeviceProperties.apiVersion >= VK_API_VERSION_1_3;
+
+  VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures =
+      {.sType =
+           VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT,
+       .pNext = NULL,
+       .extendedDynamicState = VK_FALSE};
+
+  if (!isExtendedDynamicStateCore &&
+      isDeviceExtensionSupported("VK_EXT_extended_dynamic_state")) {
+    VkPhysicalDeviceFeatures2 supportedFeatures2 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &extendedDynamicStateFeatures};
+
+    vkGetPhysicalDeviceFeatures2(activePhysicalDeviceHandle,
+                                 &supportedFeatures2);
+  }
+
+  bool isExtendedDynamicStateEnabled =
+      isExtendedDynamicStateCore ||
+      extendedDynamicStateFeatures.extendedDynamicState;
+
+  if (isExtendedDynamicStateEnabled && !isExtendedDynamicStateCore) {
+    deviceExtensionList.push_back("VK_EXT_extended_dynamic_state");
+
+    extendedDynamicStateFeatures.pNext = deviceFeaturesNextPtr;
+    deviceFeaturesNextPtr = &extendedDynamicStateFeatures;
+  }
+
+  // dynamic rendering replaces the render pass and framebuffers, the layout
+  // transitions the render pass did implicitly become synchronization2
+  // barriers around the swapchain image
+  if (isDynamicRenderingEnabled) {
+    VkPhysicalDeviceVulkan13Features supportedVulkan13Features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+        .pNext = NULL};
+
+    if (physicalDeviceProperties.apiVersion >= VK_API_VERSION_1_3) {
+      VkPhysicalDeviceFeatures2 supportedFeatures2 = {
+          .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+          .pNext = &supportedVulkan13Features};
+
+      vkGetPhysicalDeviceFeatures2(activePhysicalDeviceHandle,
+                                   &supportedFeatures2);
+    }
+
+    if (!supportedVulkan13Features.dynamicRendering ||
+        !supportedVulkan13Features.synchronization2) {
+      std::cout << "dynamic rendering not supported, using render pass"
+                << std::endl;
+      isDynamicRenderingEnabled = false;
+    }
+  }
+
+  VkPhysicalDeviceVulkan13Features deviceVulkan13Features = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+      .pNext = NULL,
+      .synchronization2 = isDynamicRenderingEnabled ? VK_TRUE : VK_FALSE,
+      .dynamicRendering = isDynamicRenderingEnabled ? VK_TRUE : VK_FALSE};
+
+  if (isDynamicRenderingEnabled) {
+    deviceVulkan13Features.pNext = deviceFeaturesNextPtr;
+    deviceFeaturesNextPtr = &deviceVulkan13Features;
+  }
+
   VkDeviceCreateInfo deviceCreateInfo = {
       .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-      .pNext = NULL,
+      .pNext = deviceFeaturesNextPtr,
       .flags = 0,
       .queueCreateInfoCount = 1,
       .pQueueCreateInfos = &deviceQueueCreateInfo,
@@ -457,6 +795,28 @@ int main() {
     throwExceptionVulkanAPI(result, "vkCreateDevice");
   }
 
+  PFN_vkWaitForPresentKHR pvkWaitForPresentKHR = NULL;
+  if (isPresentWaitEnabled) {
+    pvkWaitForPresentKHR = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(
+        deviceHandle, "vkWaitForPresentKHR");
+  }
+
+  PFN_vkCmdSetCullMode pvkCmdSetCullMode = NULL;
+  PFN_vkCmdSetFrontFace pvkCmdSetFrontFace = NULL;
+  PFN_vkCmdSetPrimitiveTopology pvkCmdSetPrimitiveTopology = NULL;
+
+  if (isExtendedDynamicStateEnabled) {
+    std::string suffix = isExtendedDynamicStateCore ? "" : "EXT";
+
+    pvkCmdSetCullMode = (PFN_vkCmdSetCullMode)vkGetDeviceProcAddr(
+        deviceHandle, ("vkCmdSetCullMode" + suffix).c_str());
+    pvkCmdSetFrontFace = (PFN_vkCmdSetFrontFace)vkGetDeviceProcAddr(
+        deviceHandle, ("vkCmdSetFrontFace" + suffix).c_str());
+    pvkCmdSetPrimitiveTopology =
+        (PFN_vkCmdSetPrimitiveTopology)vkGetDeviceProcAddr(
+            deviceHandle, ("vkCmdSetPrimitiveTopology" + suffix).c_str());
+  }
+
   // =========================================================================
   // Submission Queue
 
@@ -483,15 +843,19 @@ int main() {
   // =========================================================================
   // Command Buffers
 
+  // command buffers, uniform slots and timestamp queries are indexed by
+  // swapchain image, a recreated swapchain may not have more images than this
+  uint32_t maxSwapchainImageCount = 16;
+
   VkCommandBufferAllocateInfo commandBufferAllocateInfo = {
       .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
       .pNext = NULL,
       .commandPool = commandPoolHandle,
       .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-      .commandBufferCount = 16};
+      .commandBufferCount = maxSwapchainImageCount};
 
   std::vector<VkCommandBuffer> commandBufferHandleList =
-      std::vector<VkCommandBuffer>(16, VK_NULL_HANDLE);
+      std::vector<VkCommandBuffer>(maxSwapchainImageCount, VK_NULL_HANDLE);
 
   result = vkAllocateCommandBuffers(deviceHandle, &commandBufferAllocateInfo,
                                     commandBufferHandleList.data());
@@ -527,12 +891,21 @@ int main() {
 
   uint32_t selectedFormatIndex = 0;
   for (uint32_t x = 0; x < surfaceFormatList.size(); x++) {
-    if (surfaceFormatList[x].format == VK_FORMAT_R8G8B8A8_UNORM) {
+    if (surfaceFormatList[x].format == requestedFormat) {
       selectedFormatIndex = x;
       break;
     }
   }
 
+  std::cout << "image format: "
+            << getImageFormatName(
+                   surfaceFormatList[selectedFormatIndex].format);
+  if (surfaceFormatList[selectedFormatIndex].format != requestedFormat) {
+    std::cout << " (" << getImageFormatName(requestedFormat)
+              << " not supported)";
+  }
+  std::cout << std::endl;
+
   if (result != VK_SUCCESS) {
     throwExceptionVulkanAPI(result, "vkGetPhysicalDeviceSurfaceFormatsKHR");
   }
@@ -556,46 +929,61 @@ int main() {
                             "vkGetPhysicalDeviceSurfacePresentModesKHR");
   }
 
-  // =========================================================================
-  // Swapchain
+  // a low latency request falls back to the other low latency mode before
+  // settling for FIFO, the only mode every implementation has to support
+  std::vector<VkPresentModeKHR> presentModePreferenceList = {
+      requestedPresentMode};
 
-  VkSwapchainCreateInfoKHR swapchainCreateInfo = {
-      .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
-      .pNext = NULL,
-      .flags = 0,
-      .surface = surfaceHandle,
-      .minImageCount = surfaceCapabilities.minImageCount + 1,
-      .imageFormat = surfaceFormatList[selectedFormatIndex].format,
-      .imageColorSpace = surfaceFormatList[selectedFormatIndex].colorSpace,
-      .imageExtent = surfaceCapabilities.currentExtent,
-      .imageArrayLayers = 1,
-      .imageUsage =
-          VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-      .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
-      .queueFamilyIndexCount = 1,
-      .pQueueFamilyIndices = &queueFamilyIndex,
-      .preTransform = surfaceCapabilities.currentTransform,
-      .compositeAlpha =
-#if defined(PLATFORM_ANDROID)
-          VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR,
-#else
-          VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
-#endif
-      .presentMode = VK_PRESENT_MODE_FIFO_KHR,
-      .clipped = VK_TRUE,
-      .oldSwapchain = VK_NULL_HANDLE};
+  if (requestedPresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+    presentModePreferenceList.push_back(VK_PRESENT_MODE_IMMEDIATE_KHR);
+  } else if (requestedPresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
+    presentModePreferenceList.push_back(VK_PRESENT_MODE_MAILBOX_KHR);
+  }
 
-  VkSwapchainKHR swapchainHandle = VK_NULL_HANDLE;
-  result = vkCreateSwapchainKHR(deviceHandle, &swapchainCreateInfo, NULL,
-                                &swapchainHandle);
+  presentModePreferenceList.push_back(VK_PRESENT_MODE_FIFO_KHR);
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkCreateSwapchainKHR");
+  VkPresentModeKHR selectedPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+  for (VkPresentModeKHR presentMode : presentModePreferenceList) {
+    if (std::find(presentModeList.begin(), presentModeList.end(),
+                  presentMode) != presentModeList.end()) {
+      selectedPresentMode = presentMode;
+      break;
+    }
   }
 
+  std::cout << "present mode: " << getPresentModeName(selectedPresentMode);
+  if (selectedPresentMode != requestedPresentMode) {
+    std::cout << " (" << getPresentModeName(requestedPresentMode)
+              << " not supported)";
+  }
+  std::cout << std::endl;
+
+  // one image more than the minimum so MAILBOX always has a spare image to
+  // replace and the CPU never waits on the presentation engine for a slot
+  uint32_t swapchainMinImageCount = surfaceCapabilities.minImageCount + 1;
+  if (requestedImageCount > 0) {
+    swapchainMinImageCount =
+        std::max(requestedImageCount, surfaceCapabilities.minImageCount);
+  }
+
+  if (surfaceCapabilities.maxImageCount > 0) {
+    swapchainMinImageCount =
+        std::min(swapchainMinImageCount, surfaceCapabilities.maxImageCount);
+  }
+
+  swapchainMinImageCount =
+      std::min(swapchainMinImageCount, maxSwapchainImageCount);
+
   // =========================================================================
   // Render Pass
 
+  // startup cost of the objects dynamic rendering does without, the
+  // framebuffers are added every time the swapchain is created
+  double renderPassObjectCreationTime = 0;
+
+  std::chrono::steady_clock::time_point renderPassStartTimePoint =
+      std::chrono::steady_clock::now();
+
   std::vector<VkAttachmentDescription> attachmentDescriptionList = {
       {.flags = 0,
        .format = surfaceFormatList[selectedFormatIndex].format,
@@ -634,92 +1022,256 @@ int main() {
       .pDependencies = NULL};
 
   VkRenderPass renderPassHandle = VK_NULL_HANDLE;
-  result = vkCreateRenderPass(deviceHandle, &renderPassCreateInfo, NULL,
-                              &renderPassHandle);
+  if (!isDynamicRenderingEnabled) {
+    result = vkCreateRenderPass(deviceHandle, &renderPassCreateInfo, NULL,
+                                &renderPassHandle);
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkCreateRenderPass");
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateRenderPass");
+    }
   }
 
+  renderPassObjectCreationTime +=
+      std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - renderPassStartTimePoint)
+          .count();
+
   // =========================================================================
-  // Swapchain Images, Swapchain Image Views
+  // Swapchain, Swapchain Image Views, Framebuffers
+
+  // everything that depends on the surface extent lives here so a resize only
+  // rebuilds these objects, the ones they replace are retired and destroyed
+  // once the frames that still use them have completed
+  struct RetiredSwapchain {
+    VkSwapchainKHR swapchainHandle;
+    std::vector<VkImageView> imageViewHandleList;
+    std::vector<VkFramebuffer> framebufferHandleList;
+    std::vector<VkSemaphore> renderFinishedSemaphoreHandleList;
+    uint64_t retireFrameCount;
+  };
+
+  std::vector<RetiredSwapchain> retiredSwapchainList;
+
+  VkSwapchainKHR swapchainHandle = VK_NULL_HANDLE;
+  VkExtent2D swapchainExtent = {.width = 0, .height = 0};
 
   uint32_t swapchainImageCount = 0;
-  result = vkGetSwapchainImagesKHR(deviceHandle, swapchainHandle,
-                                   &swapchainImageCount, NULL);
+  std::vector<VkImage> swapchainImageHandleList;
+  std::vector<VkImageView> swapchainImageViewHandleList;
+  std::vector<VkFramebuffer> framebufferHandleList;
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkGetSwapchainImagesKHR");
-  }
+  // one per swapchain image, a present may still be waiting on the semaphore
+  // of an image when the next frame in flight signals its own
+  std::vector<VkSemaphore> renderFinishedSemaphoreHandleList;
 
-  std::vector<VkImage> swapchainImageHandleList(swapchainImageCount);
-  result = vkGetSwapchainImagesKHR(deviceHandle, swapchainHandle,
-                                   &swapchainImageCount,
-                                   swapchainImageHandleList.data());
+  VkViewport viewport = {.x = 0.0f,
+                         .y = 0.0f,
+                         .width = 0.0f,
+                         .height = 0.0f,
+                         .minDepth = 0.0f,
+                         .maxDepth = 1.0f};
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkGetSwapchainImagesKHR");
-  }
+  VkRect2D screenRect2D = {.offset = {.x = 0, .y = 0},
+                           .extent = {.width = 0, .height = 0}};
+
+  // returns false without touching the current swapchain while the surface
+  // has no area (e.g. a minimized window)
+  auto createSwapchain = [&](uint64_t retireFrameCount) -> bool {
+    result = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
+        activePhysicalDeviceHandle, surfaceHandle, &surfaceCapabilities);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result,
+                              "vkGetPhysicalDeviceSurfaceCapabilitiesKHR");
+    }
 
-  std::vector<VkImageView> swapchainImageViewHandleList(swapchainImageCount,
-                                                        VK_NULL_HANDLE);
+    VkExtent2D extent = surfaceCapabilities.currentExtent;
 
-  for (uint32_t x = 0; x < swapchainImageCount; x++) {
-    VkImageViewCreateInfo imageViewCreateInfo = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+    // the surface takes its size from the swapchain on some platforms
+    if (extent.width == UINT32_MAX) {
+      extent.width = std::clamp(requestedExtent.width,
+                                surfaceCapabilities.minImageExtent.width,
+                                surfaceCapabilities.maxImageExtent.width);
+      extent.height = std::clamp(requestedExtent.height,
+                                 surfaceCapabilities.minImageExtent.height,
+                                 surfaceCapabilities.maxImageExtent.height);
+    }
+
+    if (extent.width == 0 || extent.height == 0) {
+      return false;
+    }
+
+    VkSwapchainCreateInfoKHR swapchainCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
         .pNext = NULL,
         .flags = 0,
-        .image = swapchainImageHandleList[x],
-        .viewType = VK_IMAGE_VIEW_TYPE_2D,
-        .format = surfaceFormatList[selectedFormatIndex].format,
-        .components = {VK_COMPONENT_SWIZZLE_IDENTITY,
-                       VK_COMPONENT_SWIZZLE_IDENTITY,
-                       VK_COMPONENT_SWIZZLE_IDENTITY,
-                       VK_COMPONENT_SWIZZLE_IDENTITY},
-        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
-
-    result = vkCreateImageView(deviceHandle, &imageViewCreateInfo, NULL,
-                               &swapchainImageViewHandleList[x]);
+        .surface = surfaceHandle,
+        .minImageCount = swapchainMinImageCount,
+        .imageFormat = surfaceFormatList[selectedFormatIndex].format,
+        .imageColorSpace = surfaceFormatList[selectedFormatIndex].colorSpace,
+        .imageExtent = extent,
+        .imageArrayLayers = 1,
+        .imageUsage =
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 1,
+        .pQueueFamilyIndices = &queueFamilyIndex,
+        .preTransform = surfaceCapabilities.currentTransform,
+        .compositeAlpha =
+#if defined(PLATFORM_ANDROID)
+            VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR,
+#else
+            VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
+#endif
+        .presentMode = selectedPresentMode,
+        .clipped = VK_TRUE,
+        .oldSwapchain = swapchainHandle};
+
+    VkSwapchainKHR newSwapchainHandle = VK_NULL_HANDLE;
+    result = vkCreateSwapchainKHR(deviceHandle, &swapchainCreateInfo, NULL,
+                                  &newSwapchainHandle);
 
     if (result != VK_SUCCESS) {
-      throwExceptionVulkanAPI(result, "vkCreateImageView");
+      throwExceptionVulkanAPI(result, "vkCreateSwapchainKHR");
     }
-  }
 
-  // =========================================================================
-  // Framebuffers
+    if (swapchainHandle != VK_NULL_HANDLE) {
+      retiredSwapchainList.push_back(
+          {.swapchainHandle = swapchainHandle,
+           .imageViewHandleList = swapchainImageViewHandleList,
+           .framebufferHandleList = framebufferHandleList,
+           .renderFinishedSemaphoreHandleList =
+               renderFinishedSemaphoreHandleList,
+           .retireFrameCount = retireFrameCount});
+    }
 
-  std::vector<VkFramebuffer> framebufferHandleList(swapchainImageCount,
-                                                   VK_NULL_HANDLE);
+    swapchainHandle = newSwapchainHandle;
+    swapchainExtent = extent;
 
-  for (uint32_t x = 0; x < swapchainImageCount; x++) {
-    std::vector<VkImageView> imageViewHandleList = {
-        swapchainImageViewHandleList[x]};
+    viewport.width = (float)extent.width;
+    viewport.height = (float)extent.height;
+    screenRect2D.extent = extent;
 
-    VkFramebufferCreateInfo framebufferCreateInfo = {
-        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-        .pNext = NULL,
-        .flags = 0,
-        .renderPass = renderPassHandle,
-        .attachmentCount = 1,
-        .pAttachments = imageViewHandleList.data(),
-        .width = surfaceCapabilities.currentExtent.width,
-        .height = surfaceCapabilities.currentExtent.height,
-        .layers = 1};
+    result = vkGetSwapchainImagesKHR(deviceHandle, swapchainHandle,
+                                     &swapchainImageCount, NULL);
 
-    result = vkCreateFramebuffer(deviceHandle, &framebufferCreateInfo, NULL,
-                                 &framebufferHandleList[x]);
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkGetSwapchainImagesKHR");
+    }
+
+    if (swapchainImageCount > maxSwapchainImageCount) {
+      throwExceptionVulkanAPI(VK_ERROR_INITIALIZATION_FAILED,
+                              "vkGetSwapchainImagesKHR");
+    }
+
+    swapchainImageHandleList.assign(swapchainImageCount, VK_NULL_HANDLE);
+    result = vkGetSwapchainImagesKHR(deviceHandle, swapchainHandle,
+                                     &swapchainImageCount,
+                                     swapchainImageHandleList.data());
 
     if (result != VK_SUCCESS) {
-      throwExceptionVulkanAPI(result, "vkCreateFramebuffer");
+      throwExceptionVulkanAPI(result, "vkGetSwapchainImagesKHR");
     }
-  }
+
+    swapchainImageViewHandleList.assign(swapchainImageCount, VK_NULL_HANDLE);
+    framebufferHandleList.assign(swapchainImageCount, VK_NULL_HANDLE);
+    renderFinishedSemaphoreHandleList.assign(swapchainImageCount,
+                                             VK_NULL_HANDLE);
+
+    for (uint32_t x = 0; x < swapchainImageCount; x++) {
+      VkImageViewCreateInfo imageViewCreateInfo = {
+          .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+          .pNext = NULL,
+          .flags = 0,
+          .image = swapchainImageHandleList[x],
+          .viewType = VK_IMAGE_VIEW_TYPE_2D,
+          .format = surfaceFormatList[selectedFormatIndex].format,
+          .components = {VK_COMPONENT_SWIZZLE_IDENTITY,
+                         VK_COMPONENT_SWIZZLE_IDENTITY,
+                         VK_COMPONENT_SWIZZLE_IDENTITY,
+                         VK_COMPONENT_SWIZZLE_IDENTITY},
+          .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
+
+      result = vkCreateImageView(deviceHandle, &imageViewCreateInfo, NULL,
+                                 &swapchainImageViewHandleList[x]);
+
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkCreateImageView");
+      }
+
+      // left null with dynamic rendering, the destroy calls ignore them
+      if (!isDynamicRenderingEnabled) {
+        std::chrono::steady_clock::time_point framebufferStartTimePoint =
+            std::chrono::steady_clock::now();
+
+        std::vector<VkImageView> imageViewHandleList = {
+            swapchainImageViewHandleList[x]};
+
+        VkFramebufferCreateInfo framebufferCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+            .pNext = NULL,
+            .flags = 0,
+            .renderPass = renderPassHandle,
+            .attachmentCount = 1,
+            .pAttachments = imageViewHandleList.data(),
+            .width = extent.width,
+            .height = extent.height,
+            .layers = 1};
+
+        result = vkCreateFramebuffer(deviceHandle, &framebufferCreateInfo,
+                                     NULL, &framebufferHandleList[x]);
+
+        if (result != VK_SUCCESS) {
+          throwExceptionVulkanAPI(result, "vkCreateFramebuffer");
+        }
+
+        renderPassObjectCreationTime +=
+            std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - framebufferStartTimePoint)
+                .count();
+      }
+
+      VkSemaphoreCreateInfo writeImageSemaphoreCreateInfo = {
+          .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+          .pNext = NULL,
+          .flags = 0};
+
+      result = vkCreateSemaphore(deviceHandle, &writeImageSemaphoreCreateInfo,
+                                 NULL, &renderFinishedSemaphoreHandleList[x]);
+
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkCreateSemaphore");
+      }
+    }
+
+    return true;
+  };
+
+  auto destroyRetiredSwapchain = [&](const RetiredSwapchain &retired) {
+    for (uint32_t x = 0; x < retired.framebufferHandleList.size(); x++) {
+      vkDestroyFramebuffer(deviceHandle, retired.framebufferHandleList[x],
+                           NULL);
+      vkDestroyImageView(deviceHandle, retired.imageViewHandleList[x], NULL);
+      vkDestroySemaphore(deviceHandle,
+                         retired.renderFinishedSemaphoreHandleList[x], NULL);
+    }
+
+    vkDestroySwapchainKHR(deviceHandle, retired.swapchainHandle, NULL);
+  };
+
+  bool isSwapchainOutOfDate = !createSwapchain(0);
+
+  std::cout << "rendering: "
+            << (isDynamicRenderingEnabled ? "dynamic" : "render pass")
+            << ", render pass and framebuffer creation (ms): "
+            << renderPassObjectCreationTime << std::endl;
 
   // =========================================================================
   // Descriptor Pool
 
   std::vector<VkDescriptorPoolSize> descriptorPoolSizeList = {
-      {.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .descriptorCount = 1}};
+      {.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+       .descriptorCount = 1}};
 
   VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {
       .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
@@ -742,7 +1294,7 @@ int main() {
 
   std::vector<VkDescriptorSetLayoutBinding> descriptorSetLayoutBindingList = {
       {.binding = 0,
-       .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+       .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
        .descriptorCount = 1,
        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
        .pImmutableSamplers = NULL}};
@@ -855,6 +1407,35 @@ int main() {
     throwExceptionVulkanAPI(result, "vkCreateShaderModule");
   }
 
+  // =========================================================================
+  // Pipeline Cache
+
+  std::string pipelineCachePath = getPipelineCachePath(
+#if defined(PLATFORM_ANDROID)
+      appPtr->activity->internalDataPath,
+#else
+      getCacheDirectoryPath(),
+#endif
+      "triangle");
+
+  std::vector<char> initialPipelineCacheData =
+      readPipelineCacheFile(pipelineCachePath, physicalDeviceProperties);
+
+  VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+      .pNext = NULL,
+      .flags = 0,
+      .initialDataSize = initialPipelineCacheData.size(),
+      .pInitialData = initialPipelineCacheData.data()};
+
+  VkPipelineCache pipelineCacheHandle = VK_NULL_HANDLE;
+  result = vkCreatePipelineCache(deviceHandle, &pipelineCacheCreateInfo, NULL,
+                                 &pipelineCacheHandle);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkCreatePipelineCache");
+  }
+
   // =========================================================================
   // Graphics Pipeline
 
@@ -902,25 +1483,16 @@ int main() {
        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
        .primitiveRestartEnable = VK_FALSE};
 
-  VkViewport viewport = {
-      .x = 0.0f,
-      .y = 0.0f,
-      .width = (float)surfaceCapabilities.currentExtent.width,
-      .height = (float)surfaceCapabilities.currentExtent.height,
-      .minDepth = 0.0f,
-      .maxDepth = 1.0f};
-
-  VkRect2D screenRect2D = {.offset = {.x = 0, .y = 0},
-                           .extent = surfaceCapabilities.currentExtent};
-
+  // viewport and scissor follow the swapchain extent, keeping them dynamic
+  // lets a resize reuse the pipeline
   VkPipelineViewportStateCreateInfo pipelineViewportStateCreateInfo = {
       .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
       .pNext = NULL,
       .flags = 0,
       .viewportCount = 1,
-      .pViewports = &viewport,
+      .pViewports = NULL,
       .scissorCount = 1,
-      .pScissors = &screenRect2D};
+      .pScissors = NULL};
 
   VkPipelineRasterizationStateCreateInfo pipelineRasterizationStateCreateInfo =
       {.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
@@ -969,9 +1541,37 @@ int main() {
       .pAttachments = &pipelineColorBlendAttachmentState,
       .blendConstants = {0, 0, 0, 0}};
 
+  std::vector<VkDynamicState> dynamicStateList = {VK_DYNAMIC_STATE_VIEWPORT,
+                                                  VK_DYNAMIC_STATE_SCISSOR};
+
+  if (isExtendedDynamicStateEnabled) {
+    dynamicStateList.insert(dynamicStateList.end(),
+                            {VK_DYNAMIC_STATE_CULL_MODE,
+                             VK_DYNAMIC_STATE_FRONT_FACE,
+                             VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY});
+  }
+
+  VkPipelineDynamicStateCreateInfo pipelineDynamicStateCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+      .pNext = NULL,
+      .flags = 0,
+      .dynamicStateCount = (uint32_t)dynamicStateList.size(),
+      .pDynamicStates = dynamicStateList.data()};
+
+  // only the attachment format is needed, the pipeline stays valid across
+  // swapchain recreation as long as the surface format does not change
+  VkPipelineRenderingCreateInfo pipelineRenderingCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+      .pNext = NULL,
+      .viewMask = 0,
+      .colorAttachmentCount = 1,
+      .pColorAttachmentFormats = &surfaceFormatList[selectedFormatIndex].format,
+      .depthAttachmentFormat = VK_FORMAT_UNDEFINED,
+      .stencilAttachmentFormat = VK_FORMAT_UNDEFINED};
+
   VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo = {
       .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-      .pNext = NULL,
+      .pNext = isDynamicRenderingEnabled ? &pipelineRenderingCreateInfo : NULL,
       .flags = 0,
       .stageCount = (uint32_t)pipelineShaderStageCreateInfoList.size(),
       .pStages = pipelineShaderStageCreateInfoList.data(),
@@ -983,15 +1583,18 @@ int main() {
       .pMultisampleState = &pipelineMultisampleStateCreateInfo,
       .pDepthStencilState = NULL,
       .pColorBlendState = &pipelineColorBlendStateCreateInfo,
-      .pDynamicState = NULL,
+      .pDynamicState = &pipelineDynamicStateCreateInfo,
       .layout = pipelineLayoutHandle,
       .renderPass = renderPassHandle,
       .subpass = 0,
       .basePipelineHandle = VK_NULL_HANDLE,
       .basePipelineIndex = 0};
 
+  std::chrono::steady_clock::time_point pipelineStartTimePoint =
+      std::chrono::steady_clock::now();
+
   VkPipeline graphicsPipelineHandle = VK_NULL_HANDLE;
-  result = vkCreateGraphicsPipelines(deviceHandle, VK_NULL_HANDLE, 1,
+  result = vkCreateGraphicsPipelines(deviceHandle, pipelineCacheHandle, 1,
                                      &graphicsPipelineCreateInfo, NULL,
                                      &graphicsPipelineHandle);
 
@@ -999,6 +1602,14 @@ int main() {
     throwExceptionVulkanAPI(result, "vkCreateGraphicsPipelines");
   }
 
+  std::cout << "graphics pipeline creation (ms): "
+            << std::chrono::duration<double, std::milli>(
+                   std::chrono::steady_clock::now() - pipelineStartTimePoint)
+                   .count()
+            << (initialPipelineCacheData.empty() ? " (cold cache)"
+                                                 : " (warm cache)")
+            << std::endl;
+
   // =========================================================================
   // Vertex Buffer
 
@@ -1015,7 +1626,7 @@ int main() {
       .flags = 0,
       .size = sizeof(vertexBuffer),
       .usage =
-          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
       .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
       .queueFamilyIndexCount = 1,
       .pQueueFamilyIndices = &queueFamilyIndex};
@@ -1032,17 +1643,24 @@ int main() {
   vkGetBufferMemoryRequirements(deviceHandle, vertexBufferHandle,
                                 &vertexMemoryRequirements);
 
-  uint32_t vertexMemoryTypeIndex = -1;
-  for (uint32_t x = 0; x < physicalDeviceMemoryProperties.memoryTypeCount;
-       x++) {
-    if ((vertexMemoryRequirements.memoryTypeBits & (1 << x)) &&
-        (physicalDeviceMemoryProperties.memoryTypes[x].propertyFlags &
-         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ==
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+  // static geometry lives in device local memory, it is only written
+  // directly when that memory is also host visible (resizable BAR, UMA)
+  VkMemoryPropertyFlags geometryMemoryPropertyFlags =
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
 
-      vertexMemoryTypeIndex = x;
-      break;
-    }
+  uint32_t vertexMemoryTypeIndex = findMemoryTypeIndex(
+      physicalDeviceMemoryProperties, vertexMemoryRequirements.memoryTypeBits,
+      geometryMemoryPropertyFlags);
+
+  bool isGeometryStaged = vertexMemoryTypeIndex == (uint32_t)-1;
+
+  if (isGeometryStaged) {
+    geometryMemoryPropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    vertexMemoryTypeIndex = findMemoryTypeIndex(
+        physicalDeviceMemoryProperties,
+        vertexMemoryRequirements.memoryTypeBits, geometryMemoryPropertyFlags);
   }
 
   VkMemoryAllocateInfo vertexMemoryAllocateInfo = {
@@ -1064,18 +1682,6 @@ int main() {
     throwExceptionVulkanAPI(result, "vkBindBufferMemory");
   }
 
-  void *hostVertexMemoryBuffer;
-  result = vkMapMemory(deviceHandle, vertexDeviceMemoryHandle, 0,
-                       sizeof(vertexBuffer), 0, &hostVertexMemoryBuffer);
-
-  memcpy(hostVertexMemoryBuffer, vertexBuffer, sizeof(vertexBuffer));
-
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkMapMemory");
-  }
-
-  vkUnmapMemory(deviceHandle, vertexDeviceMemoryHandle);
-
   // =========================================================================
   // Index Buffer
 
@@ -1090,7 +1696,7 @@ int main() {
       .flags = 0,
       .size = sizeof(indexBuffer),
       .usage =
-          VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+          VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
       .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
       .queueFamilyIndexCount = 1,
       .pQueueFamilyIndices = &queueFamilyIndex};
@@ -1107,18 +1713,9 @@ int main() {
   vkGetBufferMemoryRequirements(deviceHandle, indexBufferHandle,
                                 &indexMemoryRequirements);
 
-  uint32_t indexMemoryTypeIndex = -1;
-  for (uint32_t x = 0; x < physicalDeviceMemoryProperties.memoryTypeCount;
-       x++) {
-    if ((indexMemoryRequirements.memoryTypeBits & (1 << x)) &&
-        (physicalDeviceMemoryProperties.memoryTypes[x].propertyFlags &
-         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ==
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
-
-      indexMemoryTypeIndex = x;
-      break;
-    }
-  }
+  uint32_t indexMemoryTypeIndex = findMemoryTypeIndex(
+      physicalDeviceMemoryProperties, indexMemoryRequirements.memoryTypeBits,
+      geometryMemoryPropertyFlags);
 
   VkMemoryAllocateInfo indexMemoryAllocateInfo = {
       .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
@@ -1139,17 +1736,223 @@ int main() {
     throwExceptionVulkanAPI(result, "vkBindBufferMemory");
   }
 
-  void *hostIndexMemoryBuffer;
-  result = vkMapMemory(deviceHandle, indexDeviceMemoryHandle, 0,
-                       sizeof(indexBuffer), 0, &hostIndexMemoryBuffer);
+  // =========================================================================
+  // Geometry Upload
 
-  memcpy(hostIndexMemoryBuffer, indexBuffer, sizeof(indexBuffer));
+  std::chrono::steady_clock::time_point uploadStartTimePoint =
+      std::chrono::steady_clock::now();
 
-  if (result != VK_SUCCESS) {
-    throwExceptionVulkanAPI(result, "vkMapMemory");
+  if (isGeometryStaged) {
+    VkBufferCreateInfo stagingBufferCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .size = sizeof(vertexBuffer) + sizeof(indexBuffer),
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 1,
+        .pQueueFamilyIndices = &queueFamilyIndex};
+
+    VkBuffer stagingBufferHandle = VK_NULL_HANDLE;
+    result = vkCreateBuffer(deviceHandle, &stagingBufferCreateInfo, NULL,
+                            &stagingBufferHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateBuffer");
+    }
+
+    VkMemoryRequirements stagingMemoryRequirements;
+    vkGetBufferMemoryRequirements(deviceHandle, stagingBufferHandle,
+                                  &stagingMemoryRequirements);
+
+    VkMemoryAllocateInfo stagingMemoryAllocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = NULL,
+        .allocationSize = stagingMemoryRequirements.size,
+        .memoryTypeIndex = findMemoryTypeIndex(
+            physicalDeviceMemoryProperties,
+            stagingMemoryRequirements.memoryTypeBits,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)};
+
+    VkDeviceMemory stagingDeviceMemoryHandle = VK_NULL_HANDLE;
+    result = vkAllocateMemory(deviceHandle, &stagingMemoryAllocateInfo, NULL,
+                              &stagingDeviceMemoryHandle);
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkAllocateMemory");
+    }
+
+    result = vkBindBufferMemory(deviceHandle, stagingBufferHandle,
+                                stagingDeviceMemoryHandle, 0);
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkBindBufferMemory");
+    }
+
+    void *hostStagingMemoryBuffer;
+    result = vkMapMemory(deviceHandle, stagingDeviceMemoryHandle, 0,
+                         VK_WHOLE_SIZE, 0, &hostStagingMemoryBuffer);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkMapMemory");
+    }
+
+    memcpy(hostStagingMemoryBuffer, vertexBuffer, sizeof(vertexBuffer));
+    memcpy((char *)hostStagingMemoryBuffer + sizeof(vertexBuffer),
+           indexBuffer, sizeof(indexBuffer));
+
+    vkUnmapMemory(deviceHandle, stagingDeviceMemoryHandle);
+
+    VkCommandBufferAllocateInfo uploadCommandBufferAllocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .pNext = NULL,
+        .commandPool = commandPoolHandle,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1};
+
+    VkCommandBuffer uploadCommandBufferHandle = VK_NULL_HANDLE;
+    result = vkAllocateCommandBuffers(deviceHandle,
+                                      &uploadCommandBufferAllocateInfo,
+                                      &uploadCommandBufferHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkAllocateCommandBuffers");
+    }
+
+    VkCommandBufferBeginInfo uploadCommandBufferBeginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = NULL,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = NULL};
+
+    result = vkBeginCommandBuffer(uploadCommandBufferHandle,
+                                  &uploadCommandBufferBeginInfo);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkBeginCommandBuffer");
+    }
+
+    VkBufferCopy vertexBufferCopy = {
+        .srcOffset = 0, .dstOffset = 0, .size = sizeof(vertexBuffer)};
+
+    vkCmdCopyBuffer(uploadCommandBufferHandle, stagingBufferHandle,
+                    vertexBufferHandle, 1, &vertexBufferCopy);
+
+    VkBufferCopy indexBufferCopy = {.srcOffset = sizeof(vertexBuffer),
+                                    .dstOffset = 0,
+                                    .size = sizeof(indexBuffer)};
+
+    vkCmdCopyBuffer(uploadCommandBufferHandle, stagingBufferHandle,
+                    indexBufferHandle, 1, &indexBufferCopy);
+
+    std::vector<VkBufferMemoryBarrier> geometryBufferMemoryBarrierList = {
+        {.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+         .pNext = NULL,
+         .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+         .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+         .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+         .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+         .buffer = vertexBufferHandle,
+         .offset = 0,
+         .size = VK_WHOLE_SIZE},
+        {.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+         .pNext = NULL,
+         .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+         .dstAccessMask = VK_ACCESS_INDEX_READ_BIT,
+         .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+         .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+         .buffer = indexBufferHandle,
+         .offset = 0,
+         .size = VK_WHOLE_SIZE}};
+
+    vkCmdPipelineBarrier(
+        uploadCommandBufferHandle, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, NULL,
+        (uint32_t)geometryBufferMemoryBarrierList.size(),
+        geometryBufferMemoryBarrierList.data(), 0, NULL);
+
+    result = vkEndCommandBuffer(uploadCommandBufferHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkEndCommandBuffer");
+    }
+
+    VkFenceCreateInfo uploadFenceCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0};
+
+    VkFence uploadFenceHandle = VK_NULL_HANDLE;
+    result = vkCreateFence(deviceHandle, &uploadFenceCreateInfo, NULL,
+                           &uploadFenceHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateFence");
+    }
+
+    VkSubmitInfo uploadSubmitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = NULL,
+        .waitSemaphoreCount = 0,
+        .pWaitSemaphores = NULL,
+        .pWaitDstStageMask = NULL,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &uploadCommandBufferHandle,
+        .signalSemaphoreCount = 0,
+        .pSignalSemaphores = NULL};
+
+    result = vkQueueSubmit(queueHandle, 1, &uploadSubmitInfo,
+                           uploadFenceHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkQueueSubmit");
+    }
+
+    result = vkWaitForFences(deviceHandle, 1, &uploadFenceHandle, true,
+                             UINT64_MAX);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkWaitForFences");
+    }
+
+    vkDestroyFence(deviceHandle, uploadFenceHandle, NULL);
+    vkFreeCommandBuffers(deviceHandle, commandPoolHandle, 1,
+                         &uploadCommandBufferHandle);
+    vkFreeMemory(deviceHandle, stagingDeviceMemoryHandle, NULL);
+    vkDestroyBuffer(deviceHandle, stagingBufferHandle, NULL);
+  } else {
+    void *hostVertexMemoryBuffer;
+    result = vkMapMemory(deviceHandle, vertexDeviceMemoryHandle, 0,
+                         sizeof(vertexBuffer), 0, &hostVertexMemoryBuffer);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkMapMemory");
+    }
+
+    memcpy(hostVertexMemoryBuffer, vertexBuffer, sizeof(vertexBuffer));
+    vkUnmapMemory(deviceHandle, vertexDeviceMemoryHandle);
+
+    void *hostIndexMemoryBuffer;
+    result = vkMapMemory(deviceHandle, indexDeviceMemoryHandle, 0,
+                         sizeof(indexBuffer), 0, &hostIndexMemoryBuffer);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkMapMemory");
+    }
+
+    memcpy(hostIndexMemoryBuffer, indexBuffer, sizeof(indexBuffer));
+    vkUnmapMemory(deviceHandle, indexDeviceMemoryHandle);
   }
 
-  vkUnmapMemory(deviceHandle, indexDeviceMemoryHandle);
+  double uploadSeconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() -
+                             uploadStartTimePoint)
+                             .count();
+
+  // too little data for a transfer rate to mean anything
+  std::cout << "geometry upload: "
+            << (isGeometryStaged ? "staged" : "direct") << ", "
+            << sizeof(vertexBuffer) + sizeof(indexBuffer) << " bytes in "
+            << uploadSeconds * 1000.0 << " ms" << std::endl;
 
   // =========================================================================
   // Uniform Buffer
@@ -1163,11 +1966,20 @@ int main() {
     uint32_t frameCount = 0;
   } uniformStructure;
 
+  // one slot per swapchain image, selected with a dynamic offset so a frame
+  // update is a single memcpy into memory the GPU is no longer reading
+  VkDeviceSize minUniformBufferOffsetAlignment =
+      physicalDeviceProperties.limits.minUniformBufferOffsetAlignment;
+
+  VkDeviceSize uniformSlotSize =
+      (sizeof(UniformStructure) + minUniformBufferOffsetAlignment - 1) /
+      minUniformBufferOffsetAlignment * minUniformBufferOffsetAlignment;
+
   VkBufferCreateInfo uniformBufferCreateInfo = {
       .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
       .pNext = NULL,
       .flags = 0,
-      .size = sizeof(UniformStructure),
+      .size = uniformSlotSize * maxSwapchainImageCount,
       .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
       .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
       .queueFamilyIndexCount = 1,
@@ -1185,18 +1997,10 @@ int main() {
   vkGetBufferMemoryRequirements(deviceHandle, uniformBufferHandle,
                                 &uniformMemoryRequirements);
 
-  uint32_t uniformMemoryTypeIndex = -1;
-  for (uint32_t x = 0; x < physicalDeviceMemoryProperties.memoryTypeCount;
-       x++) {
-    if ((uniformMemoryRequirements.memoryTypeBits & (1 << x)) &&
-        (physicalDeviceMemoryProperties.memoryTypes[x].propertyFlags &
-         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ==
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
-
-      uniformMemoryTypeIndex = x;
-      break;
-    }
-  }
+  uint32_t uniformMemoryTypeIndex = findMemoryTypeIndex(
+      physicalDeviceMemoryProperties, uniformMemoryRequirements.memoryTypeBits,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
   VkMemoryAllocateInfo uniformMemoryAllocateInfo = {
       .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
@@ -1217,23 +2021,27 @@ int main() {
     throwExceptionVulkanAPI(result, "vkBindBufferMemory");
   }
 
+  // mapped for the lifetime of the buffer
   void *hostUniformMemoryBuffer;
   result = vkMapMemory(deviceHandle, uniformDeviceMemoryHandle, 0,
-                       sizeof(UniformStructure), 0, &hostUniformMemoryBuffer);
-
-  memcpy(hostUniformMemoryBuffer, &uniformStructure, sizeof(UniformStructure));
+                       VK_WHOLE_SIZE, 0, &hostUniformMemoryBuffer);
 
   if (result != VK_SUCCESS) {
     throwExceptionVulkanAPI(result, "vkMapMemory");
   }
 
-  vkUnmapMemory(deviceHandle, uniformDeviceMemoryHandle);
+  for (uint32_t x = 0; x < maxSwapchainImageCount; x++) {
+    memcpy((char *)hostUniformMemoryBuffer + x * uniformSlotSize,
+           &uniformStructure, sizeof(UniformStructure));
+  }
 
   // =========================================================================
   // Update Descriptor Set
 
   VkDescriptorBufferInfo uniformDescriptorInfo = {
-      .buffer = uniformBufferHandle, .offset = 0, .range = VK_WHOLE_SIZE};
+      .buffer = uniformBufferHandle,
+      .offset = 0,
+      .range = sizeof(UniformStructure)};
 
   std::vector<VkWriteDescriptorSet> writeDescriptorSetList = {
       {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
@@ -1242,7 +2050,7 @@ int main() {
        .dstBinding = 0,
        .dstArrayElement = 0,
        .descriptorCount = 1,
-       .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+       .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
        .pImageInfo = NULL,
        .pBufferInfo = &uniformDescriptorInfo,
        .pTexelBufferView = NULL}};
@@ -1250,78 +2058,262 @@ int main() {
   vkUpdateDescriptorSets(deviceHandle, writeDescriptorSetList.size(),
                          writeDescriptorSetList.data(), 0, NULL);
 
+  // =========================================================================
+  // Timestamp Query Pool
+
+  // per swapchain image: render pass begin, render pass end
+  uint32_t timestampQueryCount = 2;
+
+  uint32_t timestampValidBits =
+      queueFamilyPropertiesList[queueFamilyIndex].timestampValidBits;
+
+  uint64_t timestampMask = timestampValidBits >= 64
+                               ? UINT64_MAX
+                               : ((uint64_t)1 << timestampValidBits) - 1;
+
+  VkQueryPool timestampQueryPoolHandle = VK_NULL_HANDLE;
+
+  if (timestampValidBits > 0) {
+    VkQueryPoolCreateInfo timestampQueryPoolCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = timestampQueryCount * maxSwapchainImageCount,
+        .pipelineStatistics = 0};
+
+    result = vkCreateQueryPool(deviceHandle, &timestampQueryPoolCreateInfo,
+                               NULL, &timestampQueryPoolHandle);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkCreateQueryPool");
+    }
+  }
+
   // =========================================================================
   // Record Render Pass Command Buffers
 
-  for (uint32_t x = 0; x < swapchainImageCount; x++) {
+  // pre-recorded once per swapchain image, the low latency loop re-records
+  // the command buffer every frame right after sampling the camera instead
+  auto recordCommandBuffer = [&](uint32_t imageIndex) {
     VkCommandBufferBeginInfo renderCommandBufferBeginInfo = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
         .pNext = NULL,
-        .flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        .flags = isLowLatencyEnabled
+                     ? (VkCommandBufferUsageFlags)
+                           VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+                     : 0,
         .pInheritanceInfo = NULL};
 
-    result = vkBeginCommandBuffer(commandBufferHandleList[x],
+    result = vkBeginCommandBuffer(commandBufferHandleList[imageIndex],
                                   &renderCommandBufferBeginInfo);
 
     if (result != VK_SUCCESS) {
       throwExceptionVulkanAPI(result, "vkBeginCommandBuffer");
     }
 
+    if (timestampQueryPoolHandle != VK_NULL_HANDLE) {
+      vkCmdResetQueryPool(commandBufferHandleList[imageIndex],
+                          timestampQueryPoolHandle,
+                          imageIndex * timestampQueryCount,
+                          timestampQueryCount);
+
+      vkCmdWriteTimestamp(commandBufferHandleList[imageIndex],
+                          VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                          timestampQueryPoolHandle,
+                          imageIndex * timestampQueryCount);
+    }
+
     std::vector<VkClearValue> clearValueList = {
         {.color = {0.0f, 0.0f, 0.0f, 1.0f}}, };
 
-    VkRenderPassBeginInfo renderPassBeginInfo = {
-        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-        .pNext = NULL,
-        .renderPass = renderPassHandle,
-        .framebuffer = framebufferHandleList[x],
-        .renderArea = screenRect2D,
-        .clearValueCount = (uint32_t)clearValueList.size(),
-        .pClearValues = clearValueList.data()};
-
-    vkCmdBeginRenderPass(commandBufferHandleList[x], &renderPassBeginInfo,
-                         VK_SUBPASS_CONTENTS_INLINE);
+    VkImageSubresourceRange colorSubresourceRange = {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .baseMipLevel = 0,
+        .levelCount = 1,
+        .baseArrayLayer = 0,
+        .layerCount = 1};
+
+    if (isDynamicRenderingEnabled) {
+      // the source stage matches the acquire semaphore's wait stage so the
+      // transition is ordered after the presentation engine releases the image
+      VkImageMemoryBarrier2 colorAttachmentImageMemoryBarrier = {
+          .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+          .pNext = NULL,
+          .srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+          .srcAccessMask = VK_ACCESS_2_NONE,
+          .dstStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+          .dstAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+          .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+          .newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+          .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .image = swapchainImageHandleList[imageIndex],
+          .subresourceRange = colorSubresourceRange};
+
+      VkDependencyInfo colorAttachmentDependencyInfo = {
+          .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+          .pNext = NULL,
+          .dependencyFlags = 0,
+          .memoryBarrierCount = 0,
+          .pMemoryBarriers = NULL,
+          .bufferMemoryBarrierCount = 0,
+          .pBufferMemoryBarriers = NULL,
+          .imageMemoryBarrierCount = 1,
+          .pImageMemoryBarriers = &colorAttachmentImageMemoryBarrier};
+
+      vkCmdPipelineBarrier2(commandBufferHandleList[imageIndex],
+                            &colorAttachmentDependencyInfo);
+
+      VkRenderingAttachmentInfo colorAttachmentInfo = {
+          .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+          .pNext = NULL,
+          .imageView = swapchainImageViewHandleList[imageIndex],
+          .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+          .resolveMode = VK_RESOLVE_MODE_NONE,
+          .resolveImageView = VK_NULL_HANDLE,
+          .resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+          .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+          .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+          .clearValue = clearValueList[0]};
+
+      VkRenderingInfo renderingInfo = {
+          .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+          .pNext = NULL,
+          .flags = 0,
+          .renderArea = screenRect2D,
+          .layerCount = 1,
+          .viewMask = 0,
+          .colorAttachmentCount = 1,
+          .pColorAttachments = &colorAttachmentInfo,
+          .pDepthAttachment = NULL,
+          .pStencilAttachment = NULL};
+
+      vkCmdBeginRendering(commandBufferHandleList[imageIndex], &renderingInfo);
+    } else {
+      VkRenderPassBeginInfo renderPassBeginInfo = {
+          .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+          .pNext = NULL,
+          .renderPass = renderPassHandle,
+          .framebuffer = framebufferHandleList[imageIndex],
+          .renderArea = screenRect2D,
+          .clearValueCount = (uint32_t)clearValueList.size(),
+          .pClearValues = clearValueList.data()};
+
+      vkCmdBeginRenderPass(commandBufferHandleList[imageIndex],
+                           &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    }
 
-    vkCmdBindPipeline(commandBufferHandleList[x],
+    vkCmdBindPipeline(commandBufferHandleList[imageIndex],
                       VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelineHandle);
 
+    vkCmdSetViewport(commandBufferHandleList[imageIndex], 0, 1, &viewport);
+    vkCmdSetScissor(commandBufferHandleList[imageIndex], 0, 1, &screenRect2D);
+
+    if (isExtendedDynamicStateEnabled) {
+      pvkCmdSetCullMode(commandBufferHandleList[imageIndex],
+                        pipelineRasterizationStateCreateInfo.cullMode);
+      pvkCmdSetFrontFace(commandBufferHandleList[imageIndex],
+                         pipelineRasterizationStateCreateInfo.frontFace);
+      pvkCmdSetPrimitiveTopology(
+          commandBufferHandleList[imageIndex],
+          pipelineInputAssemblyStateCreateInfo.topology);
+    }
+
     VkDeviceSize offset = 0;
-    vkCmdBindVertexBuffers(commandBufferHandleList[x], 0, 1,
+    vkCmdBindVertexBuffers(commandBufferHandleList[imageIndex], 0, 1,
                            &vertexBufferHandle, &offset);
 
-    vkCmdBindIndexBuffer(commandBufferHandleList[x], indexBufferHandle, 0,
-                         VK_INDEX_TYPE_UINT32);
+    vkCmdBindIndexBuffer(commandBufferHandleList[imageIndex],
+                         indexBufferHandle, 0, VK_INDEX_TYPE_UINT32);
 
+    uint32_t uniformDynamicOffset = imageIndex * uniformSlotSize;
     vkCmdBindDescriptorSets(
-        commandBufferHandleList[x], VK_PIPELINE_BIND_POINT_GRAPHICS,
+        commandBufferHandleList[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS,
         pipelineLayoutHandle, 0, (uint32_t)descriptorSetHandleList.size(),
-        descriptorSetHandleList.data(), 0, NULL);
+        descriptorSetHandleList.data(), 1, &uniformDynamicOffset);
 
-    vkCmdDrawIndexed(commandBufferHandleList[x],
+    vkCmdDrawIndexed(commandBufferHandleList[imageIndex],
                      sizeof(indexBuffer) / sizeof(uint32_t), 1, 0, 0, 0);
 
-    vkCmdEndRenderPass(commandBufferHandleList[x]);
+    if (isDynamicRenderingEnabled) {
+      vkCmdEndRendering(commandBufferHandleList[imageIndex]);
+
+      // what the render pass's final layout did, presentation is ordered by
+      // the render finished semaphore so nothing waits on this barrier
+      VkImageMemoryBarrier2 presentImageMemoryBarrier = {
+          .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+          .pNext = NULL,
+          .srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+          .srcAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+          .dstStageMask = VK_PIPELINE_STAGE_2_NONE,
+          .dstAccessMask = VK_ACCESS_2_NONE,
+          .oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+          .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+          .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .image = swapchainImageHandleList[imageIndex],
+          .subresourceRange = colorSubresourceRange};
+
+      VkDependencyInfo presentDependencyInfo = {
+          .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+          .pNext = NULL,
+          .dependencyFlags = 0,
+          .memoryBarrierCount = 0,
+          .pMemoryBarriers = NULL,
+          .bufferMemoryBarrierCount = 0,
+          .pBufferMemoryBarriers = NULL,
+          .imageMemoryBarrierCount = 1,
+          .pImageMemoryBarriers = &presentImageMemoryBarrier};
+
+      vkCmdPipelineBarrier2(commandBufferHandleList[imageIndex],
+                            &presentDependencyInfo);
+    } else {
+      vkCmdEndRenderPass(commandBufferHandleList[imageIndex]);
+    }
 
-    result = vkEndCommandBuffer(commandBufferHandleList[x]);
+    if (timestampQueryPoolHandle != VK_NULL_HANDLE) {
+      vkCmdWriteTimestamp(commandBufferHandleList[imageIndex],
+                          VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                          timestampQueryPoolHandle,
+                          imageIndex * timestampQueryCount + 1);
+    }
+
+    result = vkEndCommandBuffer(commandBufferHandleList[imageIndex]);
 
     if (result != VK_SUCCESS) {
       throwExceptionVulkanAPI(result, "vkEndCommandBuffer");
     }
+  };
+
+  // a recreated swapchain invalidates the recorded framebuffers, the command
+  // buffers are re-recorded the next time their image is acquired
+  std::vector<bool> isCommandBufferRecordedList(maxSwapchainImageCount,
+                                                false);
+
+  if (!isLowLatencyEnabled) {
+    for (uint32_t x = 0; x < swapchainImageCount; x++) {
+      recordCommandBuffer(x);
+      isCommandBufferRecordedList[x] = true;
+    }
   }
 
   // =========================================================================
   // Fences, Semaphores
 
-  std::vector<VkFence> inFlightFenceHandleList(swapchainImageCount,
-                                                     VK_NULL_HANDLE);
+  // the low latency loop keeps a single frame in flight, so input sampled
+  // for a frame is never queued behind other frames that were already
+  // recorded
+  uint32_t frameInFlightCount =
+      isLowLatencyEnabled ? 1 : swapchainMinImageCount;
 
-  std::vector<VkSemaphore> imageAvailableSemaphoreHandleList(swapchainImageCount,
-                                                           VK_NULL_HANDLE);
+  std::vector<VkFence> inFlightFenceHandleList(frameInFlightCount,
+                                               VK_NULL_HANDLE);
 
-  std::vector<VkSemaphore> renderFinishedSemaphoreHandleList(swapchainImageCount,
-                                                         VK_NULL_HANDLE);
+  std::vector<VkSemaphore> imageAvailableSemaphoreHandleList(
+      frameInFlightCount, VK_NULL_HANDLE);
 
-  for (uint32_t x = 0; x < swapchainImageCount; x++) {
+  for (uint32_t x = 0; x < frameInFlightCount; x++) {
     VkFenceCreateInfo imageAvailableFenceCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
         .pNext = NULL,
@@ -1345,28 +2337,166 @@ int main() {
     if (result != VK_SUCCESS) {
       throwExceptionVulkanAPI(result, "vkCreateSemaphore");
     }
+  }
 
-    VkSemaphoreCreateInfo writeImageSemaphoreCreateInfo = {
-        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
-        .pNext = NULL,
-        .flags = 0};
+  // =========================================================================
+  // Main Loop
 
-    result = vkCreateSemaphore(deviceHandle, &writeImageSemaphoreCreateInfo,
-                               NULL, &renderFinishedSemaphoreHandleList[x]);
+  // fence of the last submission that used each image's command buffer,
+  // uniform slot and timestamp queries, kept across swapchain recreation
+  std::vector<VkFence> imageInFlightFenceHandleList(maxSwapchainImageCount,
+                                                    VK_NULL_HANDLE);
 
-    if (result != VK_SUCCESS) {
-      throwExceptionVulkanAPI(result, "vkCreateSemaphore");
+  // stands in for input, the camera orbits the origin at a fixed rate and is
+  // sampled as late as possible before the uniform update
+  std::chrono::steady_clock::time_point cameraTimePoint =
+      std::chrono::steady_clock::now();
+
+  auto sampleCamera = [&]() {
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - cameraTimePoint)
+                         .count();
+
+    uniformStructure.cameraPosition[0] = (float)sin(seconds * 1.5707963);
+    uniformStructure.cameraPosition[2] = (float)-cos(seconds * 1.5707963);
+  };
+
+  struct PendingFrame {
+    uint64_t presentId;
+    uint32_t frameIndex;
+    std::chrono::steady_clock::time_point inputTimePoint;
+  };
+
+  std::deque<PendingFrame> pendingFrameList;
+  double latencySum = 0;
+  uint64_t latencyCount = 0;
+  double totalLatencySum = 0;
+  uint64_t totalLatencyCount = 0;
+
+  auto addLatency = [&](const PendingFrame &pendingFrame) {
+    double latency = std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() -
+                         pendingFrame.inputTimePoint)
+                         .count();
+
+    latencySum += latency;
+    latencyCount += 1;
+    totalLatencySum += latency;
+    totalLatencyCount += 1;
+  };
+
+  // retires every frame that reached the display without blocking, present
+  // ids are handed out in order so the first pending one is the oldest
+  auto pollPresentedFrames = [&]() {
+    while (!pendingFrameList.empty()) {
+      result = pvkWaitForPresentKHR(deviceHandle, swapchainHandle,
+                                    pendingFrameList.front().presentId, 0);
+
+      if (result == VK_TIMEOUT) {
+        break;
+      }
+
+      if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        isSwapchainOutOfDate = true;
+        break;
+      }
+
+      if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+        throwExceptionVulkanAPI(result, "vkWaitForPresentKHR");
+      }
+
+      addLatency(pendingFrameList.front());
+      pendingFrameList.pop_front();
     }
-  }
+  };
 
-  // =========================================================================
-  // Main Loop
+  uint64_t swapchainRecreateCount = 0;
+
+  // frames presented to a retired swapchain can no longer be waited on, they
+  // are dropped from the latency statistics
+  auto recreateSwapchain = [&](uint64_t retireFrameCount) -> bool {
+    if (!createSwapchain(retireFrameCount)) {
+      return false;
+    }
+
+    std::fill(isCommandBufferRecordedList.begin(),
+              isCommandBufferRecordedList.end(), false);
+
+    if (isPresentWaitEnabled) {
+      pendingFrameList.clear();
+    }
+
+    swapchainRecreateCount += 1;
+    return true;
+  };
+
+  // retired objects may still be read by presents queued behind the frames
+  // submitted before the retirement, so they are kept until a frame
+  // submitted after it has completed
+  auto destroyCompletedRetiredSwapchains = [&](uint64_t completedFrameCount) {
+    auto retiredIterator = retiredSwapchainList.begin();
+    while (retiredIterator != retiredSwapchainList.end()) {
+      if (retiredIterator->retireFrameCount < completedFrameCount) {
+        destroyRetiredSwapchain(*retiredIterator);
+        retiredIterator = retiredSwapchainList.erase(retiredIterator);
+      } else {
+        retiredIterator++;
+      }
+    }
+  };
+
+  std::string latencyName = isPresentWaitEnabled
+                                ? "input-to-present latency (ms)"
+                                : "input-to-render latency (ms)";
+
+  uint64_t frameCount = 0, frameCountReported = 0;
+  double cpuTimeSum = 0;
+
+  double gpuRenderPassTimeSum = 0;
+  uint64_t gpuRenderPassTimeCount = 0;
+
+  std::chrono::steady_clock::time_point startTimePoint =
+      std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point reportTimePoint = startTimePoint;
 
   uint32_t currentFrame = 0;
-  while (true) {
+  while (!isExitRequested) {
+    std::chrono::steady_clock::time_point frameStartTimePoint =
+        std::chrono::steady_clock::now();
+
+    if (maxFrameCount > 0 && frameCount >= maxFrameCount) {
+      break;
+    }
+
+    if (maxSeconds > 0 &&
+        std::chrono::duration<double>(frameStartTimePoint - startTimePoint)
+                .count() >= maxSeconds) {
+      break;
+    }
+
 #if defined(PLATFORM_LINUX)
-    XEvent event;
-    XNextEvent(displayPtr, &event);
+    // drain whatever is queued without blocking, frames are paced by the
+    // fences and the present mode rather than by input
+    while (XPending(displayPtr) > 0) {
+      XEvent event;
+      XNextEvent(displayPtr, &event);
+
+      if (event.type == ClientMessage &&
+          (Atom)event.xclient.data.l[0] == deleteWindowAtom) {
+        isExitRequested = 1;
+      }
+
+      // not every driver reports a resized window through the swapchain
+      if (event.type == ConfigureNotify &&
+          ((uint32_t)event.xconfigure.width != swapchainExtent.width ||
+           (uint32_t)event.xconfigure.height != swapchainExtent.height)) {
+        isSwapchainOutOfDate = true;
+      }
+    }
+
+    if (isExitRequested) {
+      break;
+    }
 #elif defined(PLATFORM_ANDROID)
     int ident;
     int events;
@@ -1390,17 +2520,34 @@ int main() {
 
     result = vkWaitForFences(deviceHandle, 1,
                              &inFlightFenceHandleList[currentFrame], true,
-                             UINT32_MAX);
+                             UINT64_MAX);
 
-    if (result != VK_SUCCESS && result != VK_TIMEOUT) {
+    if (result != VK_SUCCESS) {
       throwExceptionVulkanAPI(result, "vkWaitForFences");
     }
 
-    result = vkResetFences(deviceHandle, 1,
-                           &inFlightFenceHandleList[currentFrame]);
+    // without present wait the fence is the closest observable point, the
+    // frame that signaled it was submitted frameInFlightCount frames ago
+    if (isPresentWaitEnabled) {
+      pollPresentedFrames();
+    } else if (!pendingFrameList.empty() &&
+               pendingFrameList.front().frameIndex == currentFrame) {
+      addLatency(pendingFrameList.front());
+      pendingFrameList.pop_front();
+    }
 
-    if (result != VK_SUCCESS) {
-      throwExceptionVulkanAPI(result, "vkResetFences");
+    destroyCompletedRetiredSwapchains(
+        frameCount >= frameInFlightCount ? frameCount - frameInFlightCount + 1
+                                         : 0);
+
+    if (isSwapchainOutOfDate) {
+      if (!recreateSwapchain(frameCount)) {
+        // nothing to render into until the surface has an area again
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        continue;
+      }
+
+      isSwapchainOutOfDate = false;
     }
 
     uint32_t currentImageIndex = -1;
@@ -1409,10 +2556,119 @@ int main() {
                               imageAvailableSemaphoreHandleList[currentFrame],
                               VK_NULL_HANDLE, &currentImageIndex);
 
-    if (result != VK_SUCCESS) {
+    // nothing was acquired and the semaphore stays unsignaled, the frame is
+    // retried with a new swapchain
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+      isSwapchainOutOfDate = true;
+      continue;
+    }
+
+    if (result == VK_SUBOPTIMAL_KHR) {
+      isSwapchainOutOfDate = true;
+    } else if (result != VK_SUCCESS) {
       throwExceptionVulkanAPI(result, "vkAcquireNextImageKHR");
     }
 
+    // time blocked on the fence and the presentation engine is not counted
+    // as cpu time
+    std::chrono::steady_clock::time_point acquireTimePoint =
+        std::chrono::steady_clock::now();
+
+    // the command buffer and timestamp queries belong to the image, so the
+    // previous frame that rendered into it has to retire before they are reused
+    if (imageInFlightFenceHandleList[currentImageIndex] != VK_NULL_HANDLE) {
+      result = vkWaitForFences(deviceHandle, 1,
+                               &imageInFlightFenceHandleList[currentImageIndex],
+                               true, UINT64_MAX);
+
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkWaitForFences");
+      }
+
+      if (timestampQueryPoolHandle != VK_NULL_HANDLE) {
+        uint64_t timestampList[2];
+        result = vkGetQueryPoolResults(
+            deviceHandle, timestampQueryPoolHandle,
+            currentImageIndex * timestampQueryCount, timestampQueryCount,
+            sizeof(timestampList), timestampList, sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT);
+
+        if (result != VK_SUCCESS && result != VK_NOT_READY) {
+          throwExceptionVulkanAPI(result, "vkGetQueryPoolResults");
+        }
+
+        if (result == VK_SUCCESS) {
+          gpuRenderPassTimeSum +=
+              ((timestampList[1] - timestampList[0]) & timestampMask) *
+              physicalDeviceProperties.limits.timestampPeriod / 1000000.0;
+          gpuRenderPassTimeCount += 1;
+        }
+      }
+    }
+
+    imageInFlightFenceHandleList[currentImageIndex] =
+        inFlightFenceHandleList[currentFrame];
+
+    std::chrono::steady_clock::time_point inputTimePoint =
+        std::chrono::steady_clock::now();
+    sampleCamera();
+
+    uniformStructure.frameCount += 1;
+    memcpy((char *)hostUniformMemoryBuffer +
+               currentImageIndex * uniformSlotSize,
+           &uniformStructure, sizeof(UniformStructure));
+
+    result = vkResetFences(deviceHandle, 1,
+                           &inFlightFenceHandleList[currentFrame]);
+
+    if (result != VK_SUCCESS) {
+      throwExceptionVulkanAPI(result, "vkResetFences");
+    }
+
+    if (isLowLatencyEnabled ||
+        !isCommandBufferRecordedList[currentImageIndex]) {
+      result = vkResetCommandBuffer(commandBufferHandleList[currentImageIndex],
+                                    0);
+
+      if (result != VK_SUCCESS) {
+        throwExceptionVulkanAPI(result, "vkResetCommandBuffer");
+      }
+
+      recordCommandBuffer(currentImageIndex);
+      isCommandBufferRecordedList[currentImageIndex] = !isLowLatencyEnabled;
+    }
+
+    std::chrono::steady_clock::time_point currentTimePoint =
+        std::chrono::steady_clock::now();
+    std::chrono::duration<double> reportDuration =
+        currentTimePoint - reportTimePoint;
+
+    if (reportDuration.count() >= 1.0 && frameCount > frameCountReported) {
+      std::cout << "frames/s: "
+                << (frameCount - frameCountReported) / reportDuration.count()
+                << ", cpu time (ms): "
+                << cpuTimeSum / (frameCount - frameCountReported);
+
+      if (gpuRenderPassTimeCount > 0) {
+        std::cout << ", gpu render pass (ms): "
+                  << gpuRenderPassTimeSum / gpuRenderPassTimeCount;
+      }
+
+      if (latencyCount > 0) {
+        std::cout << ", " << latencyName << ": " << latencySum / latencyCount;
+      }
+
+      std::cout << std::endl;
+
+      frameCountReported = frameCount;
+      cpuTimeSum = 0;
+      gpuRenderPassTimeSum = 0;
+      gpuRenderPassTimeCount = 0;
+      latencySum = 0;
+      latencyCount = 0;
+      reportTimePoint = currentTimePoint;
+    }
+
     VkPipelineStageFlags pipelineStageFlags =
         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
@@ -1423,9 +2679,10 @@ int main() {
         .pWaitSemaphores = &imageAvailableSemaphoreHandleList[currentFrame],
         .pWaitDstStageMask = &pipelineStageFlags,
         .commandBufferCount = 1,
-        .pCommandBuffers = &commandBufferHandleList[currentFrame],
+        .pCommandBuffers = &commandBufferHandleList[currentImageIndex],
         .signalSemaphoreCount = 1,
-        .pSignalSemaphores = &renderFinishedSemaphoreHandleList[currentFrame]};
+        .pSignalSemaphores =
+            &renderFinishedSemaphoreHandleList[currentImageIndex]};
 
     result = vkQueueSubmit(queueHandle, 1, &submitInfo,
                            inFlightFenceHandleList[currentFrame]);
@@ -1434,11 +2691,19 @@ int main() {
       throwExceptionVulkanAPI(result, "vkQueueSubmit");
     }
 
+    uint64_t presentId = frameCount + 1;
+    VkPresentIdKHR presentIdInfo = {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+        .pNext = NULL,
+        .swapchainCount = 1,
+        .pPresentIds = &presentId};
+
     VkPresentInfoKHR presentInfo = {
         .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-        .pNext = NULL,
+        .pNext = isPresentWaitEnabled ? &presentIdInfo : NULL,
         .waitSemaphoreCount = 1,
-        .pWaitSemaphores = &renderFinishedSemaphoreHandleList[currentFrame],
+        .pWaitSemaphores =
+            &renderFinishedSemaphoreHandleList[currentImageIndex],
         .swapchainCount = 1,
         .pSwapchains = &swapchainHandle,
         .pImageIndices = &currentImageIndex,
@@ -1446,13 +2711,51 @@ int main() {
 
     result = vkQueuePresentKHR(queueHandle, &presentInfo);
 
-    if (result != VK_SUCCESS) {
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+      isSwapchainOutOfDate = true;
+    } else if (result != VK_SUCCESS) {
       throwExceptionVulkanAPI(result, "vkQueuePresentKHR");
     }
 
-    currentFrame = (currentFrame + 1) % swapchainImageCount;
+    pendingFrameList.push_back({.presentId = presentId,
+                                .frameIndex = currentFrame,
+                                .inputTimePoint = inputTimePoint});
+
+    cpuTimeSum += std::chrono::duration<double, std::milli>(
+                      std::chrono::steady_clock::now() - acquireTimePoint)
+                      .count();
+    frameCount += 1;
+
+    currentFrame = (currentFrame + 1) % frameInFlightCount;
+  }
+
+  // =========================================================================
+  // Statistics
+
+  double totalSeconds = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - startTimePoint)
+                            .count();
+
+  std::cout << "present mode: " << getPresentModeName(selectedPresentMode)
+            << ", low latency: " << (isLowLatencyEnabled ? "on" : "off")
+            << ", swapchain recreations: " << swapchainRecreateCount
+            << std::endl;
+
+  std::cout << "rendering: "
+            << (isDynamicRenderingEnabled ? "dynamic" : "render pass")
+            << ", render pass and framebuffer creation (ms): "
+            << renderPassObjectCreationTime << std::endl;
+
+  std::cout << "frames: " << frameCount << ", seconds: " << totalSeconds
+            << ", frames/s: " << frameCount / totalSeconds;
+
+  if (totalLatencyCount > 0) {
+    std::cout << ", " << latencyName << ": "
+              << totalLatencySum / totalLatencyCount;
   }
 
+  std::cout << std::endl;
+
   // =========================================================================
   // Cleanup
 
@@ -1462,12 +2765,16 @@ int main() {
     throwExceptionVulkanAPI(result, "vkDeviceWaitIdle");
   }
 
-  for (uint32_t x = 0; x < swapchainImageCount; x++) {
-    vkDestroySemaphore(deviceHandle, renderFinishedSemaphoreHandleList[x], NULL);
+  if (timestampQueryPoolHandle != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(deviceHandle, timestampQueryPoolHandle, NULL);
+  }
+
+  for (uint32_t x = 0; x < frameInFlightCount; x++) {
     vkDestroySemaphore(deviceHandle, imageAvailableSemaphoreHandleList[x], NULL);
     vkDestroyFence(deviceHandle, inFlightFenceHandleList[x], NULL);
   }
 
+  vkUnmapMemory(deviceHandle, uniformDeviceMemoryHandle);
   vkFreeMemory(deviceHandle, uniformDeviceMemoryHandle, NULL);
   vkDestroyBuffer(deviceHandle, uniformBufferHandle, NULL);
 
@@ -1476,6 +2783,28 @@ int main() {
   vkFreeMemory(deviceHandle, vertexDeviceMemoryHandle, NULL);
   vkDestroyBuffer(deviceHandle, vertexBufferHandle, NULL);
   vkDestroyPipeline(deviceHandle, graphicsPipelineHandle, NULL);
+
+  size_t pipelineCacheDataSize = 0;
+  result = vkGetPipelineCacheData(deviceHandle, pipelineCacheHandle,
+                                  &pipelineCacheDataSize, NULL);
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkGetPipelineCacheData");
+  }
+
+  std::vector<char> pipelineCacheData(pipelineCacheDataSize);
+  result = vkGetPipelineCacheData(deviceHandle, pipelineCacheHandle,
+                                  &pipelineCacheDataSize,
+                                  pipelineCacheData.data());
+
+  if (result != VK_SUCCESS) {
+    throwExceptionVulkanAPI(result, "vkGetPipelineCacheData");
+  }
+
+  pipelineCacheData.resize(pipelineCacheDataSize);
+  writePipelineCacheFile(pipelineCachePath, pipelineCacheData);
+
+  vkDestroyPipelineCache(deviceHandle, pipelineCacheHandle, NULL);
   vkDestroyShaderModule(deviceHandle, fragmentShaderModuleHandle, NULL);
   vkDestroyShaderModule(deviceHandle, vertexShaderModuleHandle, NULL);
   vkDestroyPipelineLayout(deviceHandle, pipelineLayoutHandle, NULL);
@@ -1483,13 +2812,18 @@ int main() {
   vkDestroyDescriptorSetLayout(deviceHandle, descriptorSetLayoutHandle, NULL);
   vkDestroyDescriptorPool(deviceHandle, descriptorPoolHandle, NULL);
 
-  for (uint32_t x = 0; x < swapchainImageCount; x++) {
-    vkDestroyFramebuffer(deviceHandle, framebufferHandleList[x], NULL);
-    vkDestroyImageView(deviceHandle, swapchainImageViewHandleList[x], NULL);
+  for (const RetiredSwapchain &retired : retiredSwapchainList) {
+    destroyRetiredSwapchain(retired);
   }
 
+  destroyRetiredSwapchain({.swapchainHandle = swapchainHandle,
+                           .imageViewHandleList = swapchainImageViewHandleList,
+                           .framebufferHandleList = framebufferHandleList,
+                           .renderFinishedSemaphoreHandleList =
+                               renderFinishedSemaphoreHandleList,
+                           .retireFrameCount = frameCount});
+
   vkDestroyRenderPass(deviceHandle, renderPassHandle, NULL);
-  vkDestroySwapchainKHR(deviceHandle, swapchainHandle, NULL);
   vkDestroyCommandPool(deviceHandle, commandPoolHandle, NULL);
   vkDestroyDevice(deviceHandle, NULL);
   vkDestroySurfaceKHR(instanceHandle, surfaceHandle, NULL);
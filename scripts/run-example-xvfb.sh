@@ -0,0 +1,69 @@
+#!/bin/bash
+set -e
+
+SCRIPT_PATH="$( cd -- "$(dirname "$0")" >/dev/null 2>&1 ; pwd -P )"
+
+ICD="lavapipe"
+SCREEN="1280x720x24"
+ARGUMENTS="--seconds=10"
+TOOLCHAIN="x86_64-linux-gnu"
+if [[ ! -z "${VULKAN_TOOLCHAIN}" ]]
+then
+  TOOLCHAIN=${VULKAN_TOOLCHAIN}
+fi
+
+for i in "$@"
+do
+  case $i in
+    -e=*|--example=*)
+      EXAMPLE="${i#*=}"
+    ;;
+    -i=*|--icd=*)
+      ICD="${i#*=}"
+    ;;
+    -s=*|--screen=*)
+      SCREEN="${i#*=}"
+    ;;
+    -a=*|--arguments=*)
+      ARGUMENTS="${i#*=}"
+    ;;
+    -tc=*|--toolchain=*)
+      TOOLCHAIN="${i#*=}"
+    ;;
+    *)
+      echo "Usage: run-example-xvfb.sh --example=TARGET_EXAMPLE"
+      echo "  -e,   --example=TARGET_EXAMPLE"
+      echo "  -i,   --icd=ICD (see select-icd.sh, default lavapipe)"
+      echo "  -s,   --screen=WIDTHxHEIGHTxDEPTH"
+      echo "  -a,   --arguments=\"EXAMPLE_ARGUMENTS\""
+      echo "  -tc,  --toolchain=PATH_TO_TOOLCHAIN_FILE"
+      echo ""
+      echo "Runs an installed example on a virtual X server, e.g."
+      echo "  run-example-xvfb.sh --example=triangle --arguments=\"--frames=600\""
+      exit
+    ;;
+  esac
+done
+
+if [ "${EXAMPLE}" == "" ]
+then
+  echo "No example given, see --help"
+  exit 1
+fi
+
+if ! command -v xvfb-run >/dev/null 2>&1
+then
+  echo "xvfb-run not found (install xvfb)"
+  exit 1
+fi
+
+EXAMPLE_PATH="$(dirname ${SCRIPT_PATH})/_out/${TOOLCHAIN}/install/bin/${EXAMPLE}"
+if [ ! -x "${EXAMPLE_PATH}" ]
+then
+  echo "${EXAMPLE_PATH} not found, run install-example.sh first"
+  exit 1
+fi
+
+source ${SCRIPT_PATH}/select-icd.sh ${ICD}
+
+xvfb-run -a -s "-screen 0 ${SCREEN}" ${EXAMPLE_PATH} ${ARGUMENTS}
@@ -24,6 +24,8 @@ elif [ "$1" = "intel" ] || [ "$1" = "7" ]; then
   ICD="intel_icd.x86_64.json"
 elif [ "$1" = "intel_hasvk" ] || [ "$1" = "8" ]; then
   ICD="intel_hasvk_icd.x86_64.json"
+elif [ "$1" = "lavapipe" ] || [ "$1" = "9" ]; then
+  ICD="lvp_icd.x86_64.json"
 else
   echo "1)  playground:   Experimental Open Source Driver for Vulkan (local)"
   echo "2)  radeon_git:   MESA Open Source Driver for Vulkan (local)"
@@ -33,6 +35,7 @@ else
   echo "6)  nvidia:       Nvidia Closed Source Driver for Vulkan"
   echo "7)  intel:        Intel Driver for Vulkan"
   echo "8)  intel_hasvk:  Intel Haswell Driver for Vulkan"
+  echo "9)  lavapipe:     MESA Software Rasterizer for Vulkan"
 fi
 
 if [ "$ICD" != "" ]; then